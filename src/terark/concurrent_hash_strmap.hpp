@@ -0,0 +1,583 @@
+#pragma once
+
+#include "fstring.hpp"
+#include "valvec.hpp"
+#include <terark/util/throw.hpp>
+#include <boost/noncopyable.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#if defined(_MSC_VER)
+	#include <functional>
+#else
+	#include <terark/util/fast_getcpu.hpp>
+#endif
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+namespace terark {
+
+/// Epoch based memory reclamation for lock free readers.
+///
+/// A reader increments the counter of the current epoch parity in the
+/// stripe of the cpu it runs on, so readers on different cpus never write
+/// the same cache line. synchronize() advances the epoch and waits until
+/// the counters of the previous parity drop to 0, after that no reader can
+/// still see memory which was unlinked before synchronize().
+class concurrent_epoch : boost::noncopyable {
+public:
+	static const size_t Stripes = 64;
+
+	concurrent_epoch() : m_epoch(0) {
+		for (Stripe& s : m_stripes)
+			s.cnt[0] = 0, s.cnt[1] = 0;
+	}
+
+	/// enter a read side critical section, return the token for read_unlock
+	size_t read_lock() noexcept {
+		const size_t stripe = this_stripe();
+		for (;;) {
+			size_t e = m_epoch.load(std::memory_order_seq_cst);
+			m_stripes[stripe].cnt[e & 1].fetch_add(1, std::memory_order_seq_cst);
+			if (terark_likely(m_epoch.load(std::memory_order_seq_cst) == e))
+				return 2 * stripe + (e & 1);
+			// synchronize() is running, it may have summed this counter
+			m_stripes[stripe].cnt[e & 1].fetch_sub(1, std::memory_order_release);
+		}
+	}
+	void read_unlock(size_t token) noexcept {
+		m_stripes[token / 2].cnt[token % 2].fetch_sub(1, std::memory_order_release);
+	}
+
+	/// wait until all read side critical sections entered before this call
+	/// have exited
+	void synchronize() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t e = m_epoch.load(std::memory_order_relaxed);
+		m_epoch.store(e + 1, std::memory_order_seq_cst);
+		for (;;) {
+			intptr_t sum = 0;
+			for (const Stripe& s : m_stripes)
+				sum += s.cnt[e & 1].load(std::memory_order_seq_cst);
+			if (0 == sum)
+				break;
+			std::this_thread::yield();
+		}
+	}
+
+	class guard : boost::noncopyable {
+		concurrent_epoch& m_ep;
+		size_t m_token;
+	public:
+		explicit guard(concurrent_epoch& ep) : m_ep(ep), m_token(ep.read_lock()) {}
+		~guard() { m_ep.read_unlock(m_token); }
+	};
+
+private:
+	static size_t this_stripe() noexcept {
+	#if defined(_MSC_VER)
+		return std::hash<std::thread::id>()(std::this_thread::get_id()) % Stripes;
+	#else
+		return fast_getcpu() % Stripes;
+	#endif
+	}
+	struct alignas(64) Stripe {
+		std::atomic<intptr_t> cnt[2];
+	};
+	Stripe m_stripes[Stripes];
+	alignas(64) std::atomic<size_t> m_epoch;
+	std::mutex m_mutex;
+};
+
+/// Concurrent string map, sharded by hash, readers are lock free.
+///
+/// Each shard has a writer mutex, a seqlock, a linear probing index of
+/// tagged record pointers and its own string pool: records (key, value,
+/// hash) are appended to chunks which are never moved, so a reader which
+/// races with a writer always reads valid memory.
+///
+/// Readers take no lock: find() probes the index optimistically and
+/// retries if the shard seqlock changed, the seqlock is changed only when a
+/// value is overwritten or the index of the shard is replaced. Insert and
+/// erase publish by one atomic slot store and do not disturb readers.
+///
+/// Rehash is incremental: a full index is replaced by a larger one and each
+/// later write of the shard moves MigrateStep slots of the old index to the
+/// new one, readers probe both. Erased records are reclaimed by compacting
+/// the shard when they take more than half of its string pool. Old indexes
+/// and chunks are freed by the writer after concurrent_epoch::synchronize,
+/// outside the shard lock.
+///
+/// Value must be trivially copyable, find() copies it out and a torn copy
+/// is discarded by the seqlock check.
+template<class Value, class HashFunc = fstring_func::hash>
+class concurrent_hash_strmap : boost::noncopyable {
+	static_assert(std::is_trivially_copyable<Value>::value,
+				  "Value must be trivially copyable");
+	struct Record {
+		uint32_t klen;
+		uint32_t hlow; // low 32 bits of the mixed hash, for rehash
+		Value    value;
+		const char* key() const { return (const char*)(this + 1); }
+		      char* key()       { return (      char*)(this + 1); }
+	};
+	static const size_t RecAlign = alignof(Record) < 8 ? 8 : alignof(Record);
+
+	// slot: record pointer in the low 48 bits, hash tag in the high 16 bits
+	static const uint64_t kEmpty = 0;
+	static const uint64_t kTomb = 1;
+	static const uint64_t PtrMask = (uint64_t(1) << 48) - 1;
+
+	struct Index {
+		size_t cap;  // power of 2
+		size_t live; // written and read only by writers
+		size_t used; // live + tombstones
+		std::atomic<uint64_t> slot[1];
+	};
+
+	struct alignas(64) Shard {
+		std::atomic<size_t> seq;
+		std::atomic<Index*> cur;
+		std::atomic<Index*> old; // migrating to cur, or NULL
+		std::atomic<size_t> size;
+		std::mutex     mutex;
+		size_t         migrate_pos;
+		valvec<char*>  chunks;
+		char*          chunk_pos;
+		char*          chunk_end;
+		size_t         chunk_size; // size of the next chunk
+		size_t         live_bytes;
+		size_t         dead_bytes;
+		Shard() : seq(0), cur(NULL), old(NULL), size(0) {
+			migrate_pos = 0;
+			chunk_pos = chunk_end = NULL;
+			chunk_size = MinChunkSize;
+			live_bytes = dead_bytes = 0;
+		}
+	};
+
+	struct Found {
+		Index* index;
+		size_t pos;
+		Record* rec;
+	};
+
+	std::unique_ptr<Shard[]> m_shards;
+	size_t m_shard_bits;
+	mutable concurrent_epoch m_epoch;
+
+public:
+	static const size_t MinChunkSize = 4 * 1024;
+	static const size_t MaxChunkSize = 1024 * 1024;
+	static const size_t MigrateStep = 64;
+
+	/// @param shard_bits 2^shard_bits shards
+	explicit concurrent_hash_strmap(size_t shard_bits = 6) {
+		if (shard_bits > 16) {
+			THROW_STD(invalid_argument, "shard_bits = %zd is too large", shard_bits);
+		}
+		m_shard_bits = shard_bits;
+		m_shards.reset(new Shard[size_t(1) << shard_bits]);
+	}
+	~concurrent_hash_strmap() {
+		for (size_t i = 0, n = num_shards(); i < n; ++i)
+			free_shard(m_shards[i]);
+	}
+
+	size_t num_shards() const { return size_t(1) << m_shard_bits; }
+
+	/// the sum of the shard sizes, it is exact if no concurrent writers
+	size_t size() const {
+		size_t n = 0;
+		for (size_t i = 0, k = num_shards(); i < k; ++i)
+			n += m_shards[i].size.load(std::memory_order_relaxed);
+		return n;
+	}
+	bool empty() const { return size() == 0; }
+
+	/// lock free, copy the value to *val if val is not NULL
+	bool find(fstring key, Value* val) const {
+		const size_t h = hash(key);
+		const Shard& s = shard_of(h);
+		concurrent_epoch::guard guard(m_epoch);
+		for (;;) {
+			size_t seq = s.seq.load(std::memory_order_acquire);
+			if (terark_likely(!(seq & 1))) {
+				const Record* r = lookup(s, h, key);
+				if (r && val)
+					memcpy((void*)val, &r->value, sizeof(Value));
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (terark_likely(s.seq.load(std::memory_order_relaxed) == seq))
+					return NULL != r;
+			}
+		#if defined(__SSE2__)
+			_mm_pause();
+		#endif
+		}
+	}
+	bool exists(fstring key) const { return find(key, NULL); }
+
+	/// @return true if inserted, false if key existed, the value is unchanged
+	bool insert_i(fstring key, const Value& val = Value()) {
+		return write(key, true, [&](Shard& s, size_t h, Found f, valvec<void*>&) {
+			if (f.rec)
+				return false;
+			add(s, h, key, val);
+			return true;
+		});
+	}
+
+	/// @return true if inserted, false if the existing value was assigned
+	bool insert_or_assign(fstring key, const Value& val) {
+		return write(key, true, [&](Shard& s, size_t h, Found f, valvec<void*>&) {
+			if (f.rec) {
+				s.seq.fetch_add(1, std::memory_order_acq_rel);
+				std::atomic_thread_fence(std::memory_order_release);
+				memcpy((void*)&f.rec->value, &val, sizeof(Value));
+				s.seq.fetch_add(1, std::memory_order_release);
+				return false;
+			}
+			add(s, h, key, val);
+			return true;
+		});
+	}
+
+	size_t erase(fstring key) { return erase(key, NULL); }
+
+	/// @return number of erased keys(0 or 1), copy the value to *erased
+	size_t erase(fstring key, Value* erased) {
+		return write(key, false, [&](Shard& s, size_t, Found f, valvec<void*>& retired) {
+			if (!f.rec)
+				return size_t(0);
+			if (erased)
+				memcpy((void*)erased, &f.rec->value, sizeof(Value));
+			f.index->slot[f.pos].store(kTomb, std::memory_order_release);
+			f.index->live--;
+			s.size.fetch_sub(1, std::memory_order_relaxed);
+			size_t bytes = record_bytes(f.rec->klen);
+			s.live_bytes -= bytes;
+			s.dead_bytes += bytes;
+			if (s.dead_bytes > s.live_bytes && s.dead_bytes >= 4 * MinChunkSize)
+				compact(s, retired);
+			return size_t(1);
+		});
+	}
+
+	/// op(fstring key, const Value& val), each shard is locked while it is
+	/// visited, readers are not blocked
+	template<class Op>
+	void for_each(Op op) const {
+		for (size_t i = 0, n = num_shards(); i < n; ++i) {
+			Shard& s = m_shards[i];
+			std::lock_guard<std::mutex> lock(s.mutex);
+			for (Index* t : {s.old.load(std::memory_order_relaxed),
+							 s.cur.load(std::memory_order_relaxed)}) {
+				if (!t) continue;
+				for (size_t j = 0; j < t->cap; ++j) {
+					uint64_t e = t->slot[j].load(std::memory_order_relaxed);
+					if (e > kTomb) {
+						const Record* r = (const Record*)(e & PtrMask);
+						op(fstring(r->key(), r->klen), r->value);
+					}
+				}
+			}
+		}
+	}
+
+	/// may run concurrently with readers and writers
+	void clear() {
+		valvec<void*> retired;
+		for (size_t i = 0, n = num_shards(); i < n; ++i) {
+			Shard& s = m_shards[i];
+			std::lock_guard<std::mutex> lock(s.mutex);
+			s.seq.fetch_add(1, std::memory_order_acq_rel);
+			Index* old = s.old.exchange(NULL, std::memory_order_acq_rel);
+			Index* cur = s.cur.exchange(NULL, std::memory_order_acq_rel);
+			s.seq.fetch_add(1, std::memory_order_release);
+			if (old) retired.push_back(old);
+			if (cur) retired.push_back(cur);
+			retired.append(s.chunks.begin(), s.chunks.size());
+			s.chunks.clear();
+			s.migrate_pos = 0;
+			s.chunk_pos = s.chunk_end = NULL;
+			s.chunk_size = MinChunkSize;
+			s.live_bytes = s.dead_bytes = 0;
+			s.size.store(0, std::memory_order_relaxed);
+		}
+		reclaim(retired);
+	}
+
+	/// string pool bytes(used + erased) and index bytes
+	size_t mem_size() const {
+		size_t bytes = 0;
+		for (size_t i = 0, n = num_shards(); i < n; ++i) {
+			Shard& s = m_shards[i];
+			std::lock_guard<std::mutex> lock(s.mutex);
+			bytes += s.live_bytes + s.dead_bytes;
+			for (Index* t : {s.old.load(std::memory_order_relaxed),
+							 s.cur.load(std::memory_order_relaxed)})
+				if (t) bytes += sizeof(uint64_t) * t->cap;
+		}
+		return bytes;
+	}
+
+private:
+	static size_t hash(fstring key) {
+		size_t m = size_t(HashFunc()(key)) * size_t(0x9E3779B97F4A7C15ull);
+		return m ^ (m >> 32);
+	}
+	static uint64_t tag_of(size_t h) { return (h >> 16) & 0xFFFF; }
+	static size_t record_bytes(size_t klen) {
+		return (sizeof(Record) + klen + RecAlign - 1) & ~(RecAlign - 1);
+	}
+	Shard& shard_of(size_t h) const {
+		// high bits of the multiplied hash, pos and tag use the low bits
+		return m_shards[m_shard_bits ? h >> (64 - m_shard_bits) : 0];
+	}
+
+	static Index* new_index(size_t cap) {
+		assert((cap & (cap - 1)) == 0);
+		TERARK_VERIFY_LE(cap, size_t(1) << 32); // Record::hlow
+		size_t bytes = sizeof(Index) + sizeof(uint64_t) * (cap - 1);
+		Index* t = (Index*)malloc(bytes);
+		if (NULL == t) {
+			TERARK_DIE("malloc(%zd)", bytes);
+		}
+		t->cap = cap;
+		t->live = 0;
+		t->used = 0;
+		for (size_t i = 0; i < cap; ++i)
+			new(&t->slot[i]) std::atomic<uint64_t>(kEmpty);
+		return t;
+	}
+
+	static const Record*
+	lookup_index(const Index* t, size_t h, fstring key, size_t* ppos) {
+		const size_t mask = t->cap - 1;
+		const uint64_t tag = tag_of(h);
+		size_t pos = h & mask;
+		for (size_t n = 0; n <= mask; ++n, pos = (pos + 1) & mask) {
+			uint64_t e = t->slot[pos].load(std::memory_order_acquire);
+			if (kEmpty == e)
+				return NULL;
+			if ((e >> 48) == tag && kTomb != e) {
+				const Record* r = (const Record*)(e & PtrMask);
+				if (r->klen == key.size() && memcmp(r->key(), key.data(), key.size()) == 0) {
+					*ppos = pos;
+					return r;
+				}
+			}
+		}
+		return NULL;
+	}
+
+	// readers probe old before cur: a migrated slot is put to cur before it
+	// is changed to a tombstone in old
+	static const Record* lookup(const Shard& s, size_t h, fstring key) {
+		const Index* cur = s.cur.load(std::memory_order_acquire);
+		const Index* old = s.old.load(std::memory_order_acquire);
+		size_t pos;
+		if (old)
+			if (const Record* r = lookup_index(old, h, key, &pos))
+				return r;
+		if (cur)
+			return lookup_index(cur, h, key, &pos);
+		return NULL;
+	}
+
+	static Found find_in_lock(Shard& s, size_t h, fstring key) {
+		for (Index* t : {s.old.load(std::memory_order_relaxed),
+						 s.cur.load(std::memory_order_relaxed)}) {
+			size_t pos;
+			if (t)
+				if (const Record* r = lookup_index(t, h, key, &pos))
+					return Found{t, pos, const_cast<Record*>(r)};
+		}
+		return Found{NULL, 0, NULL};
+	}
+
+	static void put(Index* t, size_t h, uint64_t entry) {
+		const size_t mask = t->cap - 1;
+		size_t pos = h & mask;
+		for (;;) {
+			uint64_t e = t->slot[pos].load(std::memory_order_relaxed);
+			if (e <= kTomb) {
+				t->used += kEmpty == e;
+				t->live++;
+				t->slot[pos].store(entry, std::memory_order_release);
+				return;
+			}
+			pos = (pos + 1) & mask;
+		}
+	}
+
+	static Record* alloc_record(Shard& s, size_t klen) {
+		size_t bytes = record_bytes(klen);
+		if (terark_unlikely(size_t(s.chunk_end - s.chunk_pos) < bytes)) {
+			if (bytes > MinChunkSize / 4) {
+				// dedicated chunk, keep the current chunk
+				char* p = (char*)malloc(bytes);
+				if (NULL == p) {
+					TERARK_DIE("malloc(%zd)", bytes);
+				}
+				s.chunks.push_back(p);
+				return (Record*)p;
+			}
+			char* p = (char*)malloc(s.chunk_size);
+			if (NULL == p) {
+				TERARK_DIE("malloc(%zd)", s.chunk_size);
+			}
+			s.chunks.push_back(p);
+			s.chunk_pos = p;
+			s.chunk_end = p + s.chunk_size;
+			s.chunk_size = std::min(2 * s.chunk_size, size_t(MaxChunkSize));
+		}
+		Record* r = (Record*)s.chunk_pos;
+		s.chunk_pos += bytes;
+		return r;
+	}
+
+	static uint64_t make_entry(const Record* r, size_t h) {
+		TERARK_ASSERT_EQ((uint64_t(size_t(r)) & ~PtrMask), 0);
+		return tag_of(h) << 48 | uint64_t(size_t(r));
+	}
+
+	void add(Shard& s, size_t h, fstring key, const Value& val) {
+		if (key.size() > UINT32_MAX) {
+			THROW_STD(length_error, "key.size() = %zd is too large", key.size());
+		}
+		Record* r = alloc_record(s, key.size());
+		r->klen = uint32_t(key.size());
+		r->hlow = uint32_t(h);
+		memcpy((void*)&r->value, &val, sizeof(Value));
+		memcpy(r->key(), key.data(), key.size());
+		s.live_bytes += record_bytes(key.size());
+		put(s.cur.load(std::memory_order_relaxed), h, make_entry(r, h));
+		s.size.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// move up to `steps` slots of old index to cur
+	static void migrate(Shard& s, size_t steps, valvec<void*>& retired) {
+		Index* old = s.old.load(std::memory_order_relaxed);
+		if (!old)
+			return;
+		Index* cur = s.cur.load(std::memory_order_relaxed);
+		size_t end = std::min(old->cap, s.migrate_pos + steps);
+		for (size_t i = s.migrate_pos; i < end; ++i) {
+			uint64_t e = old->slot[i].load(std::memory_order_relaxed);
+			if (e > kTomb) {
+				const Record* r = (const Record*)(e & PtrMask);
+				put(cur, r->hlow, e);
+				old->slot[i].store(kTomb, std::memory_order_release);
+				old->live--;
+			}
+		}
+		s.migrate_pos = end;
+		if (old->cap == end) {
+			assert(0 == old->live);
+			// all keys are in cur, readers need not retry
+			s.old.store(NULL, std::memory_order_release);
+			s.migrate_pos = 0;
+			retired.push_back(old);
+		}
+	}
+
+	static size_t index_cap_for(size_t live) {
+		size_t cap = 16;
+		while (cap < 2 * (live + 1))
+			cap *= 2;
+		return cap;
+	}
+
+	// cur is full: finish the current migration, then start migrating cur
+	// to a new index, readers which have loaded cur and old must retry
+	static void grow(Shard& s, valvec<void*>& retired) {
+		migrate(s, SIZE_MAX, retired);
+		Index* cur = s.cur.load(std::memory_order_relaxed);
+		Index* t = new_index(index_cap_for(cur ? cur->live : 0));
+		s.seq.fetch_add(1, std::memory_order_acq_rel);
+		if (cur)
+			s.old.store(cur, std::memory_order_release);
+		s.cur.store(t, std::memory_order_release);
+		s.seq.fetch_add(1, std::memory_order_release);
+		s.migrate_pos = 0;
+	}
+
+	// copy the live records to new chunks with a new index, readers keep
+	// reading the current ones until they are replaced
+	static void compact(Shard& s, valvec<void*>& retired) {
+		migrate(s, SIZE_MAX, retired);
+		Index* cur = s.cur.load(std::memory_order_relaxed);
+		valvec<char*> old_chunks;
+		old_chunks.swap(s.chunks);
+		s.chunk_pos = s.chunk_end = NULL;
+		s.chunk_size = MinChunkSize;
+		s.live_bytes = s.dead_bytes = 0;
+		Index* t = new_index(index_cap_for(cur->live));
+		for (size_t i = 0; i < cur->cap; ++i) {
+			uint64_t e = cur->slot[i].load(std::memory_order_relaxed);
+			if (e > kTomb) {
+				const Record* r = (const Record*)(e & PtrMask);
+				size_t bytes = record_bytes(r->klen);
+				Record* r2 = alloc_record(s, r->klen);
+				memcpy((void*)r2, r, bytes);
+				s.live_bytes += bytes;
+				put(t, r->hlow, (e & ~PtrMask) | uint64_t(size_t(r2)));
+			}
+		}
+		s.seq.fetch_add(1, std::memory_order_acq_rel);
+		s.cur.store(t, std::memory_order_release);
+		s.seq.fetch_add(1, std::memory_order_release);
+		retired.push_back(cur);
+		retired.append(old_chunks.begin(), old_chunks.size());
+	}
+
+	// run op(shard, hash, found, retired) in the shard lock, memory retired
+	// by op is freed after the lock is released
+	template<class Op>
+	auto write(fstring key, bool may_insert, Op op)
+	-> decltype(op(std::declval<Shard&>(), size_t(0), Found(), std::declval<valvec<void*>&>()))
+	{
+		const size_t h = hash(key);
+		Shard& s = shard_of(h);
+		valvec<void*> retired;
+		decltype(op(s, h, Found(), retired)) ret;
+		{
+			std::lock_guard<std::mutex> lock(s.mutex);
+			migrate(s, MigrateStep, retired);
+			Found f = find_in_lock(s, h, key);
+			if (!f.rec && may_insert) {
+				// keep room for the insert and the pending slots of old
+				Index* cur = s.cur.load(std::memory_order_relaxed);
+				Index* old = s.old.load(std::memory_order_relaxed);
+				size_t pending = old ? old->live : 0;
+				if (!cur || 4 * (cur->used + pending + 1) > 3 * cur->cap)
+					grow(s, retired);
+			}
+			ret = op(s, h, f, retired);
+		}
+		reclaim(retired);
+		return ret;
+	}
+
+	void reclaim(valvec<void*>& retired) {
+		if (retired.empty())
+			return;
+		m_epoch.synchronize();
+		for (void* p : retired)
+			free(p);
+	}
+
+	static void free_shard(Shard& s) {
+		free(s.old.load(std::memory_order_relaxed));
+		free(s.cur.load(std::memory_order_relaxed));
+		for (char* p : s.chunks)
+			free(p);
+	}
+};
+
+} // namespace terark
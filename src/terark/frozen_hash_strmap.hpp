@@ -0,0 +1,262 @@
+#pragma once
+
+#include "fstring.hpp"
+#include "valvec.hpp"
+#include <terark/io/FileStream.hpp>
+#include <terark/util/mmap.hpp>
+#include <terark/util/perfect_hash.hpp>
+#include <terark/util/throw.hpp>
+#include <type_traits>
+
+namespace terark {
+
+/// Read only string map, frozen from a populated hash_strmap (or any map
+/// which has beg_i/next_i/end_i/key/val) into a MinimalPerfectHash, the
+/// string pool and a value array, all ordered by the perfect hash, in a
+/// single memory block:
+///
+///   Header | MinimalPerfectHash | values | offsets | string pool
+///
+/// It is saved by save_mmap and loaded by load_mmap or risk_set_data with
+/// no rebuild. find_i is one perfect hash lookup, one offsets read and one
+/// key compare, a missing key is rejected by the key compare. The index
+/// space is about 3 bits per key above the keys and values.
+///
+/// Value must be trivially copyable, the file is not portable across
+/// endianness.
+template<class Value>
+class frozen_hash_strmap {
+	static_assert(std::is_trivially_copyable<Value>::value,
+				  "Value must be trivially copyable");
+public:
+	struct Header {
+		char     magic[16];
+		uint64_t size;
+		uint64_t value_size;
+		uint64_t mph_bytes;
+		uint64_t pool_bytes;
+		uint8_t  offset_bytes; // 4 or 8
+		uint8_t  format_version;
+		uint8_t  padding[14];
+	};
+	static_assert(sizeof(Header) == 64, "sizeof(Header) must be 64");
+	static constexpr char Magic[] = "frozen_strmap";
+
+private:
+	valvec<byte_t>     m_data; // when built by freeze
+	MmapWholeFile      m_mmap; // when loaded by load_mmap
+	MinimalPerfectHash m_mph;  // point into m_data or m_mmap
+	const Value*       m_values;
+	const byte_t*      m_offsets;
+	const char*        m_pool;
+	size_t             m_size;
+	size_t             m_offset_bytes;
+
+	static size_t offsets_mem_size(size_t num, size_t offset_bytes) {
+		return align_up(offset_bytes * (num + 1), 16);
+	}
+	size_t offset(size_t idx) const {
+		if (4 == m_offset_bytes)
+			return unaligned_load<uint32_t>(m_offsets + 4 * idx);
+		else
+			return size_t(unaligned_load<uint64_t>(m_offsets + 8 * idx));
+	}
+
+public:
+	frozen_hash_strmap() {
+		m_values = NULL;
+		m_offsets = NULL;
+		m_pool = NULL;
+		m_size = 0;
+		m_offset_bytes = 4;
+	}
+	~frozen_hash_strmap() { clear(); }
+
+	/// copy the keys and values of map, map must be not empty
+	template<class Map>
+	void freeze(const Map& map) {
+		valvec<size_t> ids(map.size(), valvec_reserve());
+		size_t pool_bytes = 0;
+		for (size_t i = map.beg_i(); i < map.end_i(); i = map.next_i(i)) {
+			ids.push_back(i);
+			pool_bytes += map.key(i).size();
+		}
+		const size_t num = ids.size();
+		if (0 == num) {
+			THROW_STD(invalid_argument, "map is empty");
+		}
+		MinimalPerfectHash mph;
+		mph.build(num, [&](size_t k) { return fstring(map.key(ids[k])); });
+
+		const size_t offset_bytes = pool_bytes < UINT32_MAX ? 4 : 8;
+		const size_t hsize = sizeof(Header);
+		const size_t msize = mph.mem_size();
+		const size_t vsize = align_up(sizeof(Value) * num, 16);
+		const size_t osize = offsets_mem_size(num, offset_bytes);
+		const size_t psize = align_up(pool_bytes, 16);
+		const size_t total = hsize + msize + vsize + osize + psize;
+		valvec<byte_t> data(total, valvec_reserve());
+		data.resize(total, 0);
+		auto header = (Header*)data.data();
+		memcpy(header->magic, Magic, sizeof(Magic));
+		header->size = num;
+		header->value_size = sizeof(Value);
+		header->mph_bytes = msize;
+		header->pool_bytes = pool_bytes;
+		header->offset_bytes = uint8_t(offset_bytes);
+		header->format_version = 0;
+		memcpy(data.data() + hsize, mph.data(), msize);
+
+		// place the keys in perfect hash order
+		byte_t* values = data.data() + hsize + msize;
+		byte_t* offsets = values + vsize;
+		char*   pool = (char*)offsets + osize;
+		valvec<size_t> order(num, valvec_no_init());
+		for (size_t k = 0; k < num; ++k)
+			order[mph.lookup(map.key(ids[k]))] = ids[k];
+		size_t pos = 0;
+		for (size_t j = 0; j < num; ++j) {
+			fstring key = map.key(order[j]);
+			memcpy(values + sizeof(Value) * j, &map.val(order[j]), sizeof(Value));
+			if (4 == offset_bytes)
+				unaligned_save<uint32_t>(offsets + 4 * j, uint32_t(pos));
+			else
+				unaligned_save<uint64_t>(offsets + 8 * j, uint64_t(pos));
+			memcpy(pool + pos, key.data(), key.size());
+			pos += key.size();
+		}
+		if (4 == offset_bytes)
+			unaligned_save<uint32_t>(offsets + 4 * num, uint32_t(pos));
+		else
+			unaligned_save<uint64_t>(offsets + 8 * num, uint64_t(pos));
+		clear();
+		m_data.swap(data);
+		risk_set_data(m_data.data(), m_data.size());
+	#if !defined(NDEBUG)
+		for (size_t k = 0; k < num; ++k) {
+			size_t idx = find_i(map.key(ids[k]));
+			assert(idx < num);
+			assert(memcmp(&val(idx), &map.val(ids[k]), sizeof(Value)) == 0);
+		}
+	#endif
+	}
+
+	size_t size() const { return m_size; }
+	bool  empty() const { return 0 == m_size; }
+	size_t beg_i() const { return 0; }
+	size_t end_i() const { return m_size; }
+	size_t next_i(size_t idx) const { return idx + 1; }
+
+	/// return end_i() if not found
+	size_t find_i(fstring key) const {
+		if (terark_unlikely(0 == m_size))
+			return 0;
+		size_t idx = m_mph.lookup(key);
+		size_t beg = offset(idx);
+		size_t end = offset(idx + 1);
+		if (end - beg == size_t(key.size()) &&
+				memcmp(m_pool + beg, key.data(), key.size()) == 0)
+			return idx;
+		return m_size;
+	}
+	bool exists(fstring key) const { return find_i(key) != m_size; }
+
+	fstring key(size_t idx) const {
+		assert(idx < m_size);
+		size_t beg = offset(idx);
+		return fstring(m_pool + beg, offset(idx + 1) - beg);
+	}
+	const Value& val(size_t idx) const {
+		assert(idx < m_size);
+		return m_values[idx];
+	}
+
+	const byte_t* data() const { return m_size ? m_mph.data() - sizeof(Header) : NULL; }
+	size_t mem_size() const {
+		return m_size ? sizeof(Header) + m_mph.mem_size()
+			+ align_up(sizeof(Value) * m_size, 16)
+			+ offsets_mem_size(m_size, m_offset_bytes)
+			+ align_up(offset(m_size), 16) : 0;
+	}
+	/// bytes of the perfect hash, per key it is about 3 bits
+	size_t index_mem_size() const { return m_mph.mem_size(); }
+
+	void save_mmap(function<void(const void*, size_t)> write) const {
+		write(data(), mem_size());
+	}
+	void save_mmap(fstring fpath) const {
+		FileStream fp(fpath, "wb");
+		save_mmap([&fp](const void* data, size_t size) {
+			fp.ensureWrite(data, size);
+		});
+	}
+	void load_mmap(fstring fpath, bool populate = false) {
+		MmapWholeFile mmap(fpath.c_str(), false, populate);
+		risk_set_data(mmap.base, mmap.size);
+		m_mmap.swap(mmap);
+	}
+
+	/// base is not owned, it must be valid until clear(), unless it is
+	/// m_data built by freeze. The data owned before, by freeze or by
+	/// load_mmap, is freed after base is validated, on throw this object
+	/// is not changed
+	void risk_set_data(const void* base, size_t bytes) {
+		if (bytes < sizeof(Header)) {
+			THROW_STD(invalid_argument, "bytes = %zd is too small", bytes);
+		}
+		auto header = (const Header*)base;
+		if (memcmp(header->magic, Magic, sizeof(Magic)) != 0 ||
+				0 != header->format_version ||
+				sizeof(Value) != header->value_size ||
+				(4 != header->offset_bytes && 8 != header->offset_bytes)) {
+			THROW_STD(invalid_argument,
+				"bad frozen_hash_strmap header: value_size = %llu, sizeof(Value) = %zd",
+				(ullong)header->value_size, sizeof(Value));
+		}
+		const size_t num = size_t(header->size);
+		const size_t msize = size_t(header->mph_bytes);
+		const size_t vsize = align_up(sizeof(Value) * num, 16);
+		const size_t osize = offsets_mem_size(num, header->offset_bytes);
+		const size_t psize = align_up(size_t(header->pool_bytes), 16);
+		if (sizeof(Header) + msize + vsize + osize + psize != bytes) {
+			THROW_STD(invalid_argument,
+				"bad frozen_hash_strmap: bytes = %zd, size = %zd", bytes, num);
+		}
+		const byte_t* mph_base = (const byte_t*)(header + 1);
+		MinimalPerfectHash mph;
+		mph.risk_set_data(mph_base, msize);
+		if (mph.size() != num) {
+			size_t mph_size = mph.size();
+			mph.risk_release_ownership();
+			THROW_STD(invalid_argument,
+				"bad frozen_hash_strmap: size = %zd, perfect hash size = %zd",
+				num, mph_size);
+		}
+		if (m_data.data() == base) { // called by freeze
+			m_mph.risk_release_ownership();
+		} else {
+			clear(); // free the data owned by freeze or load_mmap
+		}
+		m_mph.swap(mph); // mph gets the released empty one
+		m_values = (const Value*)(mph_base + msize);
+		m_offsets = mph_base + msize + vsize;
+		m_pool = (const char*)m_offsets + osize;
+		m_size = num;
+		m_offset_bytes = header->offset_bytes;
+	}
+
+	void clear() {
+		m_mph.risk_release_ownership(); // memory is owned by m_data or m_mmap
+		m_data.clear();
+		MmapWholeFile().swap(m_mmap);
+		m_values = NULL;
+		m_offsets = NULL;
+		m_pool = NULL;
+		m_size = 0;
+	}
+};
+
+template<class Value>
+constexpr char frozen_hash_strmap<Value>::Magic[];
+
+} // namespace terark
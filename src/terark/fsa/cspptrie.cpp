@@ -20,6 +20,7 @@
 #include <terark/util/profiling.hpp>
 #include <terark/num_to_str.hpp>
 #include "fast_search_byte.hpp"
+#include "levenshtein_automaton.hpp"
 
 #include <terark/util/auto_grow_circular_queue.hpp>
 #include <terark/util/auto_grow_circular_queue_matrix.hpp>
@@ -396,6 +397,12 @@ void PatriciaMem<Align>::init(ConcurrentLevel conLevel) {
     m_fd = -1;
     m_appdata_offset = size_t(-1);
     m_appdata_length = 0;
+    m_checkpoint_seq = 0;
+    m_compact_tail_age = 0;
+    m_compact_tail_beg = 0;
+    m_compact_tail_end = 0;
+    m_compact_released = 0;
+    m_compacting = false;
     m_writing_concurrent_level = conLevel;
     m_mempool_concurrent_level = conLevel;
 }
@@ -754,6 +761,66 @@ const Patricia::Stat& PatriciaMem<Align>::sync_stat() {
 #pragma GCC diagnostic ignored "-Wpmf-conversions"
 #endif
 
+static bool mmap_sync_range(void* base, size_t len, intptr_t fd) {
+#if defined(_MSC_VER)
+    if (!FlushViewOfFile(base, len) || !FlushFileBuffers((HANDLE)fd)) {
+        ERR("FlushViewOfFile(len=%zd).ErrCode=%d", len, GetLastError());
+        return false;
+    }
+#else
+    if (msync(base, len, MS_SYNC) < 0) {
+        ERR("msync(len=%zd) = %m", len);
+        return false;
+    }
+#endif
+    return true;
+}
+
+static size_t get_file_size(fstring fpath) {
+    struct stat st;
+    if (::stat(fpath.c_str(), &st) < 0) {
+        return 0; // not exists
+    }
+    return size_t(st.st_size);
+}
+
+// DFA_MmapHeader::reserve1 of file backed PatriciaMem:
+//   reserve1[0] is checkpoint seq
+//   reserve1[1] is dirty flag, set when opened for write, cleared on clean
+//               close after all data are synced
+static void check_reopen_image(fstring mem, fstring fpath,
+                               size_t align, size_t valsize) {
+    auto h = (const DFA_MmapHeader*)mem.data();
+    if (size_t(mem.size()) < sizeof(DFA_MmapHeader) || 13 != h->magic_len ||
+            memcmp(h->magic, "nark-dfa-mmap", 13) != 0 ||
+            sizeof(DFA_MmapHeader) != h->header_size) {
+        THROW_STD(invalid_argument, "%s is not a Patricia", fpath.c_str());
+    }
+    if (1 != h->num_blocks || sizeof(DFA_MmapHeader) != h->blocks[0].offset ||
+            h->blocks[0].endpos() > size_t(mem.size()) ||
+            align * h->total_states != h->blocks[0].length) {
+        THROW_STD(invalid_argument, "%s is not a Patricia: bad blocks", fpath.c_str());
+    }
+    if (valsize != h->louds_dfa_min_cross_dst) {
+        THROW_STD(logic_error, "%s: valsize = %zd, but image.valsize = %zd",
+                  fpath.c_str(), valsize, size_t(h->louds_dfa_min_cross_dst));
+    }
+    if (h->reserve1[1]) {
+        THROW_STD(logic_error,
+            "%s was not cleanly closed, recover from a checkpoint", fpath.c_str());
+    }
+}
+
+template<size_t Align>
+void PatriciaMem<Align>::mmap_set_dirty(bool dirty) {
+    auto h = const_cast<DFA_MmapHeader*>(mmap_base);
+    h->reserve1[1] = dirty;
+    h->crc32cLevel = 0; // image will be changed inplace, crc is stale
+    if (!mmap_sync_range(h, sizeof(DFA_MmapHeader), m_fd) && dirty) {
+        THROW_STD(runtime_error, "%s: sync dirty flag fail", m_mmap_fpath.c_str());
+    }
+}
+
 template<size_t Align>
 void PatriciaMem<Align>::mempool_set_readonly() {
   if (m_is_virtual_alloc && mmap_base) {
@@ -763,13 +830,15 @@ void PatriciaMem<Align>::mempool_set_readonly() {
     auto base = (byte_t*)mmap_base;
     TERARK_VERIFY_EQ(m_mempool.data(), (byte_t*)(mmap_base + 1));
     size_t realsize = sizeof(DFA_MmapHeader) + m_mempool.size();
+    // data must be durable before the header says the image is clean
+    if (mmap_sync_range(base, realsize, m_fd)) {
+        mmap_set_dirty(false);
+    }
 #if defined(_MSC_VER)
-    FlushViewOfFile(base, realsize); // this flush is async
         // windows can not unmap unused address range
 #else
     size_t filesize = sizeof(DFA_MmapHeader) + m_mempool.capacity();
     size_t alignedsize = pow2_align_up(realsize, 4*1024);
-    //msync(base, realsize, MS_ASYNC);
     if (filesize > alignedsize) {
         munmap(base + alignedsize, filesize - alignedsize);
     }
@@ -843,6 +912,7 @@ MainPatricia::MainPatricia(size_t valsize, intptr_t maxMem,
     if (m_is_virtual_alloc && mmap_base) {
         TERARK_VERIFY_GE(m_fd, 0);
         get_stat((DFA_MmapHeader*)mmap_base); // init header
+        mmap_set_dirty(true); // until clean close in mempool_set_readonly
     }
     set_insert_func(m_writing_concurrent_level);
 }
@@ -897,6 +967,7 @@ try
     case     NoWriteReadOnly: memset(&m_mempool_lock_free, 0, sizeof(m_mempool_lock_free)); break; // do nothing
     }
     HugePageEnum use_hugepage = HugePageEnum::kNone;
+    bool reopen = false;
     if (!fpath.empty() && '?' == fpath[0]) {
         // indicate fpath is a config string
         if (const char* valstr = fpath.strstr("hugepage=")) {
@@ -919,6 +990,22 @@ try
                 bool valval = parseBooleanRelaxed(valstr, false);
                 m_mempool_lock_free.m_vm_explicit_commit = valval;
             }
+            if (const char* valstr = fpath.strstr("numa=")) {
+                valstr += strlen("numa=");
+                bool valval = parseBooleanRelaxed(valstr, false);
+                if (!m_mempool_lock_free.enable_numa(valval))
+                    WARN("numa is not supported, ignored: ?%s", valstr);
+            }
+            if (const char* valstr = fpath.strstr("vm_arena=")) {
+                valstr += strlen("vm_arena=");
+                bool valval = parseBooleanRelaxed(valstr, false);
+                if (valval && maxMem >= 0) // maxMem < 0 is virtual alloc
+                    m_mempool_lock_free.enable_arena();
+            }
+        }
+        if (const char* valstr = fpath.strstr("reopen=")) {
+            valstr += strlen("reopen=");
+            reopen = parseBooleanRelaxed(valstr, false);
         }
         if (const char* valstr = fpath.strstr("file_path=")) {
             valstr += strlen("file_path="); // file_path=... must be last
@@ -959,6 +1046,13 @@ try
             // TERARK_VERIFY_GT(maxMem, 0);
             maxMem = abs(maxMem);
             maximize(maxMem, 2<<20); // min is 2M
+            const bool reopened = reopen && 0 != get_file_size(fpath);
+            if (reopened) {
+                // check before mmap_write, which would extend the file
+                MmapWholeFile image(fpath);
+                check_reopen_image(image.memory(), fpath, AlignSize, m_valsize);
+                maximize(maxMem, intptr_t(image.size));
+            }
             MmapWholeFile mmap;
             mmap.size = size_t(maxMem);
             mmap.base = mmap_write(fpath, &mmap.size, &m_fd);
@@ -973,6 +1067,10 @@ try
             m_is_virtual_alloc = true;
             mmap.base = nullptr; // release ownership
             m_mmap_fpath = fpath.str();
+            if (reopened) {
+                finish_reopen(mmap_base);
+                return; // root is in the image
+            }
         }
         size_t root = new_root();
         TERARK_VERIFY_F(0 == root, "real root = %zd", root);
@@ -1223,8 +1321,6 @@ void PatriciaMem<Align>::shrink_to_fit() {}
 size_t MainPatricia::v_num_children(size_t s) const {
     return num_children(s);
 }
-void MainPatricia::compact() {}
-
 size_t
 MainPatricia::state_move_impl(const PatriciaNode* a, size_t curr,
                               auchar_t ch, size_t* child_slot)
@@ -1277,7 +1373,13 @@ const {
             size_t n_children = p->big.n_children;
             TERARK_ASSERT_BE(n_children, 7, 16);
             auto label = p->meta.c_label + 2; // do not use [0,1]
-#if defined(TERARK_PATRICIA_LINEAR_SEARCH_SMALL)
+#if defined(__SSE2__) && !defined(TERARK_PATRICIA_LINEAR_SEARCH_SMALL)
+            // all 16 label bytes are in the node, compare them at once
+            size_t idx = sse2_search_byte_max_16(label, n_children, byte_t(ch));
+            if (idx < n_children) {
+                return_on_slot(curr + 5 + idx);
+            }
+#elif defined(TERARK_PATRICIA_LINEAR_SEARCH_SMALL)
             if (byte_t(ch) <= label[n_children-1]) {
                 size_t idx = size_t(-1);
                 do idx++; while (label[idx] < byte_t(ch));
@@ -2691,6 +2793,10 @@ MainPatricia::add_state_move(size_t curr, byte_t ch,
                         }
                     }
                 }
+                if (a[curr].meta.b_is_final) { // keep value of curr
+                    tiny_memcpy_align_4(a + node + 2 + 256,
+                                        a->bytes + get_valpos(a, curr), valsize);
+                }
                 TERARK_ASSERT_EQ(nil_state, a[node+2+ch].child);
                 a[node+2+ch].child = suffix_node;
                 break;
@@ -2756,6 +2862,217 @@ MainPatricia::add_state_move(size_t curr, byte_t ch,
     return node;
 }
 
+// Nodes which are not closed are all on the path of previous key, they are
+// kept in stack; a node is closed when the key diverges above it, then all
+// its children have been written and are on the top of children stack, so
+// each node is written exactly once, with its final size.
+template<MainPatricia::ConcurrentLevel ConLevel>
+size_t MainPatricia::bulk_load_sorted_impl(const SortedKeySource& next) {
+    struct OpenNode {
+        size_t beg; // zpath beg in prev key, label is prev[beg-1]
+        size_t end; // zpath end in prev key
+        size_t child_beg;
+        bool   is_final;
+    };
+    size_t const valsize = m_valsize;
+    LazyFreeListTLS* tls = nullptr;
+    if (ConLevel >= MultiWriteMultiRead) {
+        tls = static_cast<LazyFreeListTLS*>(m_mempool_lock_free.get_tls());
+    }
+    valvec<OpenNode> stack;
+    valvec<CharTarget<uint32_t> > children;
+    valvec<byte_t> prev; // previous key
+    valvec<byte_t> vals; // vals[valsize*i] is value of stack[i]
+    auto put_node = [&](const byte_t* zp, size_t zlen, bool is_final,
+                        const byte_t* val, const CharTarget<uint32_t>* ct,
+                        size_t n) -> size_t {
+        size_t cnt_type;
+        if (n <= 6)
+            cnt_type = n;
+        else if (n <= 16)
+            cnt_type = 7;
+        else if (n > MAX_DYNA_NUM && 0 == zlen)
+            cnt_type = 15; // same as add_state_move
+        else
+            cnt_type = 8;
+        size_t skip  = s_skip_slots[cnt_type];
+        size_t slots = 15 == cnt_type ? 256 : n;
+        size_t vlen  = is_final || 15 == cnt_type ? valsize : 0;
+        size_t nodesize = AlignSize*(skip + slots) + pow2_align_up(zlen, AlignSize) + vlen;
+        size_t node = alloc_node<ConLevel>(nodesize, tls);
+        if (mem_alloc_fail == node) {
+            THROW_STD(length_error, "out of mempool capacity = %zd, loaded keys = %zd",
+                      m_mempool.capacity(), m_n_words);
+        }
+        auto a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
+        auto p = a + node;
+        memset(p, 0, AlignSize*skip);
+        p->meta.n_cnt_type = byte_t(cnt_type);
+        p->meta.b_is_final = is_final;
+        p->meta.n_zpath_len = byte_t(zlen);
+        uint32_t* slot = &p[skip].child;
+        switch (cnt_type) {
+        default:
+            for (size_t i = 0; i < n; ++i) {
+                p->meta.c_label[i] = byte_t(ct[i].ch);
+                slot[i] = ct[i].target;
+            }
+            break;
+        case 7:
+            p->big.n_children = uint16_t(n);
+            for (size_t i = 0; i < n; ++i) {
+                p[1].bytes[i] = byte_t(ct[i].ch);
+                slot[i] = ct[i].target;
+            }
+            break;
+        case 8: {
+            p->big.n_children = uint16_t(n);
+            uint32_t* bits = &p[2].child;
+            for (size_t i = 0; i < n; ++i) {
+                terark_bit_set1(bits, ct[i].ch);
+                slot[i] = ct[i].target;
+            }
+            size_t rank1 = 0;
+            for (size_t i = 0; i < 4; ++i) {
+                p[1].bytes[i] = byte_t(rank1);
+                rank1 += fast_popcount64(unaligned_load<uint64_t>(bits, i));
+            }
+            break; }
+        case 15:
+            p->big.n_children = 256;
+            p[1].big.n_children = uint16_t(n);
+            std::fill_n(slot, 256, uint32_t(nil_state));
+            for (size_t i = 0; i < n; ++i) {
+                slot[ct[i].ch] = ct[i].target;
+            }
+            break;
+        }
+        byte_t* dst = (byte_t*)(slot + slots);
+        dst = small_memcpy_align_1(dst, zp, zlen);
+        dst =  tiny_memset_align_p(dst, 0, AlignSize);
+        if (is_final)
+            memcpy(dst, val, valsize);
+        else if (vlen)
+            memset(dst, 0xAB, vlen);
+        m_n_nodes++;
+        if (zlen) {
+            m_zpath_states++;
+            m_total_zpath_len += zlen;
+        }
+        return node;
+    };
+    // close x and add it to children of its parent
+    auto close_node = [&](const OpenNode& x, size_t parent, const byte_t* val) {
+        const byte_t* zp = prev.data() + x.beg;
+        size_t zlen = x.end - x.beg;
+        size_t num = children.size() - x.child_beg;
+        size_t node;
+        if (zlen <= PT_MAX_ZPATH) {
+            node = put_node(zp, zlen, x.is_final, val, children.data() + x.child_beg, num);
+        }
+        else { // chain of link nodes, same as new_suffix_chain
+            size_t nlink = zlen / (PT_MAX_ZPATH + 1);
+            size_t tail = nlink * (PT_MAX_ZPATH + 1);
+            node = put_node(zp + tail, zlen - tail, x.is_final, val,
+                            children.data() + x.child_beg, num);
+            while (nlink--) {
+                size_t pos = nlink * (PT_MAX_ZPATH + 1);
+                CharTarget<uint32_t> link(zp[pos + PT_MAX_ZPATH], uint32_t(node));
+                node = put_node(zp + pos, PT_MAX_ZPATH, false, NULL, &link, 1);
+            }
+        }
+        if (x.is_final) {
+            m_n_words++;
+            m_adfa_total_words_len += x.end;
+            maximize(m_max_word_len, x.end);
+        }
+        children.risk_set_size(x.child_beg);
+        byte_t ch = prev[x.beg - 1];
+        if (0 == parent) { // link to root now, root is always valid
+            auto a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
+            a[2 + ch].child = uint32_t(node);
+            a[1].big.n_children++;
+        } else {
+            children.emplace_back(ch, uint32_t(node));
+        }
+    };
+    auto close_to = [&](size_t lcp) { // close nodes begin after lcp
+        while (stack.size() > 1 && stack.back().beg > lcp) {
+            OpenNode x = stack.pop_val();
+            close_node(x, stack.size() - 1, vals.data() + valsize * stack.size());
+        }
+    };
+    stack.push_back({0, 0, 0, false}); // root, always opened
+    vals.resize_no_init(valsize);
+    size_t nkeys = 0;
+    fstring key;
+    const void* value = NULL;
+    while (next(&key, &value)) {
+        size_t lcp = 0;
+        if (nkeys) {
+            size_t minlen = std::min(prev.size(), key.size());
+            while (lcp < minlen && prev[lcp] == byte_t(key[lcp])) lcp++;
+            if (key.size() == lcp || (lcp < prev.size() && byte_t(key[lcp]) < prev[lcp])) {
+                close_to(0);
+                THROW_STD(invalid_argument,
+                    "keys are not strictly ascending: nth = %zd, len = %zd",
+                    nkeys, key.size());
+            }
+        }
+        close_to(lcp);
+        size_t level = stack.size() - 1;
+        if (lcp < stack.back().end) { // split, the tail part is closed
+            OpenNode x = stack.back();
+            x.beg = lcp + 1;
+            close_node(x, level, vals.data() + valsize * level);
+            stack.back().end = lcp;
+            stack.back().is_final = false;
+        }
+        if (key.size() == lcp) { // empty key, only for the first key
+            auto a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
+            a[0].meta.b_is_final = true;
+            memcpy(a[2 + 256].bytes, value, valsize);
+            m_n_words++;
+        }
+        else {
+            stack.push_back({lcp + 1, key.size(), children.size(), true});
+            vals.resize_no_init(valsize * stack.size());
+            memcpy(vals.data() + valsize * (stack.size() - 1), value, valsize);
+        }
+        prev.assign(key.udata(), key.size());
+        nkeys++;
+    }
+    close_to(0);
+    return nkeys;
+}
+
+size_t MainPatricia::bulk_load_sorted(const SortedKeySource& next,
+                                      ConcurrentLevel finalLevel) {
+    if (NoWriteReadOnly == m_writing_concurrent_level) {
+        THROW_STD(logic_error, "invalid operation: bulk load to readonly trie");
+    }
+    if (NoWriteReadOnly != finalLevel && m_writing_concurrent_level != finalLevel) {
+        THROW_STD(invalid_argument, "finalLevel = %s, must be NoWriteReadOnly or %s",
+                  enum_cstr(finalLevel), enum_cstr(m_writing_concurrent_level));
+    }
+    auto a = reinterpret_cast<const PatriciaNode*>(m_mempool.data());
+    if (m_n_words || a[1].big.n_children) {
+        THROW_STD(invalid_argument, "trie is not empty, num_words = %zd", m_n_words);
+    }
+    size_t nkeys = 0;
+    switch (m_mempool_concurrent_level) {
+    default: TERARK_DIE("bad m_mempool_concurrent_level = %d", m_mempool_concurrent_level); break;
+    case SingleThreadStrict :
+    case SingleThreadShared : nkeys = bulk_load_sorted_impl<SingleThreadStrict >(next); break;
+    case OneWriteMultiRead  : nkeys = bulk_load_sorted_impl<OneWriteMultiRead  >(next); break;
+    case MultiWriteMultiRead: nkeys = bulk_load_sorted_impl<MultiWriteMultiRead>(next); break;
+    }
+    if (NoWriteReadOnly == finalLevel) {
+        set_readonly();
+    }
+    return nkeys;
+}
+
 static const size_t BULK_FREE_NUM = getEnvLong("CSPP_BULK_FREE_NUM", 8);
 static const long g_lazy_free_debug_level = getEnvLong("Patricia_lazy_free_debug_level", 0);
 
@@ -2812,6 +3129,9 @@ size_t PatriciaMem<Align>::revoke_expired_nodes(LazyList& lzf, TokenBase* token)
     //auto a = reinterpret_cast<const PatriciaNode*>(m_mempool.data());
   #endif
     auto tls = static_cast<LazyFreeListTLS*>(&lzf);
+    if (terark_unlikely(as_atomic(m_compact_tail_end).load(std::memory_order_relaxed))) {
+        try_release_compact_tail(min_verseq, tls);
+    }
     size_t n = std::min(lzf.size(), BULK_FREE_NUM);
     size_t revoke_size = 0;
     for (size_t i = 0; i < n; ++i) {
@@ -2862,6 +3182,282 @@ size_t PatriciaMem<Align>::revoke_expired_nodes(LazyList& lzf, TokenBase* token)
     return revoke_size;
 }
 
+// called when all tokens older than m_compact_tail_age may be gone, in
+// MultiWriteMultiRead, writers may call it concurrently
+PatriciaMemMF(bool)try_release_compact_tail(ullong min_verseq, LazyFreeListTLS* tls) {
+    if (0 == as_atomic(m_compact_tail_end).load(std::memory_order_acquire)) {
+        return false;
+    }
+    if (m_compact_tail_age >= min_verseq) {
+        return false;
+    }
+    size_t end = as_atomic(m_compact_tail_end).exchange(0, std::memory_order_acq_rel);
+    if (0 == end) {
+        return false; // released by another thread
+    }
+    size_t beg = m_compact_tail_beg;
+    TERARK_ASSERT_LT(beg, end);
+  #if !defined(_MSC_VER)
+    auto base = m_mempool.data();
+    size_t pbeg = pow2_align_up(size_t(base + beg), 4096);
+    size_t pend = pow2_align_down(size_t(base + end), 4096);
+    if (pbeg < pend && madvise((void*)pbeg, pend - pbeg, MADV_DONTNEED) != 0) {
+        // such as EINVAL on hugetlb pages, the tail is still reused
+        DBUG("madvise(DONTNEED, size=%zd) = %m", pend - pbeg);
+    }
+  #endif
+    as_atomic(m_compact_released).fetch_add(end - beg, std::memory_order_relaxed);
+    if (MultiWriteMultiRead == m_mempool_concurrent_level &&
+            m_mempool_lock_free.shrink_tail(beg, end)) {
+        return true;
+    }
+    // put back from the top, if the tail is the top of m_mempool_lock_none
+    // or m_mempool_fixed_cap, sfree shrinks the mempool
+    constexpr size_t max_piece = size_t(1) << 30; // for 32 bit huge_link_t::size
+    while (end > beg) {
+        size_t len = std::min(end - beg, max_piece);
+        switch (m_mempool_concurrent_level) {
+        default: TERARK_DIE("bad m_mempool_concurrent_level = %d", m_mempool_concurrent_level); break;
+        case MultiWriteMultiRead: m_mempool_lock_free.sfree(end - len, len, tls); break;
+        case OneWriteMultiRead  : m_mempool_fixed_cap.sfree(end - len, len); break;
+        case SingleThreadShared :
+        case SingleThreadStrict : m_mempool_lock_none.sfree(end - len, len); break;
+        }
+        end -= len;
+    }
+    return true;
+}
+
+// aligned alloc size of a node
+static inline size_t compact_node_size(const PatriciaNode* p, size_t valsize) {
+    if (15 == p->meta.n_cnt_type) // always has value space, no zpath
+        return MainPatricia::AlignSize * (2 + 256) + valsize;
+    else
+        return pow2_align_up(node_size(p, valsize), MainPatricia::AlignSize);
+}
+
+MainPatricia::CompactStat MainPatricia::compact() {
+    if (NoWriteReadOnly == m_writing_concurrent_level) {
+        THROW_STD(logic_error, "invalid operation: compact readonly trie");
+    }
+    // writer tokens are in the token queue from acquire to release, new
+    // ones wait in mt_acquire until m_compacting is cleared
+    {
+        std::lock_guard<std::mutex> lock(m_head_mutex);
+        if (m_compacting) {
+            THROW_STD(logic_error, "compact is running in another thread");
+        }
+        for (TokenBase* t = m_dummy.m_next; t != &m_dummy; t = t->m_next) {
+            if (dynamic_cast<WriterToken*>(t)) {
+                THROW_STD(logic_error,
+                    "writers must be paused: writer token %p is acquired by thread %zd",
+                    t, t->m_thread_id);
+            }
+        }
+        m_compacting = true;
+    }
+    TERARK_SCOPE_EXIT(
+        std::lock_guard<std::mutex> lock(m_head_mutex);
+        m_compacting = false;
+        m_compact_cond.notify_all();
+    );
+    CompactStat stat;
+    LazyFreeListTLS* tls = nullptr;
+    if (MultiWriteMultiRead == m_mempool_concurrent_level) {
+        tls = static_cast<LazyFreeListTLS*>(m_mempool_lock_free.get_tls());
+    }
+    auto min_verseq_now = [this]() {
+        std::lock_guard<std::mutex> lock(m_head_mutex);
+        return 0 == m_token_qlen ? ULLONG_MAX : m_dummy.m_min_verseq;
+    };
+    if (size_t end = m_compact_tail_end) { // tail of last compact is pending
+        stat.tail_size = end - m_compact_tail_beg;
+        stat.tail_released = try_release_compact_tail(min_verseq_now(), tls);
+        return stat;
+    }
+    // {pos, len} in bytes, coalesced
+    valvec<std::pair<size_t, size_t> > fb;
+    auto on_free = [&fb](size_t pos, size_t len) { fb.emplace_back(pos, len); };
+    switch (m_mempool_concurrent_level) {
+    default: TERARK_DIE("bad m_mempool_concurrent_level = %d", m_mempool_concurrent_level); break;
+    case MultiWriteMultiRead: m_mempool_lock_free.drain_free_list(on_free); break;
+    case OneWriteMultiRead  : m_mempool_fixed_cap.drain_free_list(on_free); break;
+    case SingleThreadShared :
+    case SingleThreadStrict : m_mempool_lock_none.drain_free_list(on_free); break;
+    }
+    // expired lazy free blocks are free blocks, others are not movable
+    const ullong min_verseq = min_verseq_now();
+    auto revoke = [&](LazyFreeList& lzf) {
+        while (!lzf.empty() && lzf.front().age < min_verseq) {
+            const LazyFreeItem& head = lzf.front();
+            size_t len = pow2_align_up(size_t(head.size), AlignSize);
+            fb.emplace_back(AlignSize * head.node, len);
+            lzf.m_mem_size -= head.size;
+            lzf.pop_front();
+        }
+    };
+    if (MultiWriteMultiRead == m_mempool_concurrent_level) {
+        m_mempool_lock_free.for_each_tls([&](TCMemPoolOneThread<AlignSize>* tc) {
+            revoke(*static_cast<LazyFreeListTLS*>(tc));
+        });
+    } else if (m_lazy_free_list_sgl) {
+        revoke(*m_lazy_free_list_sgl);
+    }
+    std::sort(fb.begin(), fb.end());
+    size_t total_free = 0;
+    if (!fb.empty()) {
+        size_t j = 0;
+        for (size_t i = 1; i < fb.size(); ++i) {
+            TERARK_ASSERT_LE(fb[j].first + fb[j].second, fb[i].first);
+            if (fb[j].first + fb[j].second == fb[i].first)
+                fb[j].second += fb[i].second;
+            else
+                fb[++j] = fb[i];
+        }
+        fb.risk_set_size(j + 1);
+        for (auto& x : fb) total_free += x.second;
+    }
+
+    // live nodes reachable from the initial root, in dfs preorder, thus a
+    // parent is before its children
+    struct LiveNode {
+        uint32_t pos; // node id
+        uint32_t size; // aligned size in bytes
+        uint32_t parent; // index in nodes
+        uint32_t slot; // child slot offset in parent
+        uint32_t newpos;
+    };
+    auto a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
+    const size_t valsize = m_valsize;
+    valvec<LiveNode> nodes(m_n_nodes + 1, valvec_reserve());
+    valvec<uint32_t> stack;
+    nodes.push_back({0, uint32_t(compact_node_size(a, valsize)), UINT32_MAX, 0, 0});
+    stack.push_back(0);
+    while (!stack.empty()) {
+        size_t idx = stack.pop_val();
+        const PatriciaNode* p = a + nodes[idx].pos;
+        size_t cnt_type = p->meta.n_cnt_type;
+        size_t skip = s_skip_slots[cnt_type];
+        size_t num = cnt_type <= 6 ? cnt_type : 15 == cnt_type ? 256 : p->big.n_children;
+        for (size_t i = 0; i < num; ++i) {
+            size_t child = p[skip + i].child;
+            if (nil_state == child)
+                continue;
+            size_t size = compact_node_size(a + child, valsize);
+            stack.push_back(uint32_t(nodes.size()));
+            nodes.push_back({uint32_t(child), uint32_t(size), uint32_t(idx),
+                             uint32_t(skip + i), uint32_t(child)});
+        }
+    }
+    valvec<uint32_t> by_pos(nodes.size(), valvec_no_init());
+    for (size_t i = 0; i < nodes.size(); ++i) by_pos[i] = uint32_t(i);
+    std::sort(by_pos.begin(), by_pos.end(), [&](uint32_t x, uint32_t y) {
+        return nodes[x].pos < nodes[y].pos;
+    });
+
+    // take the tail from the top: free blocks and movable live nodes, while
+    // the free blocks below the tail can hold the live nodes in it
+    const size_t end = m_mempool.size();
+    size_t cut = end, free_below = total_free, live_above = 0;
+    size_t fi = fb.size(), ni = by_pos.size();
+    for (;;) {
+        if (fi && fb[fi-1].first + fb[fi-1].second == cut) {
+            size_t len = fb[fi-1].second;
+            if (live_above + len > free_below)
+                break;
+            cut = fb[--fi].first;
+            free_below -= len;
+            continue;
+        }
+        if (ni) {
+            const LiveNode& x = nodes[by_pos[ni-1]];
+            if (x.pos * AlignSize + x.size == cut && UINT32_MAX != x.parent &&
+                    live_above + x.size <= free_below) {
+                cut = x.pos * AlignSize;
+                live_above += x.size;
+                ni--;
+                continue;
+            }
+        }
+        break; // such as a lazy free block or a block of mem_alloc
+    }
+
+    // best fit into the free blocks below cut, from the top node, if a node
+    // does not fit, the tail ends above it
+    std::multimap<size_t, size_t> fit; // {len, pos}
+    for (size_t i = 0; i < fi; ++i) {
+        fit.emplace(fb[i].second, fb[i].first);
+    }
+    for (size_t k = by_pos.size(); k > ni; --k) {
+        LiveNode& x = nodes[by_pos[k-1]];
+        auto iter = fit.lower_bound(x.size);
+        if (fit.end() == iter) {
+            cut = x.pos * AlignSize + x.size;
+            break;
+        }
+        size_t len = iter->first, pos = iter->second;
+        fit.erase(iter);
+        if (len > x.size)
+            fit.emplace(len - x.size, pos + x.size);
+        x.newpos = uint32_t(pos / AlignSize);
+        stat.moved_nodes++;
+        stat.moved_bytes += x.size;
+    }
+
+    // copy in preorder, a moved parent is copied before its children, the
+    // child slot is in the new copy of the parent
+    for (size_t i = 1; i < nodes.size(); ++i) {
+        const LiveNode& x = nodes[i];
+        if (x.newpos != x.pos) {
+            memcpy(a + x.newpos, a + x.pos, x.size);
+            size_t slot = nodes[x.parent].newpos + x.slot;
+            as_atomic(a[slot].child).store(x.newpos, std::memory_order_release);
+        }
+    }
+
+    // put back the remaining free blocks, the tail is pending
+    auto put_back = [&](size_t pos, size_t len) {
+        constexpr size_t max_piece = size_t(1) << 30; // for 32 bit huge_link_t::size
+        for (size_t piece; len; pos += piece, len -= piece) {
+            piece = std::min(len, max_piece);
+            switch (m_mempool_concurrent_level) {
+            default: break; // have checked
+            case MultiWriteMultiRead: m_mempool_lock_free.sfree(pos, piece, tls); break;
+            case OneWriteMultiRead  : m_mempool_fixed_cap.sfree(pos, piece); break;
+            case SingleThreadShared :
+            case SingleThreadStrict : m_mempool_lock_none.sfree(pos, piece); break;
+            }
+        }
+    };
+    if (cut < end) {
+        {
+            std::lock_guard<std::mutex> lock(m_head_mutex);
+            m_compact_tail_age = m_dummy.m_verseq; // newer tokens see new nodes
+        }
+        m_compact_tail_beg = cut;
+        as_atomic(m_compact_tail_end).store(end, std::memory_order_release);
+        stat.tail_size = end - cut;
+    }
+    for (auto& x : fit) {
+        put_back(x.second, x.first);
+    }
+    for (size_t i = fi; i < fb.size() && fb[i].first < cut; ++i) {
+        put_back(fb[i].first, fb[i].second); // above the best fit cut
+    }
+    if (cut < end) {
+        stat.tail_released = try_release_compact_tail(min_verseq_now(), tls);
+    }
+    return stat;
+}
+
+size_t MainPatricia::match_levenshtein(MatchContext& ctx, size_t root,
+                                       fstring key, size_t maxDist,
+                                       const OnLevenshteinMatch& on_match)
+const {
+    assert(root < total_states());
+    return dfa_match_levenshtein(*this, ctx, root, key, maxDist, on_match);
+}
+
 bool MainPatricia::lookup(fstring key, TokenBase* token, size_t root) const {
   #if !defined(NDEBUG)
     if (m_writing_concurrent_level >= SingleThreadShared) {
@@ -3036,7 +3632,11 @@ bool MainPatricia::lookup(fstring key, TokenBase* token, size_t root) const {
                 size_t n_children = p->big.n_children;
                 TERARK_ASSERT_BE(n_children, 7, 16);
                 auto label = p->meta.c_label + 2; // do not use [0,1]
-              #if defined(TERARK_PATRICIA_LINEAR_SEARCH_SMALL)
+              #if defined(__SSE2__) && !defined(TERARK_PATRICIA_LINEAR_SEARCH_SMALL)
+                size_t idx = sse2_search_byte_max_16(label, n_children, ch);
+                if (idx < n_children)
+                    move_to(p[1 + 4 + idx].child);
+              #elif defined(TERARK_PATRICIA_LINEAR_SEARCH_SMALL)
                 if (ch <= label[n_children-1]) {
                     size_t idx = size_t(-1);
                     do idx++; while (label[idx] < ch);
@@ -3268,6 +3868,7 @@ void PatriciaMem<Align>::finish_load_mmap(const DFA_MmapHeader* base) {
     m_appdata_offset = size_t(base->louds_dfa_min_zpath_id) * AlignSize;
     m_appdata_length = size_t(base->louds_dfa_cache_states) * AlignSize;
     m_mempool.risk_set_frag_size(size_t(base->numFreeStates) * AlignSize);
+    m_checkpoint_seq = base->reserve1[0];
 }
 
 template<size_t Align>
@@ -3284,6 +3885,8 @@ long PatriciaMem<Align>::prepare_save_mmap(DFA_MmapHeader* header,
     header->louds_dfa_min_zpath_id  = uint32_t(m_appdata_offset / AlignSize);
     header->louds_dfa_cache_states  = uint32_t(m_appdata_length / AlignSize);
     header->numFreeStates = m_mempool.frag_size() / AlignSize;
+    header->reserve1[0] = m_checkpoint_seq;
+    // reserve1[1] is the dirty flag, just owned by mmap_set_dirty
 
     header->blocks[0].offset = sizeof(DFA_MmapHeader);
     header->blocks[0].length = m_mempool.size();
@@ -3292,6 +3895,61 @@ long PatriciaMem<Align>::prepare_save_mmap(DFA_MmapHeader* header,
     return 0;
 }
 
+// like finish_load_mmap, but mempool is kept writable, fragments of the
+// image are not in freelist, they are just leaked until next rebuild
+template<size_t Align>
+void PatriciaMem<Align>::finish_reopen(const DFA_MmapHeader* base) {
+    m_mempool.risk_set_size(size_t(base->blocks[0].length));
+    m_mempool.risk_set_frag_size(size_t(base->numFreeStates) * AlignSize);
+    m_kv_delim = base->kv_delim;
+    m_n_nodes = base->transition_num + 1;
+    m_n_words = base->dawg_num_words;
+    m_max_word_len = base->dfa_cluster_num;
+    m_zpath_states = base->zpath_states;
+    m_total_zpath_len = base->zpath_length;
+    m_adfa_total_words_len = base->adfa_total_words_len;
+    if (base->louds_dfa_cache_states) {
+        m_appdata_offset = size_t(base->louds_dfa_min_zpath_id) * AlignSize;
+        m_appdata_length = size_t(base->louds_dfa_cache_states) * AlignSize;
+    }
+    m_checkpoint_seq = base->reserve1[0];
+}
+
+template<size_t Align>
+void PatriciaMem<Align>::checkpoint(fstring fpath, uint64_t seq) {
+    TERARK_VERIFY_F(fpath != m_mmap_fpath,
+        "checkpoint to the live file %s", fpath.c_str());
+    sync_stat();
+    m_checkpoint_seq = seq;
+    std::string tmp = fpath + ".tmp";
+    save_mmap(tmp); // fsync'ed, header has no dirty flag
+#if defined(_MSC_VER)
+    if (!MoveFileExA(tmp.c_str(), fpath.c_str(),
+                     MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH)) {
+        DWORD err = GetLastError();
+        THROW_STD(runtime_error, "MoveFileEx(%s, %s).ErrCode=%d(%X)",
+                  tmp.c_str(), fpath.c_str(), err, err);
+    }
+#else
+    if (::rename(tmp.c_str(), fpath.c_str()) < 0) {
+        THROW_STD(runtime_error, "rename(%s, %s) = %s",
+                  tmp.c_str(), fpath.c_str(), strerror(errno));
+    }
+    // make the rename durable
+    const char* slash = strrchr(fpath.c_str(), '/');
+    std::string dir = slash ? std::string(fpath.c_str(), slash + 1) : ".";
+    int dfd = ::open(dir.c_str(), O_RDONLY);
+    if (dfd < 0) {
+        THROW_STD(runtime_error, "open(%s) = %s", dir.c_str(), strerror(errno));
+    }
+    int err = ::fsync(dfd) < 0 ? errno : 0;
+    ::close(dfd);
+    if (err) {
+        THROW_STD(runtime_error, "fsync(%s) = %s", dir.c_str(), strerror(err));
+    }
+#endif
+}
+
 ///////////////////////////////////////////////////////////////////////
 
 Patricia::TokenBase::TokenBase() {
@@ -3401,6 +4059,12 @@ void Patricia::TokenBase::mt_acquire(Patricia* trie1) {
         break;
     case ReleaseDone:
         trie->m_head_mutex.lock();
+        if (terark_unlikely(trie->m_compacting) && dynamic_cast<WriterToken*>(this)) {
+            // writers are paused during compact
+            std::unique_lock<std::mutex> lock(trie->m_head_mutex, std::adopt_lock);
+            trie->m_compact_cond.wait(lock, [trie]{ return !trie->m_compacting; });
+            lock.release(); // keep m_head_mutex locked
+        }
         this->m_flags = {AcquireDone, 0 == trie->m_token_qlen};
         trie->m_token_qlen++;
         this->m_min_verseq = trie->m_dummy.m_min_verseq;
@@ -4931,6 +5595,12 @@ size_t MainPatricia::IterImpl::seek_max_prefix(fstring key) {
             TERARK_ASSERT_BE(n_children, 7, 16);
             {
                 auto label = p->meta.c_label + 2; // do not use [0,1]
+              #if defined(__SSE2__) && !defined(TERARK_PATRICIA_LINEAR_SEARCH_SMALL)
+                size_t lo = sse2_search_byte_max_16(label, n_children, ch);
+                if (lo < n_children) {
+                    match_nth_char(5, lo);
+                }
+              #else
                 if (ch <= label[n_children-1]) {
                     size_t lo = size_t(-1);
                     do lo++; while (label[lo] < ch);
@@ -4938,6 +5608,7 @@ size_t MainPatricia::IterImpl::seek_max_prefix(fstring key) {
                         match_nth_char(5, lo);
                     }
                 }
+              #endif
                 goto RestoreLastMatch;
             }
         case 8: // cnt >= 17
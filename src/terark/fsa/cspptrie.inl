@@ -21,6 +21,7 @@
 //#include <terark/mempool_lock_free.hpp>
 #include <terark/mempool_thread_cache.hpp>
 #include <terark/util/throw.hpp>
+#include <condition_variable>
 #include <mutex>
 #if defined(TerarkFSA_HighPrivate)
 #include "dfa_algo.hpp"
@@ -110,6 +111,28 @@ public:
     intptr_t mmap_fd() const { return m_fd; }
     const std::string& mmap_fpath() const { return m_mmap_fpath; }
 
+    /// write a crash consistent image of the trie to fpath(tmp file, fsync,
+    /// then rename), seq is an opaque caller number such as a WAL sequence.
+    /// writers must be paused during checkpoint, readers need not.
+    /// the image can be reopened as a writable trie by fpath config string
+    /// "?reopen=1&file_path=...", which is O(1) as it just mmap the file.
+    void checkpoint(fstring fpath, uint64_t seq);
+
+    /// seq of the image this trie was reopened from, also be saved to the
+    /// header of file backed trie on clean close(set_readonly/destroy)
+    uint64_t checkpoint_seq() const { return m_checkpoint_seq; }
+    void set_checkpoint_seq(uint64_t seq) { m_checkpoint_seq = seq; }
+
+    /// result of MainPatricia::compact()
+    struct CompactStat {
+        size_t moved_nodes = 0;
+        size_t moved_bytes = 0;
+        size_t tail_size = 0; ///< the tail of the mempool to be released
+        bool   tail_released = false; ///< false if readers may still see it
+    };
+    /// total bytes released to the OS by compact
+    size_t compact_released_bytes() const { return m_compact_released; }
+
 protected:
     struct LazyFreeItem;
     struct LazyFreeListBase;
@@ -140,6 +163,18 @@ protected:
     intptr_t  m_fd;
     size_t    m_appdata_offset;
     size_t    m_appdata_length;
+    uint64_t  m_checkpoint_seq;
+
+    // the tail [beg, end) of the last compact which is not in freelists,
+    // it is released when all tokens older than m_compact_tail_age are
+    // gone, 0 == m_compact_tail_end means there is no such tail
+    ullong    m_compact_tail_age;
+    size_t    m_compact_tail_beg;
+    size_t    m_compact_tail_end;
+    size_t    m_compact_released;
+    bool      m_compacting; // writer tokens wait in acquire when true
+    std::condition_variable m_compact_cond; // notified on m_compacting clear
+    bool try_release_compact_tail(ullong min_verseq, LazyFreeListTLS*);
 
     union {
         MemPool_CompileX<AlignSize> m_mempool;
@@ -204,6 +239,8 @@ protected:
 
     void finish_load_mmap(const DFA_MmapHeader*) override final;
     long prepare_save_mmap(DFA_MmapHeader*, const void**) const override final;
+    void finish_reopen(const DFA_MmapHeader*);
+    void mmap_set_dirty(bool dirty);
 
     void destroy();
 
@@ -388,7 +425,24 @@ public:
         assert(1 == a[s].meta.n_cnt_type);
         return a[s+1].child;
     }
-    void compact();
+    /// online compaction of the mempool, for long running tries which
+    /// have a high mem_frag_size() caused by overwrites.
+    /// live nodes in the tail of the mempool are relocated to the free
+    /// blocks below it, the tail is taken from the top as long as it has
+    /// just live nodes and free blocks, and the free blocks below it can
+    /// hold its live nodes. a node is copied first, then the child slot of
+    /// its parent is swapped to the copy, so readers see either of them.
+    /// as the lazy free list, the tail is released after all tokens which
+    /// may see the old nodes are released or updated: by madvise(DONTNEED)
+    /// and the mempool is shrunk to the tail. the other free blocks are put
+    /// back to the freelists, adjacent ones are coalesced.
+    /// writers must be paused during compact, readers need not, values got
+    /// by tokens before compact must not be written after compact.
+    /// compact throws logic_error if a writer token is acquired, and
+    /// acquiring a writer token during compact waits until compact is done.
+    /// blocks which are not reachable from the initial root, such as blocks
+    /// of mem_alloc and nodes of other roots, are never moved.
+    CompactStat compact();
 
     fstring get_zpath_data(size_t state, MatchContext* = NULL) const {
         assert(state < total_states());
@@ -462,7 +516,12 @@ public:
                 assert(n_children >=  7);
                 assert(n_children <= 16);
                 auto label = a[curr].meta.c_label + 2; // do not use [0,1]
-#if defined(TERARK_PATRICIA_LINEAR_SEARCH_SMALL)
+#if defined(__SSE2__) && !defined(TERARK_PATRICIA_LINEAR_SEARCH_SMALL)
+                // all 16 label bytes are in the node, compare them at once
+                size_t idx = sse2_search_byte_max_16(label, n_children, byte_t(ch));
+                if (idx < n_children)
+                    return a[curr + 1 + 4 + idx].child;
+#elif defined(TERARK_PATRICIA_LINEAR_SEARCH_SMALL)
                 if (ch <= label[n_children-1]) {
                     size_t idx = size_t(-1);
                     do idx++; while (label[idx] < byte_t(ch));
@@ -672,8 +731,46 @@ public:
 
     bool lookup(fstring key, TokenBase* token, size_t root = initial_state) const override final;
 
+    /// caller should hold a ReaderToken if trie is concurrently writing
+    using Patricia::match_levenshtein;
+    size_t match_levenshtein(MatchContext&, size_t root, fstring key,
+                             size_t maxDist, const OnLevenshteinMatch&)
+    const override final;
+
+    /// pull next key/value for bulk_load_sorted, returns false on end,
+    /// *value points to get_valsize() bytes
+    typedef function<bool(fstring* key, const void** value)> SortedKeySource;
+
+    /// build an empty trie from keys in strictly ascending order, nodes are
+    /// written bottom-up into mempool in one pass, without tokens, lazy free
+    /// or CAS, so no other thread may access the trie before it returns.
+    /// @param finalLevel NoWriteReadOnly or concurrent_level(), the mempool
+    ///        is chosen by constructor and can not be changed later
+    /// @returns number of loaded keys
+    /// @throws invalid_argument if keys are not strictly ascending, keys
+    ///         before the bad one are loaded and the trie is still valid
+    /// @throws length_error if fixed capacity mempool is exhausted
+    size_t bulk_load_sorted(const SortedKeySource&, ConcurrentLevel finalLevel);
+
+    /// *iter is convertible to fstring, getval(iter) returns value pointer
+    template<class Iter, class GetValue>
+    size_t bulk_load_sorted(Iter beg, Iter end, GetValue getval,
+                            ConcurrentLevel finalLevel) {
+        return bulk_load_sorted([&](fstring* key, const void** value) {
+            if (beg == end)
+                return false;
+            *key = fstring(*beg);
+            *value = getval(beg);
+            ++beg;
+            return true;
+        }, finalLevel);
+    }
+
     void set_insert_func(ConcurrentLevel conLevel);
 
+    template<ConcurrentLevel>
+    size_t bulk_load_sorted_impl(const SortedKeySource&);
+
     size_t state_move_impl(const PatriciaNode* a, size_t curr,
                            auchar_t ch, size_t* child_slot) const;
     template<ConcurrentLevel>
@@ -1,6 +1,6 @@
 #pragma once
 
-#ifdef _M_X64
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
 #include <immintrin.h>
 #endif
 #include <terark/succinct/rank_select_basic.hpp>
@@ -24,6 +24,20 @@ binary_search_byte(const byte_t* data, size_t len, byte_t key) {
 		return len;
 }
 
+#if defined(__SSE2__)
+	/// data must have 16 readable bytes even if len < 16
+	/// @returns len if not found
+	inline size_t
+	sse2_search_byte_max_16(const byte_t* data, size_t len, byte_t key) {
+		assert(len <= 16);
+		__m128i vkey = _mm_set1_epi8(char(key));
+		__m128i vdat = _mm_loadu_si128((const __m128i*)data);
+		uint32_t m = _mm_movemask_epi8(_mm_cmpeq_epi8(vdat, vkey));
+		m &= (uint32_t(1) << len) - 1;
+		return m ? fast_ctz32(m) : len;
+	}
+#endif
+
 #if defined(__SSE4_2__) // && (defined(NDEBUG) || !defined(__GNUC__))
 	inline int // _mm_cmpestri length param is int32
 	sse4_2_search_byte(const byte_t* data, int len, byte_t key) {
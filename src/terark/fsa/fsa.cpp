@@ -3,6 +3,7 @@
 #include "tmplinst.hpp"
 
 #include "x_fsa_util.hpp"
+#include "levenshtein_automaton.hpp"
 
 #include "forward_decl.hpp"
 
@@ -204,6 +205,32 @@ void BaseDFA::get_all_move(size_t s, valvec<CharTarget<size_t> >* moves) const {
 	assert(moves->size() <= 512);
 }
 
+namespace {
+// adapt BaseDFA virtuals to the interface required by dfa_match_levenshtein
+struct VirtualDFA_Adapter {
+	const BaseDFA* dfa;
+	size_t get_sigma() const { return dfa->get_sigma(); }
+	bool is_pzip(size_t s) const { return dfa->v_is_pzip(s); }
+	bool is_term(size_t s) const { return dfa->v_is_term(s); }
+	fstring get_zpath_data(size_t s, MatchContext* ctx) const {
+		return dfa->v_get_zpath_data(s, ctx);
+	}
+	template<class OP>
+	void for_each_move(size_t s, OP op) const { dfa->v_for_each_move(s, op); }
+};
+} // namespace
+
+size_t BaseDFA::match_levenshtein(MatchContext& ctx, size_t root, fstring key,
+					size_t maxDist, const OnLevenshteinMatch& on_match) const {
+	VirtualDFA_Adapter adapter = {this};
+	return dfa_match_levenshtein(adapter, ctx, root, key, maxDist, on_match);
+}
+size_t BaseDFA::match_levenshtein(fstring key, size_t maxDist,
+					const OnLevenshteinMatch& on_match) const {
+	MatchContext ctx;
+	return match_levenshtein(ctx, initial_state, key, maxDist, on_match);
+}
+
 #define CheckBufferOverRun(inclen) do { \
 	if (q + inclen > oend) { \
 		std::string msg; \
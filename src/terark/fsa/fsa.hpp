@@ -284,6 +284,16 @@ public:
 	void get_all_dest(size_t s, valvec<size_t>* dests) const;
 	void get_all_move(size_t s, valvec<CharTarget<size_t> >* moves) const;
 
+	/// fuzzy search: all words in edit distance of maxDist to key, a
+	/// Levenshtein automaton runs in lockstep with state moves and prunes
+	/// subtrees, so it is one DFS instead of many point lookups.
+	/// @param on_match(word, state, dist), state is the final state of word
+	/// @returns number of matched words
+	typedef function<void(fstring word, size_t state, size_t dist)> OnLevenshteinMatch;
+	virtual size_t match_levenshtein(MatchContext&, size_t root, fstring key,
+				size_t maxDist, const OnLevenshteinMatch&) const;
+	size_t match_levenshtein(fstring key, size_t maxDist, const OnLevenshteinMatch&) const;
+
 	void get_stat(DFA_MmapHeader*) const;
 	virtual void str_stat(std::string*) const;
 	std::string  str_stat() const { std::string s; str_stat(&s); return s; }
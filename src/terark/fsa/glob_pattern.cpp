@@ -0,0 +1,366 @@
+#include "glob_pattern.hpp"
+#include <terark/bitmap.hpp>
+#include <terark/util/throw.hpp>
+#include <unordered_map>
+
+namespace terark {
+
+// An atom is a char class with a quantifier, a pattern is a seq of atoms,
+// position j of the NFA is "before atom j", position m is the accept state.
+struct GlobPatternDFA::Atom {
+    uint64_t bits[4];
+    char     quant; // '1', '?', '*'
+    Atom() { memset(bits, 0, sizeof(bits)); quant = '1'; }
+    bool test(byte_t ch) const { return (bits[ch/64] >> (ch%64)) & 1; }
+    void set(byte_t ch) { bits[ch/64] |= uint64_t(1) << (ch%64); }
+    void set_range(byte_t lo, byte_t hi) {
+        for (size_t ch = lo; ch <= hi; ++ch) set(byte_t(ch));
+    }
+    void set_all() { memset(bits, -1, sizeof(bits)); }
+    void flip() { for (auto& w : bits) w = ~w; }
+    size_t count() const {
+        size_t n = 0;
+        for (auto w : bits) n += fast_popcount(w);
+        return n;
+    }
+};
+
+static const size_t MaxAtoms = 63;
+static const size_t MaxStates = 1 << 16;
+
+// parse "[...]", pos points to the char after '['
+static size_t parse_char_class(fstring pattern, size_t pos, bool allowBang,
+                               GlobPatternDFA::Atom* atom) {
+    const size_t n = pattern.size();
+    bool negate = false;
+    if (pos < n && ('^' == pattern[pos] || (allowBang && '!' == pattern[pos]))) {
+        negate = true;
+        pos++;
+    }
+    bool first = true;
+    while (pos < n && (first || ']' != pattern[pos])) {
+        byte_t lo = pattern[pos++];
+        if ('\\' == lo && pos < n)
+            lo = pattern[pos++];
+        if (pos + 1 < n && '-' == pattern[pos] && ']' != pattern[pos+1]) {
+            byte_t hi = pattern[pos+1];
+            pos += 2;
+            if ('\\' == hi && pos < n)
+                hi = pattern[pos++];
+            if (lo > hi) {
+                THROW_STD(invalid_argument, "bad range %c-%c in: %.*s",
+                          lo, hi, pattern.ilen(), pattern.data());
+            }
+            atom->set_range(lo, hi);
+        }
+        else {
+            atom->set(lo);
+        }
+        first = false;
+    }
+    if (pos >= n) {
+        THROW_STD(invalid_argument, "missing ']' in: %.*s",
+                  pattern.ilen(), pattern.data());
+    }
+    if (negate)
+        atom->flip();
+    return pos + 1; // skip ']'
+}
+
+// x+ is expanded as x x*
+static void push_atom(valvec<GlobPatternDFA::Atom>& atoms,
+                      const GlobPatternDFA::Atom& atom, char quant) {
+    atoms.push_back(atom);
+    if ('+' == quant) {
+        atoms.push_back(atom);
+        atoms.back().quant = '*';
+    } else {
+        atoms.back().quant = quant;
+    }
+}
+
+GlobPatternDFA::GlobPatternDFA() {}
+GlobPatternDFA::~GlobPatternDFA() {}
+
+void GlobPatternDFA::compile_glob(fstring pattern) {
+    valvec<Atom> atoms;
+    for (size_t pos = 0, n = pattern.size(); pos < n; ) {
+        Atom atom;
+        byte_t ch = pattern[pos++];
+        switch (ch) {
+        case '*':
+            atom.set_all();
+            atoms.push_back(atom);
+            atoms.back().quant = '*';
+            continue;
+        case '?':
+            atom.set_all();
+            break;
+        case '[':
+            pos = parse_char_class(pattern, pos, true, &atom);
+            break;
+        case '\\':
+            if (pos < n)
+                ch = pattern[pos++];
+            no_break_fallthrough;
+        default:
+            atom.set(ch);
+            break;
+        }
+        char quant = '1';
+        if (pos < n && '+' == pattern[pos])
+            quant = '+', pos++;
+        push_atom(atoms, atom, quant);
+    }
+    compile_atoms(atoms);
+}
+
+void GlobPatternDFA::compile_regex(fstring pattern) {
+    valvec<Atom> atoms;
+    size_t pos = 0, n = pattern.size();
+    if (n && '^' == pattern[0])
+        pos = 1;
+    if (n > pos && '$' == pattern[n-1] && (n < 2 || '\\' != pattern[n-2]))
+        n--;
+    while (pos < n) {
+        Atom atom;
+        byte_t ch = pattern[pos++];
+        switch (ch) {
+        case '.':
+            atom.set_all();
+            break;
+        case '[':
+            pos = parse_char_class(fstring(pattern.p, n), pos, false, &atom);
+            break;
+        case '(': case ')': case '|': case '{': case '}':
+        case '*': case '+': case '?':
+            THROW_STD(invalid_argument, "unsupported '%c' at %zd in: %.*s",
+                      ch, pos - 1, pattern.ilen(), pattern.data());
+        case '\\':
+            if (pos < n) {
+                ch = pattern[pos++];
+                switch (ch) {
+                case 'd': atom.set_range('0', '9'); goto Quant;
+                case 'w': atom.set_range('0', '9');
+                          atom.set_range('a', 'z');
+                          atom.set_range('A', 'Z');
+                          atom.set('_'); goto Quant;
+                case 's': for (byte_t c : fstring(" \t\r\n\f\v")) atom.set(c);
+                          goto Quant;
+                }
+            }
+            no_break_fallthrough;
+        default:
+            atom.set(ch);
+            break;
+        }
+      Quant:
+        char quant = '1';
+        if (pos < n && strchr("*+?", pattern[pos]))
+            quant = pattern[pos++];
+        push_atom(atoms, atom, quant);
+    }
+    compile_atoms(atoms);
+}
+
+void GlobPatternDFA::compile_atoms(const valvec<Atom>& atoms) {
+    const size_t m = atoms.size();
+    if (m > MaxAtoms) {
+        THROW_STD(invalid_argument, "too many atoms: %zd, max is %zd", m, MaxAtoms);
+    }
+    m_literal_prefix.clear();
+    for (size_t j = 0; j < m && '1' == atoms[j].quant && 1 == atoms[j].count(); ++j) {
+        for (size_t ch = 0; ch < 256; ++ch)
+            if (atoms[j].test(byte_t(ch))) { m_literal_prefix.push_back(char(ch)); break; }
+    }
+    auto closure = [&](uint64_t set) {
+        for (size_t j = 0; j < m; ++j) {
+            if ((set >> j & 1) && '1' != atoms[j].quant)
+                set |= uint64_t(1) << (j + 1);
+        }
+        return set;
+    };
+    // subset construction, state 0 is the start state
+    std::unordered_map<uint64_t, uint32_t> set_to_state;
+    valvec<uint64_t> sets;
+    sets.push_back(closure(1));
+    set_to_state[sets[0]] = 0;
+    m_trans.erase_all();
+    for (size_t s = 0; s < sets.size(); ++s) {
+        const uint64_t set = sets[s];
+        uint32_t* trans = m_trans.grow_no_init(256);
+        for (size_t ch = 0; ch < 256; ++ch) {
+            uint64_t next = 0;
+            for (size_t j = 0; j < m; ++j) {
+                if ((set >> j & 1) && atoms[j].test(byte_t(ch)))
+                    next |= uint64_t(1) << ('*' == atoms[j].quant ? j : j + 1);
+            }
+            if (0 == next) {
+                trans[ch] = nil_state;
+                continue;
+            }
+            next = closure(next);
+            auto ib = set_to_state.emplace(next, uint32_t(sets.size()));
+            if (ib.second) {
+                if (sets.size() >= MaxStates) {
+                    THROW_STD(invalid_argument, "too many dfa states: %zd", sets.size());
+                }
+                sets.push_back(next);
+                trans = m_trans.data() + 256 * s; // m_trans may be realloc'ed
+            }
+            trans[ch] = ib.first->second;
+        }
+    }
+    const size_t n = sets.size();
+    // a state is live if it can reach an accept state
+    febitvec live(n, false);
+    for (size_t s = 0; s < n; ++s)
+        if (sets[s] >> m & 1) live.set1(s);
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (size_t s = 0; s < n; ++s) {
+            if (live[s]) continue;
+            for (size_t ch = 0; ch < 256; ++ch) {
+                uint32_t t = m_trans[256 * s + ch];
+                if (nil_state != t && live[t]) {
+                    live.set1(s);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    m_is_final.resize_no_init(n);
+    m_live_beg.resize_no_init(n + 1);
+    m_live_chars.erase_all();
+    for (size_t s = 0; s < n; ++s) {
+        m_is_final[s] = byte_t(sets[s] >> m & 1);
+        m_live_beg[s] = uint32_t(m_live_chars.size());
+        for (size_t ch = 0; ch < 256; ++ch) {
+            uint32_t& t = m_trans[256 * s + ch];
+            if (nil_state != t && !live[t])
+                t = nil_state;
+            if (nil_state != t)
+                m_live_chars.push_back(byte_t(ch));
+        }
+    }
+    m_live_beg[n] = uint32_t(m_live_chars.size());
+    if (!live[0]) { // matches nothing
+        m_trans.clear();
+        m_is_final.clear();
+        m_live_beg.clear();
+        m_live_chars.clear();
+    }
+}
+
+bool GlobPatternDFA::match(fstring str) const {
+    if (empty())
+        return false;
+    size_t s = 0;
+    for (size_t i = 0; i < str.size(); ++i) {
+        s = state_move(s, str[i]);
+        if (nil_state == s)
+            return false;
+    }
+    return is_final(s);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+GlobPatternIterator::GlobPatternIterator(const BaseDFA* dfa,
+                                         const GlobPatternDFA* pattern) {
+    assert(NULL != dfa);
+    assert(NULL != pattern);
+    m_dfa = dfa;
+    m_pattern = pattern;
+    m_curr = size_t(-1);
+}
+
+GlobPatternIterator::~GlobPatternIterator() {}
+
+// consume zpath of state, push a layer with children whose char is live in
+// pattern, @returns true if state itself is a matched word
+bool GlobPatternIterator::enter(size_t state, uint32_t pattern_state) {
+    auto pat = m_pattern;
+    auto dfa = m_dfa;
+    if (dfa->v_is_pzip(state)) {
+        fstring zstr = dfa->v_get_zpath_data(state, &m_ctx);
+        for (size_t j = 0; j < zstr.size(); ++j) {
+            pattern_state = pat->state_move(pattern_state, zstr[j]);
+            if (GlobPatternDFA::nil_state == pattern_state)
+                return false; // prune whole subtree
+        }
+        m_word.append(zstr);
+    }
+    const size_t child_beg = m_children.size();
+    fstring live = pat->live_chars(pattern_state);
+    if (live.size() <= 8) {
+        // few live chars, such as literal chars in pattern: direct lookup
+        const size_t nil = dfa->v_nil_state();
+        for (byte_t ch : live) {
+            size_t child = dfa->v_state_move(state, ch);
+            if (nil != child)
+                m_children.emplace_back(ch, child);
+        }
+    }
+    else if (live.size()) {
+        const size_t sigma = dfa->get_sigma();
+        auto   beg = m_children.grow_no_init(sigma);
+        size_t num = dfa->get_all_move(state, beg);
+        size_t cnt = 0;
+        for (size_t i = 0; i < num; ++i) {
+            if (beg[i].ch < 256 &&
+                GlobPatternDFA::nil_state != pat->state_move(pattern_state, byte_t(beg[i].ch)))
+                beg[cnt++] = beg[i];
+        }
+        m_children.risk_set_size(child_beg + cnt);
+    }
+    Layer layer;
+    layer.state = state;
+    layer.pattern_state = pattern_state;
+    layer.word_len = uint32_t(m_word.size());
+    layer.child_beg = child_beg;
+    layer.child_pos = child_beg;
+    layer.child_end = m_children.size();
+    m_stack.push_back(layer);
+    return dfa->v_is_term(state) && pat->is_final(pattern_state);
+}
+
+bool GlobPatternIterator::seek_begin(size_t root) {
+    m_stack.erase_all();
+    m_children.erase_all();
+    m_word.erase_all();
+    m_curr = size_t(-1);
+    if (m_pattern->empty())
+        return false;
+    if (enter(root, 0)) {
+        m_curr = root;
+        return true;
+    }
+    return incr();
+}
+
+bool GlobPatternIterator::incr() {
+    while (!m_stack.empty()) {
+        Layer& top = m_stack.back();
+        if (top.child_pos == top.child_end) {
+            m_children.risk_set_size(top.child_beg);
+            m_stack.pop_back();
+            continue;
+        }
+        auto ct = m_children[top.child_pos++];
+        auto ps = m_pattern->state_move(top.pattern_state, byte_t(ct.ch));
+        assert(GlobPatternDFA::nil_state != ps);
+        m_word.risk_set_size(top.word_len);
+        m_word.push_back(byte_t(ct.ch));
+        if (enter(ct.target, ps)) {
+            m_curr = ct.target;
+            return true;
+        }
+    }
+    m_curr = size_t(-1);
+    m_word.erase_all();
+    return false;
+}
+
+} // namespace terark
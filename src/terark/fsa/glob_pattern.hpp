@@ -0,0 +1,109 @@
+#pragma once
+
+#include "fsa.hpp"
+
+namespace terark {
+
+/*
+ * A small DFA compiled from a glob or a restricted regex, it is intersected
+ * with any AcyclicPathDFA by GlobPatternIterator through a product walk.
+ *
+ * glob  syntax: '*' any string, '?' any byte, '[a-z]' '[!a-z]' '[^a-z]'
+ *               char class, '\' escape, '+' after an atom means repeat
+ *               one or more times, such as "user:*:session:[0-9]+"
+ * regex syntax: '.' any byte, '[...]' char class, '\d' '\w' '\s',
+ *               postfix '*' '+' '?', '\' escape; '^' at head and '$' at
+ *               tail are allowed but ignored, pattern is always anchored.
+ *               groups, alternation and counted repeat are not supported.
+ *
+ * Dead states are removed, so a walker can skip a subtree as soon as the
+ * product state is dead.
+ */
+class TERARK_DLL_EXPORT GlobPatternDFA {
+public:
+    static const uint32_t nil_state = UINT32_MAX;
+
+    GlobPatternDFA();
+    ~GlobPatternDFA();
+
+    /// @throws std::invalid_argument on bad or too complex pattern
+    void compile_glob(fstring pattern);
+    void compile_regex(fstring pattern);
+
+    size_t total_states() const { return m_is_final.size(); }
+    bool   is_final(size_t s) const { return 0 != m_is_final[s]; }
+
+    /// @returns nil_state if ch leads to dead state
+    uint32_t state_move(size_t s, byte_t ch) const {
+        assert(s < total_states());
+        return m_trans[256 * s + ch];
+    }
+
+    /// chars which lead s to a live state, sorted ascending
+    fstring live_chars(size_t s) const {
+        assert(s < total_states());
+        size_t beg = m_live_beg[s], end = m_live_beg[s+1];
+        return fstring(m_live_chars.data() + beg, end - beg);
+    }
+
+    /// @returns true if nothing can be matched
+    bool empty() const { return m_is_final.empty(); }
+
+    /// match whole str
+    bool match(fstring str) const;
+
+    /// when the pattern starts with literal chars, they are a common prefix
+    /// of all matched strings, it can be used for seeking
+    fstring literal_prefix() const { return m_literal_prefix; }
+
+    struct Atom; // used by pattern parser
+
+protected:
+    void compile_atoms(const valvec<Atom>&);
+
+    valvec<uint32_t> m_trans; // 256 per state
+    valvec<byte_t>   m_is_final;
+    valvec<uint32_t> m_live_beg;
+    valvec<byte_t>   m_live_chars;
+    std::string      m_literal_prefix;
+};
+
+/// enumerate words of dfa which match pattern, lazily in lexicographic order
+/// non-matching subtrees are skipped, cost is proportional to matched paths
+/// @note dfa must be acyclic from root, concurrent Patricia requires caller
+///       to hold a ReaderToken
+class TERARK_DLL_EXPORT GlobPatternIterator : boost::noncopyable {
+public:
+    GlobPatternIterator(const BaseDFA* dfa, const GlobPatternDFA* pattern);
+    ~GlobPatternIterator();
+
+    /// seek to the first matched word under root
+    bool seek_begin(size_t root = initial_state);
+
+    /// seek to next matched word
+    bool incr();
+
+    fstring word() const { return m_word; }
+    size_t  word_state() const { return m_curr; }
+
+protected:
+    struct Layer {
+        size_t   state;
+        uint32_t pattern_state;
+        uint32_t word_len;
+        size_t   child_beg;
+        size_t   child_pos;
+        size_t   child_end;
+    };
+    bool enter(size_t state, uint32_t pattern_state);
+
+    const BaseDFA*              m_dfa;
+    const GlobPatternDFA*       m_pattern;
+    MatchContext                m_ctx;
+    valvec<Layer>               m_stack;
+    valvec<CharTarget<size_t> > m_children;
+    valvec<byte_t>              m_word;
+    size_t                      m_curr;
+};
+
+} // namespace terark
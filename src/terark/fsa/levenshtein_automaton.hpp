@@ -0,0 +1,138 @@
+#pragma once
+
+#include <terark/fstring.hpp>
+#include <terark/valvec.hpp>
+#include "fsa.hpp"
+
+namespace terark {
+
+/*
+ * Levenshtein automaton simulated by Wagner-Fischer rows.
+ *
+ * A row is the automaton state after consuming a prefix of a candidate word,
+ * row(depth)[j] is the edit distance between key[0,j) and word[0,depth).
+ * All values are saturated at max_dist + 1, so a row whose minimum exceeds
+ * max_dist is a dead state: no extension of the prefix can match.
+ *
+ * Rows are kept as a stack indexed by depth, this fits DFS on a trie: when
+ * backtracking to depth d, row(d) is still valid and step(d, ch) overwrites
+ * row(d+1) in place.
+ */
+class TERARK_DLL_EXPORT LevenshteinAutomaton {
+    fstring          m_key;
+    uint32_t         m_max_dist;
+    size_t           m_row_len; // m_key.size() + 1
+    valvec<uint32_t> m_rows;
+public:
+    LevenshteinAutomaton() : m_max_dist(0), m_row_len(1) {}
+    LevenshteinAutomaton(fstring key, size_t max_dist) { reset(key, max_dist); }
+
+    /// @note key memory must be kept valid by the caller
+    void reset(fstring key, size_t max_dist) {
+        assert(max_dist < UINT32_MAX - 1);
+        m_key = key;
+        m_max_dist = uint32_t(max_dist);
+        m_row_len = key.size() + 1;
+        m_rows.resize_no_init(m_row_len * 16);
+        uint32_t* r0 = m_rows.data();
+        for (size_t j = 0; j < m_row_len; ++j)
+            r0[j] = uint32_t(std::min<size_t>(j, max_dist + 1));
+    }
+    fstring key() const { return m_key; }
+    size_t max_dist() const { return m_max_dist; }
+
+    const uint32_t* row(size_t depth) const {
+        assert((depth + 1) * m_row_len <= m_rows.size());
+        return m_rows.data() + m_row_len * depth;
+    }
+
+    /// edit distance of whole key and word[0,depth), max_dist+1 if too far
+    size_t distance(size_t depth) const { return row(depth)[m_row_len-1]; }
+    bool   is_match(size_t depth) const { return distance(depth) <= m_max_dist; }
+
+    /// compute row(depth+1) from row(depth) by consuming ch
+    /// @returns true if row(depth+1) is alive, that is: some extension of
+    ///          word[0,depth+1) may still be in distance of max_dist
+    bool step(size_t depth, byte_t ch) {
+        const size_t n = m_row_len;
+        if (terark_unlikely((depth + 2) * n > m_rows.size())) {
+            m_rows.resize_no_init(m_rows.size() * 2);
+        }
+        const uint32_t  k1 = m_max_dist + 1;
+        const uint32_t* prev = m_rows.data() + n * depth;
+        /**/  uint32_t* curr = m_rows.data() + n * (depth + 1);
+        const byte_t*   key = (const byte_t*)m_key.data();
+        // cells out of diagonal band [depth+1-k, depth+1+k] are always > k
+        const size_t lo = depth + 1 > m_max_dist ? depth + 1 - m_max_dist : 1;
+        const size_t hi = std::min(n - 1, depth + 1 + m_max_dist);
+        uint32_t lowest = curr[0] = uint32_t(std::min<size_t>(depth + 1, k1));
+        for (size_t j = 1; j < lo && j < n; ++j)
+            curr[j] = k1;
+        for (size_t j = lo; j <= hi; ++j) {
+            uint32_t sub = prev[j-1] + (key[j-1] != ch);
+            uint32_t del = prev[j] + 1;
+            uint32_t ins = curr[j-1] + 1;
+            uint32_t val = std::min(std::min(sub, del), std::min(ins, k1));
+            curr[j] = val;
+            lowest = std::min(lowest, val);
+        }
+        for (size_t j = std::max(hi + 1, lo); j < n; ++j)
+            curr[j] = k1;
+        return lowest <= m_max_dist;
+    }
+};
+
+/// DFS over a DFA from root, with a LevenshteinAutomaton in lockstep, each
+/// subtree is pruned as soon as the automaton state is dead.
+/// @param on_match(fstring word, size_t state, size_t dist), state is the
+///        final state of word, for DAWG, convert it by state_to_word_id
+/// @param ctx is used for fetching zpath data of path zipped states
+/// @returns number of matched words
+/// @note words are visited in lexicographic order
+template<class DFA, class OnMatch>
+size_t dfa_match_levenshtein(const DFA& dfa, MatchContext& ctx, size_t root,
+                             fstring key, size_t max_dist, OnMatch on_match) {
+    struct Frame {
+        size_t state;
+        size_t depth; // word len of parent, including parent's zpath
+        size_t ch;
+    };
+    LevenshteinAutomaton la(key, max_dist);
+    valvec<Frame>  stack(dfa.get_sigma() + 1, valvec_reserve());
+    valvec<byte_t> word(256, valvec_reserve());
+    size_t cnt = 0;
+    stack.push_back({root, 0, size_t(-1)});
+    while (!stack.empty()) {
+        const Frame f = stack.pop_val();
+        word.risk_set_size(f.depth);
+        if (size_t(-1) != f.ch) {
+            if (!la.step(f.depth, byte_t(f.ch)))
+                continue;
+            word.push_back(byte_t(f.ch));
+        }
+        if (dfa.is_pzip(f.state)) {
+            fstring zstr = dfa.get_zpath_data(f.state, &ctx);
+            size_t j = 0;
+            for (; j < zstr.size(); ++j) {
+                if (!la.step(word.size(), zstr[j]))
+                    break;
+                word.push_back(zstr[j]);
+            }
+            if (j < zstr.size())
+                continue; // pruned in the middle of zpath
+        }
+        const size_t depth = word.size();
+        if (dfa.is_term(f.state) && la.is_match(depth)) {
+            on_match(fstring(word.data(), depth), f.state, la.distance(depth));
+            cnt++;
+        }
+        const size_t oldsize = stack.size();
+        dfa.for_each_move(f.state, [&](size_t child, auchar_t ch) {
+            stack.push_back({child, depth, ch});
+        });
+        std::reverse(stack.begin() + oldsize, stack.end());
+    }
+    return cnt;
+}
+
+} // namespace terark
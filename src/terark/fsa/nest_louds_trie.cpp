@@ -11,6 +11,7 @@ namespace terark {
 #endif
 
 #include "nest_louds_trie_inline.hpp"
+#include <terark/succinct/rank_select_parallel.hpp>
 #include "dfa_mmap_header.hpp"
 #include "tmplinst.hpp"
 #include <terark/io/DataIO.hpp>
@@ -1254,7 +1255,7 @@ build_patricia_tpl(StrVecType& strVec,
 			);
 		}
 	}
-	this->m_louds.build_cache(1, 1);
+	build_cache_parallel(this->m_louds, true, true);
 
 	if (FastLabel) {
 		size_t bitpos = 1; // parent's bitpos
@@ -1339,7 +1340,7 @@ build_strpool2(SortableStrVec& strVec, valvec<size_t>& linkVec,
 			, BOOST_CURRENT_FUNCTION, conf.nestLevel-1, conf.nestLevel
 		);
 	}
-	this->m_louds.build_cache(1, 1);
+	build_cache_parallel(this->m_louds, true, true);
 }
 
 ///@param[inout] strVec
@@ -1400,7 +1401,7 @@ build_strpool_loop(SortableStrVec& strVec, valvec<size_t>& linkVec,
 			, BOOST_CURRENT_FUNCTION, curNestLevel, conf.nestLevel
 		);
 	}
-	m_louds.build_cache(0, 1); // need not speed select0
+	build_cache_parallel(m_louds, false, true); // need not speed select0
 }
 
 ///@param[inout] nextLinkVec
@@ -2982,6 +2983,8 @@ template class NestLoudsTrieTpl<rank_select_se_512_32, rank_select_mixed_se_512_
 template class NestLoudsTrieTpl<rank_select_il_256_32, rank_select_mixed_il_256_0, true>;
 template class NestLoudsTrieTpl<rank_select_il_256_32, rank_select_mixed_xl_256_0, true>;
 
+template class NestLoudsTrieTpl<rank_select_il_256_32, rank_select_rrr, true>;
+
 /*
 template class NestLoudsTrieTpl<rank_select_il_256_32_41, rank_select_mixed_il_256_0, true>;
 template class NestLoudsTrieTpl<rank_select_il_256_32_41, rank_select_mixed_xl_256_0, true>;
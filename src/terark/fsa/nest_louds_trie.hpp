@@ -11,6 +11,8 @@
 #include <terark/succinct/rank_select_mixed_il_256.hpp>
 #include <terark/succinct/rank_select_mixed_xl_256.hpp>
 #include <terark/succinct/rank_select_mixed_se_512.hpp>
+#include <terark/succinct/rank_select_rrr.hpp>
+#include <terark/succinct/rank_select_batch.hpp>
 #include <terark/util/sortable_strvec.hpp>
 #include <terark/util/zo_sorted_strvec.hpp>
 #include "dfa_algo_basic.hpp"
@@ -316,6 +318,8 @@ public:
     template<class RankSelectTerm>
     size_t state_to_dict_rank(size_t state, const RankSelectTerm& is_term) const noexcept;
     template<class RankSelectTerm>
+    void state_to_dict_rank_batch(const size_t* states, size_t n, size_t* ranks, const RankSelectTerm& is_term) const noexcept;
+    template<class RankSelectTerm>
     size_t dict_rank_to_state(size_t rank, const RankSelectTerm& is_term) const noexcept;
 
 	template<class OP>
@@ -432,6 +436,9 @@ TERARK_NAME_TYPE(NestLoudsTrie_Mixed_SE_512_32_FL, NestLoudsTrieTpl<rank_select_
 TERARK_NAME_TYPE(NestLoudsTrie_Mixed_IL_256_32_FL, NestLoudsTrieTpl<rank_select_il_256_32, rank_select_mixed_il_256_0, true>);
 TERARK_NAME_TYPE(NestLoudsTrie_Mixed_XL_256_32_FL, NestLoudsTrieTpl<rank_select_il_256_32, rank_select_mixed_xl_256_0, true>);
 
+// is_link and is_term are compressed, for tries whose links/terms are sparse
+TERARK_NAME_TYPE(NestLoudsTrie_IL_256_32_RRR_FL, NestLoudsTrieTpl<rank_select_il_256_32, rank_select_rrr, true>);
+
 /*
 TERARK_NAME_TYPE(NestLoudsTrie_Mixed_IL_256_32_41_FL, NestLoudsTrieTpl<rank_select_il_256_32_41, rank_select_mixed_il_256_0, true>);
 TERARK_NAME_TYPE(NestLoudsTrie_Mixed_XL_256_32_41_FL, NestLoudsTrieTpl<rank_select_il_256_32_41, rank_select_mixed_xl_256_0, true>);
@@ -807,6 +807,88 @@ state_to_dict_rank(size_t state, const RankSelectTerm& is_term) const noexcept {
     return parent_rank + child_rank;
 }
 
+// same as state_to_dict_rank for each state, the parent and child chains of
+// a group of states are walked in lock step, so the select and rank of
+// each step are independent and are done by the batch kernels
+template<class RankSelect, class RankSelect2, bool FastLabel>
+template<class RankSelectTerm>
+void
+NestLoudsTrieTpl<RankSelect, RankSelect2, FastLabel>::
+state_to_dict_rank_batch(const size_t* states, size_t n, size_t* ranks,
+                         const RankSelectTerm& is_term) const noexcept {
+    const size_t Group = 32;
+    size_t layer_max = m_layer_id_rank.size();
+    size_t node[Group], layer[Group], active[Group], pos[Group], tmp[Group];
+    for (size_t beg = 0; beg < n; beg += Group) {
+        size_t num = std::min(n - beg, Group);
+        const size_t* st = states + beg;
+        size_t* rk = ranks + beg;
+        rank1_batch(is_term, st, num, rk);
+        size_t num_active = 0;
+        for (size_t i = 0; i < num; ++i) {
+            assert(st[i] < m_louds.max_rank1());
+            layer[i] = upper_bound_ex_a(m_layer_id_rank, st[i], TERARK_FIELD(id)) - 1;
+            assert(layer[i] < layer_max);
+            rk[i] -= m_layer_id_rank[layer[i]].rank;
+            node[i] = st[i];
+            if (node[i] != initial_state)
+                active[num_active++] = i;
+        }
+        // parent chains
+        while (num_active) {
+            for (size_t j = 0; j < num_active; ++j)
+                tmp[j] = node[active[j]];
+            select1_batch(m_louds, tmp, num_active, pos);
+            for (size_t j = 0; j < num_active; ++j) {
+                size_t i = active[j];
+                node[i] = pos[j] - node[i] - 1;
+                tmp[j] = node[i] + 1;
+                --layer[i];
+            }
+            rank1_batch(is_term, tmp, num_active, pos);
+            size_t k = 0;
+            for (size_t j = 0; j < num_active; ++j) {
+                size_t i = active[j];
+                rk[i] += pos[j] - m_layer_id_rank[layer[i]].rank;
+                if (node[i] != initial_state)
+                    active[k++] = i;
+                else
+                    assert(layer[i] == 0);
+            }
+            num_active = k;
+        }
+        // child chains
+        for (size_t i = 0; i < num; ++i) {
+            layer[i] = upper_bound_ex_a(m_layer_id_rank, st[i], TERARK_FIELD(id));
+            node[i] = st[i];
+            if (layer[i] < layer_max)
+                active[num_active++] = i;
+        }
+        while (num_active) {
+            size_t k = 0;
+            for (size_t j = 0; j < num_active; ++j) {
+                size_t i = active[j];
+                size_t child = m_louds.select0(node[i]) - node[i];
+                assert(child <= is_term.size());
+                node[i] = child;
+                if (child != m_layer_id_rank[layer[i]].id) {
+                    assert(child > m_layer_id_rank[layer[i]].id);
+                    tmp[k] = child;
+                    active[k++] = i;
+                }
+            }
+            rank1_batch(is_term, tmp, k, pos);
+            num_active = 0;
+            for (size_t j = 0; j < k; ++j) {
+                size_t i = active[j];
+                rk[i] += pos[j] - m_layer_id_rank[layer[i]].rank;
+                if (++layer[i] < layer_max)
+                    active[num_active++] = i;
+            }
+        }
+    }
+}
+
 template<class RankSelect, class RankSelect2, bool FastLabel>
 template<class RankSelectTerm>
 size_t
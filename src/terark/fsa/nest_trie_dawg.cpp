@@ -2,6 +2,7 @@
 #include "nest_trie_dawg.hpp"
 #include "fsa_cache_detail.hpp"
 #include "nest_louds_trie_inline.hpp"
+#include <terark/succinct/rank_select_parallel.hpp>
 #include "dfa_mmap_header.hpp"
 #include "tmplinst.hpp"
 
@@ -375,6 +376,14 @@ dawg_lower_bound(MatchContext& ctx, fstring qry) const noexcept {
  */
 }
 
+template<class NestTrie, class DawgType>
+size_t NestTrieDAWG<NestTrie, DawgType>::
+match_levenshtein(MatchContext& ctx, size_t root, fstring key,
+		size_t maxDist, const OnLevenshteinMatch& on_match) const {
+	assert(root < this->total_states());
+	return dfa_match_levenshtein(*this, ctx, root, key, maxDist, on_match);
+}
+
 template<class NestTrie, class DawgType>
 void NestTrieDAWG<NestTrie, DawgType>::
 nth_word(MatchContext& ctx, size_t nth, std::string* word) const noexcept {
@@ -589,7 +598,7 @@ prepare_save_mmap(DFA_MmapHeader* base, const void** dataPtrs) const {
 		blockIndex++;
 	}
 	if (!NestTrie::is_link_rs_mixed::value) {
-		dataPtrs[blockIndex] = getIsTerm().bldata();
+		dataPtrs[blockIndex] = getIsTerm().data();
 		base->blocks[blockIndex].offset = blockOffset;
 		base->blocks[blockIndex].length = getIsTerm().mem_size();
 		blockOffset = align_to_64(base->blocks[blockIndex].endpos());
@@ -700,7 +709,7 @@ NestTrieDAWG<NestTrie, DawgType>::build_term_bits(const valvec<size_t>& linkVec)
 		assert(node_id < termFlag.size());
 		termFlag.set1(node_id);
 	}
-	termFlag.build_cache(0, 1);
+	build_cache_parallel(termFlag, false, true);
 }
 
 template<class NestTrie, class DawgType>
@@ -723,7 +732,7 @@ build_with_id(SortableStrVec& strVec, valvec<size_t>& idvec, const NestLoudsTrie
 	for (size_t i = 0; i < idvec.size(); ++i) {
 		getIsTerm().set1(idvec[i]);
 	}
-	getIsTerm().build_cache(false, true);
+	build_cache_parallel(getIsTerm(), false, true);
 	this->m_zpath_states = m_trie->num_zpath_states();
 	this->m_total_zpath_len = m_trie->total_zpath_len();
 	this->n_words = getIsTerm().max_rank1();
@@ -771,6 +780,8 @@ template class NestTrieDAWG<NestLoudsTrie_Mixed_SE_512_32_FL, BaseDAWG>;
 template class NestTrieDAWG<NestLoudsTrie_Mixed_IL_256_32_FL, BaseDAWG>;
 template class NestTrieDAWG<NestLoudsTrie_Mixed_XL_256_32_FL, BaseDAWG>;
 
+template class NestTrieDAWG<NestLoudsTrie_IL_256_32_RRR_FL, BaseDAWG>;
+
 /*
 template class NestTrieDAWG<NestLoudsTrie_Mixed_IL_256_32_41_FL, BaseDAWG>;
 template class NestTrieDAWG<NestLoudsTrie_Mixed_XL_256_32_41_FL, BaseDAWG>;
@@ -806,6 +817,8 @@ TERARK_DFA_NO_LOAD_SAVE(NestLoudsTrieDAWG_Mixed_SE_512_32_FL);
 TERARK_DFA_NO_LOAD_SAVE(NestLoudsTrieDAWG_Mixed_IL_256_32_FL);
 TERARK_DFA_NO_LOAD_SAVE(NestLoudsTrieDAWG_Mixed_XL_256_32_FL);
 
+TERARK_DFA_NO_LOAD_SAVE(NestLoudsTrieDAWG_IL_256_32_RRR_FL);
+
 /*
 TERARK_DFA_NO_LOAD_SAVE(NestLoudsTrieDAWG_Mixed_IL_256_32_41_FL);
 TERARK_DFA_NO_LOAD_SAVE(NestLoudsTrieDAWG_Mixed_XL_256_32_41_FL);
@@ -835,6 +848,8 @@ TMPL_INST_DFA_CLASS(NestLoudsTrieDAWG_Mixed_SE_512_32_FL)
 TMPL_INST_DFA_CLASS(NestLoudsTrieDAWG_Mixed_IL_256_32_FL)
 TMPL_INST_DFA_CLASS(NestLoudsTrieDAWG_Mixed_XL_256_32_FL)
 
+TMPL_INST_DFA_CLASS(NestLoudsTrieDAWG_IL_256_32_RRR_FL)
+
 /*
 TMPL_INST_DFA_CLASS(NestLoudsTrieDAWG_Mixed_IL_256_32_41_FL)
 TMPL_INST_DFA_CLASS(NestLoudsTrieDAWG_Mixed_XL_256_32_41_FL)
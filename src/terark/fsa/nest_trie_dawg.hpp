@@ -1,6 +1,7 @@
 #pragma once
 
 #include "nest_louds_trie.hpp"
+#include "levenshtein_automaton.hpp"
 #include <terark/util/autofree.hpp>
 
 namespace terark {
@@ -8,7 +9,7 @@ namespace terark {
 template<class NestTrie, bool IsRankSelect2>
 class TERARK_DLL_EXPORT NestTrieDAWG_IsTerm {
 protected:
-	typedef typename NestTrie::rank_select_t rank_select_t;
+	typedef typename NestTrie::rank_select2_t rank_select_t; // same as is_link
 	NestTrie* m_trie;
 	rank_select_t  m_is_term;
 	rank_select_t& getIsTerm() { return m_is_term; }
@@ -189,7 +190,15 @@ public:
 	}
 	size_t v_state_to_word_id(size_t state) const override;
 
+	// ids[i] = state_to_word_id(states[i]), ids may be states
+	void state_to_word_id_batch(const size_t* states, size_t n, size_t* ids) const noexcept {
+		rank1_batch(getIsTerm(), states, n, ids);
+	}
+
     size_t state_to_dict_rank(size_t state) const override;
+    void state_to_dict_rank_batch(const size_t* states, size_t n, size_t* ranks) const noexcept {
+        m_trie->state_to_dict_rank_batch(states, n, ranks, getIsTerm());
+    }
     size_t dict_rank_to_state(size_t rank) const noexcept;
 
 // DAWG functions:
@@ -222,6 +231,20 @@ public:
 
 	DawgIndexIter dawg_lower_bound(MatchContext&, fstring) const noexcept override;
 
+	using MatchingDFA::match_levenshtein;
+	size_t match_levenshtein(MatchContext&, size_t root, fstring key,
+				size_t maxDist, const OnLevenshteinMatch&) const override;
+
+	///@param on_match(fstring word, size_t word_id, size_t dist)
+	template<class OnMatch>
+	size_t match_levenshtein_dawg(fstring key, size_t maxDist, OnMatch on_match) const {
+		MatchContext ctx;
+		return dfa_match_levenshtein(*this, ctx, initial_state, key, maxDist,
+			[&](fstring word, size_t state, size_t dist) {
+				on_match(word, this->state_to_word_id(state), dist);
+			});
+	}
+
 	template<class OnMatch, class TR>
 	size_t tpl_match_dawg
 (MatchContext& ctx, size_t base_nth, fstring str, OnMatch on_match, TR tr)
@@ -322,6 +345,8 @@ TERARK_NAME_TYPE(NestLoudsTrieDAWG_Mixed_SE_512_32_FL, NestTrieDAWG<NestLoudsTri
 TERARK_NAME_TYPE(NestLoudsTrieDAWG_Mixed_IL_256_32_FL, NestTrieDAWG<NestLoudsTrie_Mixed_IL_256_32_FL, BaseDAWG>);
 TERARK_NAME_TYPE(NestLoudsTrieDAWG_Mixed_XL_256_32_FL, NestTrieDAWG<NestLoudsTrie_Mixed_XL_256_32_FL, BaseDAWG>);
 
+TERARK_NAME_TYPE(NestLoudsTrieDAWG_IL_256_32_RRR_FL, NestTrieDAWG<NestLoudsTrie_IL_256_32_RRR_FL, BaseDAWG>);
+
 /*
 TERARK_NAME_TYPE(NestLoudsTrieDAWG_Mixed_IL_256_32_41_FL, NestTrieDAWG<NestLoudsTrie_Mixed_IL_256_32_41_FL, BaseDAWG>);
 TERARK_NAME_TYPE(NestLoudsTrieDAWG_Mixed_XL_256_32_41_FL, NestTrieDAWG<NestLoudsTrie_Mixed_XL_256_32_41_FL, BaseDAWG>);
@@ -123,6 +123,20 @@ protected:
 	bool    is_sorted;
 	bool    m_enable_auto_gc; // will not keep stable index(on elem erased)
 	bool    m_enable_freelist_reuse;
+	bool    m_enable_incremental_rehash;
+
+	// incremental rehash: when m_old_bucket is not NULL, the collision
+	// lists of m_old_bucket[m_migrate_pos, m_old_nBucket) are not yet
+	// migrated to bucket, a key is in m_old_bucket iff its old bucket pos
+	// is not migrated, thus a lookup still searches just one list
+	LinkTp* m_old_bucket;
+	size_t  m_old_nBucket;
+	size_t  m_migrate_pos;
+
+	// old buckets migrated per insert, a full migration takes at most
+	// m_old_nBucket/MigrateStep inserts, less than the inserts needed to
+	// reach the next maxload, thus it is rare to finish it on next growth
+	static const size_t MigrateStep = 8;
 
 private:
 	void init() {
@@ -147,9 +161,99 @@ private:
 		is_sorted = true;
 		m_enable_auto_gc = false;
 		m_enable_freelist_reuse = true;
+		m_enable_incremental_rehash = false;
+
+		m_old_bucket = NULL;
+		m_old_nBucket = 0;
+		m_migrate_pos = 0;
+	}
+
+	void free_old_bucket() {
+		if (m_old_bucket) {
+			free(m_old_bucket);
+			m_old_bucket = NULL;
+			m_old_nBucket = 0;
+			m_migrate_pos = 0;
+		}
+	}
+
+	// head of the collision list of h
+	LinkTp* bucket_head(HashTp h) const {
+		if (terark_likely(NULL == m_old_bucket))
+			return &bucket[h % nBucket];
+		return &bucket_at(bucket_pos(h));
+	}
+	// return bucket pos of h, pos >= nBucket is in m_old_bucket
+	size_t bucket_pos(HashTp h) const {
+		if (terark_unlikely(NULL != m_old_bucket)) {
+			size_t j = size_t(h % m_old_nBucket);
+			if (j >= m_migrate_pos)
+				return nBucket + j;
+		}
+		return size_t(h % nBucket);
+	}
+	LinkTp& bucket_at(size_t pos) const {
+		if (terark_likely(pos < nBucket))
+			return bucket[pos];
+		TERARK_ASSERT_LT(pos - nBucket, m_old_nBucket);
+		return m_old_bucket[pos - nBucket];
+	}
+
+	// move the collision lists of n old buckets to bucket
+	void migrate_buckets(size_t n) {
+		LinkTp* ob = m_old_bucket;
+		LinkTp* pb = bucket;
+		size_t  nb = nBucket;
+		size_t  pos = m_migrate_pos;
+		size_t  end = std::min(pos + n, m_old_nBucket);
+		NodeLayout nl = m_nl;
+		for (; pos < end; ++pos) {
+			for (LinkTp p = ob[pos]; tail != p; ) {
+				TERARK_ASSERT_LT(p, nElem);
+				LinkTp next = nl.link(p);
+				size_t i = hash_i(p) % nb;
+				nl.link(p) = pb[i];
+				pb[i] = p;
+				p = next;
+			}
+		}
+		m_migrate_pos = pos;
+		if (pos == m_old_nBucket)
+			free_old_bucket();
+	}
+
+	// allocate the new bucket, the old collision lists are migrated by
+	// later inserts, the current migration(if any) is finished first
+	void start_incremental_rehash() {
+		if (m_old_bucket)
+			migrate_buckets(m_old_nBucket);
+		size_t newBucketSize = __hsm_stl_next_prime(nBucket + 1);
+		if (1 == nBucket) { // false start, nothing to migrate
+			rehash(newBucketSize);
+			return;
+		}
+		LinkTp* pb = (LinkTp*)malloc(sizeof(LinkTp) * newBucketSize);
+		TERARK_VERIFY_F(nullptr != pb, "malloc(%zd) = NULL",
+						sizeof(LinkTp) * newBucketSize);
+		std::fill_n(pb, newBucketSize, (LinkTp)tail);
+		m_old_bucket = bucket;
+		m_old_nBucket = nBucket;
+		m_migrate_pos = 0;
+		bucket = pb;
+		nBucket = newBucketSize;
+		maxload = LinkTp(newBucketSize * load_factor / 256);
+	}
+
+	// called when nElem - freelist_size reaches maxload
+	void grow_bucket() {
+		if (m_enable_incremental_rehash)
+			start_incremental_rehash();
+		else
+			rehash(nBucket + 1); // will auto find next prime bucket size
 	}
 
 	void relink_impl(bool bFillHash) {
+		free_old_bucket(); // all lists are rebuilt in bucket
 		LinkTp* pb = bucket;
 		size_t  nb = nBucket;
 		NodeLayout nl = m_nl;
@@ -259,6 +363,8 @@ private:
 	  #endif
 		if (bucket && &tail != bucket)
 			free(bucket);
+		if (m_old_bucket)
+			free(m_old_bucket);
 	}
 
 public:
@@ -316,6 +422,10 @@ public:
 		is_sorted = y.is_sorted;
 		m_enable_auto_gc = y.m_enable_auto_gc;
 		m_enable_freelist_reuse = y.m_enable_freelist_reuse;
+		m_enable_incremental_rehash = y.m_enable_incremental_rehash;
+		m_old_bucket = NULL;
+		m_old_nBucket = 0;
+		m_migrate_pos = 0;
 
 		if (0 == nElem) { // empty
 			nBucket = 1;
@@ -346,6 +456,14 @@ public:
 		}
 	  #endif
 		memcpy(bucket, y.bucket, sizeof(LinkTp) * nBucket);
+		if (y.m_old_bucket) { // copy the migration state
+			m_old_bucket = (LinkTp*)malloc(sizeof(LinkTp) * y.m_old_nBucket);
+			TERARK_VERIFY_F(nullptr != m_old_bucket, "malloc(%zd) = NULL",
+							sizeof(LinkTp) * y.m_old_nBucket);
+			memcpy(m_old_bucket, y.m_old_bucket, sizeof(LinkTp) * y.m_old_nBucket);
+			m_old_nBucket = y.m_old_nBucket;
+			m_migrate_pos = y.m_migrate_pos;
+		}
 		if (!boost::has_trivial_copy<Elem>::value
 				&& freelist_size) {
 			node_layout_copy_cons(m_nl, y.m_nl, nElem, IsNotFree());
@@ -385,6 +503,11 @@ public:
 		is_sorted   =  y.is_sorted;
 		m_enable_auto_gc = y.m_enable_auto_gc;
 		m_enable_freelist_reuse = y.m_enable_freelist_reuse;
+		m_enable_incremental_rehash = y.m_enable_incremental_rehash;
+
+		m_old_bucket  = y.m_old_bucket;
+		m_old_nBucket = y.m_old_nBucket;
+		m_migrate_pos = y.m_migrate_pos;
 
 		y.init(); // reset y as empty
 	}
@@ -416,6 +539,10 @@ public:
 		std::swap(is_sorted  , y.is_sorted);
 		std::swap(m_enable_auto_gc, y.m_enable_auto_gc);
 		std::swap(m_enable_freelist_reuse, y.m_enable_freelist_reuse);
+		std::swap(m_enable_incremental_rehash, y.m_enable_incremental_rehash);
+		std::swap(m_old_bucket , y.m_old_bucket);
+		std::swap(m_old_nBucket, y.m_old_nBucket);
+		std::swap(m_migrate_pos, y.m_migrate_pos);
 		std::swap(static_cast<HashEqual&>(*this), static_cast<HashEqual&>(y));
 		std::swap(static_cast<KeyExtractor&>(*this) , static_cast<KeyExtractor&>(y));
 	}
@@ -673,6 +800,7 @@ public:
 				}
 			}
 			std::fill_n(bucket, nBucket, (LinkTp)tail);
+			free_old_bucket();
 		}
 		if (freelist_head < delmark) {
 			TERARK_VERIFY_LT(freelist_head, nElem);
@@ -811,6 +939,20 @@ public:
 	void disable_freelist() { enable_freelist(false); }
 	bool is_freelist_enabled() const { return m_enable_freelist_reuse; }
 
+	// when incremental rehash is enabled, growing does not relink all
+	// elements at once, the collision lists of the old bucket array are
+	// migrated MigrateStep buckets per insert, this bounds the latency of
+	// a single insert on large tables at the cost of keeping both bucket
+	// arrays during the migration. Whole table operations such as
+	// rehash/reserve/sort/revoke_deleted discard the migration by relink.
+	void enable_incremental_rehash(bool e = true) { m_enable_incremental_rehash = e; }
+	bool is_incremental_rehash_enabled() const { return m_enable_incremental_rehash; }
+	bool is_rehashing() const { return NULL != m_old_bucket; }
+	void finish_rehash() {
+		if (m_old_bucket)
+			migrate_buckets(m_old_nBucket);
+	}
+
 public:
 	//@{
 	//@brief erase_if
@@ -895,24 +1037,26 @@ public:
 	std::pair<size_t, bool>
 	lazy_insert_elem_with_hash_i(key_param_pass_t key, HashTp h, ConsElem cons_elem) {
 		TERARK_ASSERT_EQ(HashEqual::hash(key), h);
-		size_t i = h % nBucket;
-		for (LinkTp p = bucket[i]; tail != p; p = m_nl.link(p)) {
+		LinkTp* head = bucket_head(h);
+		for (LinkTp p = *head; tail != p; p = m_nl.link(p)) {
 			TERARK_ASSERT_LT(p, nElem);
 			if (HashEqual::equal(key, MyKeyExtractor(m_nl.data(p))))
 				return std::make_pair(p, false);
 		}
 		if (terark_unlikely(nElem - freelist_size >= maxload)) {
-			// rehash will auto find next prime bucket size
-			i = h % rehash(nBucket + 1);
+			grow_bucket();
+			head = bucket_head(h);
 		}
 		size_t slot = risk_slot_alloc(); // here, no risk
 		cons_elem(&m_nl.data(slot)); // must success
-		m_nl.link(slot) = bucket[i]; // newer at head
-		bucket[i] = LinkTp(slot); // new head of i'th bucket
+		m_nl.link(slot) = *head; // newer at head
+		*head = LinkTp(slot); // new head of the bucket
 	  #if defined(HSM_ENABLE_HASH_CACHE)
 		if (intptr_t(pHash) != hash_cache_disabled)
 			pHash[slot] = h;
 	  #endif
+		if (terark_unlikely(NULL != m_old_bucket))
+			migrate_buckets(MigrateStep);
 		is_sorted = false;
 		return std::make_pair(slot, true);
 	}
@@ -920,26 +1064,28 @@ public:
 	size_t hint_insert_elem_with_hash_i(key_param_pass_t key, HashTp h,
 										size_t hint, ConsElem cons_elem) {
 		TERARK_ASSERT_EQ(HashEqual::hash(key), h);
-		TERARK_ASSERT_EQ(h % nBucket, hint); // hint is bucket pos
+		TERARK_ASSERT_EQ(bucket_pos(h), hint); // hint is bucket pos
 		size_t i = hint;
 	  #if !defined(NDEBUG)
-		for (LinkTp p = bucket[i]; tail != p; p = m_nl.link(p)) {
+		for (LinkTp p = bucket_at(i); tail != p; p = m_nl.link(p)) {
 			TERARK_ASSERT_LT(p, nElem);
 			assert(!HashEqual::equal(key, MyKeyExtractor(m_nl.data(p))));
 		}
 	  #endif
 		if (terark_unlikely(nElem - freelist_size >= maxload)) {
-			// rehash will auto find next prime bucket size
-			i = h % rehash(nBucket + 1);
+			grow_bucket();
+			i = bucket_pos(h);
 		}
 		size_t slot = risk_slot_alloc(); // here, no risk
 		cons_elem(&m_nl.data(slot)); // must success
-		m_nl.link(slot) = bucket[i]; // newer at head
-		bucket[i] = LinkTp(slot); // new head of i'th bucket
+		m_nl.link(slot) = bucket_at(i); // newer at head
+		bucket_at(i) = LinkTp(slot); // new head of i'th bucket
 	  #if defined(HSM_ENABLE_HASH_CACHE)
 		if (intptr_t(pHash) != hash_cache_disabled)
 			pHash[slot] = h;
 	  #endif
+		if (terark_unlikely(NULL != m_old_bucket))
+			migrate_buckets(MigrateStep);
 		is_sorted = false;
 		return slot;
 	}
@@ -961,9 +1107,9 @@ public:
 					std::pair<size_t, bool> >::type
 	{
 		const size_t old_nBucket = nBucket;
-		size_t i = size_t(h % old_nBucket);
+		LinkTp* head = bucket_head(h);
 		// this func is a copy-paste except old_nBucket and pre_insert
-		for (LinkTp p = bucket[i]; tail != p; p = m_nl.link(p)) {
+		for (LinkTp p = *head; tail != p; p = m_nl.link(p)) {
 			TERARK_ASSERT_LT(p, nElem);
 			if (HashEqual::equal(key, MyKeyExtractor(m_nl.data(p))))
 				return std::make_pair(p, false);
@@ -972,20 +1118,22 @@ public:
 			return std::make_pair(nElem, true);
 		}
 		if (terark_unlikely(nElem - freelist_size >= maxload)) {
-			// rehash will auto find next prime bucket size
-			i = h % rehash(nBucket + 1);
+			grow_bucket();
+			head = bucket_head(h);
 		}
-		else if (terark_unlikely(nBucket != old_nBucket)) {
-			i = h % nBucket;
+		else if (terark_unlikely(nBucket != old_nBucket || NULL != m_old_bucket)) {
+			head = bucket_head(h); // pre_insert may rehash or migrate
 		}
 		size_t slot = risk_slot_alloc(); // here, no risk
 		cons_elem(&m_nl.data(slot)); // must success
-		m_nl.link(slot) = bucket[i]; // newer at head
-		bucket[i] = LinkTp(slot); // new head of i'th bucket
+		m_nl.link(slot) = *head; // newer at head
+		*head = LinkTp(slot); // new head of the bucket
 	  #if defined(HSM_ENABLE_HASH_CACHE)
 		if (intptr_t(pHash) != hash_cache_disabled)
 			pHash[slot] = h;
 	  #endif
+		if (terark_unlikely(NULL != m_old_bucket))
+			migrate_buckets(MigrateStep);
 		is_sorted = false;
 		return std::make_pair(slot, true);
 	}
@@ -1008,29 +1156,31 @@ public:
 				   std::pair<size_t, bool> >::type
 	{
 		const size_t old_nBucket = nBucket;
-		size_t i = size_t(h % old_nBucket);
+		LinkTp* head = bucket_head(h);
 		// this func is a copy-paste except old_nBucket and pre_insert
-		for (LinkTp p = bucket[i]; tail != p; p = m_nl.link(p)) {
+		for (LinkTp p = *head; tail != p; p = m_nl.link(p)) {
 			TERARK_ASSERT_LT(p, nElem);
 			if (HashEqual::equal(key, MyKeyExtractor(m_nl.data(p))))
 				return std::make_pair(p, false);
 		}
 		pre_insert(this);
 		if (terark_unlikely(nElem - freelist_size >= maxload)) {
-			// rehash will auto find next prime bucket size
-			i = h % rehash(nBucket + 1);
+			grow_bucket();
+			head = bucket_head(h);
 		}
-		else if (terark_unlikely(nBucket != old_nBucket)) {
-			i = h % nBucket;
+		else if (terark_unlikely(nBucket != old_nBucket || NULL != m_old_bucket)) {
+			head = bucket_head(h); // pre_insert may rehash or migrate
 		}
 		size_t slot = risk_slot_alloc(); // here, no risk
 		cons_elem(&m_nl.data(slot)); // must success
-		m_nl.link(slot) = bucket[i]; // newer at head
-		bucket[i] = LinkTp(slot); // new head of i'th bucket
+		m_nl.link(slot) = *head; // newer at head
+		*head = LinkTp(slot); // new head of the bucket
 	  #if defined(HSM_ENABLE_HASH_CACHE)
 		if (intptr_t(pHash) != hash_cache_disabled)
 			pHash[slot] = h;
 	  #endif
+		if (terark_unlikely(NULL != m_old_bucket))
+			migrate_buckets(MigrateStep);
 		is_sorted = false;
 		return std::make_pair(slot, true);
 	}
@@ -1081,8 +1231,8 @@ public:
 		TERARK_ASSERT_NE(delmark, m_nl.link(slot));
 		key_param_pass_t key = MyKeyExtractor(m_nl.data(slot));
 		const HashTp h = HashTp(HashEqual::hash(key));
-		size_t i = h % nBucket;
-		for (LinkTp p = bucket[i]; tail != p; p = m_nl.link(p)) {
+		LinkTp* head = bucket_head(h);
+		for (LinkTp p = *head; tail != p; p = m_nl.link(p)) {
 			TERARK_ASSERT_NE(p, slot); // slot must not be reached
 			TERARK_ASSERT_LT(p, nElem);
 			if (HashEqual::equal(key, MyKeyExtractor(m_nl.data(p))))
@@ -1093,12 +1243,19 @@ public:
 			pHash[slot] = h;
 	  #endif
 		if (terark_unlikely(nElem - freelist_size >= maxload)) { // must be >=
-			// rehash will set the bucket&link for 'slot'
-			rehash(nBucket + 1); // will auto find next prime bucket size
-		} else {
-			m_nl.link(slot) = bucket[i]; // newer at head
-			bucket[i] = LinkTp(slot); // new head of i'th bucket
+			if (!m_enable_incremental_rehash || 1 == nBucket) {
+				// rehash will set the bucket&link for 'slot'
+				rehash(nBucket + 1); // will auto find next prime bucket size
+				is_sorted = false;
+				return slot;
+			}
+			start_incremental_rehash(); // does not relink 'slot'
+			head = bucket_head(h);
 		}
+		m_nl.link(slot) = *head; // newer at head
+		*head = LinkTp(slot); // new head of the bucket
+		if (terark_unlikely(NULL != m_old_bucket))
+			migrate_buckets(MigrateStep);
 		is_sorted = false;
 		return slot;
 	}
@@ -1128,8 +1285,8 @@ public:
 	}
 	size_t find_with_hash_i(key_param_pass_t key, HashTp h) const {
 		TERARK_ASSERT_EQ(HashEqual::hash(key), h);
-		const size_t i = h % nBucket;
-		for (LinkTp p = bucket[i]; tail != p; p = m_nl.link(p)) {
+		const LinkTp* head = bucket_head(h);
+		for (LinkTp p = *head; tail != p; p = m_nl.link(p)) {
 			TERARK_ASSERT_LT(p, nElem);
 			if (HashEqual::equal(key, MyKeyExtractor(m_nl.data(p))))
 				return p;
@@ -1139,8 +1296,8 @@ public:
 	std::pair<size_t, size_t> // {index, bucket_pos}
 	find_hint_with_hash_i(key_param_pass_t key, HashTp h) const {
 		TERARK_ASSERT_EQ(HashEqual::hash(key), h);
-		const size_t i = h % nBucket;
-		for (LinkTp p = bucket[i]; tail != p; p = m_nl.link(p)) {
+		const size_t i = bucket_pos(h);
+		for (LinkTp p = bucket_at(i); tail != p; p = m_nl.link(p)) {
 			TERARK_ASSERT_LT(p, nElem);
 			if (HashEqual::equal(key, MyKeyExtractor(m_nl.data(p))))
 				return {size_t(p), i};
@@ -1156,8 +1313,8 @@ public:
 	template<class CompatibleKey>
 	size_t find_with_hash_i(const CompatibleKey& key, HashTp h) const {
 		TERARK_ASSERT_EQ(HashEqual::hash(key), h);
-		const size_t i = h % nBucket;
-		for (LinkTp p = bucket[i]; tail != p; p = m_nl.link(p)) {
+		const LinkTp* head = bucket_head(h);
+		for (LinkTp p = *head; tail != p; p = m_nl.link(p)) {
 			TERARK_ASSERT_LT(p, nElem);
 			if (HashEqual::equal(key, MyKeyExtractor(m_nl.data(p))))
 				return p;
@@ -1168,8 +1325,8 @@ public:
 	std::pair<size_t, size_t> // {index, bucket_pos}
 	find_hint_with_hash_i(const CompatibleKey& key, HashTp h) const {
 		TERARK_ASSERT_EQ(HashEqual::hash(key), h);
-		const size_t i = h % nBucket;
-		for (LinkTp p = bucket[i]; tail != p; p = m_nl.link(p)) {
+		const size_t i = bucket_pos(h);
+		for (LinkTp p = bucket_at(i); tail != p; p = m_nl.link(p)) {
 			TERARK_ASSERT_LT(p, nElem);
 			if (HashEqual::equal(key, MyKeyExtractor(m_nl.data(p))))
 				return {size_t(p), i};
@@ -1180,8 +1337,7 @@ public:
 	// return erased element count
 	size_t erase(key_param_pass_t key) {
 		const HashTp h = HashTp(HashEqual::hash(key));
-		const HashTp i = h % nBucket;
-		LinkTp curv, *curp = &bucket[i];
+		LinkTp curv, *curp = bucket_head(h);
 		while (tail != (curv = *curp)) {
 			TERARK_ASSERT_LT(curv, nElem);
 			TERARK_ASSERT_F(!is_deleted(curv), "%zd", size_t(curv));
@@ -1199,8 +1355,7 @@ public:
 	template<class GetValue>
 	size_t erase(key_param_pass_t key, GetValue get_val) {
 		const HashTp h = HashTp(HashEqual::hash(key));
-		const HashTp i = h % nBucket;
-		LinkTp curv, *curp = &bucket[i];
+		LinkTp curv, *curp = bucket_head(h);
 		while (tail != (curv = *curp)) {
 			TERARK_ASSERT_LT(curv, nElem);
 			TERARK_ASSERT_F(!is_deleted(curv), "%zd", size_t(curv));
@@ -1285,12 +1440,11 @@ public:
 		risk_unlink_with_hash_i(idx, h);
 	}
 	void risk_unlink_with_hash_i(size_t idx, HashTp h) {
-		const size_t bucket_idx = h % nBucket;
+		LinkTp* curp = bucket_head(h);
 		TERARK_ASSERT_GE(nElem, 1);
 		TERARK_ASSERT_LT(idx, nElem);
-		TERARK_ASSERT_LT(bucket[bucket_idx], nElem);
+		TERARK_ASSERT_LT(*curp, nElem);
 		TERARK_ASSERT_F(!is_deleted(idx), "idx = %zd", idx);
-		LinkTp* curp = &bucket[bucket_idx];
         LinkTp  curr;
 		while (idx != (curr = *curp)) {
 			curp = &m_nl.link(curr);
@@ -1401,9 +1555,12 @@ public:
 
 	template<class IntVec>
 	void bucket_histogram(IntVec& hist) const {
-		for (size_t i = 0, n = nBucket; i < n; ++i) {
+		size_t n = nBucket + (m_old_bucket ? m_old_nBucket : 0);
+		for (size_t i = 0; i < n; ++i) {
+			if (i >= nBucket && i - nBucket < m_migrate_pos)
+				continue; // migrated old bucket
 			size_t listlen = 0;
-			for (LinkTp j = bucket[i]; j != tail; j = m_nl.link(j))
+			for (LinkTp j = bucket_at(i); j != tail; j = m_nl.link(j))
 				++listlen;
 			if (hist.size() <= listlen)
 				hist.resize(listlen+1);
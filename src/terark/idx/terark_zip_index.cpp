@@ -1,7 +1,7 @@
 //#ifndef INDEX_UT
 //#include "db/builder.h" // for cf_options.h
 //#endif
-#if !(defined(__CYGWIN__) || defined(_MSC_VER)) && 0
+#if !(defined(__CYGWIN__) || defined(_MSC_VER))
 
 #if defined(__GNUC__) && __GNUC__ * 1000 + __GNUC_MINOR__ >= 8000
     #pragma GCC diagnostic ignored "-Wclass-memaccess"
@@ -9,6 +9,8 @@
 
 #include "terark_zip_index.hpp"
 #include <typeindex>
+#include <thread>
+#include <mutex>
 #include <terark/io/DataIO.hpp>
 #include <terark/io/FileStream.hpp>
 #include <terark/io/MemStream.hpp>
@@ -23,7 +25,10 @@
 #include <terark/fsa/nest_trie_dawg.hpp>
 #include <terark/fsa/crit_bit_trie.hpp>
 #include <terark/util/tmpfile.hpp>
+#include <terark/util/cpu_prefetch.hpp>
 #include <terark/util/crc.hpp>
+#include <terark/util/learned_uint_vec.hpp>
+#include <terark/util/block_bloom_filter.hpp>
 #include <terark/util/mmap.hpp>
 #include <terark/zbs/blob_store_file_header.hpp>
 #include <terark/zbs/zip_reorder_map.hpp>
@@ -57,20 +62,66 @@ DEFINE_TERARK_INDEX_ENV_OPT(bool, enableDynamicSuffix , true , getEnvBool);
 DEFINE_TERARK_INDEX_ENV_OPT(bool, enableEntropySuffix , true , getEnvBool);
 DEFINE_TERARK_INDEX_ENV_OPT(bool, enableDictZipSuffix , true , getEnvBool);
 DEFINE_TERARK_INDEX_ENV_OPT(long, suffixThreshold     , 0    , getEnvLong);
+DEFINE_TERARK_INDEX_ENV_OPT(bool, enableLearnedUint   , true , getEnvBool);
+DEFINE_TERARK_INDEX_ENV_OPT(long, learnedUintEpsilon  , 32   , getEnvLong);
+DEFINE_TERARK_INDEX_ENV_OPT(bool, enableParallelBuild , true , getEnvBool);
+DEFINE_TERARK_INDEX_ENV_OPT(long, buildThreads        , 0    , getEnvLong);
 
 #undef DEFINE_TERARK_INDEX_ENV_OPT
 
 using std::unique_ptr;
 
+// buildThreads <= 0 means min(hardware_concurrency, 8)
+static size_t GetBuildThreads() {
+  long n = buildThreads();
+  if (n <= 0) {
+    n = std::min<long>(std::thread::hardware_concurrency(), 8);
+  }
+  return std::max<long>(n, 1);
+}
+
+// call func(tid) for tid in [0, num_threads), the last one is called on the
+// calling thread, the first exception is rethrown after all threads joined
+template<class Func>
+static void ParallelRun(size_t num_threads, const Func& func) {
+  assert(num_threads > 0);
+  std::exception_ptr eptr;
+  std::mutex mtx;
+  auto thread_fun = [&](size_t tid) {
+    try {
+      func(tid);
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (!eptr)
+        eptr = std::current_exception();
+    }
+  };
+  valvec<std::thread> thrVec(num_threads - 1, valvec_reserve());
+  for (size_t i = 0; i + 1 < num_threads; ++i) {
+    thrVec.unchecked_emplace_back([&,i](){thread_fun(i);});
+  }
+  thread_fun(num_threads - 1);
+  for (auto& t : thrVec) {
+    t.join();
+  }
+  if (eptr) {
+    std::rethrow_exception(eptr);
+  }
+}
+
 class TerarkKeyIndexReaderBase : public TerarkKeyReader {
 protected:
+  std::string fileName;
+  size_t fileBegin, fileEnd;
   MmapWholeFile mmap;
   std::unique_ptr<TerarkIndex> index;
   valvec<byte_t> buffer;
   TerarkIndex::Iterator* iter;
   bool move_next;
 public:
-  TerarkKeyIndexReaderBase(fstring fileName, size_t fileBegin, size_t fileEnd) {
+  TerarkKeyIndexReaderBase(fstring _fileName, size_t _fileBegin, size_t _fileEnd)
+      : fileName(_fileName.str()), fileBegin(_fileBegin), fileEnd(_fileEnd) {
     MmapWholeFile(fileName).swap(mmap);
     index = TerarkIndex::LoadMemory(mmap.memory().substr(fileBegin, fileEnd - fileBegin));
     buffer.resize(index->IteratorSize());
@@ -95,6 +146,9 @@ public:
     assert(move_next);
     return iter->key();
   }
+  TerarkKeyReader* clone() const override final {
+    return new TerarkKeyIndexReader(fileName, fileBegin, fileEnd);
+  }
 };
 
 class TerarkKeyFileReader : public TerarkKeyReader {
@@ -146,6 +200,10 @@ public:
     reader.attach(fp);
     shared = 0;
   }
+  TerarkKeyReader* clone() const override final {
+    // attached readers share the FileStream of the FilePair
+    return attach ? nullptr : new TerarkKeyFileReader(files, false);
+  }
 };
 
 inline uint64_t ReadBigEndianUint64(const byte_t* beg, size_t len) {
@@ -243,8 +301,30 @@ struct TerarkIndexFooter {
   uint16_t format_version : 14;
   uint16_t footer_size;
   uint32_t footer_crc32;
+
+  // format_version 1: TerarkIndexFooterExt is just before the footer and
+  // footer_size includes it, the filter section is between suffix and ext
+  uint64_t filter_size() const;
+  uint64_t index_size() const {
+    return align_up(common_size, 8) + prefix_size + suffix_size + filter_size() + footer_size;
+  }
+  const byte_t* index_begin() const {
+    return (const byte_t*)(this + 1) - index_size();
+  }
+};
+
+struct TerarkIndexFooterExt {
+  uint64_t filter_size;
+  uint64_t reserved[3];
 };
 
+inline uint64_t TerarkIndexFooter::filter_size() const {
+  if (format_version < 1 || footer_size < sizeof(TerarkIndexFooter) + sizeof(TerarkIndexFooterExt)) {
+    return 0;
+  }
+  return ((const TerarkIndexFooterExt*)this)[-1].filter_size;
+}
+
 struct IndexUintPrefixHeader {
   uint8_t key_length;
   uint8_t padding_1;
@@ -255,10 +335,37 @@ struct IndexUintPrefixHeader {
   uint64_t rank_select_size;
 };
 
+struct IndexLearnedUintPrefixHeader {
+  uint8_t key_length;
+  uint8_t padding_1;
+  uint16_t format_version;
+  uint32_t padding_4;
+  uint64_t min_value;
+  uint64_t max_value;
+  uint64_t learned_size;
+};
+
 TerarkIndex::~TerarkIndex() {}
 TerarkIndex::Factory::~Factory() {}
 TerarkIndex::Iterator::~Iterator() {}
 
+size_t TerarkIndex::Iterator::NextBatch(size_t n, valvec<fstring>* keys, size_t* ids) {
+  keys->erase_all();
+  m_batch_buf.erase_all();
+  size_t cnt = 0;
+  for (; cnt < n && Valid() && Next(); ++cnt) {
+    fstring k = key();
+    // data pointers are offsets in m_batch_buf until it stops growing
+    keys->push_back(fstring((const char*)(m_batch_buf.size()), k.size()));
+    m_batch_buf.append(k.data(), k.size());
+    ids[cnt] = m_id;
+  }
+  for (auto& k : *keys) {
+    k.p = (const char*)m_batch_buf.data() + size_t(k.p);
+  }
+  return cnt;
+}
+
 using PrefixBuildInfo = TerarkIndex::PrefixBuildInfo;
 
 namespace index_detail {
@@ -276,6 +383,7 @@ struct Common {
   Common(Common&& o) : common(o.common) {
     flags.is_user_mem = o.flags.is_user_mem;
     o.flags.is_user_mem = true;
+    filter.swap(o.filter);
   }
   Common(fstring c, bool copy) {
     reset(c, copy);
@@ -321,6 +429,7 @@ struct Common {
 
   fstring common;
   StatusFlags flags;
+  BlockBloomFilter filter; // over full keys, empty if not built
 };
 
 struct LowerBoundResult {
@@ -337,6 +446,19 @@ struct SuffixBase {
   virtual LowerBoundResult
   LowerBound(fstring target, size_t suffix_id, size_t suffix_count, TerarkContext* ctx) const = 0;
   virtual void AppendKey(size_t suffix_id, valvec<byte_t>* buffer, TerarkContext* ctx) const = 0;
+  // key of ids[i] is buffer[offsets[i], offsets[i+1]), size_t(-1) gives an empty key
+  virtual void AppendKeyBatch(const size_t* ids, size_t n, valvec<byte_t>* buffer,
+                              size_t* offsets, TerarkContext* ctx) const {
+    for (size_t i = 0; i < n; ++i) {
+      offsets[i] = buffer->size();
+      if (ids[i] != size_t(-1)) {
+        AppendKey(ids[i], buffer, ctx);
+      }
+    }
+    offsets[n] = buffer->size();
+  }
+  // hint the kernel to read in the mmap pages of the keys of ids
+  virtual void AdviseWillNeed(const size_t* ids, size_t n) const {}
 
   virtual bool Load(fstring mem) = 0;
   virtual void Save(std::function<void(const void*, size_t)> append) const = 0;
@@ -344,6 +466,9 @@ struct SuffixBase {
   Reorder(ZReorderMap& newToOld, std::function<void(const void*, size_t)> append, fstring tmpFile) const = 0;
 };
 
+// max n of the prefix FindBatch/DictRankBatch, TerarkIndex splits larger batches
+static const size_t kIndexBatchSize = 32;
+
 struct PrefixBase {
   StatusFlags flags;
   virtual ~PrefixBase() = default;
@@ -381,6 +506,18 @@ struct VirtualPrefixBase : public PrefixBase {
   virtual size_t TotalKeySize() const = 0;
   virtual size_t Find(fstring key, const SuffixBase* suffix, TerarkContext* ctx) const = 0;
   virtual size_t DictRank(fstring key, const SuffixBase* suffix, TerarkContext* ctx) const = 0;
+  virtual void FindBatch(const fstring* keys, size_t n, size_t* ids,
+                         const SuffixBase* suffix, TerarkContext* ctx) const {
+    for (size_t i = 0; i < n; ++i) {
+      ids[i] = Find(keys[i], suffix, ctx);
+    }
+  }
+  virtual void DictRankBatch(const fstring* keys, size_t n, size_t* ranks,
+                             const SuffixBase* suffix, TerarkContext* ctx) const {
+    for (size_t i = 0; i < n; ++i) {
+      ranks[i] = DictRank(keys[i], suffix, ctx);
+    }
+  }
   virtual size_t AppendMinKey(valvec<byte_t>* buffer, TerarkContext* ctx) const = 0;
   virtual size_t AppendMaxKey(valvec<byte_t>* buffer, TerarkContext* ctx) const = 0;
 
@@ -445,6 +582,14 @@ struct VirtualPrefix : public PrefixBase {
   size_t DictRank(fstring key, const SuffixBase* suffix, TerarkContext* ctx) const {
     return prefix->DictRank(key, suffix, ctx);
   }
+  void FindBatch(const fstring* keys, size_t n, size_t* ids,
+                 const SuffixBase* suffix, TerarkContext* ctx) const {
+    prefix->FindBatch(keys, n, ids, suffix, ctx);
+  }
+  void DictRankBatch(const fstring* keys, size_t n, size_t* ranks,
+                     const SuffixBase* suffix, TerarkContext* ctx) const {
+    prefix->DictRankBatch(keys, n, ranks, suffix, ctx);
+  }
   size_t AppendMinKey(valvec<byte_t>* buffer, TerarkContext* ctx) const {
     return prefix->AppendMinKey(buffer, ctx);
   }
@@ -558,6 +703,13 @@ struct VirtualSuffix : public SuffixBase {
   void AppendKey(size_t suffix_id, valvec<byte_t>* buffer, TerarkContext* ctx) const final {
     return suffix->AppendKey(suffix_id, buffer, ctx);
   }
+  void AppendKeyBatch(const size_t* ids, size_t n, valvec<byte_t>* buffer,
+                      size_t* offsets, TerarkContext* ctx) const final {
+    suffix->AppendKeyBatch(ids, n, buffer, offsets, ctx);
+  }
+  void AdviseWillNeed(const size_t* ids, size_t n) const final {
+    suffix->AdviseWillNeed(ids, n);
+  }
   void GetMetaData(valvec<fstring>* blocks) const {
     return suffix->GetMetaData(blocks);
   }
@@ -587,6 +739,31 @@ struct VirtualSuffix : public SuffixBase {
   }
 };
 
+// non virtual prefixes are cheap to call per key, VirtualPrefix dispatches
+// once for the whole batch
+template<class Prefix>
+void PrefixFindBatch(const Prefix& prefix, const fstring* keys, size_t n, size_t* ids,
+                     const SuffixBase* suffix, TerarkContext* ctx) {
+  for (size_t i = 0; i < n; ++i) {
+    ids[i] = prefix.Find(keys[i], suffix, ctx);
+  }
+}
+inline void PrefixFindBatch(const VirtualPrefix& prefix, const fstring* keys, size_t n, size_t* ids,
+                            const SuffixBase* suffix, TerarkContext* ctx) {
+  prefix.FindBatch(keys, n, ids, suffix, ctx);
+}
+template<class Prefix>
+void PrefixDictRankBatch(const Prefix& prefix, const fstring* keys, size_t n, size_t* ranks,
+                         const SuffixBase* suffix, TerarkContext* ctx) {
+  for (size_t i = 0; i < n; ++i) {
+    ranks[i] = prefix.DictRank(keys[i], suffix, ctx);
+  }
+}
+inline void PrefixDictRankBatch(const VirtualPrefix& prefix, const fstring* keys, size_t n, size_t* ranks,
+                                const SuffixBase* suffix, TerarkContext* ctx) {
+  prefix.DictRankBatch(keys, n, ranks, suffix, ctx);
+}
+
 template<class Prefix, class Suffix>
 struct IndexParts {
   IndexParts() {}
@@ -644,7 +821,8 @@ public:
 
   unique_ptr<TerarkIndex> LoadMemory(fstring mem) const {
     auto& footer = ((const TerarkIndexFooter*)(mem.data() + mem.size()))[-1];
-    fstring suffix = mem.substr(mem.size() - footer.footer_size - footer.suffix_size, footer.suffix_size);
+    fstring filter = mem.substr(mem.size() - footer.footer_size - footer.filter_size(), footer.filter_size());
+    fstring suffix = fstring(filter.data() - footer.suffix_size, footer.suffix_size);
     fstring prefix = fstring(suffix.data() - footer.prefix_size, footer.prefix_size);
     fstring common = fstring(prefix.data() - align_up(footer.common_size, 8), footer.common_size);
     if (isChecksumVerifyEnabled()) {
@@ -678,7 +856,11 @@ public:
       throw std::invalid_argument("TerarkIndex::LoadMemory Prefix Fail, bad mem");
     }
 
-    return unique_ptr<TerarkIndex>(CreateIndex(&footer, Common(common, false), p.release(), s.release()));
+    Common c(common, false);
+    if (!filter.empty()) {
+      c.filter.risk_set_image(filter.data(), filter.size(), isChecksumVerifyEnabled());
+    }
+    return unique_ptr<TerarkIndex>(CreateIndex(&footer, std::move(c), p.release(), s.release()));
   }
 
   template<class Prefix, class Suffix>
@@ -693,6 +875,23 @@ public:
     Reorder(index->common_, index->prefix_, index->suffix_, newToOld, write, tmpFile);
   }
 
+  // write filter and footer ext if there is a filter, the filter blocks
+  // are cache line aligned relative to the index begin
+  static void SaveFilter(const Common& common, TerarkIndexFooter& footer,
+                         const std::function<void(const void*, size_t)>& write) {
+    if (common.filter.empty()) {
+      return;
+    }
+    size_t offset = align_up(footer.common_size, 8) + footer.prefix_size + footer.suffix_size;
+    TerarkIndexFooterExt ext;
+    memset(&ext, 0, sizeof ext);
+    ext.filter_size = common.filter.image_size(offset);
+    common.filter.save_image(offset, write);
+    write(&ext, sizeof ext);
+    footer.format_version = 1;
+    footer.footer_size = sizeof footer + sizeof ext;
+  }
+
   virtual void SaveMmap(const Common& common, const PrefixBase& prefix, const SuffixBase& suffix,
                         std::function<void(const void*, size_t)> write) const {
     TerarkIndexFooter footer;
@@ -722,6 +921,7 @@ public:
     });
     assert(footer.suffix_size % 8 == 0);
     footer.suffix_xxhash = dist.digest();
+    SaveFilter(common, footer, write);
     auto name = Name();
     assert(name.size() == sizeof footer.class_name);
     memcpy(footer.class_name, name.data(), sizeof footer.class_name);
@@ -756,6 +956,7 @@ public:
       footer.suffix_size += size;
     }, tmpFile);
     footer.suffix_xxhash = dist.digest();
+    SaveFilter(common, footer, write);
     auto name = Name();
     assert(name.size() == sizeof footer.class_name);
     memcpy(footer.class_name, name.data(), sizeof footer.class_name);
@@ -804,6 +1005,9 @@ public:
   TerarkContext* ctx_;
   valvec<byte_t> storage_;
   valvec<byte_t> key_;
+  valvec<byte_t> batch_prefix_;
+  valvec<byte_t> batch_suffix_;
+  valvec<size_t> batch_offsets_;
 
   fstring common() const {
     return common_;
@@ -969,6 +1173,63 @@ public:
     }
   }
 
+  // per window of kIndexBatchSize keys: walk the prefix and copy the
+  // prefix keys, then get all suffix keys by one AppendKeyBatch, so the
+  // suffix record misses of the window overlap, then concat the keys
+  size_t NextBatch(size_t n, valvec<fstring>* keys, size_t* ids) final {
+    keys->erase_all();
+    m_batch_buf.erase_all();
+    if (size_t(-1) == m_id) {
+      return 0;
+    }
+    batch_offsets_.resize_no_init(2 * (kIndexBatchSize + 1));
+    size_t* poff = batch_offsets_.data();
+    size_t* soff = poff + kIndexBatchSize + 1;
+    size_t cnt = 0;
+    while (cnt < n) {
+      size_t* wids = ids + cnt;
+      size_t m = 0, w = std::min(n - cnt, kIndexBatchSize);
+      batch_prefix_.erase_all();
+      for (; m < w; ++m) {
+        if (!prefix().IterNext(m_id, 1, prefix_storage_)) {
+          m_id = size_t(-1);
+          break;
+        }
+        wids[m] = m_id;
+        poff[m] = batch_prefix_.size();
+        batch_prefix_.append(prefix().IterGetKey(m_id, prefix_storage_));
+      }
+      poff[m] = batch_prefix_.size();
+      if (m_prefetch_ahead) {
+        suffix().AdviseWillNeed(wids, m);
+      }
+      batch_suffix_.erase_all();
+      suffix().AppendKeyBatch(wids, m, &batch_suffix_, soff, ctx_);
+      for (size_t i = 0; i < m; ++i) {
+        fstring pkey(batch_prefix_.data() + poff[i], poff[i+1] - poff[i]);
+        fstring skey(batch_suffix_.data() + soff[i], soff[i+1] - soff[i]);
+        // data pointers are offsets in m_batch_buf until it stops growing
+        keys->push_back(fstring((const char*)(m_batch_buf.size()),
+                                common_.size() + pkey.size() + skey.size()));
+        m_batch_buf.append(common_);
+        m_batch_buf.append(pkey);
+        m_batch_buf.append(skey);
+      }
+      cnt += m;
+      if (m < w) {
+        break;
+      }
+    }
+    for (auto& k : *keys) {
+      k.p = (const char*)m_batch_buf.data() + size_t(k.p);
+    }
+    if (size_t(-1) != m_id) {
+      suffix().IterSet(m_id, suffix_storage_);
+      UpdateKey();
+    }
+    return cnt;
+  }
+
   size_t DictRank() const final {
     return prefix().IterDictRank(m_id, prefix_storage_);
   }
@@ -992,6 +1253,7 @@ public:
 //      NestLoudsTriePrefix<>
 //        NestLoudsTrieDAWG_IL_256
 //        NestLoudsTrieDAWG_IL_256_32_FL
+//        NestLoudsTrieDAWG_IL_256_32_RRR_FL
 //        NestLoudsTrieDAWG_Mixed_SE_512
 //        NestLoudsTrieDAWG_Mixed_SE_512_32_FL
 //        NestLoudsTrieDAWG_Mixed_IL_256
@@ -1072,7 +1334,8 @@ public:
   }
 
   size_t Find(fstring key, TerarkContext* ctx) const final {
-    if (!key.startsWith(common_)) {
+    if (!key.startsWith(common_) ||
+        !(common_.filter.empty() || common_.filter.may_contain(key))) {
       return size_t(-1);
     }
     key = key.substr(common_.size());
@@ -1094,6 +1357,65 @@ public:
     return prefix_.DictRank(key, suffix_.TotalKeySize() != 0 ? &suffix_ : nullptr, ctx);
   }
 
+  void FindBatch(const fstring* keys, size_t n, size_t* ids, TerarkContext* ctx) const final {
+    const SuffixBase* suffix = suffix_.TotalKeySize() != 0 ? &suffix_ : nullptr;
+    fstring sub_keys[kIndexBatchSize];
+    size_t sub_ids[kIndexBatchSize];
+    size_t sub_idx[kIndexBatchSize];
+    const BlockBloomFilter& filter = common_.filter;
+    uint64_t hashes[kIndexBatchSize];
+    for (size_t beg = 0; beg < n; beg += kIndexBatchSize) {
+      size_t end = std::min(n, beg + kIndexBatchSize);
+      size_t m = 0;
+      if (!filter.empty()) {
+        for (size_t i = beg; i < end; ++i) {
+          hashes[i - beg] = BlockBloomFilter::hash(keys[i]);
+          filter.prefetch_hash(hashes[i - beg]);
+        }
+      }
+      for (size_t i = beg; i < end; ++i) {
+        if (keys[i].startsWith(common_) &&
+            (filter.empty() || filter.may_contain_hash(hashes[i - beg]))) {
+          sub_keys[m] = keys[i].substr(common_.size());
+          sub_idx[m++] = i;
+        } else {
+          ids[i] = size_t(-1);
+        }
+      }
+      PrefixFindBatch(prefix_, sub_keys, m, sub_ids, suffix, ctx);
+      for (size_t j = 0; j < m; ++j) {
+        ids[sub_idx[j]] = sub_ids[j];
+      }
+    }
+  }
+
+  void DictRankBatch(const fstring* keys, size_t n, size_t* ranks, TerarkContext* ctx) const final {
+    const SuffixBase* suffix = suffix_.TotalKeySize() != 0 ? &suffix_ : nullptr;
+    fstring sub_keys[kIndexBatchSize];
+    size_t sub_ranks[kIndexBatchSize];
+    size_t sub_idx[kIndexBatchSize];
+    for (size_t beg = 0; beg < n; beg += kIndexBatchSize) {
+      size_t end = std::min(n, beg + kIndexBatchSize);
+      size_t m = 0;
+      for (size_t i = beg; i < end; ++i) {
+        fstring key = keys[i];
+        size_t cplen = key.commonPrefixLen(common_);
+        if (cplen == common_.size()) {
+          sub_keys[m] = key.substr(cplen);
+          sub_idx[m++] = i;
+        } else if (key.size() == cplen || byte_t(key[cplen]) < byte_t(common_[cplen])) {
+          ranks[i] = 0;
+        } else {
+          ranks[i] = NumKeys();
+        }
+      }
+      PrefixDictRankBatch(prefix_, sub_keys, m, sub_ranks, suffix, ctx);
+      for (size_t j = 0; j < m; ++j) {
+        ranks[sub_idx[j]] = sub_ranks[j];
+      }
+    }
+  }
+
   void MinKey(valvec<byte_t>* key, TerarkContext* ctx) const final {
     key->assign(common_.data(), common_.size());
     size_t id = prefix_.AppendMinKey(key, ctx);
@@ -1119,14 +1441,13 @@ public:
 
   fstring Memory() const final {
     auto f = footer_;
-    size_t index_size = f ? align_up(f->common_size, 8) + f->prefix_size + f->suffix_size : 0;
-    return index_size == 0 ? fstring() : fstring((byte_t*)footer_ - index_size, index_size + f->footer_size);
+    return f ? fstring(f->index_begin(), f->index_size()) : fstring();
   }
 
   valvec<fstring> GetMetaData() const final {
     assert(footer_ != nullptr);
     auto f = footer_;
-    fstring prefix = fstring((byte_t*)f - f->suffix_size - f->prefix_size, f->prefix_size);
+    fstring prefix = fstring(f->index_begin() + align_up(f->common_size, 8), f->prefix_size);
     valvec<fstring> meta_data;
     suffix_.GetMetaData(&meta_data);
     meta_data.append(prefix);
@@ -1148,7 +1469,7 @@ public:
     double c = prefix_.KeyCount();
     double r = 1e9;
     size_t t = prefix_.TotalKeySize() + suffix_.TotalKeySize() + prefix_.KeyCount() * common_.size();
-    size_t index_size = f ? f->footer_size + align_up(f->common_size, 8) + f->prefix_size + f->suffix_size : 0;
+    size_t index_size = f ? f->index_size() : 0;
     snprintf(
         buffer, size,
         "    total_key_len = %zd  common_size = %zd  entry_cnt = %zd\n"
@@ -1554,6 +1875,249 @@ struct IndexAscendingUintPrefix : public UintPrefixBase<RankSelect> {
 };
 
 
+/*
+ * Ascending uint prefix by a learned index, piecewise linear model + residuals
+ * (see LearnedUintVec), it is smaller than rank_select for sparse keys which
+ * are near linear distributed, id is the position in LearnedUintVec
+ */
+struct IndexAscendingLearnedUintPrefix
+    : public ComponentIteratorStorageImpl<PrefixBase, UintPrefixIteratorStorage<std::false_type>> {
+  using IteratorStorage = UintPrefixIteratorStorage<std::false_type>;
+  using SelfType = IndexAscendingLearnedUintPrefix;
+
+  IndexAscendingLearnedUintPrefix() = default;
+  IndexAscendingLearnedUintPrefix(const SelfType&) = delete;
+  IndexAscendingLearnedUintPrefix(SelfType&& other) { *this = std::move(other); }
+  IndexAscendingLearnedUintPrefix(PrefixBase* base) {
+    assert(dynamic_cast<SelfType*>(base) != nullptr);
+    auto other = static_cast<SelfType*>(base);
+    *this = std::move(*other);
+    delete other;
+  }
+  IndexAscendingLearnedUintPrefix& operator = (const SelfType&) = delete;
+  IndexAscendingLearnedUintPrefix& operator = (SelfType&& other) {
+    learned.swap(other.learned);
+    key_length = other.key_length;
+    min_value = other.min_value;
+    max_value = other.max_value;
+    std::swap(flags, other.flags);
+    return *this;
+  }
+
+  ~IndexAscendingLearnedUintPrefix() {
+    if (flags.is_user_mem) {
+      learned.risk_release_ownership();
+    }
+  }
+
+  LearnedUintVec learned; // value - min_value
+  size_t key_length;
+  uint64_t min_value;
+  uint64_t max_value;
+
+  size_t KeyCount() const {
+    return learned.size();
+  }
+
+  size_t TotalKeySize() const {
+    return key_length * learned.size();
+  }
+  size_t Find(fstring key, const SuffixBase* suffix, TerarkContext* ctx) const {
+    if (key.size() < key_length) {
+      return size_t(-1);
+    }
+    byte_t buffer[8] = {};
+    memcpy(buffer + (8 - key_length), key.data(), std::min<size_t>(key_length, key.size()));
+    uint64_t value = ReadBigEndianUint64Aligned(buffer, 8);
+    if (value < min_value || value > max_value) {
+      return size_t(-1);
+    }
+    size_t id = learned.lower_bound(value - min_value);
+    if (learned[id] != value - min_value) {
+      return size_t(-1);
+    }
+    if (suffix == nullptr) {
+      return key.size() == key_length ? id : size_t(-1);
+    }
+    key = key.substr(key_length);
+    ContextBuffer suffix_key = ctx->alloc();
+    suffix->AppendKey(id, &suffix_key.get(), ctx);
+    return key == suffix_key ? id : size_t(-1);
+  }
+  size_t DictRank(fstring key, const SuffixBase* suffix, TerarkContext* ctx) const {
+    size_t id;
+    bool seek_result, is_find;
+    std::tie(seek_result, is_find) =
+        SeekImpl(key.size() > key_length ? key.substr(0, key_length) : key, id);
+    if (!seek_result) {
+      return learned.size();
+    } else if (key.size() < key_length || !is_find) {
+      return id;
+    } else if (suffix == nullptr) {
+      return id + (key.size() > key_length);
+    } else {
+      ContextBuffer suffix_key = ctx->alloc();
+      suffix->AppendKey(id, &suffix_key.get(), ctx);
+      return id + (key.substr(key_length) > suffix_key);
+    }
+  }
+  size_t AppendMinKey(valvec<byte_t>* buffer, TerarkContext* ctx) const {
+    size_t pos = buffer->size();
+    buffer->resize_no_init(pos + key_length);
+    SaveAsBigEndianUint64(buffer->data() + pos, key_length, min_value);
+    return 0;
+  }
+  size_t AppendMaxKey(valvec<byte_t>* buffer, TerarkContext* ctx) const {
+    size_t pos = buffer->size();
+    buffer->resize_no_init(pos + key_length);
+    SaveAsBigEndianUint64(buffer->data() + pos, key_length, max_value);
+    return learned.size() - 1;
+  }
+
+  bool NeedsReorder() const {
+    return false;
+  }
+  void GetOrderMap(UintVecMin0& newToOld) const {
+    assert(false);
+  }
+  void BuildCache(double cacheRatio) {
+  }
+
+  bool IterSeekToFirst(size_t& id, size_t& count, void* iter_ptr) const {
+    auto iter = static_cast<IteratorStorage*>(iter_ptr);
+    id = 0;
+    iter->pos = 0;
+    count = 1;
+    UpdateBuffer(iter);
+    return true;
+  }
+  bool IterSeekToLast(size_t& id, size_t* count, void* iter_ptr) const {
+    auto iter = static_cast<IteratorStorage*>(iter_ptr);
+    id = learned.size() - 1;
+    iter->pos = id;
+    if (count != nullptr) {
+      *count = 1;
+    }
+    UpdateBuffer(iter);
+    return true;
+  }
+  bool IterSeek(size_t& id, size_t& count, fstring target,
+                const SuffixBase* /*suffix*/, void* iter_ptr) const {
+    auto iter = static_cast<IteratorStorage *>(iter_ptr);
+    if (!SeekImpl(target, id).first) {
+      return false;
+    }
+    iter->pos = id;
+    count = 1;
+    UpdateBuffer(iter);
+    return true;
+  }
+  bool IterNext(size_t& id, size_t count, void* iter_ptr) const {
+    auto iter = static_cast<IteratorStorage*>(iter_ptr);
+    assert(id != size_t(-1));
+    assert(count > 0);
+    assert(iter->pos == id);
+    if (learned.size() - id <= count) {
+      id = size_t(-1);
+      return false;
+    }
+    id += count;
+    iter->pos = id;
+    UpdateBuffer(iter);
+    return true;
+  }
+  bool IterPrev(size_t& id, size_t* count, void* iter_ptr) const {
+    auto iter = static_cast<IteratorStorage*>(iter_ptr);
+    assert(id != size_t(-1));
+    assert(iter->pos == id);
+    if (id == 0) {
+      id = size_t(-1);
+      return false;
+    } else {
+      iter->pos = --id;
+      if (count != nullptr) {
+        *count = 1;
+      }
+      UpdateBuffer(iter);
+      return true;
+    }
+  }
+  size_t IterDictRank(size_t id, const void* /*iter*/) const {
+    if (id == size_t(-1)) {
+      return learned.size();
+    }
+    return id;
+  }
+  fstring IterGetKey(size_t id, const void* iter_ptr) const {
+    auto iter = static_cast<const IteratorStorage*>(iter_ptr);
+    return fstring(iter->buffer, key_length);
+  }
+
+  bool Load(fstring mem, SuffixBase* /*suffix*/) override {
+    if (mem.size() < sizeof(IndexLearnedUintPrefixHeader)) {
+      return false;
+    }
+    auto header = reinterpret_cast<const IndexLearnedUintPrefixHeader*>(mem.data());
+    if (mem.size() != sizeof(IndexLearnedUintPrefixHeader) + header->learned_size) {
+      return false;
+    }
+    key_length = header->key_length;
+    min_value = header->min_value;
+    max_value = header->max_value;
+    if (flags.is_user_mem) {
+      learned.risk_release_ownership();
+    } else {
+      learned.clear();
+    }
+    learned.risk_set_data(mem.data() + sizeof(IndexLearnedUintPrefixHeader), header->learned_size);
+    flags.is_user_mem = true;
+    return true;
+  }
+  void Save(std::function<void(const void*, size_t)> append) const override {
+    IndexLearnedUintPrefixHeader header;
+    memset(&header, 0, sizeof header);
+    header.format_version = 0;
+    header.key_length = key_length;
+    header.min_value = min_value;
+    header.max_value = max_value;
+    header.learned_size = learned.mem_size();
+    append(&header, sizeof header);
+    append(learned.data(), learned.mem_size());
+  }
+
+  std::pair<bool, bool> SeekImpl(fstring target, size_t& id) const {
+    byte_t buffer[8] = {};
+    memcpy(buffer + (8 - key_length), target.data(), std::min<size_t>(key_length, target.size()));
+    uint64_t value = ReadBigEndianUint64Aligned(buffer, 8);
+    if (value > max_value) {
+      id = size_t(-1);
+      return {false, false};
+    }
+    if (value < min_value) {
+      id = 0;
+      return {true, false};
+    }
+    id = learned.lower_bound(value - min_value);
+    assert(id < learned.size());
+    if (learned[id] != value - min_value) {
+      return {true, false};
+    } else if (target.size() > key_length) {
+      if (id == learned.size() - 1) {
+        id = size_t(-1);
+        return {false, false};
+      }
+      ++id;
+      return {true, false};
+    }
+    return {true, true};
+  }
+
+  void UpdateBuffer(IteratorStorage* iter) const {
+    SaveAsBigEndianUint64(iter->buffer, key_length, learned[iter->pos] + min_value);
+  }
+};
+
+
 template<class RankSelect>
 struct IndexNonDescendingUintPrefix : public UintPrefixBase<RankSelect> {
   using IteratorStorage = UintPrefixSelectIteratorStorage<RankSelect>;
@@ -1853,11 +2417,43 @@ struct IndexNonDescendingUintPrefix : public UintPrefixBase<RankSelect> {
   }
 };
 
+// NestLoudsTrieDAWG::Iterator constructed in a user buffer of iter_mem_size()
+// bytes, such as a TerarkContext buffer, thus no malloc for each iterator
+template<class NestLoudsTrieDAWG>
+class NestLoudsTrieUserMemIterator {
+  typedef typename NestLoudsTrieDAWG::Iterator Iterator;
+  Iterator* iter_;
+public:
+  NestLoudsTrieUserMemIterator(const NestLoudsTrieDAWG* trie, void* mem) {
+    trie->cons_iter(mem);
+    iter_ = static_cast<Iterator*>(mem);
+  }
+  NestLoudsTrieUserMemIterator(const NestLoudsTrieUserMemIterator&) = delete;
+  NestLoudsTrieUserMemIterator& operator=(const NestLoudsTrieUserMemIterator&) = delete;
+  ~NestLoudsTrieUserMemIterator() { destroy(); }
+
+  // must be called before the user buffer is released
+  void destroy() {
+    if (iter_) {
+      iter_->destruct();
+      iter_ = nullptr;
+    }
+  }
+  const BaseDFA* get_dfa() const { return iter_->get_dfa(); }
+  size_t word_state() const { return iter_->word_state(); }
+  fstring word() const { return iter_->word(); }
+  bool seek_begin() { return iter_->seek_begin(); }
+  bool seek_end() { return iter_->seek_end(); }
+  bool seek_lower_bound(fstring key) { return iter_->seek_lower_bound(key); }
+  bool incr() { return iter_->incr(); }
+  bool decr() { return iter_->decr(); }
+};
+
 template<class NestLoudsTrieDAWG>
 class IndexNestLoudsTriePrefixIterator {
 protected:
   valvec<byte_t> buffer_;
-  typename NestLoudsTrieDAWG::UserMemIterator iter_;
+  NestLoudsTrieUserMemIterator<NestLoudsTrieDAWG> iter_;
   bool Done(size_t& id, bool ok) {
     auto dawg = static_cast<const NestLoudsTrieDAWG*>(iter_.get_dfa());
     id = ok ? dawg->state_to_word_id(iter_.word_state()) : size_t(-1);
@@ -1873,6 +2469,7 @@ public:
       : buffer_(std::move(buffer)), iter_(trie, buffer_.data()) {}
 
   void ReclaimContextBuffer(TerarkContext* ctx) {
+    iter_.destroy();
     ContextBuffer(std::move(buffer_), ctx);
   }
 
@@ -1944,7 +2541,7 @@ struct IndexNestLoudsTriePrefix : public VirtualPrefixBase {
   }
   void IteratorStorageConstruct(TerarkContext* ctx, void* ptr) const {
     ContextBuffer buffer;
-    size_t mem_size = trie_->iterator_max_mem_size();
+    size_t mem_size = trie_->iter_mem_size();
     if (ctx != nullptr) {
       buffer = ctx->alloc(mem_size);
     } else {
@@ -1970,8 +2567,8 @@ struct IndexNestLoudsTriePrefix : public VirtualPrefixBase {
     if (suffix == nullptr && flags.is_bfs_suffix) {
       return trie_->index(key);
     }
-    auto buffer = ctx->alloc(trie_->iterator_max_mem_size());
-    typename NestLoudsTrieDAWG::UserMemIterator iter(trie_.get(), buffer.data());
+    auto buffer = ctx->alloc(trie_->iter_mem_size());
+    NestLoudsTrieUserMemIterator<NestLoudsTrieDAWG> iter(trie_.get(), buffer.data());
     if (iter.seek_lower_bound(key)) {
       if (iter.word() != key) {
         if (!iter.decr()) {
@@ -2001,8 +2598,8 @@ struct IndexNestLoudsTriePrefix : public VirtualPrefixBase {
       trie_->lower_bound(key, nullptr, &rank);
       return rank;
     }
-    auto buffer = ctx->alloc(trie_->iterator_max_mem_size());
-    typename NestLoudsTrieDAWG::UserMemIterator iter(trie_.get(), buffer.data());
+    auto buffer = ctx->alloc(trie_->iter_mem_size());
+    NestLoudsTrieUserMemIterator<NestLoudsTrieDAWG> iter(trie_.get(), buffer.data());
     if (iter.seek_lower_bound(key)) {
       if (iter.word() != key) {
         if (!iter.decr()) {
@@ -2027,6 +2624,182 @@ struct IndexNestLoudsTriePrefix : public VirtualPrefixBase {
     suffix->AppendKey(suffix_id, &suffix_key.get(), ctx);
     return rank + (key > suffix_key);
   }
+  // walk of one key of a batch, the walks of all keys are interleaved:
+  // each round moves every unfinished walk by one state, state_move
+  // prefetches the labels of the child, which are used in the next round,
+  // so the cache misses of the keys overlap
+  struct BatchWalk {
+    size_t curr;
+    size_t pos;       // key[0, pos) is the word of curr, with its zpath
+    size_t term;      // the longest word which is a prefix of key
+    size_t term_len;
+    bool   decisive;  // term is also the greatest word <= key
+  };
+  // returns false when the walk is done
+  bool WalkStep(fstring key, BatchWalk& w, MatchContext& mctx) const {
+    size_t curr = w.curr;
+    if (trie_->is_pzip(curr)) {
+      fstring zstr = trie_->get_zpath_data(curr, &mctx);
+      if (key.size() - w.pos < zstr.size() ||
+          memcmp(key.data() + w.pos, zstr.data(), zstr.size()) != 0) {
+        return false;
+      }
+      w.pos += zstr.size();
+    }
+    if (trie_->is_term(curr)) {
+      w.term = curr;
+      w.term_len = w.pos;
+    }
+    if (key.size() == w.pos) {
+      w.decisive = w.term == curr;
+      return false;
+    }
+    size_t next = trie_->state_move(curr, byte_t(key[w.pos]));
+    if (NestLoudsTrieDAWG::nil_state == next) {
+      // no word in (word(curr), key] if curr is a leaf
+      w.decisive = w.term == curr && !trie_->v_has_children(curr);
+      return false;
+    }
+    w.curr = next;
+    w.pos++;
+    return true;
+  }
+  void WalkBatch(const fstring* keys, size_t n, BatchWalk* walks) const {
+    assert(n <= kIndexBatchSize);
+    MatchContext mctx;
+    size_t active[kIndexBatchSize];
+    size_t num_active = n;
+    for (size_t i = 0; i < n; ++i) {
+      walks[i] = {initial_state, 0, NestLoudsTrieDAWG::nil_state, 0, false};
+      active[i] = i;
+    }
+    while (num_active) {
+      size_t num_next = 0;
+      for (size_t j = 0; j < num_active; ++j) {
+        size_t i = active[j];
+        if (WalkStep(keys[i], walks[i], mctx)) {
+          active[num_next++] = i;
+        }
+      }
+      num_active = num_next;
+    }
+  }
+  // stage 1 walks the trie for all keys interleaved by WalkBatch, a prefix
+  // word which is a prefix of another word has an empty suffix, so the
+  // longest prefix word of key is the only candidate of Find, which is also
+  // the DictRank candidate if the walk is decisive, else DictRank falls back
+  // to the iterator. the word states are converted to ids by the batch
+  // rank/select, stage 2 fetches all candidate suffixes by one AppendKeyBatch
+  void FindBatch(const fstring* keys, size_t n, size_t* ids,
+                 const SuffixBase* suffix, TerarkContext* ctx) const override {
+    assert(n <= kIndexBatchSize);
+    if (suffix == nullptr) {
+      for (size_t i = 0; i < n; ++i) {
+        ids[i] = Find(keys[i], suffix, ctx);
+      }
+      return;
+    }
+    size_t prefix_len[kIndexBatchSize];
+    size_t offsets[kIndexBatchSize + 1];
+    size_t hits[kIndexBatchSize], states[kIndexBatchSize], hit_ids[kIndexBatchSize];
+    size_t num_hits = 0;
+    BatchWalk walks[kIndexBatchSize];
+    WalkBatch(keys, n, walks);
+    for (size_t i = 0; i < n; ++i) {
+      ids[i] = size_t(-1);
+      if (NestLoudsTrieDAWG::nil_state != walks[i].term) {
+        prefix_len[i] = walks[i].term_len;
+        hits[num_hits] = i;
+        states[num_hits++] = walks[i].term;
+      }
+    }
+    if (flags.is_bfs_suffix) {
+      trie_->state_to_word_id_batch(states, num_hits, hit_ids);
+    } else {
+      trie_->state_to_dict_rank_batch(states, num_hits, hit_ids);
+    }
+    for (size_t j = 0; j < num_hits; ++j) {
+      ids[hits[j]] = hit_ids[j];
+    }
+    ContextBuffer suffix_keys = ctx->alloc();
+    suffix->AppendKeyBatch(ids, n, &suffix_keys.get(), offsets, ctx);
+    for (size_t i = 0; i < n; ++i) {
+      if (ids[i] != size_t(-1)) {
+        fstring suffix_key(suffix_keys.data() + offsets[i], offsets[i + 1] - offsets[i]);
+        if (keys[i].substr(prefix_len[i]) != suffix_key) {
+          ids[i] = size_t(-1);
+        }
+      }
+    }
+  }
+  void DictRankBatch(const fstring* keys, size_t n, size_t* ranks,
+                     const SuffixBase* suffix, TerarkContext* ctx) const override {
+    assert(n <= kIndexBatchSize);
+    if (suffix == nullptr) {
+      for (size_t i = 0; i < n; ++i) {
+        trie_->lower_bound(keys[i], nullptr, &ranks[i]);
+      }
+      return;
+    }
+    size_t prefix_len[kIndexBatchSize];
+    size_t suffix_ids[kIndexBatchSize];
+    size_t offsets[kIndexBatchSize + 1];
+    size_t hits[kIndexBatchSize], hit_ids[kIndexBatchSize];
+    size_t states[kIndexBatchSize] = {}; // just [0, num_hits) are used
+    size_t num_hits = 0;
+    BatchWalk walks[kIndexBatchSize];
+    WalkBatch(keys, n, walks);
+    auto buffer = ctx->alloc(trie_->iter_mem_size());
+    NestLoudsTrieUserMemIterator<NestLoudsTrieDAWG> iter(trie_.get(), buffer.data());
+    for (size_t i = 0; i < n; ++i) {
+      fstring key = keys[i];
+      suffix_ids[i] = size_t(-1);
+      ranks[i] = 0;
+      if (walks[i].decisive) {
+        prefix_len[i] = walks[i].term_len;
+        hits[num_hits] = i;
+        states[num_hits++] = walks[i].term;
+        continue;
+      }
+      if (iter.seek_lower_bound(key)) {
+        if (iter.word() != key && !iter.decr()) {
+          continue;
+        }
+      } else {
+        iter.seek_end();
+      }
+      // size_t(-1) means iter.word() is not a prefix of key
+      prefix_len[i] = key.startsWith(iter.word()) ? iter.word().size() : size_t(-1);
+      hits[num_hits] = i;
+      states[num_hits++] = iter.word_state();
+    }
+    trie_->state_to_dict_rank_batch(states, num_hits, hit_ids);
+    for (size_t j = 0; j < num_hits; ++j) {
+      size_t i = hits[j];
+      ranks[i] = hit_ids[j];
+      if (size_t(-1) == prefix_len[i]) {
+        ranks[i] += 1;
+      } else if (!flags.is_bfs_suffix) {
+        suffix_ids[i] = ranks[i];
+      }
+    }
+    if (flags.is_bfs_suffix) {
+      trie_->state_to_word_id_batch(states, num_hits, hit_ids);
+      for (size_t j = 0; j < num_hits; ++j) {
+        size_t i = hits[j];
+        if (size_t(-1) != prefix_len[i])
+          suffix_ids[i] = hit_ids[j];
+      }
+    }
+    ContextBuffer suffix_keys = ctx->alloc();
+    suffix->AppendKeyBatch(suffix_ids, n, &suffix_keys.get(), offsets, ctx);
+    for (size_t i = 0; i < n; ++i) {
+      if (suffix_ids[i] != size_t(-1)) {
+        fstring suffix_key(suffix_keys.data() + offsets[i], offsets[i + 1] - offsets[i]);
+        ranks[i] += keys[i].substr(prefix_len[i]) > suffix_key;
+      }
+    }
+  }
   size_t AppendMinKey(valvec<byte_t>* buffer, TerarkContext* ctx) const {
     size_t id = trie_->index_begin();
     auto key_buffer = ctx->alloc();
@@ -2441,6 +3214,35 @@ struct IndexFixedStringSuffix : ComponentIteratorStorageImpl<SuffixBase, void> {
     }
     buffer->append(key.data(), key.size());
   }
+  void AppendKeyBatch(const size_t* ids, size_t n, valvec<byte_t>* buffer,
+                      size_t* offsets, TerarkContext* ctx) const override {
+    size_t num_records = str_pool_.m_size;
+    for (size_t i = 0; i < n; ++i) {
+      if (ids[i] != size_t(-1)) {
+        size_t id = flags.is_rev_suffix ? num_records - ids[i] - 1 : ids[i];
+        TERARK_CPU_PREFETCH(str_pool_.m_strpool.data() + id * str_pool_.m_fixlen);
+      }
+    }
+    buffer->reserve(buffer->size() + n * str_pool_.m_fixlen);
+    SuffixBase::AppendKeyBatch(ids, n, buffer, offsets, ctx);
+  }
+  void AdviseWillNeed(const size_t* ids, size_t n) const override {
+    if (0 == n || 0 == str_pool_.m_fixlen) {
+      return;
+    }
+    auto minmax = std::minmax_element(ids, ids + n);
+    size_t lo = *minmax.first, hi = *minmax.second + 1;
+    if (flags.is_rev_suffix) {
+      std::swap(lo, hi);
+      lo = str_pool_.m_size - lo;
+      hi = str_pool_.m_size - hi;
+    }
+    // a sparse batch is left to the page faults
+    if (hi - lo <= 4 * n) {
+      mmap_advise_willneed(str_pool_.m_strpool.data() + lo * str_pool_.m_fixlen,
+                           (hi - lo) * str_pool_.m_fixlen);
+    }
+  }
   void GetMetaData(valvec<fstring>* blocks) const {
   }
   void DetachMetaData(const valvec<fstring>& blocks) {
@@ -2544,15 +3346,15 @@ struct IndexBlobStoreSuffix : public VirtualSuffixBase {
   }
 
   size_t IteratorStorageSize() const { return sizeof(IteratorStorage); }
+  // an uncompressed ZipOffsetBlobStore sets recData to the record in place
+  // instead of appending, which requires recData.capacity() == 0, so the
+  // store is always given an empty valvec instead of a context buffer
   void IteratorStorageConstruct(TerarkContext* ctx, void* ptr) const {
-    auto iter = ::new(ptr) IteratorStorage();
-    if (ctx != nullptr) {
-      iter->recData.swap(ctx->alloc());
-    }
+    ::new(ptr) IteratorStorage();
   }
   void IteratorStorageDestruct(TerarkContext* ctx, void* ptr) const {
     auto iter = static_cast<IteratorStorage*>(ptr);
-    if (ctx != nullptr) {
+    if (ctx != nullptr && iter->recData.capacity() != 0) {
       ContextBuffer(std::move(iter->recData), ctx);
     }
     iter->~IteratorStorage();
@@ -2568,39 +3370,100 @@ struct IndexBlobStoreSuffix : public VirtualSuffixBase {
   }
   LowerBoundResult
   LowerBound(fstring target, size_t suffix_id, size_t suffix_count, TerarkContext* ctx) const override {
-    ContextBuffer buffer = ctx->alloc();
+    valvec<byte_t> rec; // see IteratorStorageConstruct
     if (flags.is_rev_suffix) {
       size_t num_records = store_.num_records();
       suffix_id = num_records - suffix_id - suffix_count;
       size_t end = suffix_id + suffix_count;
-      suffix_id = store_.lower_bound(suffix_id, end, target, &buffer.get());
+      suffix_id = store_.lower_bound(suffix_id, end, target, &rec);
       if (suffix_id == end) {
         return {num_records - suffix_id - 1, {}, {}};
       }
+      ContextBuffer buffer = ctx->alloc();
+      buffer.get().assign(rec.data(), rec.size());
       fstring suffix_key = buffer;
       return {num_records - suffix_id - 1, suffix_key, std::move(buffer)};
     } else {
       size_t end = suffix_id + suffix_count;
-      suffix_id = store_.lower_bound(suffix_id, end, target, &buffer.get());
+      suffix_id = store_.lower_bound(suffix_id, end, target, &rec);
       if (suffix_id == end) {
         return {suffix_id, {}, {}};
       }
+      ContextBuffer buffer = ctx->alloc();
+      buffer.get().assign(rec.data(), rec.size());
       fstring suffix_key = buffer;
       return {suffix_id, suffix_key, std::move(buffer)};
     }
   }
   void AppendKey(size_t suffix_id, valvec<byte_t>* buffer, TerarkContext* ctx) const override {
     if (flags.is_rev_suffix) {
-      store_.get_record_append(store_.num_records() - suffix_id - 1, buffer);
-    } else {
-      store_.get_record_append(suffix_id, buffer);
+      suffix_id = store_.num_records() - suffix_id - 1;
+    }
+    valvec<byte_t> rec; // see IteratorStorageConstruct
+    store_.get_record_append(suffix_id, &rec);
+    buffer->append(rec.data(), rec.size());
+  }
+  void AppendKeyBatch(const size_t* ids, size_t n, valvec<byte_t>* buffer,
+                      size_t* offsets, TerarkContext* ctx) const override {
+    size_t num_records = store_.num_records();
+    auto rec_id = [&](size_t i) {
+      return flags.is_rev_suffix ? num_records - ids[i] - 1 : ids[i];
+    };
+    // offsets of all ids are in cache before any get2, then so are the
+    // heads of all records before any decoding
+    for (size_t i = 0; i < n; ++i) {
+      if (ids[i] != size_t(-1)) {
+        store_.prefetch_offsets(rec_id(i));
+      }
+    }
+    for (size_t i = 0; i < n; ++i) {
+      if (ids[i] != size_t(-1)) {
+        store_.prefetch_record(rec_id(i));
+      }
+    }
+    valvec<byte_t> rec; // see IteratorStorageConstruct
+    for (size_t i = 0; i < n; ++i) {
+      offsets[i] = buffer->size();
+      if (ids[i] != size_t(-1)) {
+        rec.risk_set_size(0);
+        store_.get_record_append(rec_id(i), &rec);
+        buffer->append(rec.data(), rec.size());
+      }
+    }
+    offsets[n] = buffer->size();
+  }
+  void AdviseWillNeed(const size_t* ids, size_t n) const override {
+    if (0 == n) {
+      return;
+    }
+    auto minmax = std::minmax_element(ids, ids + n);
+    size_t lo = *minmax.first, hi = *minmax.second + 1;
+    if (flags.is_rev_suffix) {
+      std::swap(lo, hi);
+      lo = store_.num_records() - lo;
+      hi = store_.num_records() - hi;
+    }
+    // a sparse batch is left to the page faults
+    if (hi - lo <= 4 * n) {
+      store_.advise_willneed(lo, hi);
     }
   }
   void GetMetaData(valvec<fstring>* blocks) const {
-    store_.get_meta_blocks(blocks);
+    valvec<BlobStore::Block> store_blocks;
+    store_.get_meta_blocks(&store_blocks);
+    for (auto& block : store_blocks) {
+      blocks->push_back(block.data);
+    }
   }
   void DetachMetaData(const valvec<fstring>& blocks) {
-    store_.detach_meta_blocks(blocks);
+    // blocks are in the order of get_meta_blocks, names are kept
+    valvec<BlobStore::Block> store_blocks;
+    store_.get_meta_blocks(&store_blocks);
+    assert(store_blocks.size() == blocks.size());
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      store_blocks[i].data = blocks[i];
+    }
+    store_.detach_meta_blocks(store_blocks);
   }
 
   void IterSet(size_t suffix_id, void* iter_ptr) const {
@@ -2765,6 +3628,31 @@ BuildAscendingUintPrefix(
   return prefix;
 }
 
+template<class InputBufferType>
+PrefixBase*
+BuildAscendingLearnedUintPrefix(
+    InputBufferType& input,
+    const TerarkIndex::KeyStat& ks,
+    const PrefixBuildInfo& info) {
+  assert(enableLearnedUint());
+  assert(info.min_value <= info.max_value);
+  valvec<uint64_t> values(info.key_count, valvec_no_init());
+  for (size_t seq_id = 0; seq_id < info.key_count; ++seq_id) {
+    auto key = input.next();
+    assert(key.size() == info.key_length);
+    values[seq_id] = ReadBigEndianUint64(key) - info.min_value;
+  }
+  if (ks.minKey > ks.maxKey) {
+    std::reverse(values.begin(), values.end());
+  }
+  auto prefix = new IndexAscendingLearnedUintPrefix();
+  prefix->learned.build_from(values, size_t(learnedUintEpsilon()));
+  prefix->key_length = info.key_length;
+  prefix->min_value = info.min_value;
+  prefix->max_value = info.max_value;
+  return prefix;
+}
+
 template<class RankSelect, class InputBufferType>
 void NonDescendingUintPrefixFillRankSelect(
     const PrefixBuildInfo& info,
@@ -2899,6 +3787,8 @@ BuildUintPrefix(
     return BuildAscendingUintPrefix<rank_select_fewone<7>>(input, ks, info);
   case PrefixBuildInfo::asc_few_one_8:
     return BuildAscendingUintPrefix<rank_select_fewone<8>>(input, ks, info);
+  case PrefixBuildInfo::asc_learned:
+    return BuildAscendingLearnedUintPrefix(input, ks, info);
   case PrefixBuildInfo::non_desc_il_256:
     assert(ks.maxKeyLen > commonPrefixLen(ks.minKey, ks.maxKey) + info.key_length);
     return BuildNonDescendingUintPrefix<rank_select_il_256_32>(input, ks, info);
@@ -2991,6 +3881,9 @@ NestLoudsTriePrefixSelect(fstring type, NestLoudsTrieConfig& cfg, StrVec& keyVec
   }
 #endif
   if (keyVec.mem_size() < 0x1E0000000) {
+    if (type.endsWith("IL_256_32_RRR_FL") || type.endsWith("IL_256_RRR_FL")) {
+      return NestLoudsTriePrefixProcess<NestLoudsTrieDAWG_IL_256_32_RRR_FL>(cfg, keyVec);
+    }
     if (type.endsWith("IL_256_32") || type.endsWith("IL_256")) {
       return NestLoudsTriePrefixProcess<NestLoudsTrieDAWG_IL_256>(cfg, keyVec);
     }
@@ -3329,6 +4222,18 @@ PrefixBuildInfo TerarkIndex::GetPrefixBuildInfo(const TerarkIndexOptions& opt, c
   for (size_t i = cplen, e = cplen + 8; i < e; ++i) {
     entryCnt[i - cplen] = keyCount - (i < ks.diff.size() ? ks.diff[i].cnt : 0);
   }
+  // near linear keys fill the buckets of their high bytes about as evenly as
+  // uniform keys, a clustered distribution has much fewer distinct buckets
+  auto IsNearLinear = [&](const PrefixBuildInfo& info) {
+    for (size_t j = 1; j < info.key_length; ++j) {
+      size_t shift = 8 * (info.key_length - j);
+      uint64_t buckets = (info.max_value >> shift) - (info.min_value >> shift) + 1;
+      if (entryCnt[j - 1] * 2 < std::min<uint64_t>(buckets, keyCount)) {
+        return false;
+      }
+    }
+    return true;
+  };
   for (size_t i = 2; i <= maxPrefixLen; ++i) {
     if (!enableCompositeIndex() && (ks.maxKeyLen != ks.minKeyLen || cplen + i != ks.maxKeyLen)) {
       continue;
@@ -3433,6 +4338,17 @@ PrefixBuildInfo TerarkIndex::GetPrefixBuildInfo(const TerarkIndexOptions& opt, c
       }
       prefixCost = bit_count * 21 / 128;
     } else {
+      prefixCost = size_t(-1);
+    }
+    if (enableLearnedUint() && info.entry_count == keyCount && prefixCost != 0 && IsNearLinear(info)) {
+      size_t learnedCost = LearnedUintVec::estimate_mem_size(
+          keyCount, double(diff) / keyCount, size_t(learnedUintEpsilon()));
+      if (learnedCost < prefixCost) {
+        info.type = PrefixAlgo::asc_learned;
+        prefixCost = learnedCost;
+      }
+    }
+    if (prefixCost == size_t(-1)) {
       continue;
     }
     size_t suffixCost = totalKeySize - i * keyCount;
@@ -3526,22 +4442,220 @@ TerarkIndexDebugBuilder::Finish(TerarkIndex::KeyStat* output) {
   *output = std::move(stat);
   class TerarkKeyDebugReader : public TerarkKeyReader {
   public:
-    fstrvec data;
+    std::shared_ptr<fstrvec> data;
     size_t i;
 
     fstring next() final {
-      return data[i++];
+      return (*data)[i++];
     }
     void rewind() final {
       i = 0;
     }
+    TerarkKeyReader* clone() const final {
+      auto reader = new TerarkKeyDebugReader;
+      reader->data = data;
+      reader->i = 0;
+      return reader;
+    }
   };
   auto reader = new TerarkKeyDebugReader;
-  reader->data.swap(data);
+  reader->data = std::make_shared<fstrvec>();
+  reader->data->swap(data);
   reader->i = 0;
   return reader;
 }
 
+namespace {
+// KeyStat of a chunk of sorted keys, keys[0] is the last key of the previous
+// chunk if has_prev, keys.back() is the first key of the next chunk if
+// has_next, they are only used for computing common prefix lengths
+struct KeyStatChunk {
+  // runs of adjacent key pairs which share byte i, lead/trail are the run
+  // lengths at the chunk boundaries, lead == npairs means no break
+  struct DiffRun {
+    size_t cnt = 0, max = 0, lead = 0, trail = 0;
+  };
+  fstrvec keys;
+  bool has_prev, has_next;
+  size_t npairs;
+  size_t sumKeyLen, minKeyLen, maxKeyLen;
+  size_t sumPrefixLen, minPrefixLen, maxPrefixLen;
+  size_t minSuffixLen, maxSuffixLen;
+  valvec<DiffRun> diff;
+
+  void Reset() {
+    keys.erase_all();
+    has_prev = has_next = false;
+    npairs = 0;
+    sumKeyLen = sumPrefixLen = 0;
+    maxKeyLen = maxPrefixLen = maxSuffixLen = 0;
+    minKeyLen = minPrefixLen = minSuffixLen = size_t(-1);
+    diff.erase_all();
+  }
+  void AddPair(size_t samePrefix) {
+    if (diff.size() < samePrefix) {
+      diff.resize(samePrefix);
+    }
+    for (size_t i = 0; i < samePrefix; ++i) {
+      auto& d = diff[i];
+      d.cnt++;
+      d.trail++;
+      if (d.lead == npairs)
+        d.lead++;
+    }
+    for (size_t i = samePrefix; i < diff.size(); ++i) {
+      diff[i].max = std::max(diff[i].max, diff[i].trail);
+      diff[i].trail = 0;
+    }
+    npairs++;
+  }
+  // same as TerarkIndexDebugBuilder::Add, but samePrefix of the next key
+  // is known in advance
+  void Process(freq_hist_o1& freq) {
+    size_t beg = has_prev ? 1 : 0;
+    size_t end = keys.size() - (has_next ? 1 : 0);
+    size_t left = has_prev ? keys[0].commonPrefixLen(keys[1]) : 0;
+    for (size_t i = beg; i < end; ++i) {
+      fstring key = keys[i];
+      size_t right = i + 1 < keys.size() ? key.commonPrefixLen(keys[i + 1]) : 0;
+      size_t prefixSize = std::min(key.size(), std::max(left, right) + 1);
+      size_t suffixSize = key.size() - prefixSize;
+      freq.add_record(key);
+      minKeyLen = std::min(minKeyLen, key.size());
+      maxKeyLen = std::max(maxKeyLen, key.size());
+      sumKeyLen += key.size();
+      sumPrefixLen += prefixSize;
+      minPrefixLen = std::min(minPrefixLen, prefixSize);
+      maxPrefixLen = std::max(maxPrefixLen, prefixSize);
+      minSuffixLen = std::min(minSuffixLen, suffixSize);
+      maxSuffixLen = std::max(maxSuffixLen, suffixSize);
+      if (i > 0) {
+        AddPair(left);
+      }
+      left = right;
+    }
+    for (auto& d : diff) {
+      d.max = std::max(d.max, d.trail);
+    }
+  }
+  // append y, which is the chunk just after this
+  void Merge(const KeyStatChunk& y) {
+    if (diff.size() < y.diff.size()) {
+      diff.resize(y.diff.size());
+    }
+    for (size_t i = 0; i < diff.size(); ++i) {
+      auto& d = diff[i];
+      DiffRun e = i < y.diff.size() ? y.diff[i] : DiffRun();
+      bool d_all = d.lead == npairs;
+      bool e_all = e.lead == y.npairs;
+      d.cnt += e.cnt;
+      d.max = std::max(std::max(d.max, e.max), d.trail + e.lead);
+      if (d_all)
+        d.lead += e.lead;
+      d.trail = e_all ? d.trail + e.trail : e.trail;
+    }
+    npairs += y.npairs;
+    sumKeyLen += y.sumKeyLen;
+    sumPrefixLen += y.sumPrefixLen;
+    minKeyLen = std::min(minKeyLen, y.minKeyLen);
+    maxKeyLen = std::max(maxKeyLen, y.maxKeyLen);
+    minPrefixLen = std::min(minPrefixLen, y.minPrefixLen);
+    maxPrefixLen = std::max(maxPrefixLen, y.maxPrefixLen);
+    minSuffixLen = std::min(minSuffixLen, y.minSuffixLen);
+    maxSuffixLen = std::max(maxSuffixLen, y.maxSuffixLen);
+  }
+};
+} // namespace
+
+void TerarkIndex::CollectKeyStat(TerarkKeyReader* reader, size_t keyCount,
+                                 KeyStat* ks, size_t threads) {
+  const size_t chunkKeys = 64 * 1024;
+  if (0 == threads) {
+    threads = GetBuildThreads();
+  }
+  threads = std::max<size_t>(1, std::min(threads, ceiled_div(keyCount, chunkKeys)));
+  valvec<KeyStatChunk> chunks(threads);
+  valvec<std::unique_ptr<freq_hist_o1>> freqs(threads, valvec_reserve());
+  for (size_t i = 0; i < threads; ++i) {
+    freqs.emplace_back(new freq_hist_o1());
+  }
+  KeyStatChunk total;
+  total.Reset();
+  *ks = KeyStat();
+  ks->keyCount = keyCount;
+  reader->rewind();
+  // keys are read sequentially by the calling thread, a round of `threads`
+  // chunks is processed in parallel, peek is the first key of next round
+  valvec<byte_t> lastKey, peek;
+  bool has_peek = false;
+  size_t consumed = 0;
+  while (consumed < keyCount) {
+    size_t num = 0;
+    for (; num < threads && consumed < keyCount; ++num) {
+      auto& c = chunks[num];
+      c.Reset();
+      if (consumed) {
+        c.keys.push_back(lastKey);
+        c.has_prev = true;
+      }
+      size_t n = std::min(chunkKeys, keyCount - consumed);
+      for (size_t i = 0; i < n; ++i) {
+        if (has_peek) {
+          c.keys.push_back(peek);
+          has_peek = false;
+        } else {
+          c.keys.push_back(reader->next());
+        }
+      }
+      if (0 == consumed) {
+        ks->minKey.assign(c.keys[0]);
+      }
+      consumed += n;
+      lastKey.assign(c.keys.back());
+    }
+    for (size_t i = 0; i + 1 < num; ++i) {
+      chunks[i].keys.push_back(chunks[i + 1].keys[1]);
+      chunks[i].has_next = true;
+    }
+    if (consumed < keyCount) {
+      peek.assign(reader->next());
+      has_peek = true;
+      chunks[num - 1].keys.push_back(peek);
+      chunks[num - 1].has_next = true;
+    }
+    ParallelRun(num, [&](size_t tid) { chunks[tid].Process(*freqs[tid]); });
+    for (size_t i = 0; i < num; ++i) {
+      total.Merge(chunks[i]);
+    }
+  }
+  for (size_t i = 1; i < threads; ++i) {
+    freqs[0]->add_hist(*freqs[i]);
+  }
+  freqs[0]->finish();
+  ks->entropyLen = freq_hist_o1::estimate_size(freqs[0]->histogram());
+  ks->sumKeyLen = total.sumKeyLen;
+  ks->minKeyLen = total.minKeyLen;
+  ks->maxKeyLen = total.maxKeyLen;
+  ks->sumPrefixLen = total.sumPrefixLen;
+  ks->minPrefixLen = total.minPrefixLen;
+  ks->maxPrefixLen = total.maxPrefixLen;
+  ks->minSuffixLen = total.minSuffixLen;
+  ks->maxSuffixLen = total.maxSuffixLen;
+  ks->maxKey.assign(lastKey);
+  ks->diff.resize(total.diff.size());
+  for (size_t i = 0; i < total.diff.size(); ++i) {
+    ks->diff[i].cnt = total.diff[i].cnt;
+    ks->diff[i].max = total.diff[i].max;
+  }
+}
+
+TerarkIndex* TerarkIndex::Factory::Build(TerarkKeyReader* reader, size_t keyCount,
+                                         const TerarkIndexOptions& tiopt) {
+  KeyStat ks;
+  CollectKeyStat(reader, keyCount, &ks);
+  return Build(reader, tiopt, ks, nullptr);
+}
+
 TerarkIndex* TerarkIndex::Factory::Build(TerarkKeyReader* reader, const TerarkIndexOptions& tiopt,
                                          const KeyStat& ks, const PrefixBuildInfo* info_ptr) {
   using namespace index_detail;
@@ -3681,8 +4795,35 @@ TerarkIndex* TerarkIndex::Factory::Build(TerarkKeyReader* reader, const TerarkIn
   bool isReverse = ks.minKey > ks.maxKey;
   PrefixBuildInfo uint_prefix_info = info_ptr != nullptr ? *info_ptr : GetPrefixBuildInfo(tiopt, ks);
   size_t cplen = uint_prefix_info.common_prefix;
-  PrefixBase* prefix;
-  SuffixBase* suffix;
+  PrefixBase* prefix = nullptr;
+  SuffixBase* suffix = nullptr;
+  // prefix and suffix are built concurrently if the key reader can be
+  // cloned, the suffix scans the keys by the cloned reader
+  std::unique_ptr<TerarkKeyReader> reader_clone;
+  if (enableParallelBuild() && GetBuildThreads() > 1) {
+    reader_clone.reset(reader->clone());
+  }
+  TerarkKeyReader* suffix_reader = reader_clone ? reader_clone.get() : reader;
+  auto build_prefix_suffix = [&](auto build_prefix, auto build_suffix) {
+    if (!reader_clone) {
+      prefix = build_prefix();
+      suffix = build_suffix();
+      return;
+    }
+    try {
+      ParallelRun(2, [&](size_t tid) {
+        if (0 == tid)
+          prefix = build_prefix();
+        else
+          suffix = build_suffix();
+      });
+    }
+    catch (...) {
+      delete prefix;
+      delete suffix;
+      throw;
+    }
+  };
   if (uint_prefix_info.key_length > 0) {
     if (ks.minKeyLen == ks.maxKeyLen && ks.maxKeyLen == cplen + uint_prefix_info.key_length) {
       DefaultInputBuffer input_reader{reader, cplen};
@@ -3690,19 +4831,26 @@ TerarkIndex* TerarkIndex::Factory::Build(TerarkKeyReader* reader, const TerarkIn
       suffix = BuildEmptySuffix();
     } else {
       FixPrefixInputBuffer prefix_input_reader{reader, cplen, uint_prefix_info.key_length, ks.maxKeyLen};
-      prefix = BuildUintPrefix(prefix_input_reader, ks, uint_prefix_info);
-      FixPrefixRemainingInputBuffer suffix_input_reader{reader, cplen, uint_prefix_info.key_length, ks.maxKeyLen};
-      suffix = BuildSuffixAutoSelect(
-          suffix_input_reader, ks.keyCount,
-          ks.sumKeyLen - ks.keyCount * prefix_input_reader.cplenPrefixSize,
-          ks.minKeyLen == ks.maxKeyLen, isReverse, uint_prefix_info.zip_ratio,
-          tiopt);
+      FixPrefixRemainingInputBuffer suffix_input_reader{suffix_reader, cplen, uint_prefix_info.key_length, ks.maxKeyLen};
+      build_prefix_suffix([&] {
+        return BuildUintPrefix(prefix_input_reader, ks, uint_prefix_info);
+      }, [&] {
+        return BuildSuffixAutoSelect(
+            suffix_input_reader, ks.keyCount,
+            ks.sumKeyLen - ks.keyCount * prefix_input_reader.cplenPrefixSize,
+            ks.minKeyLen == ks.maxKeyLen, isReverse, uint_prefix_info.zip_ratio,
+            tiopt);
+      });
     }
   } else if (uint_prefix_info.type == PrefixBuildInfo::crit_bit_trie) {
-    DefaultInputBuffer input_reader{reader, cplen};
-    prefix = BuildCritBitTriePrefix(input_reader, tiopt, ks.keyCount, ks.sumKeyLen - ks.keyCount * cplen, isReverse);
-    suffix = BuildSuffixAutoSelect(input_reader, ks.keyCount, ks.sumKeyLen - ks.keyCount * cplen,
+    DefaultInputBuffer prefix_input_reader{reader, cplen};
+    DefaultInputBuffer suffix_input_reader{suffix_reader, cplen};
+    build_prefix_suffix([&] {
+      return BuildCritBitTriePrefix(prefix_input_reader, tiopt, ks.keyCount, ks.sumKeyLen - ks.keyCount * cplen, isReverse);
+    }, [&] {
+      return BuildSuffixAutoSelect(suffix_input_reader, ks.keyCount, ks.sumKeyLen - ks.keyCount * cplen,
                                    ks.minKeyLen == ks.maxKeyLen, isReverse, uint_prefix_info.zip_ratio, tiopt);
+    });
   } else if ((!enableDynamicSuffix() && ks.minSuffixLen != ks.maxSuffixLen) ||
               !enableCompositeIndex() || ks.sumPrefixLen >= ks.sumKeyLen * 31 / 32) {
     DefaultInputBuffer input_reader{reader, cplen};
@@ -3712,20 +4860,31 @@ TerarkIndex* TerarkIndex::Factory::Build(TerarkKeyReader* reader, const TerarkIn
     suffix = BuildEmptySuffix();
   } else {
     MinimizePrefixInputBuffer prefix_input_reader{reader, cplen, ks.keyCount, ks.maxKeyLen};
-    prefix = BuildNestLoudsTriePrefix(
-        prefix_input_reader, tiopt, ks.keyCount, ks.sumPrefixLen - ks.keyCount * cplen,
-        isReverse, ks.minPrefixLen == ks.maxPrefixLen);
-    MinimizePrefixRemainingInputBuffer suffix_input_reader{reader, cplen, ks.keyCount, ks.maxKeyLen};
-    suffix = BuildSuffixAutoSelect(
-        suffix_input_reader, ks.keyCount, ks.sumKeyLen - ks.sumPrefixLen,
-        ks.minSuffixLen == ks.maxSuffixLen, isReverse,
-        uint_prefix_info.zip_ratio, tiopt);
+    MinimizePrefixRemainingInputBuffer suffix_input_reader{suffix_reader, cplen, ks.keyCount, ks.maxKeyLen};
+    build_prefix_suffix([&] {
+      return BuildNestLoudsTriePrefix(
+          prefix_input_reader, tiopt, ks.keyCount, ks.sumPrefixLen - ks.keyCount * cplen,
+          isReverse, ks.minPrefixLen == ks.maxPrefixLen);
+    }, [&] {
+      return BuildSuffixAutoSelect(
+          suffix_input_reader, ks.keyCount, ks.sumKeyLen - ks.sumPrefixLen,
+          ks.minSuffixLen == ks.maxSuffixLen, isReverse,
+          uint_prefix_info.zip_ratio, tiopt);
+    });
   }
   valvec<char> common(cplen, valvec_reserve());
   common.append(ks.minKey.data(), cplen);
+  Common c(common, true);
+  if (tiopt.filterBitsPerKey > 0) {
+    c.filter.init(ks.keyCount, tiopt.filterBitsPerKey);
+    reader->rewind();
+    for (size_t i = 0; i < ks.keyCount; ++i) {
+      c.filter.add(reader->next());
+    }
+  }
   auto factory = IndexFactoryBase::GetFactoryByType(std::type_index(typeid(*prefix)), std::type_index(typeid(*suffix)));
   assert(factory != nullptr);
-  return factory->CreateIndex(nullptr, Common(common, true), prefix, suffix);
+  return factory->CreateIndex(nullptr, std::move(c), prefix, suffix);
 }
 
 size_t TerarkIndex::Factory::MemSizeForBuild(const TerarkIndex::KeyStat& ks) {
@@ -3767,7 +4926,7 @@ unique_ptr<TerarkIndex> TerarkIndex::LoadMemory(fstring mem) {
           + class_name.c_str());
     }
     TerarkIndex::Factory* factory = g_TerarkIndexFactroy.val(idx).get();
-    size_t index_size = footer.footer_size + align_up(footer.common_size, 8) + footer.prefix_size + footer.suffix_size;
+    size_t index_size = footer.index_size();
     index_vec.emplace_back(factory->LoadMemory(mem.substr(mem.size() - index_size)));
     offset += index_size;
   } while (offset < mem.size());
@@ -3829,6 +4988,7 @@ using IndexNLT = IndexNestLoudsTriePrefix<NLT>;
 using PrefixComponentList_0 = ComponentRegister<>
 ::reg<NAME(IL_256      ), IndexNLT<NestLoudsTrieDAWG_IL_256            >>
 ::reg<NAME(IL_256_FL   ), IndexNLT<NestLoudsTrieDAWG_IL_256_32_FL      >>
+::reg<NAME(IL_256_RRR_FL), IndexNLT<NestLoudsTrieDAWG_IL_256_32_RRR_FL>>
 ::reg<NAME(M_SE_512    ), IndexNLT<NestLoudsTrieDAWG_Mixed_SE_512      >>
 ::reg<NAME(M_SE_512_FL ), IndexNLT<NestLoudsTrieDAWG_Mixed_SE_512_32_FL>>
 ::reg<NAME(M_IL_256    ), IndexNLT<NestLoudsTrieDAWG_Mixed_IL_256      >>
@@ -3852,6 +5012,7 @@ using PrefixComponentList_0 = ComponentRegister<>
 ::reg<NAME(A_FewOne_6  ), IndexAscendingUintPrefix<rank_select_fewone<6>>>
 ::reg<NAME(A_FewOne_7  ), IndexAscendingUintPrefix<rank_select_fewone<7>>>
 ::reg<NAME(A_FewOne_8  ), IndexAscendingUintPrefix<rank_select_fewone<8>>>
+::reg<NAME(A_Learned   ), IndexAscendingLearnedUintPrefix                 >
 ::list;
 
 using SuffixComponentList_0 = ComponentRegister<>
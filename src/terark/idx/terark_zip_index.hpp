@@ -16,6 +16,7 @@ struct TERARK_DLL_EXPORT TerarkIndexOptions {
   uint64_t smallTaskMemory = 1200 << 20;
   uint32_t cbtEntryPerTrie = 65536;
   uint32_t cbtMinKeySize = 16;
+  uint32_t filterBitsPerKey = 0; // bloom filter for Find, 0 is disabled
   double cbtMinKeyRatio = 0.5;
   int32_t indexNestLevel = 3;
   uint8_t debugLevel = 0;
@@ -38,6 +39,9 @@ class TERARK_DLL_EXPORT TerarkKeyReader {
   MakeReader(const valvec<std::shared_ptr<FilePair>>& files, bool attach);
   virtual fstring next() = 0;
   virtual void rewind() = 0;
+  // an independent reader over the same keys, for scanning the keys from
+  // multiple threads, return nullptr if the reader can not be cloned
+  virtual TerarkKeyReader* clone() const { return nullptr; }
 };
 
 class TERARK_DLL_EXPORT TerarkIndex : boost::noncopyable {
@@ -45,6 +49,8 @@ class TERARK_DLL_EXPORT TerarkIndex : boost::noncopyable {
   class Iterator : boost::noncopyable {
    protected:
     size_t m_id = size_t(-1);
+    bool m_prefetch_ahead = false;
+    valvec<byte_t> m_batch_buf; // key data of NextBatch
 
    public:
     virtual ~Iterator();
@@ -58,6 +64,14 @@ class TERARK_DLL_EXPORT TerarkIndex : boost::noncopyable {
     inline size_t id() const { return m_id; }
     virtual fstring key() const = 0;
     inline void SetInvalid() { m_id = size_t(-1); }
+    // same as calling Next() up to n times, the key and id after each move
+    // are put into keys and ids, return the number of moves that succeeded,
+    // which is < n if the end is reached. keys are valid until the next
+    // call on this iterator
+    virtual size_t NextBatch(size_t n, valvec<fstring>* keys, size_t* ids);
+    // when on, NextBatch also asks the kernel to read in the mmap pages of
+    // the whole batch at once, for long scans over a cold file
+    void SetPrefetchAhead(bool on) { m_prefetch_ahead = on; }
   };
   struct TERARK_DLL_EXPORT KeyStat {
     struct DiffItem {
@@ -115,6 +129,7 @@ class TERARK_DLL_EXPORT TerarkIndex : boost::noncopyable {
       non_desc_few_one_6,
       non_desc_few_one_7,
       non_desc_few_one_8,
+      asc_learned,
     };
     PrefixAlgo type;
   };
@@ -125,6 +140,10 @@ class TERARK_DLL_EXPORT TerarkIndex : boost::noncopyable {
                                                 const TerarkIndexOptions& tiopt,
                                                 const KeyStat&,
                                                 const PrefixBuildInfo*);
+    // KeyStat of the keys is collected by CollectKeyStat
+    static TerarkIndex* TERARK_DLL_EXPORT Build(TerarkKeyReader* keyReader,
+                                                size_t keyCount,
+                                                const TerarkIndexOptions& tiopt);
     static TerarkIndex* TERARK_DLL_EXPORT Build(DoSortedStrVec&,
                                                 const TerarkIndexOptions& tiopt,
                                                 const KeyStat&,
@@ -136,6 +155,11 @@ class TERARK_DLL_EXPORT TerarkIndex : boost::noncopyable {
   typedef boost::intrusive_ptr<Factory> FactoryPtr;
   static PrefixBuildInfo GetPrefixBuildInfo(const TerarkIndexOptions& opt,
                                             const TerarkIndex::KeyStat& ks);
+  // scan keyCount sorted keys from reader and fill ks, the keys are read
+  // sequentially and the stats of key chunks are computed by `threads`
+  // threads, threads == 0 means TerarkZipTable_buildThreads
+  static void CollectKeyStat(TerarkKeyReader* reader, size_t keyCount,
+                             KeyStat* ks, size_t threads = 0);
   static std::unique_ptr<TerarkIndex> LoadMemory(fstring mem);
   virtual ~TerarkIndex();
   virtual fstring Name() const = 0;
@@ -146,6 +170,12 @@ class TERARK_DLL_EXPORT TerarkIndex : boost::noncopyable {
                        fstring tmpFile) const = 0;
   virtual size_t Find(fstring key, TerarkContext* ctx) const = 0;
   virtual size_t DictRank(fstring key, TerarkContext* ctx) const = 0;
+  // ids[i] = Find(keys[i]), ranks[i] = DictRank(keys[i]), the lookups of
+  // different keys are interleaved, so their cache misses are overlapped
+  virtual void FindBatch(const fstring* keys, size_t n, size_t* ids,
+                         TerarkContext* ctx) const = 0;
+  virtual void DictRankBatch(const fstring* keys, size_t n, size_t* ranks,
+                             TerarkContext* ctx) const = 0;
   virtual void MinKey(valvec<byte_t>* key, TerarkContext* ctx) const = 0;
   virtual void MaxKey(valvec<byte_t>* key, TerarkContext* ctx) const = 0;
   virtual size_t NumKeys() const = 0;
@@ -4,26 +4,213 @@
 #include "io/StreamBuffer.hpp"
 #include "io/DataOutput.hpp"
 #include "fstring.hpp"
+#include <utility>
+#if defined(__AVX2__)
+	#include <immintrin.h>
+#endif
 
 namespace terark {
 
+namespace {
+
+// values of index [8*k, 8*k+8) start at byte Bits*k, so in a group of 8
+// values, the byte offset and the bit shift of each value are constants
+template<size_t Bits>
+inline void get_group8(const byte* p, size_t* out) {
+    const size_t mask = ~(size_t(-1) << Bits);
+    for (size_t j = 0; j < 8; ++j) {
+        size_t val = unaligned_load<size_t>(p + j * Bits / 8);
+        out[j] = (val >> j * Bits % 8) & mask;
+    }
+}
+
+#if defined(__AVX2__)
+// 8 values in 32 bit lanes: lane 0 holds values 0..3 loaded from p, lane 1
+// holds values 4..7 loaded from p + 4*Bits/8, a value is 4 bytes picked by
+// vpshufb then shifted by vpsrlvd, (bitpos % 8) + Bits <= 32: Bits <= 25
+template<size_t Bits>
+struct Unpack8Epi32Tab {
+    alignas(32) uint8_t  shuf[32];
+    alignas(32) uint32_t shift[8];
+    constexpr Unpack8Epi32Tab() : shuf(), shift() {
+        for (size_t j = 0; j < 8; ++j) {
+            size_t bitpos = j * Bits - j / 4 * (4 * Bits / 8 * 8);
+            for (size_t k = 0; k < 4; ++k)
+                shuf[4 * j + k] = uint8_t(bitpos / 8 + k);
+            shift[j] = uint32_t(bitpos % 8);
+        }
+    }
+};
+template<size_t Bits>
+constexpr Unpack8Epi32Tab<Bits> g_unpack8_epi32_tab{};
+
+template<size_t Bits>
+inline void unpack8_epi32(const byte* p, size_t* out) {
+    static_assert(Bits >= 1 && Bits <= 25, "Bits must be in [1, 25]");
+    const Unpack8Epi32Tab<Bits>& tab = g_unpack8_epi32_tab<Bits>;
+    __m128i lo = _mm_loadu_si128((const __m128i*)p);
+    __m128i hi = _mm_loadu_si128((const __m128i*)(p + 4 * Bits / 8));
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    v = _mm256_shuffle_epi8(v, _mm256_load_si256((const __m256i*)tab.shuf));
+    v = _mm256_srlv_epi32(v, _mm256_load_si256((const __m256i*)tab.shift));
+    v = _mm256_and_si256(v, _mm256_set1_epi32(int((1u << Bits) - 1)));
+    _mm256_storeu_si256((__m256i*)(out + 0),
+        _mm256_cvtepu32_epi64(_mm256_castsi256_si128(v)));
+    _mm256_storeu_si256((__m256i*)(out + 4),
+        _mm256_cvtepu32_epi64(_mm256_extracti128_si256(v, 1)));
+}
+
+// 8 values in 64 bit lanes: 128 bit lane m holds values 2m, 2m+1 loaded
+// from p + 2m*Bits/8, a value is 8 bytes picked by vpshufb then shifted by
+// vpsrlvq, (bitpos % 8) + Bits <= 64: Bits <= 57
+template<size_t Bits>
+struct Unpack8Epi64Tab {
+    alignas(32) uint8_t  shuf[2][32];
+    alignas(32) uint64_t shift[2][4];
+    constexpr Unpack8Epi64Tab() : shuf(), shift() {
+        for (size_t j = 0; j < 8; ++j) {
+            size_t bitpos = j * Bits - j / 2 * 2 * Bits / 8 * 8;
+            for (size_t k = 0; k < 8; ++k)
+                shuf[j / 4][8 * (j % 4) + k] = uint8_t(bitpos / 8 + k);
+            shift[j / 4][j % 4] = bitpos % 8;
+        }
+    }
+};
+template<size_t Bits>
+constexpr Unpack8Epi64Tab<Bits> g_unpack8_epi64_tab{};
+
+template<size_t Bits>
+inline void unpack8_epi64(const byte* p, size_t* out) {
+    static_assert(Bits >= 26 && Bits <= 57, "Bits must be in [26, 57]");
+    const Unpack8Epi64Tab<Bits>& tab = g_unpack8_epi64_tab<Bits>;
+    const __m256i mask = _mm256_set1_epi64x(~(uint64_t(-1) << Bits));
+    for (size_t h = 0; h < 2; ++h) {
+        const byte* q0 = p + (4 * h + 0) * Bits / 8;
+        const byte* q1 = p + (4 * h + 2) * Bits / 8;
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)q0)),
+            _mm_loadu_si128((const __m128i*)q1), 1);
+        v = _mm256_shuffle_epi8(v, _mm256_load_si256((const __m256i*)tab.shuf[h]));
+        v = _mm256_srlv_epi64(v, _mm256_load_si256((const __m256i*)tab.shift[h]));
+        _mm256_storeu_si256((__m256i*)(out + 4 * h), _mm256_and_si256(v, mask));
+    }
+}
+
+// a kernel reads ReadBytes from the group start, the values in [i, end)
+// cover these bytes if i + unpack8_margin <= end
+constexpr size_t unpack8_margin(size_t Bits, size_t ReadBytes) {
+    return std::max<size_t>(8, (8 * ReadBytes + Bits - 1) / Bits);
+}
+#endif
+
+template<size_t Bits>
+void get_range_tpl(const byte* data, size_t beg, size_t end, size_t* out) {
+    if constexpr (0 == Bits) {
+        std::fill_n(out, end - beg, size_t(0));
+    }
+    else if constexpr (Bits > 58) { // may span 9 bytes
+        for (size_t i = beg; i < end; ++i)
+            *out++ = febitvec::s_get_uint((const size_t*)data, Bits * i, Bits);
+    }
+    else {
+        const size_t mask = ~(size_t(-1) << Bits);
+        size_t i = beg;
+        for (; i < end && i % 8; ++i)
+            *out++ = UintVecMin0::fast_get(data, Bits, mask, i);
+#if defined(__AVX2__)
+        if constexpr (Bits <= 25) {
+            const size_t margin = unpack8_margin(Bits, 4 * Bits / 8 + 16);
+            for (; i + margin <= end; i += 8, out += 8)
+                unpack8_epi32<Bits>(data + Bits * i / 8, out);
+        }
+        else if constexpr (Bits <= 57) {
+            const size_t margin = unpack8_margin(Bits, 6 * Bits / 8 + 16);
+            for (; i + margin <= end; i += 8, out += 8)
+                unpack8_epi64<Bits>(data + Bits * i / 8, out);
+        }
+#endif
+        for (; i + 8 <= end; i += 8, out += 8)
+            get_group8<Bits>(data + Bits * i / 8, out);
+        for (; i < end; ++i)
+            *out++ = UintVecMin0::fast_get(data, Bits, mask, i);
+    }
+}
+
+// pack by streaming whole 64 bit words, only the first and the last word
+// are merged with the existing bits
+template<size_t Bits>
+void set_range_tpl(byte* data, size_t beg, size_t end, const size_t* vals) {
+    if (0 == Bits || beg == end)
+        return; // 0 == Bits: nothing to store
+    const uint64_t mask = Bits < 64 ? ~(uint64_t(-1) << Bits % 64) : uint64_t(-1);
+    size_t bitpos = Bits * beg;
+    byte*  p = data + bitpos / 64 * 8;
+    size_t off = bitpos % 64;
+    uint64_t acc = unaligned_load<uint64_t>(p) & ~(uint64_t(-1) << off);
+    for (size_t i = 0, n = end - beg; i < n; ++i) {
+        uint64_t val = vals[i];
+        assert(val <= mask);
+        acc |= val << off;
+        off += Bits;
+        if (off >= 64) {
+            unaligned_save<uint64_t>(p, acc);
+            p += 8;
+            off -= 64;
+            acc = off ? val >> (Bits - off) : 0;
+        }
+    }
+    if (off) {
+        uint64_t keep = unaligned_load<uint64_t>(p) & (uint64_t(-1) << off);
+        unaligned_save<uint64_t>(p, acc | keep);
+    }
+    TERARK_UNUSED_VAR(mask);
+}
+
+typedef void (*GetRangeFunc)(const byte*, size_t, size_t, size_t*);
+typedef void (*SetRangeFunc)(byte*, size_t, size_t, const size_t*);
+
+template<size_t... Bits>
+constexpr std::array<GetRangeFunc, sizeof...(Bits)>
+make_get_range_tab(std::index_sequence<Bits...>) {
+    return {{ &get_range_tpl<Bits>... }};
+}
+template<size_t... Bits>
+constexpr std::array<SetRangeFunc, sizeof...(Bits)>
+make_set_range_tab(std::index_sequence<Bits...>) {
+    return {{ &set_range_tpl<Bits>... }};
+}
+const std::array<GetRangeFunc, 65> g_get_range_tab =
+    make_get_range_tab(std::make_index_sequence<65>());
+const std::array<SetRangeFunc, 65> g_set_range_tab =
+    make_set_range_tab(std::make_index_sequence<65>());
+
+} // namespace
+
+void UintVecMin0Base::s_get_range(const byte* data, size_t bits,
+                                  size_t beg, size_t end, size_t* out) {
+    assert(beg <= end);
+    assert(bits <= 64);
+    g_get_range_tab[bits](data, beg, end, out);
+}
+
+void UintVecMin0Base::s_set_range(byte* data, size_t bits,
+                                  size_t beg, size_t end, const size_t* vals) {
+    assert(beg <= end);
+    assert(bits <= 64);
+    g_set_range_tab[bits](data, beg, end, vals);
+}
+
 void UintVecMin0Base::push_back_slow_path(size_t val) {
     // 103/64 is a bit less than 1.618
     if (val > m_mask) {
         size_t num = m_size;
         UintVecMin0Base tmp(std::max(num+1, num*103/64), val);
-        auto d = m_data.data();
-        auto b = m_bits;
-        if (b <= 58) {
-            auto m = m_mask;
-            for (size_t i = 0; i < num; ++i) {
-                tmp.set_wire(i, UintVecMin0::fast_get(d, b, m, i));
-            }
-        }
-        else {
-            for (size_t i = 0; i < num; ++i) {
-                tmp.set_wire(i, BigUintVecMin0::fast_get(d, b, i));
-            }
+        size_t buf[256];
+        for (size_t i = 0; i < num; ) {
+            size_t n = std::min(num - i, sizeof(buf)/sizeof(buf[0]));
+            s_get_range(m_data.data(), m_bits, i, i + n, buf);
+            tmp.set_range(i, i + n, buf);
+            i += n;
         }
         tmp.m_size = num;
         this->swap(tmp);
@@ -102,6 +289,11 @@ void UintVecMin0Base::resize_with_uintbits(size_t num, size_t bits) {
 UintVecMin0Base::Builder::~Builder() {
 }
 
+void UintVecMin0Base::Builder::push_back_n(const size_t* values, size_t num) {
+    for (size_t i = 0; i < num; ++i)
+        push_back(values[i]);
+}
+
 class UintVecMin0Builder : public UintVecMin0Base::Builder {
 protected:
     boost::intrusive_ptr<OutputBuffer> m_writer;
@@ -123,14 +315,29 @@ public:
     ~UintVecMin0Builder() {
     }
 
+    void flush_full_buffer() {
+        size_t byte_count = m_buffer.uintbits() * offset_flush_size / 8;
+        m_writer->ensureWrite(m_buffer.data(), byte_count);
+        m_flush_count += offset_flush_size;
+        m_output_size += byte_count;
+        m_count = 0;
+    }
     void push_back(size_t value) override {
         m_buffer.set_wire(m_count++, value);
         if (m_count == offset_flush_size) {
-            size_t byte_count = m_buffer.uintbits() * offset_flush_size / 8;
-            m_writer->ensureWrite(m_buffer.data(), byte_count);
-            m_flush_count += offset_flush_size;
-            m_output_size += byte_count;
-            m_count = 0;
+            flush_full_buffer();
+        }
+    }
+    void push_back_n(const size_t* values, size_t num) override {
+        while (num) {
+            size_t n = std::min(num, offset_flush_size - m_count);
+            m_buffer.set_range(m_count, m_count + n, values);
+            m_count += n;
+            values += n;
+            num -= n;
+            if (m_count == offset_flush_size) {
+                flush_full_buffer();
+            }
         }
     }
     BuildResult finish() override {
@@ -74,6 +74,19 @@ public:
 
 	void resize_with_uintbits(size_t num, size_t bit_width);
 
+	// bulk unpack/pack of the values of index [beg, end), the kernels are
+	// specialized for each bit width, sequential unpack runs at several GB/s
+	static void s_get_range(const byte* data, size_t bits,
+							size_t beg, size_t end, size_t* out);
+	static void s_set_range(byte* data, size_t bits,
+							size_t beg, size_t end, const size_t* vals);
+	void set_range(size_t beg, size_t end, const size_t* vals) {
+		assert(beg <= end);
+		assert(end <= m_size);
+		assert(m_bits <= 64);
+		s_set_range(m_data.data(), m_bits, beg, end, vals);
+	}
+
 private:
 	terark_no_inline void push_back_slow_path(size_t val);
 public:
@@ -128,8 +141,14 @@ public:
 		typedef typename boost::make_unsigned<Int>::type Uint;
 		ullong wire_max = Uint(max_val - min_val);
 		resize_with_wire_max_val(num, wire_max);
-		for (size_t i = 0; i < num; ++i)
-			set_wire(i, Uint(src[i] - min_val));
+		size_t buf[256];
+		for (size_t i = 0; i < num; ) {
+			size_t n = std::min(num - i, sizeof(buf)/sizeof(buf[0]));
+			for (size_t j = 0; j < n; ++j)
+				buf[j] = Uint(src[i + j] - min_val);
+			set_range(i, i + n, buf);
+			i += n;
+		}
 		return min_val;
 	}
 
@@ -142,6 +161,7 @@ public:
         };
         virtual ~Builder();
         virtual void push_back(size_t value) = 0;
+        virtual void push_back_n(const size_t* values, size_t num);
         virtual BuildResult finish() = 0;
     };
     static Builder* create_builder_by_uintbits(size_t uintbits, const char* fpath);
@@ -205,6 +225,12 @@ public:
     size_t val = unaligned_load<size_t>(data + byte_idx);
     return (val >> bit_idx % 8) & mask;
   }
+  void get_range(size_t beg, size_t end, size_t* out) const {
+    assert(beg <= end);
+    assert(end <= m_size);
+    assert(m_bits <= 58);
+    s_get_range(m_data.data(), m_bits, beg, end, out);
+  }
   size_t back() const { assert(m_size > 0); return get(m_size-1); }
   size_t operator[](size_t idx) const { return get(idx); }
 
@@ -256,6 +282,12 @@ public:
     size_t bitpos = bits * idx;
     return febitvec::s_get_uint((const size_t*)data, bitpos, bits);
   }
+  void get_range(size_t beg, size_t end, size_t* out) const {
+    assert(beg <= end);
+    assert(end <= m_size);
+    assert(m_bits <= 64);
+    s_get_range(m_data.data(), m_bits, beg, end, out);
+  }
   size_t back() const { assert(m_size > 0); return get(m_size-1); }
   size_t operator[](size_t idx) const { return get(idx); }
 
@@ -335,6 +367,28 @@ public:
 				    size_t minVal, size_t idx) {
 		return Int(minVal + UintVecMin0::fast_get(data, bits, mask, idx));
 	}
+	void get_range(size_t beg, size_t end, Int* out) const {
+		assert(beg <= end);
+		assert(end <= m_size);
+		const size_t minVal = size_t(m_min_val);
+		if (sizeof(Int) == sizeof(size_t)) {
+			size_t* p = reinterpret_cast<size_t*>(out);
+			s_get_range(m_data.data(), m_bits, beg, end, p);
+			for (size_t i = 0, n = end - beg; i < n; ++i)
+				p[i] += minVal;
+		}
+		else {
+			size_t buf[256];
+			while (beg < end) {
+				size_t n = std::min(end - beg, sizeof(buf)/sizeof(buf[0]));
+				s_get_range(m_data.data(), m_bits, beg, beg + n, buf);
+				for (size_t i = 0; i < n; ++i)
+					out[i] = Int(minVal + buf[i]);
+				beg += n;
+				out += n;
+			}
+		}
+	}
 	Int min_val() const { return Int(m_min_val); }
 
 	template<class Int2>
@@ -1,5 +1,6 @@
 #pragma once
 #include "valvec.hpp"
+#include "mempool_trim.hpp"
 #include <terark/util/atomic.hpp>
 #include <terark/util/throw.hpp>
 #include <stdexcept>
@@ -52,6 +53,9 @@ class MemPool_ThisType : private valvec<unsigned char> {
     huge_link_t huge_list; // huge_list.size is max height of skiplist
     valvec<LockFreeHead> free_list_lock_free;
     std::mutex  huge_mutex;
+    MemPoolTrimPolicy m_trim_policy;
+    MemPoolTrimStat   m_trim_stat;
+    size_t  m_trim_low = 0; // lowest free size seen since last trim
 
 #if defined(__GNUC__)
     unsigned int m_rand_seed = 1;
@@ -218,6 +222,41 @@ public:
         return *(U*)(p + pos);
     }
 
+private:
+    // find in huge_list, use first match, return list_tail if not found
+    size_t huge_alloc(size_t request) {
+        size_t res = list_tail, remain = 0;
+        huge_link_t* update[skip_list_level_max];
+        huge_link_t* n1 = &huge_list;
+        huge_link_t* n2 = nullptr;
+        huge_mutex.lock();
+        size_t k = huge_list.size;
+        while (k-- > 0) {
+            while (n1->next[k] != list_tail && (n2 = &at<huge_link_t>(size_t(n1->next[k]) << offset_shift))->size < request)
+                n1 = n2;
+            update[k] = n1;
+        }
+        if (n2 != nullptr && n2->size >= request) {
+            assert((byte*)n2 >= p);
+            remain = n2->size - request;
+            res = size_t((byte*)n2 - p);
+            size_t res_shift = res >> offset_shift;
+            for (k = 0; k < huge_list.size; ++k)
+                if ((n1 = update[k])->next[k] == res_shift)
+                    n1->next[k] = n2->next[k];
+            while (huge_list.next[huge_list.size - 1] == list_tail && --huge_list.size > 0)
+                ;
+            as_atomic(fragment_size).fetch_sub(request, std::memory_order_relaxed);
+            huge_size_sum -= request;
+            huge_node_cnt--;
+        }
+        huge_mutex.unlock();
+        if (remain)
+            sfree(res + request, remain); // may lock huge_mutex
+        return res;
+    }
+
+public:
     // param request must be aligned by align_size
     size_t alloc(size_t request) {
         assert(request > 0);
@@ -246,33 +285,7 @@ public:
         }
         else { // find in freelist, use first match
             assert(request >= sizeof(huge_link_t));
-            huge_link_t* update[skip_list_level_max];
-            huge_link_t* n1 = &huge_list;
-            huge_link_t* n2 = nullptr;
-            huge_mutex.lock();
-            size_t k = huge_list.size;
-            while (k-- > 0) {
-                while (n1->next[k] != list_tail && (n2 = &at<huge_link_t>(size_t(n1->next[k]) << offset_shift))->size < request)
-                    n1 = n2;
-                update[k] = n1;
-            }
-            if (n2 != nullptr && n2->size >= request) {
-                assert((byte*)n2 >= p);
-                size_t remain = n2->size - request;
-                res = size_t((byte*)n2 - p);
-                size_t res_shift = res >> offset_shift;
-                for (k = 0; k < huge_list.size; ++k)
-                    if ((n1 = update[k])->next[k] == res_shift)
-                        n1->next[k] = n2->next[k];
-                while (huge_list.next[huge_list.size - 1] == list_tail && --huge_list.size > 0)
-                    ;
-                if (remain)
-                    sfree(res + request, remain);
-                as_atomic(fragment_size).fetch_sub(request, std::memory_order_relaxed);
-                huge_size_sum -= request;
-                huge_node_cnt--;
-            }
-            huge_mutex.unlock();
+            res = huge_alloc(request);
         }
         if (list_tail == res) {
         LockFreeIncN:
@@ -286,6 +299,13 @@ public:
                     return pos;
                 }
             }
+            if (request <= free_list_lock_free.size() * align_size &&
+                    as_atomic(huge_list.size).load(std::memory_order_relaxed)) {
+                // such as blocks coalesced by trim
+                res = huge_alloc(request);
+                if (list_tail != res)
+                    return res;
+            }
             return size_t(-1); // fail
         }
         return res;
@@ -390,6 +410,73 @@ public:
 
     size_t frag_size() const { return fragment_size; }
 
+    /// move all free blocks out of the freelists, on_free(pos, len) is
+    /// called for each of them, the caller owns them and may put them back
+    /// by sfree. there should not be any other concurrent thread accessing
+    /// this mempool.
+    template<class OnFree>
+    void drain_free_list(OnFree on_free) {
+        for (size_t i = 0; i < free_list_lock_free.size(); ++i) {
+            size_t len = align_size * (i + 1);
+            size_t next = free_list_lock_free[i].head;
+            while (list_tail != next) {
+                size_t pos = next * AlignSize;
+                next = at<link_t>(pos);
+                on_free(pos, len);
+            }
+            free_list_lock_free[i].head = link_size_t(list_tail);
+            free_list_lock_free[i].cnt = 0;
+        }
+        size_t next = huge_list.next[0];
+        while (list_tail != next) {
+            size_t pos = next << offset_shift;
+            const huge_link_t& h = at<huge_link_t>(pos);
+            next = h.next[0];
+            on_free(pos, size_t(h.size));
+        }
+        huge_list.size = 0;
+        for(auto& link : huge_list.next) link = list_tail;
+        fragment_size = 0;
+        huge_size_sum = 0;
+        huge_node_cnt = 0;
+    }
+
+    /// coalesce the free blocks and release the whole pages in them to the
+    /// OS, the blocks are still free, return the released bytes. there
+    /// should not be any other concurrent thread accessing this mempool.
+    /// @see MemPoolTrimPolicy, mempool_trim_blocks
+    size_t trim() {
+        valvec<std::pair<size_t, size_t> > blocks;
+        drain_free_list([&](size_t pos, size_t len) {
+            blocks.emplace_back(pos, len);
+        });
+        size_t ranges = 0;
+        size_t released = mempool_trim_blocks(mem::p, blocks,
+            sizeof(huge_link_t), m_trim_policy.lazy_free,
+            [this](size_t pos, size_t len) { sfree(pos, len); }, &ranges);
+        m_trim_low = fragment_size;
+        m_trim_stat.trim_cnt++;
+        m_trim_stat.released_bytes += released;
+        m_trim_stat.last_released = released;
+        m_trim_stat.last_ranges = ranges;
+        return released;
+    }
+
+    /// trim if the free size reaches the high watermark of trim policy,
+    /// it is cheap if not, it is never called implicitly because trim can
+    /// not run concurrently with alloc and sfree of other threads
+    size_t maybe_trim() {
+        m_trim_low = std::min(m_trim_low, fragment_size);
+        if (m_trim_policy.high_watermark &&
+                fragment_size - m_trim_low >= m_trim_policy.high_watermark)
+            return trim();
+        return 0;
+    }
+
+    void set_trim_policy(const MemPoolTrimPolicy& tp) { m_trim_policy = tp; }
+    const MemPoolTrimPolicy& get_trim_policy() const { return m_trim_policy; }
+    const MemPoolTrimStat& get_trim_stat() const { return m_trim_stat; }
+
     void swap(MemPool_ThisType& y) {
         mem::swap(y);
         std::swap(fragment_size, y.fragment_size);
@@ -398,6 +485,9 @@ public:
         std::swap(huge_list, y.huge_list);
         // don't swap huge_mutex
         std::swap(free_list_lock_free, y.free_list_lock_free);
+        std::swap(m_trim_policy, y.m_trim_policy);
+        std::swap(m_trim_stat, y.m_trim_stat);
+        std::swap(m_trim_low, y.m_trim_low);
     }
 
     template<class DataIO>
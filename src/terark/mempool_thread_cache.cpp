@@ -12,6 +12,11 @@
 #else
 #include <sys/mman.h>
 #endif
+#if defined(__linux__)
+  #include <terark/util/fast_getcpu.hpp>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
 #include <terark/util/hugepage.hpp>
 #include <terark/util/profiling.hpp> // for qtime
 
@@ -51,6 +56,8 @@ TCMemPoolOneThreadMF()TCMemPoolOneThread(ThreadCacheMemPool<AlignSize>* mp) {
     for(auto& next : huge_list.next) next = list_tail;
     m_hot_pos = 0;
     m_hot_end = 0;
+    m_numa_node = 0;
+    m_trim_low = 0;
 }
 TCMemPoolOneThreadMF()~TCMemPoolOneThread() {
 }
@@ -82,6 +89,8 @@ TCMemPoolOneThreadMF(void)reduce_frag_size(size_t request) {
         as_atomic(m_mempool->fragment_size).
             fetch_sub(size_t(-m_frag_inc), std::memory_order_relaxed);
         m_frag_inc = 0;
+        if (fragment_size < m_trim_low)
+            m_trim_low = fragment_size;
     }
 }
 
@@ -175,6 +184,7 @@ alloc(byte_t* base, size_t request) {
             while (huge_list.next[huge_list.size - 1] == list_tail && --huge_list.size > 0)
                 loop_cnt++;
             if (m_hot_pos < m_hot_end) {
+                ASAN_UNPOISON_MEMORY_REGION(base + m_hot_pos, m_hot_end - m_hot_pos);
                 sfree(base, m_hot_pos, m_hot_end - m_hot_pos);
             }
             m_hot_pos = res + request;
@@ -194,6 +204,7 @@ alloc(byte_t* base, size_t request) {
             if (rlen >= request) {
                 huge_list.next[0] = ((huge_link_t*)(base + res))->next[0];
                 if (m_hot_pos < m_hot_end) {
+                    ASAN_UNPOISON_MEMORY_REGION(base + m_hot_pos, m_hot_end - m_hot_pos);
                     sfree(base, m_hot_pos, m_hot_end - m_hot_pos);
                 }
                 m_hot_pos = res + request;
@@ -385,6 +396,11 @@ TCMemPoolOneThreadMF(void)sfree(byte_t* base, size_t pos, size_t len) {
         as_atomic(m_mempool->fragment_size).
             fetch_add(size_t(m_frag_inc), std::memory_order_relaxed);
         m_frag_inc = 0;
+        // auto trim is checked here to keep the fast path unchanged
+        if (terark_unlikely(intptr_t(fragment_size - m_trim_low) >=
+                            m_mempool->m_trim_auto_high)) {
+            m_mempool->tc_trim(this);
+        }
     }
 }
 
@@ -416,6 +432,35 @@ populate_hot_area(byte_t* base, size_t pageSize) {
     }
 }
 
+TCMemPoolOneThreadMF(void)
+drain_free_list(byte_t* base, const function<void(size_t pos, size_t len)>& on_free) {
+    for (size_t i = 0; i < m_freelist_head.size(); ++i) {
+        size_t len = AlignSize * (i + 1);
+        size_t next = m_freelist_head[i].head;
+        while (list_tail != next) {
+            size_t pos = next * AlignSize;
+            ASAN_UNPOISON_MEMORY_REGION(base + pos, len);
+            next = *(link_t*)(base + pos);
+            on_free(pos, len);
+        }
+        m_freelist_head[i] = head_t();
+    }
+    size_t next = huge_list.next[0];
+    while (list_tail != next) {
+        size_t pos = next << offset_shift;
+        auto h = (huge_link_t*)(base + pos);
+        ASAN_UNPOISON_MEMORY_REGION(h, h->size);
+        next = h->next[0];
+        on_free(pos, size_t(h->size));
+    }
+    huge_list.size = 0;
+    for (auto& link : huge_list.next) link = list_tail;
+    m_frag_inc -= intptr_t(fragment_size);
+    fragment_size = 0;
+    huge_size_sum = 0;
+    huge_node_cnt = 0;
+}
+
 // called on current thread exit
 TCMemPoolOneThreadMF(void)clean_for_reuse() {}
 
@@ -443,7 +488,7 @@ ThreadCacheMemPoolMF()ThreadCacheMemPool(size_t fastbin_max_size) {
 }
 
 ThreadCacheMemPoolMF()~ThreadCacheMemPool() {
-    // do nothing
+    destroy_arena();
 }
 
 ThreadCacheMemPoolMF(void)sync_frag_size() {
@@ -493,7 +538,97 @@ ThreadCacheMemPoolMF(size_t)get_cur_tls_free_size() const {
 }
 
 ThreadCacheMemPoolMF(void)destroy_and_clean() {
+    destroy_arena();
     mem::clear();
+    m_numa_nodes.clear();
+}
+
+// the owner of the memory may have called risk_release_ownership, such as
+// PatriciaMem, so mem::p is checked
+ThreadCacheMemPoolMF(void)destroy_arena() {
+    if (m_arena) {
+        m_arena->stop_prefault();
+        if (mem::p == m_arena->base()) {
+            ASAN_UNPOISON_MEMORY_REGION(mem::p, mem::c);
+            mem::risk_release_ownership();
+        }
+        m_arena.reset(); // munmap
+    }
+}
+
+ThreadCacheMemPoolMF(void)
+drain_free_list(const function<void(size_t pos, size_t len)>& on_free) {
+    byte_t* base = mem::p;
+    this->for_each_tls([&](TCMemPoolOneThread<AlignSize>* tc) {
+        tc->drain_free_list(base, on_free);
+        if (tc->m_hot_pos < tc->m_hot_end) {
+            size_t len = tc->m_hot_end - tc->m_hot_pos;
+            ASAN_UNPOISON_MEMORY_REGION(base + tc->m_hot_pos, len);
+            on_free(tc->m_hot_pos, len);
+        }
+        tc->m_hot_pos = tc->m_hot_end = 0;
+        tc->m_frag_inc = 0;
+    });
+    fragment_size = 0;
+}
+
+ThreadCacheMemPoolMF(bool)shrink_tail(size_t newsize, size_t oldsize) {
+    assert(newsize <= oldsize);
+    assert(newsize % AlignSize == 0);
+    if (cas_strong(mem::n, oldsize, newsize)) {
+        ASAN_POISON_MEMORY_REGION(mem::p + newsize, oldsize - newsize);
+        return true;
+    }
+    return false;
+}
+
+// called by the thread of tc, or with exclusive access to the mempool
+ThreadCacheMemPoolMF(terark_no_inline size_t)
+tc_trim(TCMemPoolOneThread<AlignSize>* tc) {
+    typedef TCMemPoolOneThread<AlignSize> TC;
+    byte_t* base = mem::p;
+    valvec<std::pair<size_t, size_t> > blocks;
+    tc->m_trim_low = tc->fragment_size; // avoid recursive trim by put back
+    tc->drain_free_list(base, [&](size_t pos, size_t len) {
+        blocks.emplace_back(pos, len);
+    });
+    size_t ranges = 0;
+    size_t released = mempool_trim_blocks(base, blocks,
+        sizeof(typename TC::huge_link_t), m_trim_policy.lazy_free,
+        [&](size_t pos, size_t len) { tc->sfree(base, pos, len); }, &ranges);
+    tc->m_trim_low = tc->fragment_size;
+    as_atomic(m_trim_stat.trim_cnt).fetch_add(1, std::memory_order_relaxed);
+    as_atomic(m_trim_stat.released_bytes).fetch_add(released, std::memory_order_relaxed);
+    as_atomic(m_trim_stat.last_released).store(released, std::memory_order_relaxed);
+    as_atomic(m_trim_stat.last_ranges).store(ranges, std::memory_order_relaxed);
+    return released;
+}
+
+ThreadCacheMemPoolMF(size_t)trim() {
+    size_t released = 0;
+    this->for_each_tls([&](TCMemPoolOneThread<AlignSize>* tc) {
+        released += tc_trim(tc);
+    });
+    return released;
+}
+
+ThreadCacheMemPoolMF(size_t)maybe_trim() {
+    const size_t high = m_trim_policy.high_watermark;
+    size_t released = 0;
+    this->for_each_tls([&](TCMemPoolOneThread<AlignSize>* tc) {
+        tc->m_trim_low = std::min(tc->m_trim_low, tc->fragment_size);
+        if (high && tc->fragment_size - tc->m_trim_low >= high)
+            released += tc_trim(tc);
+    });
+    return released;
+}
+
+ThreadCacheMemPoolMF(void)set_trim_policy(const MemPoolTrimPolicy& tp) {
+    m_trim_policy = tp;
+    intptr_t auto_high = INTPTR_MAX;
+    if (tp.auto_trim && tp.high_watermark)
+        auto_high = intptr_t(std::min<size_t>(tp.high_watermark, INTPTR_MAX));
+    as_atomic(m_trim_auto_high).store(auto_high, std::memory_order_relaxed);
 }
 
 ThreadCacheMemPoolMF(void)get_fastbin(valvec<size_t>* fast) const {
@@ -536,6 +671,17 @@ ThreadCacheMemPoolMF(void)print_stat(FILE* fp) const {
     });
     fprintf(fp, "computed_frag_size = %zd, computed_hot_size = %zd, plus the two = %zd\n",
                     computed_frag_size, computed_hot_size, computed_frag_size + computed_hot_size);
+    if (!m_numa_nodes.empty()) {
+        valvec<size_t> threads(m_numa_nodes.size(), 0);
+        this->for_each_tls([&](TCMemPoolOneThread<AlignSize>* tc) {
+            threads[tc->m_numa_node]++;
+        });
+        for (size_t node = 0; node < m_numa_nodes.size(); ++node) {
+            const NumaNodeStat& ns = m_numa_nodes[node];
+            fprintf(fp, "numa node %zd: threads=%zd, chunk{num=%zd,len=%zd}, mbind_fail=%zd\n",
+                    node, threads[node], ns.chunk_cnt, ns.chunk_len, ns.mbind_fail_cnt);
+        }
+    }
 }
 
 ThreadCacheMemPoolMF(size_t)get_huge_stat(size_t* huge_memsize) const {
@@ -565,6 +711,23 @@ ThreadCacheMemPoolMF(void)erase_all() {
 
 ThreadCacheMemPoolMF(terark_no_inline void)reserve(size_t cap) {
     cap = pow2_align_up(cap, ArenaSize);
+    if (m_arena) {
+        TERARK_VERIFY_F(nullptr == mem::p && nullptr == m_arena->base(),
+                        "arena mode can only be reserved once");
+        VmArena::Options opt = m_arena_opt;
+        opt.reserve_size = cap;
+        if (!m_arena->create(opt)) {
+            throw std::bad_alloc();
+        }
+        mem::risk_set_data(m_arena->base(), 0);
+        mem::risk_set_capacity(m_arena->capacity());
+        ASAN_POISON_MEMORY_REGION(mem::p, mem::c);
+        MSAN_POISON_MEMORY_REGION(mem::p, mem::c);
+        m_arena->start_prefault([this]() {
+            return as_atomic(mem::n).load(std::memory_order_relaxed);
+        });
+        return;
+    }
     size_t oldsize = mem::n;
     use_hugepage_resize_no_init(this, cap);
     mem::n = oldsize;
@@ -574,6 +737,73 @@ ThreadCacheMemPoolMF(terark_no_inline void)reserve(size_t cap) {
 
 ThreadCacheMemPoolMF(void)shrink_to_fit() {}
 
+ThreadCacheMemPoolMF(void)enable_arena(const VmArena::Options& opt) {
+    TERARK_VERIFY_F(nullptr == mem::p, "enable_arena must be before reserve");
+    m_arena.reset(new VmArena());
+    m_arena_opt = opt;
+}
+
+ThreadCacheMemPoolMF(VmArena::Stat)get_arena_stat(bool with_huge_pages) const {
+    if (m_arena) {
+        return m_arena->get_stat(with_huge_pages);
+    }
+    return VmArena::Stat();
+}
+
+#if defined(__linux__)
+// number of possible NUMA nodes, "/sys/devices/system/node/possible" is
+// such as "0" or "0-3"
+static size_t numa_possible_nodes() {
+    size_t num = 1;
+    if (FILE* fp = fopen("/sys/devices/system/node/possible", "r")) {
+        char buf[64] = "";
+        if (fgets(buf, sizeof(buf), fp)) {
+            const char* last = strrchr(buf, '-');
+            last = last ? last + 1 : buf;
+            num = size_t(atoi(last)) + 1;
+        }
+        fclose(fp);
+    }
+    return std::min<size_t>(num, 1024);
+}
+#endif
+
+ThreadCacheMemPoolMF(bool)enable_numa(bool enable) {
+    m_numa_nodes.clear();
+  #if defined(__linux__)
+    if (enable) {
+        m_numa_nodes.resize(numa_possible_nodes());
+        return true;
+    }
+  #endif
+    return !enable;
+}
+
+// called on chunk alloc, before the chunk is touched
+ThreadCacheMemPoolMF(terark_no_inline void)
+numa_bind_chunk(TCMemPoolOneThread<AlignSize>* tc, size_t pos, size_t len) {
+  #if defined(__linux__)
+    size_t node = fast_getcpu_node();
+    if (terark_unlikely(node >= m_numa_nodes.size()))
+        node = 0; // should not happen
+    tc->m_numa_node = node;
+    NumaNodeStat& ns = m_numa_nodes[node];
+    as_atomic(ns.chunk_cnt).fetch_add(1, std::memory_order_relaxed);
+    as_atomic(ns.chunk_len).fetch_add(len, std::memory_order_relaxed);
+    size_t beg = pow2_align_up(size_t(mem::p + pos), 4096);
+    size_t end = pow2_align_down(size_t(mem::p + pos + len), 4096);
+    if (beg < end) {
+        const int MPOL_PREFERRED_ = 1; // avoid depending on libnuma
+        unsigned long nodemask[1024 / (8 * sizeof(long))] = {0};
+        nodemask[node / (8 * sizeof(long))] = 1UL << (node % (8 * sizeof(long)));
+        if (syscall(SYS_mbind, beg, end - beg, MPOL_PREFERRED_, nodemask,
+                    8 * sizeof(nodemask), 0) != 0) {
+            as_atomic(ns.mbind_fail_cnt).fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+  #endif
+}
+
 
     // should not throw
 ThreadCacheMemPoolMF(terark_no_inline bool)
@@ -599,6 +829,12 @@ chunk_alloc(TCMemPoolOneThread<AlignSize>* tc, size_t request) {
         assert(oldn + chunk_len <= cap);
     } while (!cas_weak(mem::n, oldn, oldn + chunk_len));
 
+    if (m_arena) {
+        m_arena->notify(oldn + chunk_len);
+    }
+    if (!m_numa_nodes.empty()) {
+        numa_bind_chunk(tc, oldn, chunk_len);
+    }
   #if defined(_MSC_VER)
     // Windows requires explicit commit virtual memory
     size_t beg = pow2_align_down(size_t(base + oldn), 4096);
@@ -737,6 +973,9 @@ ThreadCacheMemPoolMF(void)tc_populate(size_t sz) {
     } while (!cas_weak(mem::n, oldn, oldn + chunk_len));
 
     auto tc = this->get_tls();
+    if (!m_numa_nodes.empty()) {
+        numa_bind_chunk(tc, oldn, chunk_len);
+    }
     tc->set_hot_area(base, oldn, chunk_len);
     //tc->populate_hot_area(base, m_chunk_size);
     tc->populate_hot_area(base, 4*1024);
@@ -1,9 +1,12 @@
 #pragma once
 #include <terark/valvec32.hpp>
+#include <terark/mempool_trim.hpp>
 #include <terark/util/function.hpp>
+#include <terark/util/vm_arena.hpp>
 #include <terark/thread/instance_tls_owner.hpp>
 #include <boost/integer/static_log2.hpp>
 #include <boost/mpl/if.hpp>
+#include <memory>
 
 namespace terark {
 
@@ -50,6 +53,8 @@ public:
     size_t  huge_node_cnt;
     TCMemPoolOneThread* m_next_free;
     ThreadCacheMemPool<AlignSize>* m_mempool;
+    size_t  m_numa_node; // NUMA node of the last chunk, if numa is enabled
+    size_t  m_trim_low; // lowest free size seen since last trim
     size_t random_level();
 
     void reduce_frag_size(size_t request);
@@ -60,6 +65,9 @@ public:
     void set_hot_area(byte_t* base, size_t pos, size_t len);
     void populate_hot_area(byte_t* base, size_t pageSize);
 
+    /// move all free blocks out of the freelists, hot area is not touched
+    void drain_free_list(byte_t* base, const function<void(size_t pos, size_t len)>& on_free);
+
     virtual void clean_for_reuse();
     virtual void init_for_reuse();
 };
@@ -131,6 +139,47 @@ public:
     size_t m_vm_commit_fail_cnt = 0;
     size_t m_vm_commit_fail_len = 0;
 
+    struct NumaNodeStat {
+        size_t chunk_cnt = 0;
+        size_t chunk_len = 0;
+        size_t mbind_fail_cnt = 0;
+    };
+protected:
+    valvec<NumaNodeStat> m_numa_nodes; // one sub arena per node
+    void numa_bind_chunk(TCMemPoolOneThread<AlignSize>*, size_t pos, size_t len);
+
+    MemPoolTrimPolicy m_trim_policy;
+    MemPoolTrimStat   m_trim_stat;
+    intptr_t      m_trim_auto_high = INTPTR_MAX; // checked by thread caches
+    size_t tc_trim(TCMemPoolOneThread<AlignSize>*);
+
+    std::unique_ptr<VmArena> m_arena;
+    VmArena::Options m_arena_opt;
+    void destroy_arena();
+public:
+    /// NUMA aware mode, should be set before any alloc. A chunk is the hot
+    /// area of a thread cache, it is bound to the NUMA node of the thread
+    /// by mbind(MPOL_PREFERRED) before it is touched, the chunks of a node
+    /// are the sub arena of the node, all sub arenas are in the same
+    /// virtual address range, thus offsets are not changed. Threads which
+    /// migrate to another node get chunks of the new node on next chunk
+    /// alloc, the fast path is not changed. The chunks allocated before
+    /// enable_numa are not bound.
+    /// return false if numa is not supported, then it is not enabled.
+    bool enable_numa(bool enable = true);
+    bool is_numa_enabled() const { return !m_numa_nodes.empty(); }
+    const valvec<NumaNodeStat>& get_numa_stat() const { return m_numa_nodes; }
+
+    /// arena mode, should be set before reserve(). reserve(cap) maps the
+    /// whole cap of virtual memory by VmArena, which is aligned to 2M and
+    /// advised as transparent huge pages, and a background thread populates
+    /// the pages ahead of the used size, thus chunk_alloc never touches new
+    /// pages by itself. opt.reserve_size is overridden by cap of reserve().
+    /// The arena is unmapped by destroy_and_clean() or the destructor.
+    void enable_arena(const VmArena::Options& opt = VmArena::Options());
+    bool is_arena_enabled() const { return m_arena != nullptr; }
+    VmArena::Stat get_arena_stat(bool with_huge_pages = false) const;
+
     void set_chunk_size(size_t sz) {
         TERARK_VERIFY_F((sz & (sz-1)) == 0, "%zd(%#zX)", sz, sz);
         m_chunk_size = sz;
@@ -158,6 +207,37 @@ public:
     size_t get_cur_tls_free_size() const;
 
     void destroy_and_clean();
+
+    /// move all free blocks out of the freelists and hot areas of all
+    /// thread caches, on_free(pos, len) is called for each of them, the
+    /// caller owns them and may put them back by sfree.
+    /// there should not be any other concurrent thread accessing this
+    /// mempool's meta data.
+    void drain_free_list(const function<void(size_t pos, size_t len)>& on_free);
+
+    /// if the arena ends at oldsize, shrink it to newsize and return true,
+    /// [newsize, oldsize) must be owned by the caller, this is lock free
+    /// with chunk_alloc of other threads.
+    bool shrink_tail(size_t newsize, size_t oldsize);
+
+    /// trim each thread cache: coalesce its free blocks and release the
+    /// whole pages in them to the OS, the blocks are still free and hot
+    /// areas are not touched, return the released bytes. there should not
+    /// be any other concurrent thread accessing this mempool's meta data.
+    /// the stat is of thread cache trims.
+    /// @see MemPoolTrimPolicy, mempool_trim_blocks
+    size_t trim();
+
+    /// trim the thread caches which reach the high watermark of the trim
+    /// policy, the same concurrency requirement as trim(). thread caches
+    /// are also trimmed by their own threads if policy.auto_trim is true,
+    /// which does not slow down the fast path of alloc and sfree.
+    size_t maybe_trim();
+
+    void set_trim_policy(const MemPoolTrimPolicy&);
+    const MemPoolTrimPolicy& get_trim_policy() const { return m_trim_policy; }
+    MemPoolTrimStat get_trim_stat() const { return m_trim_stat; }
+
     void get_fastbin(valvec<size_t>* fast) const;
     void print_stat(FILE* fp) const;
 
@@ -0,0 +1,79 @@
+#pragma once
+#include <terark/valvec.hpp>
+#include <terark/util/vm_util.hpp>
+#include <algorithm>
+#include <utility>
+
+namespace terark {
+
+/// trim of a mempool releases the whole pages in its free blocks to the
+/// OS, the free blocks are still in the free lists, their pages are
+/// faulted in again when they are reused.
+struct MemPoolTrimPolicy {
+    /// maybe_trim() trims if the free size has grown by high_watermark
+    /// over the lowest free size seen since the last trim, 0 disables it
+    size_t high_watermark = 0;
+
+    /// use MADV_FREE instead of MADV_DONTNEED, RSS is reduced lazily by
+    /// the kernel on memory pressure, but the pages are cheaper to reuse
+    bool   lazy_free = false;
+
+    /// just for ThreadCacheMemPool: a thread cache is trimmed by its own
+    /// thread when it reaches high_watermark, it is checked in sfree only
+    /// when the free size is synced to the mempool, once per 256K bytes
+    bool   auto_trim = false;
+};
+
+/// released bytes are the bytes advised to the OS, the pages which were
+/// released by a previous trim and not reused are counted again
+struct MemPoolTrimStat {
+    size_t trim_cnt = 0;
+    size_t released_bytes = 0; // sum of all trims
+    size_t last_released = 0;
+    size_t last_ranges = 0; // free ranges after coalescing of last trim
+};
+
+/// free blocks {pos, len} drained from a mempool are sorted and coalesced,
+/// a coalesced range which spans whole pages after its first head_size
+/// bytes, the head holds the free list link, is put back as one block by
+/// put_back(pos, len) and its whole pages are released, other ranges are
+/// put back as the original blocks, thus small blocks are not merged for
+/// nothing. blocks are put back from the top, thus the range at the end
+/// of the mempool is truncated by sfree. return the released bytes.
+template<class PutBack>
+size_t mempool_trim_blocks(byte_t* base,
+                           valvec<std::pair<size_t, size_t> >& blocks,
+                           size_t head_size, bool lazy_free,
+                           PutBack put_back, size_t* num_ranges = NULL) {
+    const size_t max_piece = size_t(1) << 30; // huge_link_t::size is 32 bit
+    std::sort(blocks.begin(), blocks.end());
+    size_t released = 0, ranges = 0;
+    for (size_t i = 0; i < blocks.size(); ) {
+        size_t beg = i;
+        size_t pos = blocks[i].first;
+        size_t end = pos + blocks[i].second;
+        while (++i < blocks.size() && blocks[i].first == end)
+            end += blocks[i].second;
+        ranges++;
+        size_t lo = pow2_align_up(size_t(base + pos) + head_size, VM_PAGE_SIZE);
+        size_t hi = pow2_align_down(size_t(base + end), VM_PAGE_SIZE);
+        if (lo >= hi) {
+            for (size_t j = i; j > beg; --j)
+                put_back(blocks[j-1].first, blocks[j-1].second);
+            continue;
+        }
+        while (end > pos) {
+            size_t len = std::min(end - pos, max_piece);
+            put_back(end - len, len);
+            if (len > head_size)
+                released += vm_release(base + end - len + head_size,
+                                       len - head_size, lazy_free);
+            end -= len;
+        }
+    }
+    if (num_ranges)
+        *num_ranges = ranges;
+    return released;
+}
+
+} // namespace terark
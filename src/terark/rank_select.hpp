@@ -8,3 +8,4 @@
 #include "succinct/rank_select_mixed_xl_256.hpp"
 #include "succinct/rank_select_mixed_se_512.hpp"
 #include "succinct/rank_select_few.hpp"
+#include "succinct/rank_select_rrr.hpp"
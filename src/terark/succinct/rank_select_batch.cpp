@@ -0,0 +1,332 @@
+#include "rank_select_batch.hpp"
+#include <terark/util/cpu_prefetch.hpp>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    #define TERARK_RANK_SELECT_BATCH_X86
+    #include <immintrin.h>
+#endif
+
+namespace terark {
+
+typedef rank_select_il_layout Layout;
+
+static inline const unsigned char* il_line(const Layout& l, size_t line) {
+    return l.lines + l.line_bytes * line;
+}
+static inline uint32_t il_base(const Layout& l, const unsigned char* line) {
+    return *(const uint32_t*)(line + l.base_offset);
+}
+static inline size_t il_rlev(const Layout& l, const unsigned char* line, size_t w) {
+    return line[l.base_offset + 4 + w];
+}
+static inline uint64_t il_word(const Layout& l, const unsigned char* line, size_t w) {
+    return *(const uint64_t*)(line + l.bits_offset + l.word_stride * w);
+}
+static inline void il_prefetch_line(const Layout& l, size_t line) {
+    const char* p = (const char*)il_line(l, line);
+    TERARK_CPU_PREFETCH(p);
+    TERARK_CPU_PREFETCH(p + l.line_bytes - 1);
+}
+
+// kernels compute a group of at most RankSelectBatchGroup queries whose
+// lines have been prefetched
+struct RankSelectBatchKernel {
+    const char* name;
+    bool (*is_supported)();
+    void (*rank1)(const Layout&, const size_t* pos, size_t n, size_t* out);
+    // lineIdx[i] is the line holding the ranks[i]'th one
+    void (*select1_in_line)(const Layout&, const size_t* lineIdx,
+                            const size_t* ranks, size_t n, size_t* out);
+};
+
+static bool scalar_is_supported() { return true; }
+
+static void scalar_rank1(const Layout& l, const size_t* pos, size_t n, size_t* out) {
+    for (size_t i = 0; i < n; ++i) {
+        size_t p = pos[i];
+        const unsigned char* line = il_line(l, p / 256);
+        size_t w = p % 256 / 64;
+        out[i] = il_base(l, line) + il_rlev(l, line, w)
+               + fast_popcount_trail(il_word(l, line, w), p % 64);
+    }
+}
+
+static void scalar_select1_in_line(const Layout& l, const size_t* lineIdx,
+                                   const size_t* ranks, size_t n, size_t* out) {
+    for (size_t i = 0; i < n; ++i) {
+        const unsigned char* line = il_line(l, lineIdx[i]);
+        size_t r = ranks[i] - il_base(l, line);
+        size_t w = (r >= il_rlev(l, line, 1))
+                 + (r >= il_rlev(l, line, 2))
+                 + (r >= il_rlev(l, line, 3));
+        out[i] = 256 * lineIdx[i] + 64 * w
+               + UintSelect1(il_word(l, line, w), r - il_rlev(l, line, w));
+    }
+}
+
+static const RankSelectBatchKernel g_scalar_kernel = {
+    "scalar", &scalar_is_supported, &scalar_rank1, &scalar_select1_in_line,
+};
+
+#if defined(TERARK_RANK_SELECT_BATCH_X86)
+
+static inline void select1_finish(const size_t* lineIdx, const uint64_t* w,
+                                  const uint64_t* r, const uint64_t* word,
+                                  size_t n, size_t* out) {
+    for (size_t i = 0; i < n; ++i)
+        out[i] = 256 * lineIdx[i] + 64 * w[i] + UintSelect1(word[i], r[i]);
+}
+
+static bool avx2_is_supported() {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2");
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_popcnt_epi64(__m256i v) {
+    const __m256i lut = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                         0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i low4 = _mm256_set1_epi8(0x0F);
+    __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low4));
+    __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low4));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+static void avx2_rank1(const Layout& l, const size_t* pos, size_t n, size_t* out) {
+    const long long* base = (const long long*)(l.lines + l.base_offset);
+    const long long* bits = (const long long*)(l.lines + l.bits_offset);
+    const __m256i line_bytes = _mm256_set1_epi64x(l.line_bytes);
+    const __m256i stride = _mm256_set1_epi64x(l.word_stride);
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i p = _mm256_loadu_si256((const __m256i*)(pos + i));
+        __m256i w = _mm256_and_si256(_mm256_srli_epi64(p, 6), _mm256_set1_epi64x(3));
+        __m256i off = _mm256_mul_epu32(_mm256_srli_epi64(p, 8), line_bytes);
+        __m256i g = _mm256_i64gather_epi64(base, off, 1);
+        __m256i word = _mm256_i64gather_epi64(bits,
+                           _mm256_add_epi64(off, _mm256_mul_epu32(w, stride)), 1);
+        __m256i mask = _mm256_xor_si256(ones, _mm256_sllv_epi64(ones,
+                           _mm256_and_si256(p, _mm256_set1_epi64x(63))));
+        __m256i cnt = avx2_popcnt_epi64(_mm256_and_si256(word, mask));
+        __m256i lev1 = _mm256_and_si256(g, _mm256_set1_epi64x(0xFFFFFFFF));
+        __m256i lev2 = _mm256_and_si256(_mm256_srlv_epi64(g,
+                           _mm256_add_epi64(_mm256_set1_epi64x(32), _mm256_slli_epi64(w, 3))),
+                           _mm256_set1_epi64x(0xFF));
+        _mm256_storeu_si256((__m256i*)(out + i),
+                            _mm256_add_epi64(_mm256_add_epi64(lev1, lev2), cnt));
+    }
+    scalar_rank1(l, pos + i, n - i, out + i);
+}
+
+__attribute__((target("avx2,bmi2")))
+static void avx2_select1_in_line(const Layout& l, const size_t* lineIdx,
+                                 const size_t* ranks, size_t n, size_t* out) {
+    const long long* base = (const long long*)(l.lines + l.base_offset);
+    const long long* bits = (const long long*)(l.lines + l.bits_offset);
+    const __m256i line_bytes = _mm256_set1_epi64x(l.line_bytes);
+    const __m256i stride = _mm256_set1_epi64x(l.word_stride);
+    const __m256i byte_mask = _mm256_set1_epi64x(0xFF);
+    alignas(32) uint64_t w[4], r[4], word[4];
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i off = _mm256_mul_epu32(
+                _mm256_loadu_si256((const __m256i*)(lineIdx + i)), line_bytes);
+        __m256i g = _mm256_i64gather_epi64(base, off, 1);
+        __m256i rank = _mm256_sub_epi64(
+                _mm256_loadu_si256((const __m256i*)(ranks + i)),
+                _mm256_and_si256(g, _mm256_set1_epi64x(0xFFFFFFFF)));
+        __m256i rl1 = _mm256_and_si256(_mm256_srli_epi64(g, 40), byte_mask);
+        __m256i rl2 = _mm256_and_si256(_mm256_srli_epi64(g, 48), byte_mask);
+        __m256i rl3 = _mm256_srli_epi64(g, 56);
+        // cmpgt is -1 where rlev[k] > rank, w = 3 - count of such k
+        __m256i vw = _mm256_add_epi64(_mm256_set1_epi64x(3),
+                     _mm256_add_epi64(_mm256_cmpgt_epi64(rl1, rank),
+                     _mm256_add_epi64(_mm256_cmpgt_epi64(rl2, rank),
+                                      _mm256_cmpgt_epi64(rl3, rank))));
+        __m256i rlw = _mm256_and_si256(_mm256_srlv_epi64(g,
+                         _mm256_add_epi64(_mm256_set1_epi64x(32), _mm256_slli_epi64(vw, 3))),
+                         byte_mask);
+        __m256i vword = _mm256_i64gather_epi64(bits,
+                         _mm256_add_epi64(off, _mm256_mul_epu32(vw, stride)), 1);
+        _mm256_store_si256((__m256i*)w, vw);
+        _mm256_store_si256((__m256i*)r, _mm256_sub_epi64(rank, rlw));
+        _mm256_store_si256((__m256i*)word, vword);
+        select1_finish(lineIdx + i, w, r, word, 4, out + i);
+    }
+    scalar_select1_in_line(l, lineIdx + i, ranks + i, n - i, out + i);
+}
+
+static const RankSelectBatchKernel g_avx2_kernel = {
+    "avx2", &avx2_is_supported, &avx2_rank1, &avx2_select1_in_line,
+};
+
+static bool avx512_is_supported() {
+    return __builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512vpopcntdq") &&
+           __builtin_cpu_supports("bmi2");
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static void avx512_rank1(const Layout& l, const size_t* pos, size_t n, size_t* out) {
+    const unsigned char* base = l.lines + l.base_offset;
+    const unsigned char* bits = l.lines + l.bits_offset;
+    const __m512i line_bytes = _mm512_set1_epi64(l.line_bytes);
+    const __m512i stride = _mm512_set1_epi64(l.word_stride);
+    const __m512i ones = _mm512_set1_epi64(-1);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i p = _mm512_loadu_si512(pos + i);
+        __m512i w = _mm512_and_si512(_mm512_srli_epi64(p, 6), _mm512_set1_epi64(3));
+        __m512i off = _mm512_mul_epu32(_mm512_srli_epi64(p, 8), line_bytes);
+        __m512i g = _mm512_i64gather_epi64(off, base, 1);
+        __m512i word = _mm512_i64gather_epi64(
+                _mm512_add_epi64(off, _mm512_mul_epu32(w, stride)), bits, 1);
+        __m512i mask = _mm512_andnot_si512(_mm512_sllv_epi64(ones,
+                _mm512_and_si512(p, _mm512_set1_epi64(63))), ones);
+        __m512i cnt = _mm512_popcnt_epi64(_mm512_and_si512(word, mask));
+        __m512i lev1 = _mm512_and_si512(g, _mm512_set1_epi64(0xFFFFFFFF));
+        __m512i lev2 = _mm512_and_si512(_mm512_srlv_epi64(g,
+                _mm512_add_epi64(_mm512_set1_epi64(32), _mm512_slli_epi64(w, 3))),
+                _mm512_set1_epi64(0xFF));
+        _mm512_storeu_si512(out + i, _mm512_add_epi64(_mm512_add_epi64(lev1, lev2), cnt));
+    }
+    scalar_rank1(l, pos + i, n - i, out + i);
+}
+
+__attribute__((target("avx512f,bmi2")))
+static void avx512_select1_in_line(const Layout& l, const size_t* lineIdx,
+                                   const size_t* ranks, size_t n, size_t* out) {
+    const unsigned char* base = l.lines + l.base_offset;
+    const unsigned char* bits = l.lines + l.bits_offset;
+    const __m512i line_bytes = _mm512_set1_epi64(l.line_bytes);
+    const __m512i stride = _mm512_set1_epi64(l.word_stride);
+    const __m512i byte_mask = _mm512_set1_epi64(0xFF);
+    alignas(64) uint64_t w[8], r[8], word[8];
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i off = _mm512_mul_epu32(_mm512_loadu_si512(lineIdx + i), line_bytes);
+        __m512i g = _mm512_i64gather_epi64(off, base, 1);
+        __m512i rank = _mm512_sub_epi64(_mm512_loadu_si512(ranks + i),
+                _mm512_and_si512(g, _mm512_set1_epi64(0xFFFFFFFF)));
+        __m512i rl1 = _mm512_and_si512(_mm512_srli_epi64(g, 40), byte_mask);
+        __m512i rl2 = _mm512_and_si512(_mm512_srli_epi64(g, 48), byte_mask);
+        __m512i rl3 = _mm512_srli_epi64(g, 56);
+        // w = count of k in [1,3] where rlev[k] <= rank
+        __m512i vw = _mm512_maskz_mov_epi64(_mm512_cmple_epu64_mask(rl1, rank), _mm512_set1_epi64(1));
+        vw = _mm512_mask_add_epi64(vw, _mm512_cmple_epu64_mask(rl2, rank), vw, _mm512_set1_epi64(1));
+        vw = _mm512_mask_add_epi64(vw, _mm512_cmple_epu64_mask(rl3, rank), vw, _mm512_set1_epi64(1));
+        __m512i rlw = _mm512_and_si512(_mm512_srlv_epi64(g,
+                _mm512_add_epi64(_mm512_set1_epi64(32), _mm512_slli_epi64(vw, 3))), byte_mask);
+        __m512i vword = _mm512_i64gather_epi64(
+                _mm512_add_epi64(off, _mm512_mul_epu32(vw, stride)), bits, 1);
+        _mm512_store_si512(w, vw);
+        _mm512_store_si512(r, _mm512_sub_epi64(rank, rlw));
+        _mm512_store_si512(word, vword);
+        select1_finish(lineIdx + i, w, r, word, 8, out + i);
+    }
+    scalar_select1_in_line(l, lineIdx + i, ranks + i, n - i, out + i);
+}
+
+static const RankSelectBatchKernel g_avx512_kernel = {
+    "avx512", &avx512_is_supported, &avx512_rank1, &avx512_select1_in_line,
+};
+
+static const RankSelectBatchKernel* const g_all_kernels[] = {
+    &g_avx512_kernel, &g_avx2_kernel, &g_scalar_kernel,
+};
+
+#else
+
+static const RankSelectBatchKernel* const g_all_kernels[] = {
+    &g_scalar_kernel,
+};
+
+#endif // TERARK_RANK_SELECT_BATCH_X86
+
+// constant initialized, so it is valid before the static initializer below
+static const RankSelectBatchKernel* g_kernel = &g_scalar_kernel;
+
+static struct RankSelectBatchKernelInit {
+    RankSelectBatchKernelInit() {
+        for (auto k : g_all_kernels) {
+            if (k->is_supported()) {
+                g_kernel = k;
+                break;
+            }
+        }
+    }
+} g_kernel_init;
+
+const char* rank_select_batch_kernel_name() {
+    return g_kernel->name;
+}
+
+bool rank_select_batch_set_kernel(const char* name) {
+    for (auto k : g_all_kernels) {
+        if (strcmp(k->name, name) == 0 && k->is_supported()) {
+            g_kernel = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+void rank_select_il_rank1_batch(const Layout& l, const size_t* pos, size_t n, size_t* out) {
+    auto kernel = g_kernel->rank1;
+    for (size_t beg = 0; beg < n; beg += RankSelectBatchGroup) {
+        size_t m = std::min(n - beg, RankSelectBatchGroup);
+        for (size_t i = 0; i < m; ++i) {
+            size_t p = pos[beg + i];
+            const unsigned char* line = il_line(l, p / 256);
+            TERARK_CPU_PREFETCH(line + l.base_offset);
+            TERARK_CPU_PREFETCH(line + l.bits_offset + l.word_stride * (p % 256 / 64));
+        }
+        kernel(l, pos + beg, m, out + beg);
+    }
+}
+
+void rank_select_il_select1_batch(const Layout& l, const uint32_t* sel1,
+                                  const size_t* ranks, size_t n, size_t* out) {
+    auto kernel = g_kernel->select1_in_line;
+    size_t lineIdx[RankSelectBatchGroup];
+    for (size_t beg = 0; beg < n; beg += RankSelectBatchGroup) {
+        size_t m = std::min(n - beg, RankSelectBatchGroup);
+        const size_t* r = ranks + beg;
+        if (sel1) {
+            for (size_t i = 0; i < m; ++i) {
+                il_prefetch_line(l, sel1[r[i] / 256]);
+            }
+        }
+        // same as rank_select_il::fast_select1, find the line
+        for (size_t i = 0; i < m; ++i) {
+            size_t Rank1 = r[i];
+            size_t lo, hi;
+            if (sel1) {
+                lo = sel1[Rank1 / 256];
+                hi = sel1[Rank1 / 256 + 1];
+            } else {
+                lo = 0;
+                hi = l.num_lines;
+            }
+            if (sel1 && hi - lo < 32) {
+                while (il_base(l, il_line(l, lo)) <= Rank1) lo++;
+            }
+            else {
+                while (lo < hi) {
+                    size_t mid = (lo + hi) / 2;
+                    if (il_base(l, il_line(l, mid)) <= Rank1) // upper_bound
+                        lo = mid + 1;
+                    else
+                        hi = mid;
+                }
+            }
+            assert(lo > 0 && lo <= l.num_lines);
+            lineIdx[i] = lo - 1;
+        }
+        kernel(l, lineIdx, r, m, out + beg);
+    }
+}
+
+} // namespace terark
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "rank_select_basic.hpp"
+#include <algorithm>
+
+namespace terark {
+
+/// Batch rank1/select1 over arrays of positions/ranks.
+///
+/// Independent queries are processed a group at a time: all cache lines of
+/// a group are prefetched before any of them is computed, so the misses of
+/// the group overlap instead of being paid one after another. The line
+/// popcount of rank1 and the in-line word choosing of select1 are done for
+/// several queries by one SIMD kernel, the kernel is chosen at startup by
+/// cpuid: AVX-512 VPOPCNTDQ(8 queries), AVX2(4 queries) or scalar.
+
+/// Memory layout of the rank_select_il family(il_256, mixed_il_256 and
+/// mixed_xl_256 for one dimension): a line of 256 bits is `line_bytes`,
+/// the uint32 rank of the line start at `base_offset` is followed by the
+/// uint8 rank of each 64 bit word in the line, the 4 words of the line are
+/// at `bits_offset + word_stride * i`. lines[num_lines] is the sentinel
+/// line, its base is max_rank1.
+struct rank_select_il_layout {
+    const unsigned char* lines;
+    size_t num_lines;
+    size_t line_bytes;
+    size_t base_offset;
+    size_t bits_offset;
+    size_t word_stride;
+};
+
+/// out[i] = rank1(pos[i])
+TERARK_DLL_EXPORT
+void rank_select_il_rank1_batch(const rank_select_il_layout&,
+                                const size_t* pos, size_t n, size_t* out);
+
+/// out[i] = select1(ranks[i]), sel1 is the select1 cache, may be NULL
+TERARK_DLL_EXPORT
+void rank_select_il_select1_batch(const rank_select_il_layout&,
+                                  const uint32_t* sel1,
+                                  const size_t* ranks, size_t n, size_t* out);
+
+/// "avx512", "avx2" or "scalar"
+TERARK_DLL_EXPORT const char* rank_select_batch_kernel_name();
+
+/// for tests and benchmarks, return false if the cpu does not support it
+TERARK_DLL_EXPORT bool rank_select_batch_set_kernel(const char* name);
+
+/// queries of a group in the generic batch functions
+static const size_t RankSelectBatchGroup = 16;
+
+/// for rank select classes which have no batch kernel
+template<class RankSelect>
+void rank_select_rank1_batch_generic(const RankSelect& rs,
+                                     const size_t* pos, size_t n, size_t* out) {
+    for (size_t beg = 0; beg < n; beg += RankSelectBatchGroup) {
+        size_t end = std::min(n, beg + RankSelectBatchGroup);
+        for (size_t i = beg; i < end; ++i) {
+            rs.prefetch_rank1(pos[i]);
+            rs.prefetch_bit(pos[i]);
+        }
+        for (size_t i = beg; i < end; ++i) {
+            out[i] = rs.rank1(pos[i]);
+        }
+    }
+}
+
+template<class RankSelect>
+void rank_select_select1_batch_generic(const RankSelect& rs,
+                                       const size_t* ranks, size_t n, size_t* out) {
+    // select1 has no prefetch, the calls are independent, out of order
+    // execution overlaps them
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = rs.select1(ranks[i]);
+    }
+}
+
+namespace rank_select_batch_detail {
+    // use the member function if RankSelect has one
+    template<class RankSelect>
+    auto rank1(const RankSelect& rs, const size_t* pos, size_t n, size_t* out, int)
+    -> decltype(rs.rank1_batch(pos, n, out)) {
+        return rs.rank1_batch(pos, n, out);
+    }
+    template<class RankSelect>
+    void rank1(const RankSelect& rs, const size_t* pos, size_t n, size_t* out, long) {
+        rank_select_rank1_batch_generic(rs, pos, n, out);
+    }
+    template<class RankSelect>
+    auto select1(const RankSelect& rs, const size_t* ranks, size_t n, size_t* out, int)
+    -> decltype(rs.select1_batch(ranks, n, out)) {
+        return rs.select1_batch(ranks, n, out);
+    }
+    template<class RankSelect>
+    void select1(const RankSelect& rs, const size_t* ranks, size_t n, size_t* out, long) {
+        rank_select_select1_batch_generic(rs, ranks, n, out);
+    }
+} // namespace rank_select_batch_detail
+
+/// out[i] = rs.rank1(pos[i]) for any rank select class
+template<class RankSelect>
+inline void rank1_batch(const RankSelect& rs, const size_t* pos, size_t n, size_t* out) {
+    rank_select_batch_detail::rank1(rs, pos, n, out, 0);
+}
+
+/// out[i] = rs.select1(ranks[i]) for any rank select class
+template<class RankSelect>
+inline void select1_batch(const RankSelect& rs, const size_t* ranks, size_t n, size_t* out) {
+    rank_select_batch_detail::select1(rs, ranks, n, out, 0);
+}
+
+} // namespace terark
@@ -1,4 +1,6 @@
 #include "rank_select_il_256.hpp"
+#include "rank_select_batch.hpp"
+#include "rank_select_parallel.hpp"
 
 #define GUARD_MAX_RANK(B, rank) \
     assert(rank < m_max_rank##B);
@@ -422,6 +424,22 @@ size_t rank_select_il::select1_q(size_t Rank1) const {
     }
 }
 
+void rank_select_il::rank1_batch(const size_t* pos, size_t n, size_t* out) const {
+    const rank_select_il_layout layout = {
+        (const unsigned char*)m_lines.data(), m_lines.size(), sizeof(Line),
+        offsetof(Line, rlev1), offsetof(Line, bit64), sizeof(uint64_t),
+    };
+    rank_select_il_rank1_batch(layout, pos, n, out);
+}
+
+void rank_select_il::select1_batch(const size_t* ranks, size_t n, size_t* out) const {
+    const rank_select_il_layout layout = {
+        (const unsigned char*)m_lines.data(), m_lines.size(), sizeof(Line),
+        offsetof(Line, rlev1), offsetof(Line, bit64), sizeof(uint64_t),
+    };
+    rank_select_il_select1_batch(layout, m_fast_select1, ranks, n, out);
+}
+
 void rank_select_il::risk_mmap_from(unsigned char* base, size_t length) {
     assert(length % sizeof(Line) == 0);
     uint64_t flags = ((uint64_t*)(base + length))[-1];
@@ -448,9 +466,13 @@ void rank_select_il::risk_release_ownership() {
 }
 
 void rank_select_il::build_cache(bool speed_select0, bool speed_select1) {
-    build_cache_q(speed_select0, speed_select1);
+    build_cache_q(speed_select0, speed_select1, 1);
 }
-void rank_select_il::build_cache_q(size_t Q0, size_t Q1) {
+void rank_select_il::build_cache_parallel(bool speed_select0, bool speed_select1,
+                                          size_t num_threads) {
+    build_cache_q(speed_select0, speed_select1, num_threads);
+}
+void rank_select_il::build_cache_q(size_t Q0, size_t Q1, size_t num_threads) {
     rank_select_check_overflow(m_size, > , rank_select_il_256);
     assert(NULL == m_fast_select0);
     assert(NULL == m_fast_select1);
@@ -463,16 +485,25 @@ void rank_select_il::build_cache_q(size_t Q0, size_t Q1) {
     }
     shrink_to_fit();
     Line* lines = m_lines.data();
-    size_t Rank1 = 0;
-    for(size_t i = 0; i < m_lines.size(); ++i) {
-        size_t inc = 0;
-        lines[i].rlev1 = (uint32_t)(Rank1);
-        for (size_t j = 0; j < 4; ++j) {
-            lines[i].rlev2[j] = (uint8_t)inc;
-            inc += fast_popcount(lines[i].bit64[j]);
+    num_threads = rank_select_parallel::get_threads(num_threads, m_lines.size());
+    size_t Rank1 = rank_select_parallel::build_rank_cache(m_lines.size(), num_threads,
+    [lines](size_t beg, size_t end) {
+        size_t Rank1 = 0;
+        for(size_t i = beg; i < end; ++i) {
+            size_t inc = 0;
+            lines[i].rlev1 = (uint32_t)(Rank1);
+            for (size_t j = 0; j < 4; ++j) {
+                lines[i].rlev2[j] = (uint8_t)inc;
+                inc += fast_popcount(lines[i].bit64[j]);
+            }
+            Rank1 += inc;
         }
-        Rank1 += inc;
-    }
+        return Rank1;
+    },
+    [lines](size_t beg, size_t end, size_t base) {
+        for(size_t i = beg; i < end; ++i)
+            lines[i].rlev1 += (uint32_t)(base);
+    });
     m_max_rank0 = m_size - Rank1;
     m_max_rank1 = Rank1;
     size_t select0_slots = (m_max_rank0 + LineBits - 1) / (LineBits/(Q0?Q0:1));
@@ -491,23 +522,17 @@ void rank_select_il::build_cache_q(size_t Q0, size_t Q1) {
     uint32_t* select_index = (uint32_t*)(m_lines.end() + 1);
     if (speed_select0) {
         m_fast_select0 = select_index;
-        m_fast_select0[0] = 0;
-        for(size_t j = 1; j < select0_slots; ++j) {
-            size_t k = m_fast_select0[j - 1];
-            while (k * LineBits - lines[k].rlev1 < (LineBits/Q0) * j) ++k;
-            m_fast_select0[j] = k;
-        }
+        rank_select_parallel::build_select_cache(m_fast_select0, select0_slots,
+            LineBits/Q0, m_lines.size(), num_threads,
+            [lines](size_t k) { return k * LineBits - lines[k].rlev1; });
         m_fast_select0[select0_slots] = m_lines.size();
         select_index += select0_slots + 1;
     }
     if (speed_select1) {
         m_fast_select1 = select_index;
-        m_fast_select1[0] = 0;
-        for(size_t j = 1; j < select1_slots; ++j) {
-            size_t k = m_fast_select1[j - 1];
-            while (lines[k].rlev1 < (LineBits/Q1) * j) ++k;
-            m_fast_select1[j] = k;
-        }
+        rank_select_parallel::build_select_cache(m_fast_select1, select1_slots,
+            LineBits/Q1, m_lines.size(), num_threads,
+            [lines](size_t k) { return size_t(lines[k].rlev1); });
         m_fast_select1[select1_slots] = m_lines.size();
     }
     uint64_t flags
@@ -131,7 +131,16 @@ public:
     size_t max_rank1() const { return m_max_rank1; }
     size_t max_rank0() const { return m_max_rank0; }
 
+    ///@{ out[i] = rank1(pos[i]), out[i] = select1(ranks[i]), by the SIMD
+    ///   kernel in rank_select_batch.hpp
+    void rank1_batch(const size_t* pos, size_t n, size_t* out) const;
+    void select1_batch(const size_t* ranks, size_t n, size_t* out) const;
+    ///@}
+
     void build_cache(bool speed_select0, bool speed_select1);
+    /// same result as build_cache, by num_threads threads, 0 means auto
+    void build_cache_parallel(bool speed_select0, bool speed_select1,
+                              size_t num_threads = 0);
     void risk_mmap_from(unsigned char* base, size_t length);
     void risk_release_ownership();
     void risk_set_data(void*  data) { m_lines.risk_set_data((Line*)(data)); }
@@ -178,7 +187,7 @@ protected:
 
     template<size_t Q> size_t select0_q(size_t Rank0) const;
     template<size_t Q> size_t select1_q(size_t Rank1) const;
-    void build_cache_q(size_t Q0, size_t Q1);
+    void build_cache_q(size_t Q0, size_t Q1, size_t num_threads);
 };
 
 inline size_t rank_select_il::
@@ -306,7 +315,11 @@ public:
         return fast_select0_q<4>(lines, sel1, lines, Rank0);
     }
     void build_cache(bool speed_select0, bool speed_select1) {
-         build_cache_q(speed_select0?4:0, speed_select1);
+         build_cache_q(speed_select0?4:0, speed_select1, 1);
+    }
+    void build_cache_parallel(bool speed_select0, bool speed_select1,
+                              size_t num_threads = 0) {
+         build_cache_q(speed_select0?4:0, speed_select1, num_threads);
     }
     size_t select0(size_t Rank0) const;
 };
@@ -84,10 +84,19 @@ public:
     void build_cache(bool speed_select0, bool speed_select1) {
         this->template build_cache_dx<dimensions>(speed_select0, speed_select1);
     }
+    void build_cache_parallel(bool speed_select0, bool speed_select1, size_t num_threads = 0) {
+        this->template build_cache_parallel_dx<dimensions>(speed_select0, speed_select1, num_threads);
+    }
     size_t rank0(size_t bitpos) const noexcept { return this->template rank0_dx<dimensions>(bitpos); }
     size_t rank1(size_t bitpos) const noexcept { return this->template rank1_dx<dimensions>(bitpos); }
     size_t select0(size_t id) const noexcept { return this->template select0_dx<dimensions>(id); }
     size_t select1(size_t id) const noexcept { return this->template select1_dx<dimensions>(id); }
+    void rank1_batch(const size_t* pos, size_t n, size_t* out) const noexcept {
+        this->template rank1_batch_dx<dimensions>(pos, n, out);
+    }
+    void select1_batch(const size_t* ranks, size_t n, size_t* out) const noexcept {
+        this->template select1_batch_dx<dimensions>(ranks, n, out);
+    }
 	size_t max_rank1() const { return this->m_max_rank1[dimensions]; }
 	size_t max_rank0() const { return this->m_max_rank0[dimensions]; }
 
@@ -334,6 +334,9 @@ void rank_select_mixed_il_256::build_cache_dx(bool speed_select0, bool speed_sel
     size_t u32_slots = (speed_select0 ? select0_slots_dx + 1 : 0)
                      + (speed_select1 ? select1_slots_dx + 1 : 0)
                      ;
+    // realloc may move the select caches of dimensions_y, rebase them
+    ptrdiff_t sel0_offset_y = (byte_t*)m_sel0_cache[dimensions_y] - (byte_t*)m_lines;
+    ptrdiff_t sel1_offset_y = (byte_t*)m_sel1_cache[dimensions_y] - (byte_t*)m_lines;
     reserve_bytes((0
                    + (lines + 1) * sizeof(RankCacheMixed)
                    + u32_slots * 4
@@ -341,6 +344,10 @@ void rank_select_mixed_il_256::build_cache_dx(bool speed_select0, bool speed_sel
                    + flag_as_u32_slots * 4
                    + sizeof(bm_uint_t) - 1
                    ) & ~(sizeof(bm_uint_t) - 1));
+    if (m_sel0_cache[dimensions_y])
+        m_sel0_cache[dimensions_y] = (uint32_t*)((byte_t*)m_lines + sel0_offset_y);
+    if (m_sel1_cache[dimensions_y])
+        m_sel1_cache[dimensions_y] = (uint32_t*)((byte_t*)m_lines + sel1_offset_y);
     {
         char* start  = (char*)(m_lines + lines + 1) + u32_slots_used * 4;
         char* finish = (char*)m_lines + m_capacity;
@@ -2,6 +2,7 @@
 
 #include "rank_select_basic.hpp"
 #include "rank_select_mixed_basic.hpp"
+#include "rank_select_batch.hpp"
 
 namespace terark {
 
@@ -98,6 +99,11 @@ protected:
         terark_bit_set1(m_lines[i / LineBits].mixed[dimensions].words, i % LineBits);
     }
     template<size_t dimensions> void build_cache_dx(bool speed_select0, bool speed_select1);
+    /// build_cache_dx of the two dimensions is not parallel
+    template<size_t dimensions>
+    void build_cache_parallel_dx(bool speed_select0, bool speed_select1, size_t /*num_threads*/) {
+        build_cache_dx<dimensions>(speed_select0, speed_select1);
+    }
     template<size_t dimensions> size_t one_seq_len_dx(size_t bitpos) const noexcept;
     template<size_t dimensions> size_t zero_seq_len_dx(size_t bitpos) const noexcept;
     template<size_t dimensions> size_t one_seq_revlen_dx(size_t endpos) const noexcept;
@@ -106,6 +112,20 @@ protected:
     template<size_t dimensions> inline size_t rank1_dx(size_t bitpos) const noexcept;
     template<size_t dimensions> size_t select0_dx(size_t id) const noexcept;
     template<size_t dimensions> size_t select1_dx(size_t id) const noexcept;
+    template<size_t dimensions>
+    rank_select_il_layout il_layout_dx() const noexcept {
+        return { (const unsigned char*)m_lines, (m_size[dimensions] + LineBits - 1) / LineBits,
+                 sizeof(RankCacheMixed), offsetof(RankCacheMixed, mixed[dimensions].base),
+                 offsetof(RankCacheMixed, mixed[dimensions].bit64), sizeof(uint64_t) };
+    }
+    template<size_t dimensions>
+    void rank1_batch_dx(const size_t* pos, size_t n, size_t* out) const noexcept {
+        rank_select_il_rank1_batch(il_layout_dx<dimensions>(), pos, n, out);
+    }
+    template<size_t dimensions>
+    void select1_batch_dx(const size_t* ranks, size_t n, size_t* out) const noexcept {
+        rank_select_il_select1_batch(il_layout_dx<dimensions>(), m_sel1_cache[dimensions], ranks, n, out);
+    }
 
 public:
     template<size_t dimensions>
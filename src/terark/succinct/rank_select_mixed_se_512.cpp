@@ -344,6 +344,9 @@ void rank_select_mixed_se_512::build_cache_dx(bool speed_select0, bool speed_sel
     size_t u32_slots = (speed_select0 ? select0_slots_dx + 1 : 0)
                      + (speed_select1 ? select1_slots_dx + 1 : 0)
                      ;
+    // realloc may move the select caches of dimensions_y, rebase them
+    ptrdiff_t sel0_offset_y = (byte_t*)m_sel0_cache[dimensions_y] - (byte_t*)m_words;
+    ptrdiff_t sel1_offset_y = (byte_t*)m_sel1_cache[dimensions_y] - (byte_t*)m_words;
     reserve((0
              + ceiled_bits
              + (lines + 1) * sizeof(RankCacheMixed) * 8
@@ -352,6 +355,10 @@ void rank_select_mixed_se_512::build_cache_dx(bool speed_select0, bool speed_sel
              + flag_as_u32_slots * 32
              + WordBits - 1
              ) & ~(WordBits - 1));
+    if (m_sel0_cache[dimensions_y])
+        m_sel0_cache[dimensions_y] = (uint32_t*)((byte_t*)m_words + sel0_offset_y);
+    if (m_sel1_cache[dimensions_y])
+        m_sel1_cache[dimensions_y] = (uint32_t*)((byte_t*)m_words + sel1_offset_y);
     rank_cache = m_rank_cache = (RankCacheMixed*)(m_words + ceiled_bits / WordBits);
     {
         char* start  = (char*)(rank_cache + lines + 1) + u32_slots_used * 4;
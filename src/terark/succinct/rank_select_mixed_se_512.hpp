@@ -2,6 +2,7 @@
 
 #include "rank_select_basic.hpp"
 #include "rank_select_mixed_basic.hpp"
+#include "rank_select_batch.hpp"
 
 namespace terark {
 
@@ -103,6 +104,11 @@ protected:
         terark_bit_set1(m_words + (i / WordBits * 2 + dimensions), i % WordBits);
     }
     template<size_t dimensions> void build_cache_dx(bool speed_select0, bool speed_select1);
+    /// build_cache_dx of the two dimensions is not parallel
+    template<size_t dimensions>
+    void build_cache_parallel_dx(bool speed_select0, bool speed_select1, size_t /*num_threads*/) {
+        build_cache_dx<dimensions>(speed_select0, speed_select1);
+    }
     template<size_t dimensions> size_t one_seq_len_dx(size_t bitpos) const noexcept;
     template<size_t dimensions> size_t zero_seq_len_dx(size_t bitpos) const noexcept;
     template<size_t dimensions> size_t one_seq_revlen_dx(size_t endpos) const noexcept;
@@ -111,6 +117,25 @@ protected:
     template<size_t dimensions> inline size_t rank1_dx(size_t bitpos) const noexcept;
     template<size_t dimensions> size_t select0_dx(size_t id) const noexcept;
     template<size_t dimensions> size_t select1_dx(size_t id) const noexcept;
+    template<size_t dimensions>
+    void rank1_batch_dx(const size_t* pos, size_t n, size_t* out) const noexcept {
+        for (size_t beg = 0; beg < n; beg += RankSelectBatchGroup) {
+            size_t end = std::min(n, beg + RankSelectBatchGroup);
+            for (size_t i = beg; i < end; ++i) {
+                prefetch_rank1_dx<dimensions>(pos[i]);
+                prefetch_bit_dx<dimensions>(pos[i]);
+            }
+            for (size_t i = beg; i < end; ++i) {
+                out[i] = rank1_dx<dimensions>(pos[i]);
+            }
+        }
+    }
+    template<size_t dimensions>
+    void select1_batch_dx(const size_t* ranks, size_t n, size_t* out) const noexcept {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = select1_dx<dimensions>(ranks[i]);
+        }
+    }
 
 public:
     template<size_t dimensions>
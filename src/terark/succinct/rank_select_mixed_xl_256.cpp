@@ -1,4 +1,5 @@
 #include "rank_select_mixed_xl_256.hpp"
+#include "rank_select_parallel.hpp"
 
 #define GUARD_MAX_RANK(B, rank) \
     assert(rank < m_max_rank##B);
@@ -139,7 +140,7 @@ void rank_select_mixed_xl_256<Arity>::risk_mmap_from(unsigned char* base, size_t
     for (size_t i = 0; i < Arity; ++i) {
         m_size[i] = ((uint32_t*)(base + length))[-2 - Arity + i];
     }
-    size_t ceiled_bits = (std::max(m_size[0], m_size[1]) + LineBits - 1) & ~size_t(LineBits - 1);
+    size_t ceiled_bits = (*std::max_element(m_size, m_size + Arity) + LineBits - 1) & ~size_t(LineBits - 1);
     size_t nlines = ceiled_bits / LineBits;
     m_lines = (RankCacheMixed*)base;
     m_capacity = length;
@@ -306,7 +307,8 @@ void rank_select_mixed_xl_256<Arity>::
 build_cache_impl(bool speed_select0,
                  bool speed_select1,
                  size_t dimensions,
-                 void (rank_select_mixed_xl_256<Arity>::*bits_range_set0)(size_t, size_t)) {
+                 void (rank_select_mixed_xl_256<Arity>::*bits_range_set0)(size_t, size_t),
+                 size_t num_threads) {
     rank_select_check_overflow(m_size[dimensions], > , rank_select_mixed_se_512);
     if (NULL == m_lines) return;
     uint64_t  one = 1;
@@ -347,16 +349,26 @@ build_cache_impl(bool speed_select0,
     }
     (this->*bits_range_set0)(m_size[dimensions], ceiled_bits);
 
-    size_t Rank1 = 0;
-    for (size_t i = 0; i < lines; ++i) {
-        size_t inc = 0;
-        m_lines[i].mixed[dimensions].base = (uint32_t)(Rank1);
-        for (size_t j = 0; j < 4; ++j) {
-            m_lines[i].mixed[dimensions].rlev[j] = (uint8_t)inc;
-            inc += fast_popcount(m_lines[i].bit64[j * Arity + dimensions]);
+    RankCacheMixed* plines = m_lines;
+    num_threads = rank_select_parallel::get_threads(num_threads, lines);
+    size_t Rank1 = rank_select_parallel::build_rank_cache(lines, num_threads,
+    [=](size_t beg, size_t end) {
+        size_t Rank1 = 0;
+        for (size_t i = beg; i < end; ++i) {
+            size_t inc = 0;
+            plines[i].mixed[dimensions].base = (uint32_t)(Rank1);
+            for (size_t j = 0; j < 4; ++j) {
+                plines[i].mixed[dimensions].rlev[j] = (uint8_t)inc;
+                inc += fast_popcount(plines[i].bit64[j * Arity + dimensions]);
+            }
+            Rank1 += inc;
         }
-        Rank1 += inc;
-    }
+        return Rank1;
+    },
+    [=](size_t beg, size_t end, size_t base) {
+        for (size_t i = beg; i < end; ++i)
+            plines[i].mixed[dimensions].base += (uint32_t)(base);
+    });
     m_lines[lines].mixed[dimensions].base = uint32_t(Rank1);
     for (size_t j = 0; j < 4; ++j)
         m_lines[lines].mixed[dimensions].rlev[j] = 0;
@@ -372,7 +384,17 @@ build_cache_impl(bool speed_select0,
                      + u32_slots_other_used * 4
                      + flag_as_u32_slots * 4
                      ;
+    // realloc may move the select caches of other dimensions, rebase them
+    ptrdiff_t sel0_offset[Arity], sel1_offset[Arity];
+    for (size_t i = 0; i < Arity; ++i) {
+        sel0_offset[i] = (byte_t*)m_sel0_cache[i] - (byte_t*)m_lines;
+        sel1_offset[i] = (byte_t*)m_sel1_cache[i] - (byte_t*)m_lines;
+    }
     reserve_bytes(align_up(new_bytes, sizeof(bm_uint_t)));
+    for (size_t i = 0; i < Arity; ++i) {
+        if (m_sel0_cache[i]) m_sel0_cache[i] = (uint32_t*)((byte_t*)m_lines + sel0_offset[i]);
+        if (m_sel1_cache[i]) m_sel1_cache[i] = (uint32_t*)((byte_t*)m_lines + sel1_offset[i]);
+    }
     {
         size_t tailing_size = m_capacity - new_bytes + flag_as_u32_slots * 4;
         char* start = (char*)(m_lines + lines + 1) + u32_slots_start * 4;
@@ -389,26 +411,21 @@ build_cache_impl(bool speed_select0,
         }
     }
     uint32_t* select_index = (uint32_t*)(m_lines + lines + 1) + u32_slots_start;
+    plines = m_lines;
     if (speed_select0) {
         uint32_t* sel0_cache = select_index;
-        sel0_cache[dimensions] = 0;
-        for (size_t j = 1; j < select0_slots_dx; ++j) {
-            size_t k = sel0_cache[j - 1];
-            while (k * LineBits - m_lines[k].mixed[dimensions].base < LineBits * j) ++k;
-            sel0_cache[j] = k;
-        }
+        rank_select_parallel::build_select_cache(sel0_cache, select0_slots_dx,
+            LineBits, lines, num_threads,
+            [=](size_t k) { return k * LineBits - plines[k].mixed[dimensions].base; });
         sel0_cache[select0_slots_dx] = lines;
         m_sel0_cache[dimensions] = sel0_cache;
         select_index += select0_slots_dx + 1;
     }
     if (speed_select1) {
         uint32_t* sel1_cache = select_index;
-        sel1_cache[dimensions] = 0;
-        for (size_t j = 1; j < select1_slots_dx; ++j) {
-            size_t k = sel1_cache[j - 1];
-            while (m_lines[k].mixed[dimensions].base < LineBits * j) ++k;
-            sel1_cache[j] = k;
-        }
+        rank_select_parallel::build_select_cache(sel1_cache, select1_slots_dx,
+            LineBits, lines, num_threads,
+            [=](size_t k) { return size_t(plines[k].mixed[dimensions].base); });
         sel1_cache[select1_slots_dx] = lines;
         m_sel1_cache[dimensions] = sel1_cache;
     }
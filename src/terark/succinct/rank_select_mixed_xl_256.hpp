@@ -2,6 +2,7 @@
 
 #include "rank_select_basic.hpp"
 #include "rank_select_mixed_basic.hpp"
+#include "rank_select_batch.hpp"
 
 namespace terark {
 
@@ -100,10 +101,17 @@ protected:
     }
     template<size_t dimensions> void build_cache_dx(bool speed_select0, bool speed_select1) {
         build_cache_impl(speed_select0, speed_select1, dimensions,
-            &rank_select_mixed_xl_256<Arity>::bits_range_set0_dx<dimensions>);
+            &rank_select_mixed_xl_256<Arity>::bits_range_set0_dx<dimensions>, 1);
+    }
+    /// same result as build_cache_dx, by num_threads threads, 0 means auto
+    template<size_t dimensions>
+    void build_cache_parallel_dx(bool speed_select0, bool speed_select1, size_t num_threads) {
+        build_cache_impl(speed_select0, speed_select1, dimensions,
+            &rank_select_mixed_xl_256<Arity>::bits_range_set0_dx<dimensions>, num_threads);
     }
     void build_cache_impl(bool speed_select0, bool speed_select1, size_t dimensions,
-        void (rank_select_mixed_xl_256<Arity>::*bits_range_set0)(size_t i, size_t k));
+        void (rank_select_mixed_xl_256<Arity>::*bits_range_set0)(size_t i, size_t k),
+        size_t num_threads);
     template<size_t dimensions> size_t one_seq_len_dx(size_t bitpos) const noexcept;
     template<size_t dimensions> size_t zero_seq_len_dx(size_t bitpos) const noexcept;
     template<size_t dimensions> size_t one_seq_revlen_dx(size_t endpos) const noexcept;
@@ -112,6 +120,21 @@ protected:
     template<size_t dimensions> inline size_t rank1_dx(size_t bitpos) const noexcept;
     template<size_t dimensions> size_t select0_dx(size_t id) const noexcept;
     template<size_t dimensions> size_t select1_dx(size_t id) const noexcept;
+    template<size_t dimensions>
+    rank_select_il_layout il_layout_dx() const noexcept {
+        return { (const unsigned char*)m_lines, (m_size[dimensions] + LineBits - 1) / LineBits,
+                 sizeof(RankCacheMixed), offsetof(RankCacheMixed, mixed[dimensions].base),
+                 offsetof(RankCacheMixed, bit64) + sizeof(uint64_t) * dimensions,
+                 sizeof(uint64_t) * Arity };
+    }
+    template<size_t dimensions>
+    void rank1_batch_dx(const size_t* pos, size_t n, size_t* out) const noexcept {
+        rank_select_il_rank1_batch(il_layout_dx<dimensions>(), pos, n, out);
+    }
+    template<size_t dimensions>
+    void select1_batch_dx(const size_t* ranks, size_t n, size_t* out) const noexcept {
+        rank_select_il_select1_batch(il_layout_dx<dimensions>(), m_sel1_cache[dimensions], ranks, n, out);
+    }
 
 public:
     template<size_t dimensions>
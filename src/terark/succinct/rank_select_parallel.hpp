@@ -0,0 +1,135 @@
+#pragma once
+
+#include <terark/valvec.hpp>
+#include <algorithm>
+#include <thread>
+
+namespace terark {
+
+/// Helpers of build_cache_parallel.
+///
+/// The rank cache is built in two passes over chunks of lines: the first
+/// pass computes the ranks inside each chunk and the popcount of the chunk,
+/// after a serial prefix sum of the chunk popcounts, the second pass adds
+/// the chunk base to the ranks. The select samples are split by slot, each
+/// thread finds its first line by a binary search on the rank cache, so the
+/// output is identical to the sequential build_cache.
+namespace rank_select_parallel {
+
+/// when num_threads is 0, a thread handles at least this many lines
+static const size_t MinLinesPerThread = 64 * 1024;
+
+/// num_threads = 0 means min(hardware_concurrency, 8), limited by the size
+inline size_t get_threads(size_t num_threads, size_t num_lines) {
+    if (0 == num_threads) {
+        num_threads = std::min<size_t>(std::thread::hardware_concurrency(), 8);
+        num_threads = std::min(num_threads, num_lines / MinLinesPerThread);
+    }
+    num_threads = std::min(num_threads, num_lines);
+    return std::max<size_t>(num_threads, 1);
+}
+
+/// call func(tid) for tid in [0, num_threads), the last one is called on the
+/// calling thread
+template<class Func>
+void run(size_t num_threads, const Func& func) {
+    assert(num_threads > 0);
+    valvec<std::thread> thrVec(num_threads - 1, valvec_reserve());
+    for (size_t i = 0; i + 1 < num_threads; ++i) {
+        thrVec.unchecked_emplace_back([&,i](){func(i);});
+    }
+    func(num_threads - 1);
+    for (auto& t : thrVec) {
+        t.join();
+    }
+}
+
+/// count(beg, end) sets the ranks of lines [beg, end) relative to line beg
+/// and returns the popcount of the lines, add(beg, end, base) adds base to
+/// the ranks of lines [beg, end), return the popcount of all lines
+template<class Count, class Add>
+size_t build_rank_cache(size_t num_lines, size_t num_threads,
+                        const Count& count, const Add& add) {
+    size_t part = (num_lines + num_threads - 1) / num_threads;
+    valvec<size_t> base(num_threads + 1);
+    run(num_threads, [&](size_t tid) {
+        size_t beg = std::min(num_lines, part * tid);
+        size_t end = std::min(num_lines, beg + part);
+        base[tid + 1] = count(beg, end);
+    });
+    for (size_t tid = 0; tid < num_threads; ++tid) {
+        base[tid + 1] += base[tid];
+    }
+    run(num_threads, [&](size_t tid) {
+        size_t beg = std::min(num_lines, part * tid);
+        size_t end = std::min(num_lines, beg + part);
+        if (base[tid] && beg < end)
+            add(beg, end, base[tid]);
+    });
+    return base[num_threads];
+}
+
+/// same as the sequential loop:
+///
+///   sel[0] = 0;
+///   for (size_t j = 1; j < slots; ++j) {
+///       size_t k = sel[j - 1];
+///       while (rank_of(k) < step * j) ++k;
+///       sel[j] = k;
+///   }
+///
+/// rank_of(k) must be non-descending for k in [0, num_lines], num_lines is
+/// the sentinel line. The slots whose first line is beyond the sentinel are
+/// left to the last thread, which walks to them as the sequential loop does.
+template<class Index, class RankOf>
+void build_select_cache(Index* sel, size_t slots, size_t step,
+                        size_t num_lines, size_t num_threads,
+                        const RankOf& rank_of) {
+    sel[0] = 0;
+    size_t safe_slots = std::min(slots, rank_of(num_lines) / step + 1);
+    size_t part = (safe_slots + num_threads - 1) / num_threads;
+    run(num_threads, [&](size_t tid) {
+        size_t jbeg = std::max<size_t>(1, std::min(safe_slots, part * tid));
+        size_t jend = tid + 1 < num_threads
+                    ? std::max(jbeg, std::min(safe_slots, part * (tid + 1)))
+                    : slots;
+        if (jbeg >= jend)
+            return;
+        size_t lo = 0, hi = num_lines; // rank_of(num_lines) >= step * jbeg
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (rank_of(mid) < step * jbeg)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        size_t k = lo;
+        for (size_t j = jbeg; j < jend; ++j) {
+            while (rank_of(k) < step * j) ++k;
+            sel[j] = Index(k);
+        }
+    });
+}
+
+template<class RankSelect>
+auto build_cache(RankSelect& rs, bool speed_select0, bool speed_select1,
+                 size_t num_threads, int)
+-> decltype(rs.build_cache_parallel(speed_select0, speed_select1, num_threads)) {
+    return rs.build_cache_parallel(speed_select0, speed_select1, num_threads);
+}
+template<class RankSelect>
+void build_cache(RankSelect& rs, bool speed_select0, bool speed_select1,
+                 size_t /*num_threads*/, long) {
+    rs.build_cache(speed_select0, speed_select1);
+}
+
+} // namespace rank_select_parallel
+
+/// rs.build_cache_parallel if RankSelect has it, else rs.build_cache
+template<class RankSelect>
+inline void build_cache_parallel(RankSelect& rs, bool speed_select0,
+                                 bool speed_select1, size_t num_threads = 0) {
+    rank_select_parallel::build_cache(rs, speed_select0, speed_select1, num_threads, 0);
+}
+
+} // namespace terark
@@ -0,0 +1,372 @@
+#include "rank_select_rrr.hpp"
+
+namespace terark {
+
+struct rank_select_rrr::Header {
+    uint64_t size;
+    uint64_t max_rank1;
+    uint64_t offset_bits;
+    uint32_t sel0_num;
+    uint32_t sel1_num;
+};
+BOOST_STATIC_ASSERT(sizeof(rank_select_rrr::Header) == 32);
+
+static constexpr rank_select_rrr::BinomialTable make_binomial() {
+    rank_select_rrr::BinomialTable t = {};
+    for (size_t n = 0; n < rank_select_rrr::BlockBits; ++n) {
+        t.v[n][0] = 1;
+        for (size_t k = 1; k <= rank_select_rrr::BlockBits/2; ++k)
+            t.v[n][k] = n ? t.v[n-1][k-1] + t.v[n-1][k] : 0;
+    }
+    return t;
+}
+const rank_select_rrr::BinomialTable rank_select_rrr::s_binomial = make_binomial();
+
+// ceil(log2(C(64,k)))
+const uint8_t rank_select_rrr::s_width[BlockBits + 1] = {
+     0,  6, 11, 16, 20, 23, 27, 30, 33, 35, 38, 40, 42, 44, 46, 48,
+    49, 51, 52, 53, 55, 56, 57, 58, 58, 59, 60, 60, 60, 61, 61, 61,
+    61,
+        61, 61, 61, 60, 60, 60, 59, 58, 58, 57, 56, 55, 53, 52, 51,
+    49, 48, 46, 44, 42, 40, 38, 35, 33, 30, 27, 23, 20, 16, 11,  6,
+     0,
+};
+
+uint64_t rank_select_rrr::encode_block(uint64_t w) noexcept {
+    size_t cls = fast_popcount64(w);
+    if (cls > BlockBits / 2)
+        w = ~w;
+    uint64_t offset = 0;
+    for (size_t k = 1; w; ++k) {
+        offset += s_binomial.v[fast_ctz64(w)][k];
+        w &= w - 1;
+    }
+    return offset;
+}
+
+static size_t align8(size_t bytes) { return (bytes + 7) & ~size_t(7); }
+
+rank_select_rrr::rank_select_rrr() {
+    m_super = NULL;
+    m_sel0 = NULL;
+    m_sel1 = NULL;
+    m_class = NULL;
+    m_offsets = NULL;
+    m_size = 0;
+    m_max_rank1 = 0;
+    m_num_super = 0;
+}
+
+rank_select_rrr::rank_select_rrr(size_t n, bool val) : rank_select_rrr() {
+    rank_select_check_overflow(n, > , rank_select_rrr);
+    m_bits.resize(n, val);
+}
+
+rank_select_rrr::rank_select_rrr(size_t n, valvec_no_init) : rank_select_rrr() {
+    rank_select_check_overflow(n, > , rank_select_rrr);
+    m_bits.resize_no_init(n);
+}
+
+rank_select_rrr::rank_select_rrr(size_t n, valvec_reserve) : rank_select_rrr() {
+    rank_select_check_overflow(n, > , rank_select_rrr);
+    m_bits.reserve(n);
+}
+
+rank_select_rrr::rank_select_rrr(const rank_select_rrr& y)
+  : rank_select_rrr() {
+    m_bits = y.m_bits;
+    if (y.is_built()) {
+        m_data = y.m_data; // copy even if y is mmap'ed
+        set_pointers(m_data.size() * 8);
+    }
+}
+
+rank_select_rrr& rank_select_rrr::operator=(const rank_select_rrr& y) {
+    if (this != &y) {
+        rank_select_rrr(y).swap(*this);
+    }
+    return *this;
+}
+
+rank_select_rrr::rank_select_rrr(rank_select_rrr&& y) noexcept
+  : rank_select_rrr() {
+    swap(y);
+}
+
+rank_select_rrr& rank_select_rrr::operator=(rank_select_rrr&& y) noexcept {
+    rank_select_rrr(std::move(y)).swap(*this);
+    return *this;
+}
+
+rank_select_rrr::~rank_select_rrr() {
+}
+
+void rank_select_rrr::clear() noexcept {
+    rank_select_rrr().swap(*this);
+}
+
+void rank_select_rrr::risk_release_ownership() noexcept {
+    m_data.risk_release_ownership();
+    m_bits.risk_release_ownership();
+    clear();
+}
+
+void rank_select_rrr::swap(rank_select_rrr& y) noexcept {
+    m_bits.swap(y.m_bits);
+    m_data.swap(y.m_data);
+    std::swap(m_super    , y.m_super);
+    std::swap(m_sel0     , y.m_sel0);
+    std::swap(m_sel1     , y.m_sel1);
+    std::swap(m_class    , y.m_class);
+    std::swap(m_offsets  , y.m_offsets);
+    std::swap(m_size     , y.m_size);
+    std::swap(m_max_rank1, y.m_max_rank1);
+    std::swap(m_num_super, y.m_num_super);
+}
+
+void rank_select_rrr::set_pointers(size_t length) {
+    if (length < sizeof(Header) || length % 8 != 0) {
+        THROW_STD(invalid_argument, "length = %zd is invalid", length);
+    }
+    auto header = (const Header*)m_data.data();
+    size_t nbits = size_t(header->size);
+    size_t num_blocks = (nbits + BlockBits - 1) / BlockBits;
+    size_t num_super = (nbits + LineBits - 1) / LineBits;
+    size_t super_bytes = sizeof(SuperBlock) * (num_super + 1);
+    size_t sel0_bytes = align8(4 * header->sel0_num);
+    size_t sel1_bytes = align8(4 * header->sel1_num);
+    size_t class_bytes = align8(num_blocks);
+    size_t offset_bytes = 8 * ((header->offset_bits + 63) / 64 + 1);
+    size_t expected = sizeof(Header) + super_bytes + sel0_bytes + sel1_bytes
+                    + class_bytes + offset_bytes;
+    if (expected != length || header->max_rank1 > nbits ||
+            nbits > size_t(std::numeric_limits<uint32_t>::max())) {
+        THROW_STD(invalid_argument,
+            "bad rank_select_rrr: length = %zd, size = %zd, expected = %zd",
+            length, nbits, expected);
+    }
+    auto base = (const byte_t*)(header + 1);
+    m_super = (const SuperBlock*)base;
+    base += super_bytes;
+    m_sel0 = header->sel0_num ? (const uint32_t*)base : NULL;
+    base += sel0_bytes;
+    m_sel1 = header->sel1_num ? (const uint32_t*)base : NULL;
+    base += sel1_bytes;
+    m_class = base;
+    base += class_bytes;
+    m_offsets = (const uint64_t*)base;
+    m_size = nbits;
+    m_max_rank1 = size_t(header->max_rank1);
+    m_num_super = num_super;
+}
+
+void rank_select_rrr::risk_mmap_from(unsigned char* base, size_t length) {
+    assert(size_t(base) % 8 == 0);
+    clear();
+    m_data.risk_set_data((uint64_t*)base, length / 8);
+    try {
+        set_pointers(length);
+    }
+    catch (const std::exception&) {
+        risk_release_ownership();
+        throw;
+    }
+}
+
+void rank_select_rrr::build_cache(bool speed_select0, bool speed_select1) {
+    if (is_built()) { // rebuild, may be with different select samples
+        febitvec bits(m_size, valvec_no_init());
+        for (size_t k = 0, n = bits.num_words(); k < n; ++k)
+            bits.set_word(k, get_word(k));
+        clear();
+        m_bits.swap(bits);
+    }
+    const size_t nbits = m_bits.size();
+    rank_select_check_overflow(nbits, > , rank_select_rrr);
+    const size_t num_blocks = (nbits + BlockBits - 1) / BlockBits;
+    const size_t num_super = (nbits + LineBits - 1) / LineBits;
+    const uint64_t* words = (const uint64_t*)m_bits.bldata();
+    auto block = [&](size_t k) {
+        uint64_t w = words[k];
+        if ((k + 1) * BlockBits > nbits)
+            w &= ~(uint64_t(-1) << nbits % BlockBits);
+        return w;
+    };
+    size_t max_rank1 = 0, offset_bits = 0;
+    for (size_t k = 0; k < num_blocks; ++k) {
+        size_t cls = fast_popcount64(block(k));
+        max_rank1 += cls;
+        offset_bits += s_width[cls];
+    }
+    if (offset_bits > size_t(std::numeric_limits<uint32_t>::max())) {
+        TERARK_DIE("rank_select_rrr overflow, offset_bits = %zd", offset_bits);
+    }
+    size_t max_rank0 = nbits - max_rank1;
+    size_t sel0_num = speed_select0 && max_rank0 ? max_rank0 / SelectSampleRate + 2 : 0;
+    size_t sel1_num = speed_select1 && max_rank1 ? max_rank1 / SelectSampleRate + 2 : 0;
+    size_t super_bytes = sizeof(SuperBlock) * (num_super + 1);
+    size_t sel0_bytes = align8(4 * sel0_num);
+    size_t sel1_bytes = align8(4 * sel1_num);
+    size_t class_bytes = align8(num_blocks);
+    size_t offset_bytes = 8 * ((offset_bits + 63) / 64 + 1);
+    size_t total = sizeof(Header) + super_bytes + sel0_bytes + sel1_bytes
+                 + class_bytes + offset_bytes;
+    valvec<uint64_t> data(total / 8, 0);
+    auto header = (Header*)data.data();
+    header->size = nbits;
+    header->max_rank1 = max_rank1;
+    header->offset_bits = offset_bits;
+    header->sel0_num = uint32_t(sel0_num);
+    header->sel1_num = uint32_t(sel1_num);
+    byte_t* base = (byte_t*)(header + 1);
+    auto super = (SuperBlock*)base;
+    auto sel0 = (uint32_t*)(base + super_bytes);
+    auto sel1 = (uint32_t*)(base + super_bytes + sel0_bytes);
+    auto cls = base + super_bytes + sel0_bytes + sel1_bytes;
+    auto offsets = (ullong*)(cls + class_bytes);
+    size_t rank1 = 0, bitpos = 0;
+    for (size_t k = 0; k < num_blocks; ++k) {
+        if (k % SuperBlocks == 0) {
+            super[k / SuperBlocks].rank1 = uint32_t(rank1);
+            super[k / SuperBlocks].offset = uint32_t(bitpos);
+        }
+        uint64_t w = block(k);
+        size_t c = fast_popcount64(w);
+        size_t width = s_width[c];
+        cls[k] = byte_t(c);
+        if (width)
+            febitvec::s_set_uint(offsets, bitpos, width, (ullong)encode_block(w));
+        rank1 += c;
+        bitpos += width;
+    }
+    super[num_super].rank1 = uint32_t(rank1);
+    super[num_super].offset = uint32_t(bitpos);
+    assert(rank1 == max_rank1);
+    assert(bitpos == offset_bits);
+    // sel[j] is the last superblock whose rank is <= j * SelectSampleRate
+    if (sel0_num) {
+        size_t sb = 0;
+        for (size_t j = 0; j + 1 < sel0_num; ++j) {
+            size_t r = j * SelectSampleRate;
+            while (sb + 1 < num_super && LineBits * (sb + 1) - super[sb + 1].rank1 <= r)
+                sb++;
+            sel0[j] = uint32_t(sb);
+        }
+        sel0[sel0_num - 1] = uint32_t(num_super - 1);
+    }
+    if (sel1_num) {
+        size_t sb = 0;
+        for (size_t j = 0; j + 1 < sel1_num; ++j) {
+            size_t r = j * SelectSampleRate;
+            while (sb + 1 < num_super && super[sb + 1].rank1 <= r)
+                sb++;
+            sel1[j] = uint32_t(sb);
+        }
+        sel1[sel1_num - 1] = uint32_t(num_super - 1);
+    }
+    m_bits.clear();
+    m_data.swap(data);
+    set_pointers(total);
+}
+
+size_t rank_select_rrr::select0(size_t id) const noexcept {
+    assert(is_built());
+    assert(id < max_rank0());
+    const SuperBlock* super = m_super;
+    size_t lo, hi;
+    if (m_sel0) {
+        lo = m_sel0[id / SelectSampleRate];
+        hi = m_sel0[id / SelectSampleRate + 1] + 1;
+    } else {
+        lo = 0;
+        hi = m_num_super;
+    }
+    while (lo + 1 < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (LineBits * mid - super[mid].rank1 <= id)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    size_t rank = LineBits * lo - super[lo].rank1;
+    size_t offset = super[lo].offset;
+    size_t k = lo * SuperBlocks;
+    for (;; ++k) {
+        size_t c = m_class[k];
+        if (id < rank + BlockBits - c)
+            break;
+        rank += BlockBits - c;
+        offset += s_width[c];
+    }
+    uint64_t w = decode_block(m_class[k], get_offset(offset, s_width[m_class[k]]));
+    return k * BlockBits + UintSelect1(~w, id - rank);
+}
+
+size_t rank_select_rrr::select1(size_t id) const noexcept {
+    assert(is_built());
+    assert(id < m_max_rank1);
+    const SuperBlock* super = m_super;
+    size_t lo, hi;
+    if (m_sel1) {
+        lo = m_sel1[id / SelectSampleRate];
+        hi = m_sel1[id / SelectSampleRate + 1] + 1;
+    } else {
+        lo = 0;
+        hi = m_num_super;
+    }
+    while (lo + 1 < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (super[mid].rank1 <= id)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    size_t rank = super[lo].rank1;
+    size_t offset = super[lo].offset;
+    size_t k = lo * SuperBlocks;
+    for (;; ++k) {
+        size_t c = m_class[k];
+        if (id < rank + c)
+            break;
+        rank += c;
+        offset += s_width[c];
+    }
+    uint64_t w = decode_block(m_class[k], get_offset(offset, s_width[m_class[k]]));
+    return k * BlockBits + UintSelect1(w, id - rank);
+}
+
+// the seq functions of the compressed bits are computed by rank and select
+
+size_t rank_select_rrr::one_seq_len(size_t bitpos) const noexcept {
+    if (!is_built())
+        return m_bits.one_seq_len(bitpos);
+    assert(bitpos < m_size);
+    size_t r0 = rank0(bitpos);
+    return (r0 < max_rank0() ? select0(r0) : m_size) - bitpos;
+}
+
+size_t rank_select_rrr::zero_seq_len(size_t bitpos) const noexcept {
+    if (!is_built())
+        return m_bits.zero_seq_len(bitpos);
+    assert(bitpos < m_size);
+    size_t r1 = rank1(bitpos);
+    return (r1 < m_max_rank1 ? select1(r1) : m_size) - bitpos;
+}
+
+size_t rank_select_rrr::one_seq_revlen(size_t endpos) const noexcept {
+    if (!is_built())
+        return m_bits.one_seq_revlen(endpos);
+    assert(endpos <= m_size);
+    size_t r0 = rank0(endpos);
+    return r0 ? endpos - select0(r0 - 1) - 1 : endpos;
+}
+
+size_t rank_select_rrr::zero_seq_revlen(size_t endpos) const noexcept {
+    if (!is_built())
+        return m_bits.zero_seq_revlen(endpos);
+    assert(endpos <= m_size);
+    size_t r1 = rank1(endpos);
+    return r1 ? endpos - select1(r1 - 1) - 1 : endpos;
+}
+
+} // namespace terark
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "rank_select_basic.hpp"
+#include <terark/valvec.hpp>
+#include <terark/util/cpu_prefetch.hpp>
+
+namespace terark {
+
+// rank_select_rrr, compressed rank select (Raman, Raman and Rao):
+// the bits are split into 64 bit blocks, a block is stored as its popcount
+// (the class, one byte) and the index of the block in all blocks of the
+// same class (the offset, ceil(log2(C(64,class))) bits, bit packed).
+// Blocks of class > 32 store the offset of the complement.
+//
+// Space is about H0 + 0.19 bits per bit(class bytes and superblocks), it is
+// much smaller than plain rank select(1.25 bits per bit) when the ones or
+// the zeros are sparse, such as the is_link and is_term bitmaps of most
+// NestLoudsTrie, and about the same when the density is near 50%.
+//
+// rank1 is one superblock access, a scan of at most 15 class bytes and one
+// block decode, select1 binary searches the superblocks between two select
+// samples, is1 is one block decode, so all operations are slower than the
+// plain rank select classes.
+//
+// Before build_cache, it is a plain bitvector: push_back, set1, resize...
+// and get_word, is1, operator[] work on the plain bits. build_cache
+// compresses the bits into a single contiguous memory block and frees the
+// plain bits, data()/mem_size() and risk_mmap_from save and load it.
+class TERARK_DLL_EXPORT rank_select_rrr {
+public:
+    typedef boost::mpl::false_ is_mixed;
+    typedef uint32_t index_t;
+    static const size_t BlockBits = 64;
+    static const size_t SuperBlocks = 16; // blocks per superblock
+    static const size_t LineBits = BlockBits * SuperBlocks;
+    static const size_t SelectSampleRate = 512;
+    struct Header;
+    struct SuperBlock {
+        uint32_t rank1;  // ones before the superblock
+        uint32_t offset; // bit position of the first offset
+    };
+    struct BinomialTable {
+        uint64_t v[BlockBits][BlockBits/2 + 1]; // C(n, k), k <= 32
+    };
+    static const BinomialTable s_binomial;
+    static const uint8_t s_width[BlockBits + 1]; // offset bits of a class
+
+    rank_select_rrr();
+    explicit rank_select_rrr(size_t n, bool val = false);
+    rank_select_rrr(size_t n, valvec_no_init);
+    rank_select_rrr(size_t n, valvec_reserve);
+    rank_select_rrr(const rank_select_rrr&);
+    rank_select_rrr& operator=(const rank_select_rrr&);
+    rank_select_rrr(rank_select_rrr&&) noexcept;
+    rank_select_rrr& operator=(rank_select_rrr&&) noexcept;
+    ~rank_select_rrr();
+
+    void clear() noexcept;
+    void risk_release_ownership() noexcept;
+    void risk_mmap_from(unsigned char* base, size_t length);
+    void shrink_to_fit() noexcept { m_bits.shrink_to_fit(); }
+    void swap(rank_select_rrr&) noexcept;
+
+    // build phase, before build_cache
+    void push_back(bool val) { assert(!is_built()); m_bits.push_back(val); }
+    void resize(size_t n, bool val = false) { assert(!is_built()); m_bits.resize(n, val); }
+    void resize_fill(size_t n, bool val = false) { assert(!is_built()); m_bits.resize_fill(n, val); }
+    void reserve(size_t n) { assert(!is_built()); m_bits.reserve(n); }
+    void set0(size_t i) { assert(!is_built()); m_bits.set0(i); }
+    void set1(size_t i) { assert(!is_built()); m_bits.set1(i); }
+    void set(size_t i, bool val) { assert(!is_built()); m_bits.set(i, val); }
+    void set1(size_t first, size_t num) { assert(!is_built()); m_bits.set1(first, num); }
+    void set_word(size_t k, bm_uint_t w) { assert(!is_built()); m_bits.set_word(k, w); }
+
+    // compress the bits, speed_select0/1 enable the select samples, else
+    // select binary searches all superblocks, no cache is needed by rank
+    void build_cache(bool speed_select0, bool speed_select1);
+
+    bool is_built() const { return NULL != m_offsets; }
+    size_t size() const { return is_built() ? m_size : m_bits.size(); }
+    size_t num_words() const { return (size() + WordBits - 1) / WordBits; }
+    bool empty() const { return size() == 0; }
+    size_t mem_size() const { return is_built() ? m_data.size() * 8 : m_bits.mem_size(); }
+    const void* data() const { return is_built() ? (const void*)m_data.data() : m_bits.data(); }
+
+    size_t max_rank1() const { return m_max_rank1; }
+    size_t max_rank0() const { return m_size - m_max_rank1; }
+    bool isall0() const { return m_max_rank1 == 0; }
+    bool isall1() const { return m_max_rank1 == m_size; }
+
+    inline bm_uint_t get_word(size_t k) const noexcept;
+    bool is1(size_t i) const noexcept {
+        assert(i < size());
+        return (get_word(i / WordBits) >> (i % WordBits)) & 1;
+    }
+    bool is0(size_t i) const noexcept { return !is1(i); }
+    bool operator[](size_t i) const noexcept { return is1(i); }
+
+    inline size_t rank1(size_t bitpos) const noexcept;
+    size_t rank0(size_t bitpos) const noexcept { return bitpos - rank1(bitpos); }
+    size_t select0(size_t id) const noexcept;
+    size_t select1(size_t id) const noexcept;
+
+    size_t one_seq_len(size_t bitpos) const noexcept;
+    size_t zero_seq_len(size_t bitpos) const noexcept;
+    size_t one_seq_revlen(size_t endpos) const noexcept;
+    size_t zero_seq_revlen(size_t endpos) const noexcept;
+
+    void prefetch_bit(size_t i) const noexcept {
+        TERARK_CPU_PREFETCH(&m_super[i / LineBits]);
+        TERARK_CPU_PREFETCH(&m_class[i / BlockBits]);
+    }
+    void prefetch_rank1(size_t bitpos) const noexcept { prefetch_bit(bitpos); }
+
+    // the NestLoudsTrie interface of static functions: the "bits" and the
+    // "rank cache" are the object itself
+    const rank_select_rrr* bldata() const { return this; }
+    const rank_select_rrr* get_rank_cache() const { return this; }
+    const uint32_t* get_sel0_cache() const { return m_sel0; }
+    const uint32_t* get_sel1_cache() const { return m_sel1; }
+    static bool fast_is0(const rank_select_rrr* rs, size_t i) { return rs->is0(i); }
+    static bool fast_is1(const rank_select_rrr* rs, size_t i) { return rs->is1(i); }
+    static size_t fast_rank0(const rank_select_rrr* rs, const rank_select_rrr*, size_t bitpos)
+        { return rs->rank0(bitpos); }
+    static size_t fast_rank1(const rank_select_rrr* rs, const rank_select_rrr*, size_t bitpos)
+        { return rs->rank1(bitpos); }
+    static size_t fast_select0(const rank_select_rrr* rs, const uint32_t*, const rank_select_rrr*, size_t id)
+        { return rs->select0(id); }
+    static size_t fast_select1(const rank_select_rrr* rs, const uint32_t*, const rank_select_rrr*, size_t id)
+        { return rs->select1(id); }
+
+    static inline uint64_t decode_block(size_t cls, uint64_t offset) noexcept;
+    static uint64_t encode_block(uint64_t w) noexcept;
+
+private:
+    uint64_t get_offset(size_t bitpos, size_t width) const noexcept {
+        if (0 == width)
+            return 0;
+        const uint64_t* p = m_offsets + bitpos / 64;
+        size_t shift = bitpos % 64;
+        uint64_t val = p[0] >> shift;
+        if (shift + width > 64)
+            val |= p[1] << (64 - shift);
+        return val & ~(uint64_t(-1) << width);
+    }
+    // set pointers to the compressed block m_data
+    void set_pointers(size_t length);
+
+    febitvec          m_bits;  // plain bits, used only before build_cache
+    valvec<uint64_t>  m_data;  // the compressed block, may be mmap'ed
+    const SuperBlock* m_super; // num_super + 1, the last is the sentinel
+    const uint32_t*   m_sel0;  // superblock index, may be NULL
+    const uint32_t*   m_sel1;  // superblock index, may be NULL
+    const uint8_t*    m_class;
+    const uint64_t*   m_offsets;
+    size_t            m_size;
+    size_t            m_max_rank1;
+    size_t            m_num_super;
+};
+
+inline uint64_t
+rank_select_rrr::decode_block(size_t cls, uint64_t offset) noexcept {
+    if (0 == cls)
+        return 0;
+    if (BlockBits == cls)
+        return uint64_t(-1);
+    uint64_t flip = 0;
+    if (cls > BlockBits / 2) {
+        cls = BlockBits - cls;
+        flip = uint64_t(-1);
+    }
+    uint64_t w;
+    if (1 == cls) {
+        w = uint64_t(1) << offset;
+    }
+    else {
+        // the largest n with C(n, cls) <= offset is the highest 1
+        w = 0;
+        for (size_t n = BlockBits - 1; cls; --n) {
+            uint64_t c = s_binomial.v[n][cls];
+            if (offset >= c) {
+                offset -= c;
+                w |= uint64_t(1) << n;
+                cls--;
+            }
+        }
+    }
+    return w ^ flip;
+}
+
+inline bm_uint_t rank_select_rrr::get_word(size_t k) const noexcept {
+    if (terark_unlikely(!is_built()))
+        return m_bits.get_word(k);
+    assert(k < (m_size + BlockBits - 1) / BlockBits);
+    const uint8_t* cls = m_class;
+    size_t sb = k / SuperBlocks;
+    size_t offset = m_super[sb].offset;
+    for (size_t b = sb * SuperBlocks; b < k; ++b)
+        offset += s_width[cls[b]];
+    return decode_block(cls[k], get_offset(offset, s_width[cls[k]]));
+}
+
+inline size_t rank_select_rrr::rank1(size_t bitpos) const noexcept {
+    assert(is_built());
+    assert(bitpos <= m_size);
+    const uint8_t* cls = m_class;
+    size_t sb = bitpos / LineBits;
+    size_t rank = m_super[sb].rank1;
+    size_t offset = m_super[sb].offset;
+    size_t k = bitpos / BlockBits;
+    for (size_t b = sb * SuperBlocks; b < k; ++b) {
+        rank += cls[b];
+        offset += s_width[cls[b]];
+    }
+    if (bitpos % BlockBits) {
+        uint64_t w = decode_block(cls[k], get_offset(offset, s_width[cls[k]]));
+        rank += fast_popcount_trail(w, bitpos % BlockBits);
+    }
+    return rank;
+}
+
+} // namespace terark
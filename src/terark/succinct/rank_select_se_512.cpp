@@ -1,4 +1,6 @@
 #include "rank_select_se_512.hpp"
+#include "rank_select_parallel.hpp"
+#include <terark/util/cpu_prefetch.hpp>
 
 #define GUARD_MAX_RANK(B, rank) \
     assert(rank < m_max_rank##B);
@@ -155,6 +157,12 @@ void rank_select_se_512_tpl<rank_cache_base_t>::swap(rank_select_se_512_tpl& y)
 
 template<class rank_cache_base_t>
 void rank_select_se_512_tpl<rank_cache_base_t>::build_cache(bool speed_select0, bool speed_select1) {
+    build_cache_parallel(speed_select0, speed_select1, 1);
+}
+
+template<class rank_cache_base_t>
+void rank_select_se_512_tpl<rank_cache_base_t>::
+build_cache_parallel(bool speed_select0, bool speed_select1, size_t num_threads) {
     if (sizeof(rank_cache_base_t) == 4)
         rank_select_check_overflow(m_size, > , rank_select_se_512);
     if (NULL == m_words) return;
@@ -165,21 +173,30 @@ void rank_select_se_512_tpl<rank_cache_base_t>::build_cache(bool speed_select0,
     bits_range_set0(m_words, m_size, ceiled_bits);
     RankCache512* rank_cache = (RankCache512*)(m_words + ceiled_bits/WordBits);
     uint64_t* pBit64 = (uint64_t*)m_words;
-    size_t Rank1 = 0;
-    for(size_t i = 0; i < nlines; ++i) {
-        size_t r = 0;
-        uint64_t rela = 0;
-        BOOST_STATIC_ASSERT(LineBits/64 == 8);
-        for(size_t j = 0; j < (LineBits/64); ++j) {
-            r += fast_popcount(pBit64[i*(LineBits/64) + j]);
-            rela |= uint64_t(r) << (j*9); // last 'r' will not be in 'rela'
-        //    printf("i = %zd, j = %zd, r = %zd\n", i, j, r);
+    num_threads = rank_select_parallel::get_threads(num_threads, nlines);
+    size_t Rank1 = rank_select_parallel::build_rank_cache(nlines, num_threads,
+    [=](size_t beg, size_t end) {
+        size_t Rank1 = 0;
+        for(size_t i = beg; i < end; ++i) {
+            size_t r = 0;
+            uint64_t rela = 0;
+            BOOST_STATIC_ASSERT(LineBits/64 == 8);
+            for(size_t j = 0; j < (LineBits/64); ++j) {
+                r += fast_popcount(pBit64[i*(LineBits/64) + j]);
+                rela |= uint64_t(r) << (j*9); // last 'r' will not be in 'rela'
+            //    printf("i = %zd, j = %zd, r = %zd\n", i, j, r);
+            }
+            rela &= uint64_t(-1) >> 1; // set unused bit as zero
+            rank_cache[i].base = index_t(Rank1);
+            rank_cache[i].rela = rela;
+            Rank1 += r;
         }
-        rela &= uint64_t(-1) >> 1; // set unused bit as zero
-        rank_cache[i].base = index_t(Rank1);
-        rank_cache[i].rela = rela;
-        Rank1 += r;
-    }
+        return Rank1;
+    },
+    [=](size_t beg, size_t end, size_t base) {
+        for(size_t i = beg; i < end; ++i)
+            rank_cache[i].base += index_t(base);
+    });
     rank_cache[nlines] = RankCache512(index_t(Rank1));
     m_max_rank0 = m_size - Rank1;
     m_max_rank1 = Rank1;
@@ -203,24 +220,18 @@ void rank_select_se_512_tpl<rank_cache_base_t>::build_cache(bool speed_select0,
     index_t* select_index = (index_t*)(rank_cache + nlines + 1);
     if (speed_select0) {
         index_t* sel0_cache = select_index;
-        sel0_cache[0] = 0;
-        for(size_t j = 1; j < select0_slots; ++j) {
-            size_t k = sel0_cache[j - 1];
-            while (k * LineBits - rank_cache[k].base < LineBits * j) ++k;
-            sel0_cache[j] = k;
-        }
+        rank_select_parallel::build_select_cache(sel0_cache, select0_slots,
+            LineBits, nlines, num_threads,
+            [=](size_t k) { return k * LineBits - size_t(rank_cache[k].base); });
         sel0_cache[select0_slots] = nlines;
         m_sel0_cache = sel0_cache;
         select_index += select0_slots + 1;
     }
     if (speed_select1) {
         index_t* sel1_cache = select_index;
-        sel1_cache[0] = 0;
-        for(size_t j = 1; j < select1_slots; ++j) {
-            size_t k = sel1_cache[j - 1];
-            while (rank_cache[k].base < LineBits * j) ++k;
-            sel1_cache[j] = k;
-        }
+        rank_select_parallel::build_select_cache(sel1_cache, select1_slots,
+            LineBits, nlines, num_threads,
+            [=](size_t k) { return size_t(rank_cache[k].base); });
         sel1_cache[select1_slots] = nlines;
         m_sel1_cache = sel1_cache;
     }
@@ -353,6 +364,25 @@ size_t rank_select_se_512_tpl<rank_cache_base_t>::select1(size_t Rank1) const no
 #undef select1_nth64
 }
 
+template<class rank_cache_base_t>
+void rank_select_se_512_tpl<rank_cache_base_t>::
+select1_batch(const size_t* ranks, size_t n, size_t* out) const noexcept {
+    // load the select1 cache of a group, then prefetch the rank cache at
+    // its lower bound, which is the line of the result in most cases
+    for (size_t beg = 0; beg < n; beg += RankSelectBatchGroup) {
+        size_t end = std::min(n, beg + RankSelectBatchGroup);
+        if (m_sel1_cache) {
+            for (size_t i = beg; i < end; ++i) {
+                size_t lo = m_sel1_cache[ranks[i] / LineBits];
+                TERARK_CPU_PREFETCH(&m_rank_cache[lo]);
+            }
+        }
+        for (size_t i = beg; i < end; ++i) {
+            out[i] = select1(ranks[i]);
+        }
+    }
+}
+
 template class TERARK_DLL_EXPORT rank_select_se_512_tpl<uint32_t>;
 template class TERARK_DLL_EXPORT rank_select_se_512_tpl<uint64_t>;
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "rank_select_basic.hpp"
+#include "rank_select_batch.hpp"
 
 namespace terark {
 
@@ -31,6 +32,9 @@ public:
 
     void swap(rank_select_se_512_tpl&) noexcept;
     void build_cache(bool speed_select0, bool speed_select1);
+    /// same result as build_cache, by num_threads threads, 0 means auto
+    void build_cache_parallel(bool speed_select0, bool speed_select1,
+                              size_t num_threads = 0);
     size_t mem_size() const { return m_capacity / 8; }
     inline size_t rank1(size_t bitpos) const noexcept;
     inline size_t rank0(size_t bitpos) const noexcept;
@@ -38,6 +42,9 @@ public:
     size_t select1(size_t id) const noexcept;
     size_t max_rank1() const { return m_max_rank1; }
     size_t max_rank0() const { return m_max_rank0; }
+    void rank1_batch(const size_t* pos, size_t n, size_t* out) const noexcept
+      { rank_select_rank1_batch_generic(*this, pos, n, out); }
+    void select1_batch(const size_t* ranks, size_t n, size_t* out) const noexcept;
     bool isall0() const { return m_max_rank1 == 0; }
     bool isall1() const { return m_max_rank0 == 0; }
 protected:
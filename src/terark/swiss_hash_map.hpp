@@ -0,0 +1,1065 @@
+#pragma once
+
+#include "gold_hash_map.hpp"
+#include "fstring.hpp"
+#include "valvec.hpp"
+#include "bitmap.hpp"
+#include <terark/util/cpu_prefetch.hpp>
+#include <terark/util/throw.hpp>
+#include <boost/current_function.hpp>
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+	#include <malloc.h> // _aligned_malloc
+#endif
+
+#if defined(__GNUC__) && __GNUC_MINOR__ + 1000 * __GNUC__ > 7000
+  #pragma GCC diagnostic push
+  #pragma GCC diagnostic ignored "-Wclass-memaccess" // which version support?
+#endif
+
+namespace terark {
+
+/// Open addressing hash index of element links(ids), in the manner of
+/// Swiss tables: each slot has a control byte which is kEmpty or the 7 bit
+/// tag of the hash, a probe compares the tag with the control bytes of a
+/// group by one SSE2 compare.
+///
+/// A group is one cache line: 16 control bytes and the links of its slots,
+/// 12 slots for 32 bit links. The last control byte counts the keys which
+/// have probed past the group(as F14), a probe stops at the first group
+/// whose count is 0 instead of the first group which has an empty slot, so
+/// a negative lookup usually touches one cache line even at load factor
+/// 0.875, a positive lookup the same line and the element, and erase needs
+/// no tombstones.
+///
+/// The index does not own the elements, the caller passes the equality
+/// test `eq(link)`, and `for_each(emit)` for rehash, which calls
+/// `emit(link, hash)` for each live element, in the element order, so a
+/// rehash reads the elements sequentially.
+template<class LinkTp>
+class swiss_hash_index {
+public:
+	static const size_t GroupSize = std::min<size_t>(15, (64 - 16) / sizeof(LinkTp));
+	static const uint8_t kEmpty    = 0x80;
+	static const uint8_t kSentinel = 0xFF; // unused control bytes
+	static const uint8_t kMaxOverflow = 0x7F; // sticky until rehash
+	static const size_t  npos = size_t(-1);
+
+	struct alignas(64) Group {
+		uint8_t ctrl[16]; // ctrl[15] is 0x80 | overflow count
+		LinkTp  link[GroupSize];
+	};
+
+private:
+	Group*   m_groups;
+	size_t   m_group_mask;
+	size_t   m_size;
+	size_t   m_max_fill;
+	uint8_t  m_load_factor; // real load factor = m_load_factor / 256
+
+	static Group* empty_group() {
+		static const Group group = make_empty_group();
+		return const_cast<Group*>(&group); // never be written
+	}
+	static Group make_empty_group() {
+		Group group;
+		memset(&group, 0, sizeof(group));
+		init_ctrl(group);
+		return group;
+	}
+	static void init_ctrl(Group& group) {
+		memset(group.ctrl, kEmpty, GroupSize);
+		memset(group.ctrl + GroupSize, kSentinel, 15 - GroupSize);
+		group.ctrl[15] = 0x80;
+	}
+	static size_t overflow(const Group& group) { return group.ctrl[15] & 0x7F; }
+	bool is_empty_table() const { return empty_group() == m_groups; }
+
+	void init() {
+		m_groups = empty_group();
+		m_group_mask = 0;
+		m_size = 0;
+		m_max_fill = 0;
+	}
+	// msvc has no aligned_alloc, memory of _aligned_malloc must be freed
+	// by _aligned_free
+	static Group* groups_alloc(size_t groups) {
+	#if defined(_MSC_VER)
+		return (Group*)_aligned_malloc(sizeof(Group) * groups, alignof(Group));
+	#else
+		return (Group*)aligned_alloc(alignof(Group), sizeof(Group) * groups);
+	#endif
+	}
+	static void groups_free(Group* mem) {
+	#if defined(_MSC_VER)
+		_aligned_free(mem);
+	#else
+		::free(mem);
+	#endif
+	}
+	void destroy() {
+		if (!is_empty_table())
+			groups_free(m_groups);
+	}
+	size_t max_fill(size_t groups) const {
+		size_t cap = GroupSize * groups;
+		return std::min(cap - 1, cap * m_load_factor / 256);
+	}
+	void alloc(size_t groups) {
+		assert((groups & (groups - 1)) == 0);
+		Group* mem = groups_alloc(groups);
+		if (NULL == mem) {
+			TERARK_DIE("aligned alloc(%zd)", sizeof(Group) * groups);
+		}
+		for (size_t g = 0; g < groups; ++g)
+			init_ctrl(mem[g]);
+		m_groups = mem;
+		m_group_mask = groups - 1;
+		m_max_fill = max_fill(groups);
+	}
+	uint8_t& ctrl(size_t pos) const { return m_groups[pos / GroupSize].ctrl[pos % GroupSize]; }
+	LinkTp&  slot(size_t pos) const { return m_groups[pos / GroupSize].link[pos % GroupSize]; }
+
+public:
+	/// the tag is the low 7 bits, the group is from the higher bits
+	static size_t mix(size_t h) {
+		uint64_t m = uint64_t(h) * 0x9E3779B97F4A7C15ull;
+		return size_t(m ^ (m >> 32));
+	}
+	typedef uint32_t mask_t;
+	/// bits of the slots whose control byte is ch
+	static mask_t match(const uint8_t* ctrl, uint8_t ch) {
+	#if defined(__SSE2__)
+		__m128i g = _mm_load_si128((const __m128i*)ctrl);
+		mask_t bits = _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(char(ch))));
+	#else
+		mask_t bits = 0;
+		for (size_t i = 0; i < 16; ++i)
+			bits |= mask_t(ctrl[i] == ch) << i;
+	#endif
+		return bits & ((mask_t(1) << GroupSize) - 1);
+	}
+
+	swiss_hash_index() { m_load_factor = 224; init(); }
+	swiss_hash_index(const swiss_hash_index& y) {
+		m_load_factor = y.m_load_factor;
+		if (y.is_empty_table()) {
+			init();
+			return;
+		}
+		size_t groups = y.m_group_mask + 1;
+		alloc(groups);
+		memcpy(m_groups, y.m_groups, sizeof(Group) * groups);
+		m_size = y.m_size;
+	}
+	swiss_hash_index& operator=(const swiss_hash_index& y) {
+		if (this != &y) {
+			swiss_hash_index(y).swap(*this);
+		}
+		return *this;
+	}
+	swiss_hash_index(swiss_hash_index&& y) noexcept {
+		memcpy((void*)this, &y, sizeof(*this));
+		y.init();
+	}
+	swiss_hash_index& operator=(swiss_hash_index&& y) noexcept {
+		if (this != &y) {
+			destroy();
+			memcpy((void*)this, &y, sizeof(*this));
+			y.init();
+		}
+		return *this;
+	}
+	~swiss_hash_index() { destroy(); }
+
+	void swap(swiss_hash_index& y) noexcept {
+		std::swap(m_groups, y.m_groups);
+		std::swap(m_group_mask, y.m_group_mask);
+		std::swap(m_size, y.m_size);
+		std::swap(m_max_fill, y.m_max_fill);
+		std::swap(m_load_factor, y.m_load_factor);
+	}
+	void clear() { destroy(); init(); }
+
+	/// keep memory
+	void erase_all() {
+		if (!is_empty_table()) {
+			for (size_t g = 0, n = m_group_mask + 1; g < n; ++g)
+				init_ctrl(m_groups[g]);
+			m_size = 0;
+		}
+	}
+
+	size_t size() const { return m_size; }
+	size_t capacity() const { return is_empty_table() ? 0 : GroupSize * (m_group_mask + 1); }
+	size_t mem_size() const { return is_empty_table() ? 0 : sizeof(Group) * (m_group_mask + 1); }
+	double get_load_factor() const { return m_load_factor / 256.0; }
+	/// fact is in [0.5, 0.875], takes effect on next rehash
+	void set_load_factor(double fact) {
+		if (fact < 0.5 || fact > 0.875) {
+			THROW_STD(invalid_argument, "load factor = %f is not in [0.5, 0.875]", fact);
+		}
+		m_load_factor = uint8_t(256 * fact);
+	}
+	LinkTp link(size_t pos) const {
+		assert(pos < capacity());
+		assert(ctrl(pos) < kEmpty);
+		return slot(pos);
+	}
+	void prefetch(size_t h) const {
+		size_t g = (mix(h) >> 7) & m_group_mask;
+		TERARK_CPU_PREFETCH(m_groups + g);
+	}
+
+	/// return the slot pos of the link which eq(link) is true, or npos
+	template<class Equal>
+	size_t find_pos(size_t h, Equal eq) const {
+		const size_t m = mix(h);
+		const uint8_t tag = uint8_t(m & 0x7F);
+		size_t g = (m >> 7) & m_group_mask;
+		for (size_t step = 1; ; ++step) {
+			const Group& group = m_groups[g];
+			for (mask_t bits = match(group.ctrl, tag); bits; bits &= bits - 1) {
+				size_t i = fast_ctz32(bits);
+				if (eq(group.link[i]))
+					return GroupSize * g + i;
+			}
+			if (0 == overflow(group))
+				return npos;
+			g = (g + step) & m_group_mask;
+			TERARK_ASSERT_LE(step, m_group_mask + 1);
+		}
+	}
+	/// return the link which eq(link) is true, or npos
+	template<class Equal>
+	size_t find(size_t h, Equal eq) const {
+		const size_t m = mix(h);
+		const uint8_t tag = uint8_t(m & 0x7F);
+		size_t g = (m >> 7) & m_group_mask;
+		for (size_t step = 1; ; ++step) {
+			const Group& group = m_groups[g];
+			for (mask_t bits = match(group.ctrl, tag); bits; bits &= bits - 1) {
+				LinkTp link = group.link[fast_ctz32(bits)];
+				if (eq(link))
+					return link;
+			}
+			if (0 == overflow(group))
+				return npos;
+			g = (g + step) & m_group_mask;
+			TERARK_ASSERT_LE(step, m_group_mask + 1);
+		}
+	}
+
+private:
+	// the table has no such key, put it in the first group which has an
+	// empty slot, count it as overflow of the full groups before it
+	void insert_new(size_t m, LinkTp link) {
+		size_t g = (m >> 7) & m_group_mask;
+		for (size_t step = 1; ; ++step) {
+			Group& group = m_groups[g];
+			mask_t bits = match(group.ctrl, kEmpty);
+			if (bits) {
+				size_t i = fast_ctz32(bits);
+				group.ctrl[i] = uint8_t(m & 0x7F);
+				group.link[i] = link;
+				return;
+			}
+			if (overflow(group) < kMaxOverflow)
+				group.ctrl[15]++;
+			g = (g + step) & m_group_mask;
+			TERARK_ASSERT_LE(step, m_group_mask + 1);
+		}
+	}
+
+public:
+	/// called before the new element is added, then insert(h, link)
+	template<class ForEach>
+	void prepare_insert(ForEach for_each) {
+		if (terark_unlikely(m_size >= m_max_fill))
+			grow(for_each);
+	}
+	/// the key must not be in the table
+	void insert(size_t h, LinkTp link) {
+		assert(m_size < m_max_fill);
+		insert_new(mix(h), link);
+		m_size++;
+	}
+	/// a pos got by find_pos(h, ...)
+	void erase_at(size_t pos, size_t h) {
+		assert(pos < capacity());
+		assert(ctrl(pos) < kEmpty);
+		const size_t m = mix(h);
+		assert(ctrl(pos) == (m & 0x7F));
+		size_t g = (m >> 7) & m_group_mask;
+		for (size_t step = 1; g != pos / GroupSize; ++step) {
+			Group& group = m_groups[g];
+			assert(overflow(group) > 0);
+			if (overflow(group) < kMaxOverflow)
+				group.ctrl[15]--;
+			g = (g + step) & m_group_mask;
+			TERARK_ASSERT_LE(step, m_group_mask + 1);
+		}
+		ctrl(pos) = kEmpty;
+		m_size--;
+	}
+	/// after links are changed by the caller, such as compaction
+	template<class MapLink>
+	void remap_links(MapLink map_link) {
+		for (size_t pos = 0, n = capacity(); pos < n; ++pos) {
+			if (ctrl(pos) < kEmpty)
+				slot(pos) = LinkTp(map_link(slot(pos)));
+		}
+	}
+
+	/// capacity for cap elements without rehash
+	template<class ForEach>
+	void reserve(size_t cap, ForEach for_each) {
+		size_t groups = 1;
+		while (max_fill(groups) < std::max(cap, m_size))
+			groups *= 2;
+		if (is_empty_table() || groups != m_group_mask + 1)
+			rehash(groups, for_each);
+	}
+	/// also resets sticky overflow counts
+	template<class ForEach>
+	void rehash(size_t groups, ForEach for_each) {
+		TERARK_VERIFY_EQ((groups & (groups - 1)), 0);
+		TERARK_VERIFY_LE(m_size, max_fill(groups));
+		destroy();
+		alloc(groups);
+		size_t size = 0;
+		for_each([this,&size](size_t link, size_t h) {
+			insert_new(mix(h), LinkTp(link));
+			size++;
+		});
+		m_size = size;
+	}
+	template<class ForEach>
+	terark_no_inline void grow(ForEach for_each) {
+		rehash(is_empty_table() ? 1 : 2 * (m_group_mask + 1), for_each);
+	}
+};
+
+/// Fixed key hash table with the same api as gold_hash_tab, the elements
+/// are stored by NodeLayout in insertion order(erased slots are reused by
+/// the freelist), indexed by swiss_hash_index instead of bucket chains.
+template< class Key
+		, class Elem = Key
+		, class HashEqual = hash_and_equal<Key, DEFAULT_HASH_FUNC<Key>, std::equal_to<Key> >
+		, class KeyExtractor = terark_identity<Elem>
+		, class NodeLayout = node_layout<Elem, unsigned/*LinkTp*/ >
+		>
+class swiss_hash_tab : dummy_bucket<typename NodeLayout::link_t>, HashEqual, KeyExtractor
+{
+#define MyKeyExtractor static_cast<const KeyExtractor&>(*this)
+protected:
+	typedef typename NodeLayout::link_t LinkTp;
+	typedef typename NodeLayout::copy_strategy CopyStrategy;
+	using dummy_bucket<LinkTp>::tail;
+	using dummy_bucket<LinkTp>::delmark;
+
+	struct IsNotFree {
+		bool operator()(LinkTp link_val) const { return delmark != link_val; }
+	};
+
+public:
+	typedef typename ParamPassType<Key>::type key_param_pass_t;
+
+	class iterator; friend class iterator;
+	class iterator {
+	public:
+		typedef Elem  value_type;
+		typedef swiss_hash_tab* OwnerPtr;
+	#define ClassIterator iterator
+	#include "gold_hash_map_iterator.hpp"
+	};
+	class const_iterator; friend class const_iterator;
+	class const_iterator {
+	public:
+		typedef const Elem  value_type;
+		const_iterator(const iterator& y)
+		  : owner(y.get_owner()), index(y.get_index()) {}
+		typedef const swiss_hash_tab* OwnerPtr;
+	#define ClassIterator const_iterator
+	#include "gold_hash_map_iterator.hpp"
+	};
+	      iterator get_iter(size_t idx)       { return       iterator(this, idx); }
+	const_iterator get_iter(size_t idx) const { return const_iterator(this, idx); }
+
+	typedef ptrdiff_t difference_type;
+	typedef size_t  size_type;
+	typedef Elem  value_type;
+	typedef Elem& reference;
+	typedef const Key key_type;
+	typedef LinkTp link_t;
+
+protected:
+	NodeLayout m_nl;
+	swiss_hash_index<LinkTp> m_index;
+	LinkTp  nElem;
+	LinkTp  maxElem;
+	LinkTp  freelist_head;
+	LinkTp  freelist_size;
+
+	void init() {
+		BOOST_STATIC_ASSERT(sizeof(LinkTp) <= sizeof(Elem));
+		new(&m_nl)NodeLayout();
+		nElem = 0;
+		maxElem = 0;
+		freelist_head = tail;
+		freelist_size = 0;
+	}
+	void destroy() {
+		NodeLayout nl = m_nl;
+		if (!nl.is_null()) {
+			if (!boost::has_trivial_destructor<Elem>::value) {
+				for (size_t i = nElem; i > 0; --i)
+					if (delmark != nl.link(i-1))
+						nl.data(i-1).~Elem();
+			}
+			m_nl.free();
+		}
+	}
+	auto for_each_hash() const {
+		return [this](auto emit) {
+			NodeLayout nl = m_nl;
+			for (size_t i = 0, n = nElem; i < n; ++i) {
+				if (delmark != nl.link(i))
+					emit(i, size_t(HashEqual::hash(MyKeyExtractor(nl.data(i)))));
+			}
+		};
+	}
+	template<class CompatibleKey>
+	auto get_equal_func(const CompatibleKey& key) const {
+		return [this,&key](size_t link) {
+			TERARK_ASSERT_LT(link, nElem);
+			return HashEqual::equal(key, MyKeyExtractor(m_nl.data(link)));
+		};
+	}
+
+public:
+	swiss_hash_tab() { init(); }
+	explicit swiss_hash_tab(HashEqual he, KeyExtractor keyExtr = KeyExtractor())
+	  : HashEqual(he), KeyExtractor(keyExtr) { init(); }
+	explicit swiss_hash_tab(size_t cap, HashEqual he = HashEqual()
+						  , KeyExtractor keyExtr = KeyExtractor())
+	  : HashEqual(he), KeyExtractor(keyExtr) {
+		init();
+		reserve(cap);
+	}
+	swiss_hash_tab(std::initializer_list<Elem> list, HashEqual he = HashEqual()
+				 , KeyExtractor keyExtr = KeyExtractor())
+	  : HashEqual(he), KeyExtractor(keyExtr) {
+		init();
+		reserve(list.size());
+		for (auto& e : list)
+			this->insert_i(e);
+	}
+	swiss_hash_tab(const swiss_hash_tab& y)
+	  : HashEqual(y), KeyExtractor(y), m_index(y.m_index) {
+		init();
+		if (0 == y.nElem)
+			return;
+		m_nl.reserve(0, y.nElem);
+		if (!boost::has_trivial_copy<Elem>::value && y.freelist_size)
+			node_layout_copy_cons(m_nl, y.m_nl, y.nElem, IsNotFree());
+		else
+			node_layout_copy_cons(m_nl, y.m_nl, y.nElem);
+		nElem = maxElem = y.nElem;
+		freelist_head = y.freelist_head;
+		freelist_size = y.freelist_size;
+	}
+	swiss_hash_tab& operator=(const swiss_hash_tab& y) {
+		if (this != &y)
+			swiss_hash_tab(y).swap(*this);
+		return *this;
+	}
+	swiss_hash_tab(swiss_hash_tab&& y) noexcept
+	  : HashEqual(std::move(y)), KeyExtractor(std::move(y))
+	  , m_index(std::move(y.m_index)) {
+		m_nl = y.m_nl;
+		nElem = y.nElem;
+		maxElem = y.maxElem;
+		freelist_head = y.freelist_head;
+		freelist_size = y.freelist_size;
+		y.init();
+	}
+	swiss_hash_tab& operator=(swiss_hash_tab&& y) noexcept {
+		if (this != &y) {
+			this->~swiss_hash_tab();
+			new(this)swiss_hash_tab(std::move(y));
+		}
+		return *this;
+	}
+	~swiss_hash_tab() { destroy(); }
+
+	void swap(swiss_hash_tab& y) {
+		std::swap(m_nl, y.m_nl);
+		m_index.swap(y.m_index);
+		std::swap(nElem, y.nElem);
+		std::swap(maxElem, y.maxElem);
+		std::swap(freelist_head, y.freelist_head);
+		std::swap(freelist_size, y.freelist_size);
+		std::swap(static_cast<HashEqual&>(*this), static_cast<HashEqual&>(y));
+		std::swap(static_cast<KeyExtractor&>(*this), static_cast<KeyExtractor&>(y));
+	}
+
+	const HashEqual& getHashEqual() const { return *this; }
+	const KeyExtractor& getKeyExtractor() const { return *this; }
+
+	void clear() {
+		destroy();
+		init();
+		m_index.clear();
+	}
+	// keep memory
+	void erase_all() {
+		if (!boost::has_trivial_destructor<Elem>::value) {
+			for (size_t i = nElem; i > 0; --i)
+				if (delmark != m_nl.link(i-1))
+					m_nl.data(i-1).~Elem();
+		}
+		m_index.erase_all();
+		nElem = 0;
+		freelist_head = tail;
+		freelist_size = 0;
+	}
+
+	void reserve(size_t cap) {
+		reserve_nodes(cap);
+		m_index.reserve(cap, for_each_hash());
+	}
+	void reserve_nodes(size_t cap) {
+		TERARK_VERIFY_GE(cap, nElem);
+		TERARK_VERIFY_LE(cap, delmark);
+		if (cap != (size_t)maxElem) {
+			if (freelist_size)
+				m_nl.reserve(nElem, cap, IsNotFree());
+			else
+				m_nl.reserve(nElem, cap);
+			maxElem = LinkTp(cap);
+		}
+	}
+	void shrink_to_fit() {
+		if (nElem < maxElem) reserve_nodes(nElem);
+	}
+	void set_load_factor(double fact) { m_index.set_load_factor(fact); }
+	double get_load_factor() const { return m_index.get_load_factor(); }
+	const swiss_hash_index<LinkTp>& get_index() const { return m_index; }
+
+	bool   empty() const { return nElem == freelist_size; }
+	size_t  size() const { return nElem -  freelist_size; }
+	size_t beg_i() const {
+		if (freelist_size == nElem)
+			return nElem;
+		else if (freelist_size && delmark == m_nl.link(0))
+			return next_i(0);
+		else
+			return 0;
+	}
+	size_t  end_i() const { return nElem; }
+	size_t next_i(size_t idx) const {
+		size_t n = nElem;
+		TERARK_ASSERT_LT(idx, n);
+		do ++idx; while (idx < n && delmark == m_nl.link(idx));
+		return idx;
+	}
+	size_t prev_i(size_t idx) const {
+		TERARK_ASSERT_GT(idx, 0);
+		TERARK_ASSERT_LE(idx, nElem);
+		do --idx; while (idx > 0 && delmark == m_nl.link(idx));
+		return idx;
+	}
+	size_t capacity() const { return maxElem; }
+	size_t delcnt() const { return freelist_size; }
+	bool is_deleted(size_t idx) const {
+		TERARK_ASSERT_LT(idx, nElem);
+		return delmark == m_nl.link(idx);
+	}
+	bool freelist_is_empty() const { return 0 == freelist_size; }
+
+	      iterator  begin()       { return get_iter(beg_i()); }
+	const_iterator  begin() const { return get_iter(beg_i()); }
+	const_iterator cbegin() const { return get_iter(beg_i()); }
+	      iterator  end()       { return get_iter(nElem); }
+	const_iterator  end() const { return get_iter(nElem); }
+	const_iterator cend() const { return get_iter(nElem); }
+
+	template<class CompatibleObject>
+	std::pair<iterator, bool> insert(const CompatibleObject& obj) {
+		std::pair<size_t, bool> ib = insert_i(obj);
+		return std::pair<iterator, bool>(get_iter(ib.first), ib.second);
+	}
+	template<class... Args>
+	std::pair<iterator, bool> emplace(Args&&... args) {
+		std::pair<size_t, bool> ib = insert_i(value_type(std::forward<Args>(args)...));
+		return std::pair<iterator, bool>(get_iter(ib.first), ib.second);
+	}
+	      iterator find(key_param_pass_t key)       { return get_iter(find_i(key)); }
+	const_iterator find(key_param_pass_t key) const { return get_iter(find_i(key)); }
+
+	template<class CompatibleObject>
+	std::pair<size_t, bool> insert_i(const CompatibleObject& obj) {
+		return lazy_insert_elem_i(MyKeyExtractor(obj), CopyConsFunc<CompatibleObject>(obj));
+	}
+	std::pair<size_t, bool> insert_i(const Elem& obj) {
+		return lazy_insert_elem_i(MyKeyExtractor(obj), CopyConsFunc<Elem>(obj));
+	}
+	template<class ConsElem>
+	std::pair<size_t, bool>
+	lazy_insert_elem_i(key_param_pass_t key, ConsElem cons_elem) {
+		const size_t h = size_t(HashEqual::hash(key));
+		size_t found = m_index.find(h, get_equal_func(key));
+		if (m_index.npos != found)
+			return std::make_pair(found, false);
+		m_index.prepare_insert(for_each_hash());
+		size_t slot = slot_alloc();
+		cons_elem(&m_nl.data(slot)); // must success
+		m_index.insert(h, LinkTp(slot));
+		return std::make_pair(slot, true);
+	}
+
+	size_t find_i(key_param_pass_t key) const {
+		size_t idx = m_index.find(size_t(HashEqual::hash(key)), get_equal_func(key));
+		return m_index.npos == idx ? nElem : idx;
+	}
+	template<class CompatibleKey>
+	size_t find_i(const CompatibleKey& key) const {
+		size_t idx = m_index.find(size_t(HashEqual::hash(key)), get_equal_func(key));
+		return m_index.npos == idx ? nElem : idx;
+	}
+	size_t count(key_param_pass_t key) const { return find_i(key) != nElem ? 1 : 0; }
+	bool  exists(key_param_pass_t key) const { return find_i(key) != nElem; }
+	bool contains(key_param_pass_t key) const { return find_i(key) != nElem; }
+
+	// return erased element count
+	size_t erase(key_param_pass_t key) {
+		const size_t h = size_t(HashEqual::hash(key));
+		size_t pos = m_index.find_pos(h, get_equal_func(key));
+		if (m_index.npos == pos)
+			return 0;
+		size_t slot = m_index.link(pos);
+		m_index.erase_at(pos, h);
+		slot_free(slot);
+		return 1;
+	}
+	void erase_i(size_t idx) {
+		TERARK_ASSERT_LT(idx, nElem);
+		TERARK_ASSERT_NE(delmark, m_nl.link(idx));
+		key_param_pass_t key = MyKeyExtractor(m_nl.data(idx));
+		const size_t h = size_t(HashEqual::hash(key));
+		size_t pos = m_index.find_pos(h, [idx](size_t link) { return link == idx; });
+		TERARK_VERIFY_NE(pos, m_index.npos);
+		m_index.erase_at(pos, h);
+		slot_free(idx);
+	}
+
+	// if return non-zero, all permanent id/index are invalidated
+	size_t revoke_deleted() {
+		if (0 == freelist_size)
+			return 0;
+		NodeLayout nl = m_nl;
+		valvec<LinkTp> newIdx(nElem, valvec_no_init());
+		size_t i = 0;
+		for (size_t j = 0, n = nElem; j < n; ++j) {
+			if (delmark == nl.link(j))
+				continue;
+			if (i != j) {
+				CopyStrategy::move_cons(&nl.data(i), nl.data(j));
+				nl.data(j).~Elem();
+			}
+			nl.link(i) = tail;
+			newIdx[j] = LinkTp(i++);
+		}
+		size_t erased = nElem - i;
+		m_index.remap_links([&](size_t link) { return newIdx[link]; });
+		nElem = LinkTp(i);
+		freelist_head = tail;
+		freelist_size = 0;
+		return erased;
+	}
+
+	const Key& key(size_t idx) const {
+		TERARK_ASSERT_LT(idx, nElem);
+		TERARK_ASSERT_NE(delmark, m_nl.link(idx));
+		return MyKeyExtractor(m_nl.data(idx));
+	}
+	const Elem& elem_at(size_t idx) const {
+		TERARK_ASSERT_LT(idx, nElem);
+		TERARK_ASSERT_NE(delmark, m_nl.link(idx));
+		return m_nl.data(idx);
+	}
+	Elem& elem_at(size_t idx) {
+		TERARK_ASSERT_LT(idx, nElem);
+		TERARK_ASSERT_NE(delmark, m_nl.link(idx));
+		return m_nl.data(idx);
+	}
+	template<class OP>
+	void for_each(OP op) {
+		for (size_t i = beg_i(), n = nElem; i < n; i = next_i(i))
+			op(m_nl.data(i));
+	}
+	template<class OP>
+	void for_each(OP op) const {
+		for (size_t i = beg_i(), n = nElem; i < n; i = next_i(i))
+			op(m_nl.data(i));
+	}
+
+protected:
+	LinkTp slot_alloc() {
+		LinkTp slot;
+		if (0 == freelist_size) {
+			slot = nElem;
+			if (terark_unlikely(nElem == maxElem))
+				reserve_nodes(0 == nElem ? 1 : 2*nElem);
+			nElem++;
+		} else {
+			TERARK_ASSERT_LT(freelist_head, nElem);
+			TERARK_ASSERT_EQ(m_nl.link(freelist_head), delmark);
+			slot = freelist_head;
+			freelist_size--;
+			freelist_head = reinterpret_cast<LinkTp&>(m_nl.data(slot));
+		}
+		m_nl.link(slot) = tail; // live element
+		return slot;
+	}
+	void slot_free(size_t slot) {
+		TERARK_ASSERT_LT(slot, nElem);
+		m_nl.data(slot).~Elem();
+		if (slot + 1 == nElem) {
+			nElem--;
+		} else {
+			m_nl.link(slot) = delmark;
+			reinterpret_cast<LinkTp&>(m_nl.data(slot)) = freelist_head;
+			freelist_head = LinkTp(slot);
+			freelist_size++;
+		}
+	}
+#undef MyKeyExtractor
+};
+
+/// same api as gold_hash_map, indexed by swiss_hash_index
+template< class Key
+		, class Value
+		, class HashFunc = DEFAULT_HASH_FUNC<Key>
+		, class KeyEqual = std::equal_to<Key>
+		, class NodeLayout = node_layout<std::pair<Key, Value>, unsigned>
+		>
+class swiss_hash_map : public
+	swiss_hash_tab<Key, std::pair<Key, Value>
+		, hash_and_equal<Key, HashFunc, KeyEqual>, terark_get_first<Key>
+		, NodeLayout
+		>
+{
+	typedef
+	swiss_hash_tab<Key, std::pair<Key, Value>
+		, hash_and_equal<Key, HashFunc, KeyEqual>, terark_get_first<Key>
+		, NodeLayout
+		>
+	super;
+public:
+	typedef typename super::key_param_pass_t key_param_pass_t;
+	typedef Value mapped_type;
+	using super::super;
+	using super::insert_i;
+	std::pair<size_t, bool>
+	insert_i(key_param_pass_t key, const Value& val) {
+		return this->insert_i(std::make_pair(key, val));
+	}
+	std::pair<size_t, bool>
+	insert_i(key_param_pass_t key) {
+		return this->lazy_insert_i(key, &default_cons<Value>);
+	}
+	template<class ConsValue>
+	std::pair<size_t, bool>
+	lazy_insert_i(key_param_pass_t key, const ConsValue& cons) {
+		return this->lazy_insert_elem_i(key, [&](std::pair<Key, Value>* kv_mem) {
+			new(&kv_mem->first) Key(key);
+			cons(&kv_mem->second); // if cons fail, key will be leaked
+		});
+	}
+	Value& operator[](key_param_pass_t key) {
+		std::pair<size_t, bool> ib = this->insert_i(key);
+		return this->m_nl.data(ib.first).second;
+	}
+	Value& at(key_param_pass_t key) {
+		size_t idx = this->find_i(key);
+		if (this->end_i() != idx)
+			return this->m_nl.data(idx).second;
+		else
+			throw std::out_of_range(BOOST_CURRENT_FUNCTION);
+	}
+	const Value& at(key_param_pass_t key) const {
+		size_t idx = this->find_i(key);
+		if (this->end_i() != idx)
+			return this->m_nl.data(idx).second;
+		else
+			throw std::out_of_range(BOOST_CURRENT_FUNCTION);
+	}
+	Value& val(size_t idx) { return this->elem_at(idx).second; }
+	const Value& val(size_t idx) const { return this->elem_at(idx).second; }
+};
+
+template< class Key
+		, class HashFunc = DEFAULT_HASH_FUNC<Key>
+		, class KeyEqual = std::equal_to<Key>
+		, class NodeLayout = node_layout<Key, unsigned>
+		>
+class swiss_hash_set : public
+	swiss_hash_tab<Key, Key
+		, hash_and_equal<Key, HashFunc, KeyEqual>, terark_identity<Key>
+		, NodeLayout
+		>
+{
+	typedef
+	swiss_hash_tab<Key, Key
+		, hash_and_equal<Key, HashFunc, KeyEqual>, terark_identity<Key>
+		, NodeLayout
+		>
+	super;
+public:
+	using super::super;
+};
+
+/// String map with the same api as hash_strmap: keys are appended to one
+/// string pool, key of id i is [offsets[i], offsets[i+1]) of the pool,
+/// values are in a separated array, indexed by swiss_hash_index.
+/// Value is stored in valvec, so it must be memmove-able.
+///
+/// Ids are stable on erase, the pool space of erased keys is reclaimed by
+/// revoke_deleted, which invalidates the ids.
+template< class Value
+		, class HashFunc = fstring_func::hash
+		, class KeyEqual = fstring_func::equal
+		, class LinkTp = unsigned int
+		>
+class swiss_hash_strmap : HashFunc, KeyEqual {
+	static const LinkTp maxlink = LinkTp(-1);
+	valvec<char>   m_strpool;
+	valvec<LinkTp> m_offsets; // size is nElem + 1
+	valvec<Value>  m_values;  // a deleted value is reset to Value()
+	febitvec       m_deleted; // empty if no element was erased
+	size_t         m_delcnt;
+	swiss_hash_index<LinkTp> m_index;
+
+	size_t hash(fstring key) const { return static_cast<const HashFunc&>(*this)(key); }
+	bool  equal(fstring x, fstring y) const { return static_cast<const KeyEqual&>(*this)(x, y); }
+	fstring raw_key(size_t idx) const {
+		const LinkTp* off = m_offsets.data();
+		return fstring(m_strpool.data() + off[idx], off[idx+1] - off[idx]);
+	}
+	auto for_each_hash() const {
+		return [this](auto emit) {
+			for (size_t i = 0, n = m_values.size(); i < n; ++i) {
+				if (!is_deleted_raw(i))
+					emit(i, hash(raw_key(i)));
+			}
+		};
+	}
+	auto get_equal_func(fstring key) const {
+		return [this,key](size_t link) { return equal(key, raw_key(link)); };
+	}
+	bool is_deleted_raw(size_t idx) const {
+		return m_delcnt && idx < m_deleted.size() && m_deleted.is1(idx);
+	}
+
+public:
+	typedef fstring key_type;
+	typedef Value mapped_type;
+	typedef LinkTp link_t;
+
+	swiss_hash_strmap() { m_offsets.push_back(0); m_delcnt = 0; }
+
+	void swap(swiss_hash_strmap& y) {
+		m_strpool.swap(y.m_strpool);
+		m_offsets.swap(y.m_offsets);
+		m_values.swap(y.m_values);
+		m_deleted.swap(y.m_deleted);
+		std::swap(m_delcnt, y.m_delcnt);
+		m_index.swap(y.m_index);
+	}
+	void clear() {
+		m_strpool.clear();
+		m_offsets.clear();
+		m_offsets.push_back(0);
+		m_values.clear();
+		m_deleted.clear();
+		m_delcnt = 0;
+		m_index.clear();
+	}
+	// keep memory
+	void erase_all() {
+		m_strpool.erase_all();
+		m_offsets.resize(1);
+		m_values.erase_all();
+		m_deleted.erase_all();
+		m_delcnt = 0;
+		m_index.erase_all();
+	}
+	void reserve(size_t cap, size_t poolcap = 0) {
+		m_offsets.reserve(cap + 1);
+		m_values.reserve(cap);
+		if (poolcap)
+			m_strpool.reserve(poolcap);
+		m_index.reserve(cap, for_each_hash());
+	}
+	void set_load_factor(double fact) { m_index.set_load_factor(fact); }
+	double get_load_factor() const { return m_index.get_load_factor(); }
+	const swiss_hash_index<LinkTp>& get_index() const { return m_index; }
+
+	size_t  size() const { return m_values.size() - m_delcnt; }
+	bool   empty() const { return size() == 0; }
+	size_t end_i() const { return m_values.size(); }
+	size_t beg_i() const { return m_values.empty() || !is_deleted_raw(0) ? 0 : next_i(0); }
+	size_t next_i(size_t idx) const {
+		size_t n = m_values.size();
+		TERARK_ASSERT_LT(idx, n);
+		do ++idx; while (idx < n && is_deleted(idx));
+		return idx;
+	}
+	size_t delcnt() const { return m_delcnt; }
+	bool is_deleted(size_t idx) const {
+		TERARK_ASSERT_LT(idx, m_values.size());
+		return is_deleted_raw(idx);
+	}
+	size_t total_key_size() const { return m_strpool.size(); }
+	size_t mem_size() const {
+		return m_strpool.capacity() + sizeof(LinkTp) * m_offsets.capacity()
+			 + sizeof(Value) * m_values.capacity() + m_index.mem_size();
+	}
+
+	fstring key(size_t idx) const {
+		TERARK_ASSERT_LT(idx, m_values.size());
+		TERARK_ASSERT_F(!is_deleted(idx), "%zd", idx);
+		return raw_key(idx);
+	}
+	Value& val(size_t idx) {
+		TERARK_ASSERT_LT(idx, m_values.size());
+		TERARK_ASSERT_F(!is_deleted(idx), "%zd", idx);
+		return m_values[idx];
+	}
+	const Value& val(size_t idx) const {
+		TERARK_ASSERT_LT(idx, m_values.size());
+		TERARK_ASSERT_F(!is_deleted(idx), "%zd", idx);
+		return m_values[idx];
+	}
+
+	size_t find_i(fstring key) const {
+		size_t idx = m_index.find(hash(key), get_equal_func(key));
+		return m_index.npos == idx ? m_values.size() : idx;
+	}
+	bool exists(fstring key) const { return find_i(key) != m_values.size(); }
+	bool contains(fstring key) const { return find_i(key) != m_values.size(); }
+	size_t count(fstring key) const { return exists(key) ? 1 : 0; }
+
+	template<class ConsValue>
+	std::pair<size_t, bool> lazy_insert_i(fstring key, ConsValue cons_value) {
+		const size_t h = hash(key);
+		size_t found = m_index.find(h, get_equal_func(key));
+		if (m_index.npos != found)
+			return std::make_pair(found, false);
+		size_t pool_end = m_strpool.size() + key.size();
+		if (terark_unlikely(pool_end > size_t(maxlink) || m_values.size() >= size_t(maxlink))) {
+			THROW_STD(length_error, "pool_end = %zd, elements = %zd",
+					  pool_end, m_values.size());
+		}
+		m_index.prepare_insert(for_each_hash());
+		size_t idx = m_values.size();
+		cons_value(m_values.grow_no_init(1));
+		m_strpool.append(key.data(), key.size());
+		m_offsets.push_back(LinkTp(pool_end));
+		m_index.insert(h, LinkTp(idx));
+		return std::make_pair(idx, true);
+	}
+	std::pair<size_t, bool> insert_i(fstring key, const Value& val) {
+		return lazy_insert_i(key, [&](Value* mem) { new(mem)Value(val); });
+	}
+	std::pair<size_t, bool> insert_i(fstring key, Value&& val) {
+		return lazy_insert_i(key, [&](Value* mem) { new(mem)Value(std::move(val)); });
+	}
+	std::pair<size_t, bool> insert_i(fstring key) {
+		return lazy_insert_i(key, [](Value* mem) { new(mem)Value(); });
+	}
+	Value& operator[](fstring key) {
+		return m_values[insert_i(key).first];
+	}
+
+	/// the pool space of the key is not reclaimed until revoke_deleted
+	size_t erase(fstring key) {
+		const size_t h = hash(key);
+		size_t pos = m_index.find_pos(h, get_equal_func(key));
+		if (m_index.npos == pos)
+			return 0;
+		size_t idx = m_index.link(pos);
+		m_index.erase_at(pos, h);
+		mark_deleted(idx);
+		return 1;
+	}
+	void erase_i(size_t idx) {
+		TERARK_ASSERT_LT(idx, m_values.size());
+		TERARK_ASSERT_F(!is_deleted(idx), "%zd", idx);
+		const size_t h = hash(raw_key(idx));
+		size_t pos = m_index.find_pos(h, [idx](size_t link) { return link == idx; });
+		TERARK_VERIFY_NE(pos, m_index.npos);
+		m_index.erase_at(pos, h);
+		mark_deleted(idx);
+	}
+
+	// if return non-zero, all ids are invalidated
+	size_t revoke_deleted() {
+		if (0 == m_delcnt)
+			return 0;
+		size_t n = m_values.size();
+		valvec<LinkTp> newIdx(n, valvec_no_init());
+		char*   pool = m_strpool.data();
+		LinkTp* off  = m_offsets.data();
+		size_t  i = 0, poolpos = 0;
+		for (size_t j = 0; j < n; ++j) {
+			if (is_deleted_raw(j))
+				continue;
+			size_t kbeg = off[j], klen = off[j+1] - kbeg;
+			memmove(pool + poolpos, pool + kbeg, klen);
+			if (i != j)
+				m_values[i] = std::move(m_values[j]);
+			off[i] = LinkTp(poolpos);
+			poolpos += klen;
+			newIdx[j] = LinkTp(i++);
+		}
+		off[i] = LinkTp(poolpos);
+		m_values.resize(i);
+		m_offsets.resize(i + 1);
+		m_strpool.resize(poolpos);
+		m_deleted.erase_all();
+		m_delcnt = 0;
+		m_index.remap_links([&](size_t link) { return newIdx[link]; });
+		return n - i;
+	}
+
+	template<class OP>
+	void for_each(OP op) {
+		for (size_t i = beg_i(), n = end_i(); i < n; i = next_i(i))
+			op(raw_key(i), m_values[i]);
+	}
+	template<class OP>
+	void for_each(OP op) const {
+		for (size_t i = beg_i(), n = end_i(); i < n; i = next_i(i))
+			op(raw_key(i), m_values[i]);
+	}
+
+private:
+	void mark_deleted(size_t idx) {
+		m_values[idx] = Value(); // release resources of the value
+		if (m_deleted.size() < m_values.size())
+			m_deleted.resize(m_values.size(), false);
+		m_deleted.set1(idx);
+		m_delcnt++;
+	}
+};
+
+} // namespace terark
+
+#if defined(__GNUC__) && __GNUC_MINOR__ + 1000 * __GNUC__ > 7000
+  #pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,195 @@
+#include "block_bloom_filter.hpp"
+#include <terark/util/crc.hpp>
+#include <terark/util/cpu_prefetch.hpp>
+#if defined(__AVX2__)
+	#include <immintrin.h>
+#endif
+
+namespace terark {
+
+struct BlockBloomFilter::Header {
+	uint64_t num_blocks;
+	uint64_t num_keys;
+	uint32_t bits_per_key;
+	uint32_t blocks_crc32;
+	uint16_t blocks_offset; // from image begin
+	uint8_t  format_version;
+	uint8_t  padding1;
+	uint32_t padding4;
+	uint64_t reserved[4];
+};
+BOOST_STATIC_ASSERT(sizeof(BlockBloomFilter::Header) == 64);
+
+// the salts of the parquet split block bloom filter
+alignas(32) static const uint32_t g_bloom_salt[8] = {
+	0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+	0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+#if defined(__AVX2__)
+static inline __m256i bloom_mask(uint32_t h) {
+	__m256i salt = _mm256_load_si256((const __m256i*)g_bloom_salt);
+	__m256i bits = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(h), salt), 27);
+	return _mm256_sllv_epi32(_mm256_set1_epi32(1), bits);
+}
+#endif
+
+BlockBloomFilter::BlockBloomFilter() {
+	m_blocks = NULL;
+	m_num_blocks = 0;
+	m_num_keys = 0;
+	m_bits_per_key = 0;
+}
+
+BlockBloomFilter::~BlockBloomFilter() {
+}
+
+BlockBloomFilter::BlockBloomFilter(BlockBloomFilter&& y) noexcept
+  : BlockBloomFilter() {
+	swap(y);
+}
+
+BlockBloomFilter& BlockBloomFilter::operator=(BlockBloomFilter&& y) noexcept {
+	BlockBloomFilter(std::move(y)).swap(*this);
+	return *this;
+}
+
+// MurmurHash64A
+uint64_t BlockBloomFilter::hash(fstring key) {
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+	const byte_t* p = key.udata();
+	size_t n = key.size();
+	uint64_t h = 0x5bd1e9955bd1e995ULL ^ (n * m);
+	for (; n >= 8; n -= 8, p += 8) {
+		uint64_t k = unaligned_load<uint64_t>(p);
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+	if (n) {
+		uint64_t k = 0;
+		for (size_t i = 0; i < n; ++i)
+			k |= uint64_t(p[i]) << (8 * i);
+		h ^= k;
+		h *= m;
+	}
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
+}
+
+void BlockBloomFilter::init(size_t num_keys, size_t bits_per_key) {
+	if (bits_per_key < 1 || bits_per_key > 64) {
+		THROW_STD(invalid_argument, "bits_per_key = %zd is out of range [1, 64]", bits_per_key);
+	}
+	size_t num_blocks = (num_keys * bits_per_key + 8*BlockBytes - 1) / (8*BlockBytes);
+	num_blocks = std::max<size_t>(num_blocks, 1);
+	clear();
+	m_build.resize(num_blocks * BlockBytes / 4, 0);
+	m_blocks = m_build.data();
+	m_num_blocks = num_blocks;
+	m_num_keys = num_keys;
+	m_bits_per_key = uint32_t(bits_per_key);
+}
+
+void BlockBloomFilter::add_hash(uint64_t h) {
+	assert(m_build.data() == m_blocks && m_num_blocks > 0);
+	uint32_t* block = m_build.data() + 8 * block_of(h);
+#if defined(__AVX2__)
+	__m256i x = _mm256_loadu_si256((const __m256i*)block);
+	_mm256_storeu_si256((__m256i*)block, _mm256_or_si256(x, bloom_mask(uint32_t(h))));
+#else
+	for (size_t i = 0; i < 8; ++i) {
+		block[i] |= uint32_t(1) << ((uint32_t(h) * g_bloom_salt[i]) >> 27);
+	}
+#endif
+}
+
+bool BlockBloomFilter::may_contain_hash(uint64_t h) const {
+	if (0 == m_num_blocks)
+		return true;
+	const uint32_t* block = m_blocks + 8 * block_of(h);
+#if defined(__AVX2__)
+	__m256i x = _mm256_loadu_si256((const __m256i*)block);
+	return _mm256_testc_si256(x, bloom_mask(uint32_t(h))) != 0;
+#else
+	for (size_t i = 0; i < 8; ++i) {
+		uint32_t mask = uint32_t(1) << ((uint32_t(h) * g_bloom_salt[i]) >> 27);
+		if (!(block[i] & mask))
+			return false;
+	}
+	return true;
+#endif
+}
+
+void BlockBloomFilter::prefetch_hash(uint64_t h) const {
+	if (m_num_blocks)
+		TERARK_CPU_PREFETCH(m_blocks + 8 * block_of(h));
+}
+
+static size_t blocks_offset_of(size_t offset) {
+	size_t hsize = sizeof(BlockBloomFilter::Header);
+	size_t align = BlockBloomFilter::BlockAlign;
+	return hsize + (align - (offset + hsize) % align) % align;
+}
+
+size_t BlockBloomFilter::image_size(size_t offset) const {
+	return blocks_offset_of(offset) + BlockBytes * m_num_blocks;
+}
+
+valvec<byte_t> BlockBloomFilter::make_image_head(size_t offset) const {
+	size_t blocks_offset = blocks_offset_of(offset);
+	valvec<byte_t> head(blocks_offset, valvec_reserve());
+	head.resize(blocks_offset, 0);
+	auto header = (Header*)head.data();
+	header->num_blocks = m_num_blocks;
+	header->num_keys = m_num_keys;
+	header->bits_per_key = m_bits_per_key;
+	header->blocks_crc32 = Crc32c_update(0, m_blocks, BlockBytes * m_num_blocks);
+	header->blocks_offset = uint16_t(blocks_offset);
+	header->format_version = 0;
+	return head;
+}
+
+void BlockBloomFilter::risk_set_image(const void* base, size_t bytes, bool verify_checksum) {
+	if (bytes < sizeof(Header)) {
+		THROW_STD(invalid_argument, "bytes = %zd is too small", bytes);
+	}
+	auto header = (const Header*)base;
+	if (header->blocks_offset < sizeof(Header) || 0 != header->format_version ||
+			header->blocks_offset + BlockBytes * header->num_blocks != bytes) {
+		THROW_STD(invalid_argument,
+			"bad BlockBloomFilter: bytes = %zd, blocks = %llu, blocks_offset = %d",
+			bytes, (ullong)header->num_blocks, header->blocks_offset);
+	}
+	auto blocks = (const uint32_t*)((const byte_t*)base + header->blocks_offset);
+	if (verify_checksum) {
+		uint32_t crc = Crc32c_update(0, blocks, BlockBytes * header->num_blocks);
+		if (crc != header->blocks_crc32) {
+			throw BadCrc32cException("BlockBloomFilter::risk_set_image", header->blocks_crc32, crc);
+		}
+	}
+	clear();
+	m_blocks = blocks;
+	m_num_blocks = header->num_blocks;
+	m_num_keys = header->num_keys;
+	m_bits_per_key = header->bits_per_key;
+}
+
+void BlockBloomFilter::clear() {
+	BlockBloomFilter().swap(*this);
+}
+
+void BlockBloomFilter::swap(BlockBloomFilter& y) {
+	m_build.swap(y.m_build);
+	std::swap(m_blocks      , y.m_blocks);
+	std::swap(m_num_blocks  , y.m_num_blocks);
+	std::swap(m_num_keys    , y.m_num_keys);
+	std::swap(m_bits_per_key, y.m_bits_per_key);
+}
+
+} // namespace terark
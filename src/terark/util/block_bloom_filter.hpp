@@ -0,0 +1,75 @@
+#pragma once
+#include <terark/fstring.hpp>
+#include <terark/valvec.hpp>
+#include <terark/util/throw.hpp>
+
+namespace terark {
+
+// Split block Bloom filter:
+// a key sets 8 bits in one 32 byte block, one bit in each 32 bit lane, so
+// a probe touches one block, which is in one cache line when the blocks
+// are 64 bytes aligned, and the 8 lanes are tested by one AVX2 compare.
+//
+// The memory image is: header(64 bytes), padding, blocks. The padding
+// makes the blocks 64 bytes aligned relative to a given file offset, so
+// the image can be written into a file and used on mmap by risk_set_image.
+class TERARK_DLL_EXPORT BlockBloomFilter {
+public:
+	static const size_t BlockBytes = 32;
+	static const size_t BlockAlign = 64;
+	struct Header;
+private:
+	valvec<uint32_t> m_build; // owned blocks when built
+	const uint32_t*  m_blocks;
+	size_t           m_num_blocks;
+	size_t           m_num_keys;
+	uint32_t         m_bits_per_key;
+
+	size_t block_of(uint64_t h) const {
+	#if defined(__SIZEOF_INT128__)
+		return size_t((unsigned __int128)h * m_num_blocks >> 64);
+	#else
+		return size_t((h >> 32) * m_num_blocks >> 32);
+	#endif
+	}
+public:
+	BlockBloomFilter();
+	~BlockBloomFilter();
+	BlockBloomFilter(BlockBloomFilter&&) noexcept;
+	BlockBloomFilter& operator=(BlockBloomFilter&&) noexcept;
+
+	// the hash is saved in the filter, it must be stable across versions
+	static uint64_t hash(fstring key);
+
+	// allocate zero blocks for num_keys keys
+	void init(size_t num_keys, size_t bits_per_key);
+	void add_hash(uint64_t h);
+	void add(fstring key) { add_hash(hash(key)); }
+
+	bool may_contain_hash(uint64_t h) const;
+	bool may_contain(fstring key) const { return may_contain_hash(hash(key)); }
+	void prefetch_hash(uint64_t h) const;
+
+	bool empty() const { return 0 == m_num_blocks; }
+	size_t num_blocks() const { return m_num_blocks; }
+	size_t num_keys() const { return m_num_keys; }
+	size_t bits_per_key() const { return m_bits_per_key; }
+
+	// image written at file offset `offset`
+	size_t image_size(size_t offset) const;
+	template<class Writer>
+	void save_image(size_t offset, const Writer& write) const {
+		valvec<byte_t> head = make_image_head(offset);
+		write(head.data(), head.size());
+		write(m_blocks, BlockBytes * m_num_blocks);
+	}
+	valvec<byte_t> make_image_head(size_t offset) const; // header + padding
+
+	// throw BadCrc32cException if verify_checksum and crc of blocks mismatch
+	void risk_set_image(const void* base, size_t bytes, bool verify_checksum);
+
+	void clear();
+	void swap(BlockBloomFilter&);
+};
+
+} // namespace terark
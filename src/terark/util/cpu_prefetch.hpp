@@ -3,6 +3,11 @@
 //
 #pragma once
 
-#include <xmmintrin.h>
-
-#define TERARK_CPU_PREFETCH(ptr) _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+  #include <xmmintrin.h>
+  #define TERARK_CPU_PREFETCH(ptr) _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+#elif defined(__GNUC__)
+  #define TERARK_CPU_PREFETCH(ptr) __builtin_prefetch((const void*)(ptr))
+#else
+  #define TERARK_CPU_PREFETCH(ptr) ((void)(ptr))
+#endif
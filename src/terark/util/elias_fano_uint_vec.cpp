@@ -0,0 +1,270 @@
+#include "elias_fano_uint_vec.hpp"
+#include <terark/bitmap.hpp>
+#if defined(__AVX2__)
+	#include <immintrin.h>
+#endif
+
+namespace terark {
+
+struct EliasFanoUintVec::Header {
+	uint64_t size;
+	uint64_t max_val;
+	uint64_t low_bytes;
+	uint64_t high_bytes;
+	uint8_t  low_bits;
+	uint8_t  format_version;
+	uint16_t padding2;
+	uint32_t padding4;
+	uint64_t reserved;
+};
+BOOST_STATIC_ASSERT(sizeof(EliasFanoUintVec::Header) == 48);
+
+static inline size_t low_mem_size(size_t bits, size_t num) {
+	if (0 == bits || 0 == num)
+		return 0;
+	// one extra word for the unaligned tail read in get_low and the
+	// 8 byte gather in add_low_range
+	return align_up(((bits * num + 63) / 64 + 1) * 8, 32);
+}
+
+static inline size_t low_bits_of(size_t num, uint64_t max_val) {
+	size_t bits = 0;
+	if (num) {
+		uint64_t q = max_val / num;
+		while ((q >> bits) > 1) bits++;
+	}
+	return bits;
+}
+
+EliasFanoUintVec::EliasFanoUintVec() {
+	m_low = NULL;
+	m_size = 0;
+	m_max_val = 0;
+	m_low_bits = 0;
+}
+
+EliasFanoUintVec::~EliasFanoUintVec() {
+	m_high.risk_release_ownership(); // memory is owned by m_data
+}
+
+EliasFanoUintVec::EliasFanoUintVec(EliasFanoUintVec&& y) noexcept
+  : EliasFanoUintVec() {
+	swap(y);
+}
+
+EliasFanoUintVec& EliasFanoUintVec::operator=(EliasFanoUintVec&& y) noexcept {
+	EliasFanoUintVec(std::move(y)).swap(*this);
+	return *this;
+}
+
+bool EliasFanoUintVec::can_build(size_t num, uint64_t max_val) {
+	const size_t bits = low_bits_of(num, max_val);
+	return num + (max_val >> bits) + 1 < UINT32_MAX;
+}
+
+void EliasFanoUintVec::build_from(const uint64_t* vals, size_t num) {
+	for (size_t i = 1; i < num; ++i) {
+		if (vals[i-1] > vals[i])
+			THROW_STD(invalid_argument,
+				"vals must be non-descending: vals[%zd] = %llu, vals[%zd] = %llu",
+				i-1, (ullong)vals[i-1], i, (ullong)vals[i]);
+	}
+	const uint64_t max_val = num ? vals[num-1] : 0;
+	const size_t bits = low_bits_of(num, max_val);
+	const uint64_t high_bits = num + (max_val >> bits) + 1;
+	if (!can_build(num, max_val)) {
+		THROW_STD(length_error,
+			"num = %zd, max_val = %llu, high bitmap is too large",
+			num, (ullong)max_val);
+	}
+	rank_select_il high(size_t(high_bits), false);
+	for (size_t i = 0; i < num; ++i) {
+		high.set1(i + size_t(vals[i] >> bits));
+	}
+	high.build_cache(true, true);
+
+	size_t hsize = sizeof(Header);
+	size_t lsize = low_mem_size(bits, num);
+	size_t rsize = high.mem_size();
+	size_t total = align_up(hsize + lsize + rsize, 16);
+	valvec<byte_t> data(total, valvec_reserve());
+	data.resize(total, 0);
+	auto header = (Header*)data.data();
+	header->size = num;
+	header->max_val = max_val;
+	header->low_bytes = lsize;
+	header->high_bytes = rsize;
+	header->low_bits = uint8_t(bits);
+	header->format_version = 0;
+	uint64_t* lbase = (uint64_t*)(data.data() + hsize);
+	const uint64_t mask = ~(uint64_t(-1) << bits);
+	for (size_t i = 0; i < num && bits; ++i) {
+		febitvec::s_set_uint((ullong*)lbase, bits * i, bits, (ullong)(vals[i] & mask));
+	}
+	memcpy(data.data() + hsize + lsize, high.data(), rsize);
+	clear();
+	m_data.swap(data);
+	risk_set_data(m_data.data(), m_data.size()); // set pointer fields
+#if !defined(NDEBUG)
+	for (size_t i = 0; i < num; ++i) {
+		assert(get(i) == vals[i]);
+	}
+#endif
+}
+
+size_t EliasFanoUintVec::next_one(size_t bitpos) const {
+	size_t k = bitpos / 64;
+	uint64_t w = m_high.get_word(k) & (uint64_t(-1) << bitpos % 64);
+	while (0 == w) {
+		w = m_high.get_word(++k);
+	}
+	return k * 64 + fast_ctz64(w);
+}
+
+void EliasFanoUintVec::get_range(size_t beg, size_t end, size_t* aVal) const {
+	assert(beg <= end);
+	assert(end <= m_size);
+	if (beg >= end)
+		return;
+	const size_t shift = m_low_bits;
+	size_t pos = m_high.select1(beg);
+	size_t k = pos / 64;
+	uint64_t w = m_high.get_word(k) & (uint64_t(-1) << pos % 64);
+	size_t* out = aVal - beg;
+	for (size_t i = beg; i < end; ) {
+		while (0 == w) {
+			w = m_high.get_word(++k);
+		}
+		do {
+			out[i] = (k * 64 + fast_ctz64(w) - i) << shift;
+			w &= w - 1;
+			i++;
+		} while (w && i < end);
+	}
+	if (shift)
+		add_low_range(beg, end, aVal);
+}
+
+void EliasFanoUintVec::add_low_range(size_t beg, size_t end, size_t* aVal) const {
+	const size_t bits = m_low_bits;
+	size_t i = beg;
+#if defined(__AVX2__)
+	if (bits <= 56 && sizeof(size_t) == 8) {
+		// byte aligned unaligned load covers (bitpos % 8) + bits <= 63 bits
+		const __m256i vbits = _mm256_set1_epi64x(bits);
+		const __m256i vmask = _mm256_set1_epi64x(~(uint64_t(-1) << bits));
+		const __m256i seven = _mm256_set1_epi64x(7);
+		__m256i idx = _mm256_setr_epi64x(i, i + 1, i + 2, i + 3);
+		const __m256i four = _mm256_set1_epi64x(4);
+		for (; i + 4 <= end; i += 4) {
+			__m256i bitpos = _mm256_mul_epu32(idx, vbits); // idx < 2^32
+			__m256i bytepos = _mm256_srli_epi64(bitpos, 3);
+			__m256i g = _mm256_i64gather_epi64((const long long*)m_low, bytepos, 1);
+			__m256i lo = _mm256_and_si256(
+				_mm256_srlv_epi64(g, _mm256_and_si256(bitpos, seven)), vmask);
+			__m256i* p = (__m256i*)(aVal + (i - beg));
+			_mm256_storeu_si256(p, _mm256_or_si256(_mm256_loadu_si256(p), lo));
+			idx = _mm256_add_epi64(idx, four);
+		}
+	}
+#endif
+	for (; i < end; ++i) {
+		aVal[i - beg] |= get_low(i);
+	}
+}
+
+size_t EliasFanoUintVec::lower_bound(size_t lo, size_t hi, uint64_t key) const {
+	assert(lo <= hi);
+	assert(hi <= m_size);
+	if (lo >= hi || key > m_max_val)
+		return hi;
+	// values of rank [blo, bhi) have the same high part as key
+	const uint64_t h = key >> m_low_bits;
+	size_t blo = 0 == h ? 0 : m_high.select0(size_t(h) - 1) + 1 - size_t(h);
+	size_t bhi = m_high.select0(size_t(h)) - size_t(h);
+	if (bhi <= lo)
+		return lo;
+	if (blo >= hi)
+		return hi;
+	blo = std::max(blo, lo);
+	bhi = std::min(bhi, hi);
+	const uint64_t key_low = key & ~(uint64_t(-1) << m_low_bits);
+	while (blo < bhi) {
+		size_t mid = (blo + bhi) / 2;
+		if (get_low(mid) < key_low)
+			blo = mid + 1;
+		else
+			bhi = mid;
+	}
+	return blo;
+}
+
+size_t EliasFanoUintVec::upper_bound(size_t lo, size_t hi, uint64_t key) const {
+	if (UINT64_MAX == key)
+		return hi;
+	return lower_bound(lo, hi, key + 1);
+}
+
+size_t EliasFanoUintVec::estimate_mem_size(size_t num, uint64_t max_val) {
+	size_t bits = low_bits_of(num, max_val);
+	size_t zeros = size_t(max_val >> bits) + 1;
+	size_t lines = (num + zeros + 255) / 256;
+	// same as rank_select_il::build_cache(true, true): a sentinel line,
+	// select0 and select1 sample one uint32 per 256 zeros or ones, 2 flags
+	size_t u32_slots = (zeros + 255) / 256 + 1 + (num + 255) / 256 + 1 + 2;
+	const size_t line_bytes = 8 + 256/8; // rlev1, rlev2[4], 256 bits
+	lines += 1 + (4 * u32_slots + line_bytes - 1) / line_bytes;
+	return align_up(sizeof(Header) + low_mem_size(bits, num) + line_bytes * lines, 16);
+}
+
+void EliasFanoUintVec::clear() {
+	EliasFanoUintVec().swap(*this);
+}
+
+void EliasFanoUintVec::swap(EliasFanoUintVec& y) {
+	m_data.swap(y.m_data);
+	m_high.swap(y.m_high);
+	std::swap(m_low     , y.m_low);
+	std::swap(m_size    , y.m_size);
+	std::swap(m_max_val , y.m_max_val);
+	std::swap(m_low_bits, y.m_low_bits);
+}
+
+void EliasFanoUintVec::risk_set_data(const void* base, size_t bytes) {
+	if (bytes < sizeof(Header)) {
+		THROW_STD(invalid_argument, "bytes = %zd is too small", bytes);
+	}
+	auto header = (const Header*)base;
+	size_t lsize = low_mem_size(header->low_bits, header->size);
+	size_t rsize = size_t(header->high_bytes);
+	if (header->low_bits > 63 || 0 != header->format_version ||
+			header->low_bytes != lsize || rsize < 8 || rsize % 8 != 0 ||
+			align_up(sizeof(Header) + lsize + rsize, 16) != bytes) {
+		THROW_STD(invalid_argument,
+			"bad EliasFanoUintVec: bytes = %zd, size = %llu, low_bits = %d",
+			bytes, (ullong)header->size, header->low_bits);
+	}
+	byte_t* high = (byte_t*)base + sizeof(Header) + lsize;
+	m_high.risk_release_ownership();
+	m_high.risk_mmap_from(high, rsize);
+	if (m_high.max_rank1() != header->size) {
+		m_high.risk_release_ownership();
+		THROW_STD(invalid_argument,
+			"bad EliasFanoUintVec: size = %llu, but high bitmap has %zd ones",
+			(ullong)header->size, m_high.max_rank1());
+	}
+	if (m_data.data() != base) {
+		m_data.risk_set_data((byte_t*)base, bytes);
+	}
+	m_low = (const byte_t*)(header + 1);
+	m_size = header->size;
+	m_max_val = header->max_val;
+	m_low_bits = header->low_bits;
+}
+
+void EliasFanoUintVec::risk_release_ownership() {
+	m_data.risk_release_ownership();
+	clear();
+}
+
+} // namespace terark
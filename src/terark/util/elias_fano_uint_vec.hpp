@@ -0,0 +1,116 @@
+#pragma once
+#include <terark/stdtypes.hpp>
+#include <terark/valvec.hpp>
+#include <terark/util/throw.hpp>
+#include <terark/succinct/rank_select_il_256.hpp>
+#include <array>
+
+namespace terark {
+
+// Elias-Fano encoding of a non-descending uint64 sequence, such as the
+// record offsets of a blob store:
+// each value is split into low_bits() low bits, which are bit packed, and
+// the high part h, value i is a 1 at bit position i + h of the high bitmap.
+// The high bitmap has about 2*size() bits, total is about 2 + log2(max/size)
+// bits per value.
+//
+// get is one select1, get2 is get plus scanning to the next 1, lower_bound
+// is two select0 and a binary search on the low bits of one high bucket.
+//
+// The object is a single contiguous memory block, it can be saved by
+// writing data()/mem_size() and loaded by risk_set_data on mmap, mem_size()
+// is a multiple of 16. The high bitmap is a rank_select_il, so size() plus
+// max_val()/2^low_bits() must be less than 2^32.
+class TERARK_DLL_EXPORT EliasFanoUintVec {
+public:
+	struct Header;
+private:
+	valvec<byte_t>  m_data;
+	rank_select_il  m_high; // point into m_data
+	const byte_t*   m_low;
+	size_t          m_size;
+	uint64_t        m_max_val;
+	size_t          m_low_bits;
+
+	uint64_t get_low(size_t idx) const {
+		size_t bits = m_low_bits;
+		if (0 == bits)
+			return 0;
+		const uint64_t* base = (const uint64_t*)m_low;
+		size_t bitpos = bits * idx;
+		const uint64_t* p = base + bitpos / 64;
+		size_t offset = bitpos % 64;
+		uint64_t mask = ~(uint64_t(-1) << bits);
+		uint64_t low = p[0] >> offset;
+		if (offset + bits <= 64)
+			return mask & low;
+		else
+			return mask & (low | (p[1] << (64 - offset)));
+	}
+	// position of the first 1 at or after bitpos, there must be one
+	size_t next_one(size_t bitpos) const;
+	void add_low_range(size_t beg, size_t end, size_t* aVal) const;
+
+public:
+	EliasFanoUintVec();
+	~EliasFanoUintVec();
+	EliasFanoUintVec(EliasFanoUintVec&&) noexcept;
+	EliasFanoUintVec& operator=(EliasFanoUintVec&&) noexcept;
+
+	// vals must be non-descending, else throw invalid_argument
+	void build_from(const uint64_t* vals, size_t num);
+	template<class UintVec>
+	void build_from(const UintVec& vals) {
+		build_from(vals.data(), vals.size());
+	}
+	// false if build_from would throw length_error for num values whose
+	// max is max_val, because the high bitmap would have 2^32 bits or more
+	static bool can_build(size_t num, uint64_t max_val);
+
+	size_t size() const { return m_size; }
+	uint64_t max_val() const { return m_max_val; }
+	size_t low_bits() const { return m_low_bits; }
+
+	const byte_t* data() const { return m_data.data(); }
+	size_t mem_size() const { return m_data.size(); }
+
+	size_t get(size_t idx) const {
+		assert(idx < m_size);
+		return ((m_high.select1(idx) - idx) << m_low_bits) | get_low(idx);
+	}
+	size_t operator[](size_t idx) const { return get(idx); }
+
+	// same as {get(idx), get(idx+1)}, idx + 1 < size()
+	std::array<size_t, 2> get2(size_t idx) const {
+		assert(idx + 1 < m_size);
+		size_t pos0 = m_high.select1(idx);
+		size_t pos1 = next_one(pos0 + 1);
+		size_t shift = m_low_bits;
+		return {{ ((pos0 - idx) << shift) | get_low(idx),
+		          ((pos1 - idx - 1) << shift) | get_low(idx + 1) }};
+	}
+	void get2(size_t idx, size_t aVal[2]) const {
+		*reinterpret_cast<std::array<size_t, 2>*>(aVal) = get2(idx);
+	}
+
+	// decode [beg, end) to aVal, the high parts are decoded by scanning the
+	// bitmap a word at a time, the low parts are gathered 4 at a time by
+	// AVX2 when low_bits() <= 56
+	void get_range(size_t beg, size_t end, size_t* aVal) const;
+
+	// return the first rank in [lo, hi) whose value >= key, hi if none
+	size_t lower_bound(size_t lo, size_t hi, uint64_t key) const;
+	size_t upper_bound(size_t lo, size_t hi, uint64_t key) const;
+	size_t lower_bound(uint64_t key) const { return lower_bound(0, m_size, key); }
+	size_t upper_bound(uint64_t key) const { return upper_bound(0, m_size, key); }
+
+	// bytes of the built object, for choosing an encoding without building
+	static size_t estimate_mem_size(size_t num, uint64_t max_val);
+
+	void clear();
+	void swap(EliasFanoUintVec&);
+	void risk_set_data(const void* base, size_t bytes);
+	void risk_release_ownership();
+};
+
+} // namespace terark
@@ -24,15 +24,36 @@ terark_forceinline unsigned int fast_getcpu(void) {
     // unsigned node = p >> 12;
     return p & VGETCPU_CPU_MASK;
 }
+/// NUMA node of current cpu, same encoding as vgetcpu: (node << 12) | cpu
+terark_forceinline unsigned int fast_getcpu_node(void) {
+    const unsigned GDT_ENTRY_PER_CPU = 15;
+    const unsigned __PER_CPU_SEG = (GDT_ENTRY_PER_CPU * 8 + 3);
+    unsigned int p;
+    asm volatile ("lsl %1,%0" : "=r" (p) : "r" (__PER_CPU_SEG));
+    return p >> 12;
+}
 } // namespace terark
 
 #elif !defined(_MSC_VER)
 
 #include <sched.h>
+#if defined(__linux__)
+  #include <unistd.h>
+  #include <sys/syscall.h>
+#endif
 namespace terark {
 terark_forceinline unsigned int fast_getcpu(void) {
     return sched_getcpu();
 }
+/// NUMA node of current cpu
+terark_forceinline unsigned int fast_getcpu_node(void) {
+  #if defined(__linux__) && defined(SYS_getcpu)
+    unsigned int cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+        return node;
+  #endif
+    return 0;
+}
 } // namespace terark
 
 #endif
@@ -0,0 +1,240 @@
+#include "learned_uint_vec.hpp"
+#include <terark/bitmap.hpp>
+#include <cmath>
+#include <limits>
+
+namespace terark {
+
+struct LearnedUintVec::Header {
+	uint64_t size;
+	uint64_t num_segs;
+	uint64_t residual_base;
+	uint32_t epsilon;
+	uint8_t  residual_bits;
+	uint8_t  format_version;
+	uint16_t padding;
+};
+BOOST_STATIC_ASSERT(sizeof(LearnedUintVec::Segment) == 32);
+
+static inline size_t residual_mem_size(size_t bits, size_t num) {
+	// one extra word for the unaligned tail read in get_residual
+	return ((bits * num + 63) / 64 + 1) * 8;
+}
+
+LearnedUintVec::LearnedUintVec() {
+	m_segs = NULL;
+	m_bits = NULL;
+	m_size = 0;
+	m_num_segs = 0;
+	m_residual_base = 0;
+	m_epsilon = 0;
+	m_residual_bits = 0;
+}
+
+LearnedUintVec::~LearnedUintVec() {
+}
+
+LearnedUintVec::LearnedUintVec(LearnedUintVec&& y) noexcept
+  : LearnedUintVec() {
+	swap(y);
+}
+
+LearnedUintVec& LearnedUintVec::operator=(LearnedUintVec&& y) noexcept {
+	LearnedUintVec(std::move(y)).swap(*this);
+	return *this;
+}
+
+void LearnedUintVec::build_from(const uint64_t* keys, size_t num, size_t epsilon) {
+	if (epsilon < 1 || epsilon > UINT32_MAX) {
+		THROW_STD(invalid_argument, "epsilon = %zd is out of range", epsilon);
+	}
+	for (size_t i = 1; i < num; ++i) {
+		if (keys[i-1] >= keys[i])
+			THROW_STD(invalid_argument,
+				"keys must be strictly ascending: keys[%zd] = %llu, keys[%zd] = %llu",
+				i-1, (ullong)keys[i-1], i, (ullong)keys[i]);
+	}
+	const double eps = double(epsilon);
+	valvec<Segment> segs;
+	// shrinking cone: the segment is anchored at its first point, the
+	// slope range [lo, hi] is narrowed by each following point until empty
+	for (size_t i = 0; i < num; ) {
+		size_t   rank0 = i;
+		uint64_t key0 = keys[i];
+		double lo = 0, hi = std::numeric_limits<double>::infinity();
+		for (++i; i < num; ++i) {
+			double dx = double(keys[i] - key0);
+			double dy = double(i - rank0);
+			double nlo = std::max(lo, (dy - eps) / dx);
+			double nhi = std::min(hi, (dy + eps) / dx);
+			if (nlo > nhi)
+				break;
+			lo = nlo;
+			hi = nhi;
+		}
+		Segment seg;
+		seg.key0 = key0;
+		seg.rank0 = rank0;
+		seg.slope = i - rank0 > 1 ? (lo + hi) / 2 : 0;
+		seg.islope = seg.slope > 0 ? 1 / seg.slope : 0;
+		segs.push_back(seg);
+	}
+	// residuals are stored as (key - predict - base) in wrapped uint64
+	int64_t rmin = 0, rmax = 0;
+	for (size_t s = 0; s < segs.size(); ++s) {
+		size_t end = s + 1 < segs.size() ? segs[s+1].rank0 : num;
+		for (size_t i = segs[s].rank0; i < end; ++i) {
+			int64_t r = int64_t(keys[i] - predict(segs[s], i));
+			rmin = std::min(rmin, r);
+			rmax = std::max(rmax, r);
+		}
+	}
+	uint64_t spread = uint64_t(rmax) - uint64_t(rmin);
+	size_t bits = 0;
+	while (bits < 64 && (spread >> bits) != 0) bits++;
+
+	size_t hsize = sizeof(Header);
+	size_t ssize = sizeof(Segment) * segs.size();
+	size_t rsize = num ? residual_mem_size(bits, num) : 0;
+	valvec<byte_t> data(hsize + ssize + rsize, valvec_reserve());
+	data.resize(hsize + ssize + rsize, 0);
+	auto header = (Header*)data.data();
+	header->size = num;
+	header->num_segs = segs.size();
+	header->residual_base = uint64_t(rmin);
+	header->epsilon = uint32_t(epsilon);
+	header->residual_bits = uint8_t(bits);
+	header->format_version = 0;
+	if (ssize)
+		memcpy(data.data() + hsize, segs.data(), ssize);
+	uint64_t* rbase = (uint64_t*)(data.data() + hsize + ssize);
+	for (size_t s = 0; s < segs.size() && bits; ++s) {
+		size_t end = s + 1 < segs.size() ? segs[s+1].rank0 : num;
+		for (size_t i = segs[s].rank0; i < end; ++i) {
+			uint64_t r = keys[i] - predict(segs[s], i) - uint64_t(rmin);
+			febitvec::s_set_uint((ullong*)rbase, bits * i, bits, (ullong)r);
+		}
+	}
+	clear();
+	m_data.swap(data);
+	risk_set_data(m_data.data(), m_data.size()); // set pointer fields
+#if !defined(NDEBUG)
+	for (size_t i = 0; i < num; ++i) {
+		assert(get(i) == keys[i]);
+	}
+#endif
+}
+
+size_t LearnedUintVec::seg_of_rank(size_t idx) const {
+	size_t lo = 0, hi = m_num_segs;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (m_segs[mid].rank0 <= idx)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	assert(lo > 0);
+	return lo - 1;
+}
+
+uint64_t LearnedUintVec::get(size_t idx) const {
+	assert(idx < m_size);
+	return get_in_seg(m_segs[seg_of_rank(idx)], idx);
+}
+
+size_t LearnedUintVec::lower_bound(uint64_t key) const {
+	size_t lo = 0, hi = m_num_segs;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (m_segs[mid].key0 <= key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (0 == lo)
+		return 0;
+	const Segment& seg = m_segs[lo-1];
+	size_t beg = seg.rank0;
+	size_t end = lo < m_num_segs ? m_segs[lo].rank0 : m_size;
+	double fpos = double(key - seg.key0) * seg.slope;
+	size_t pos = beg + (fpos < double(end - beg) ? size_t(fpos) : end - beg);
+	size_t eps = m_epsilon;
+	size_t wlo = pos > beg + eps + 1 ? pos - eps - 1 : beg;
+	size_t whi = std::min(end, pos + eps + 2);
+	// float rounding may push the answer out of the window, check borders
+	if (wlo > beg && get_in_seg(seg, wlo - 1) >= key)
+		wlo = beg;
+	if (whi < end && get_in_seg(seg, whi) < key)
+		whi = end;
+	while (wlo < whi) {
+		size_t mid = (wlo + whi) / 2;
+		if (get_in_seg(seg, mid) < key)
+			wlo = mid + 1;
+		else
+			whi = mid;
+	}
+	return wlo;
+}
+
+size_t LearnedUintVec::upper_bound(uint64_t key) const {
+	if (UINT64_MAX == key)
+		return m_size;
+	return lower_bound(key + 1); // keys are unique
+}
+
+size_t LearnedUintVec::estimate_mem_size(size_t num, double avg_gap, size_t epsilon) {
+	// residual spread of a near linear segment is about 2*epsilon*avg_gap,
+	// segment count is an allowance of num/(4*epsilon)
+	double spread = 2.0 * epsilon * std::max(avg_gap, 1.0) + 1;
+	size_t bits = std::min<size_t>(64, size_t(std::ceil(std::log2(spread))));
+	size_t segs = num / (4 * epsilon) + 1;
+	return sizeof(Header) + sizeof(Segment) * segs + residual_mem_size(bits, num);
+}
+
+void LearnedUintVec::clear() {
+	LearnedUintVec().swap(*this);
+}
+
+void LearnedUintVec::swap(LearnedUintVec& y) {
+	m_data.swap(y.m_data);
+	std::swap(m_segs         , y.m_segs);
+	std::swap(m_bits         , y.m_bits);
+	std::swap(m_size         , y.m_size);
+	std::swap(m_num_segs     , y.m_num_segs);
+	std::swap(m_residual_base, y.m_residual_base);
+	std::swap(m_epsilon      , y.m_epsilon);
+	std::swap(m_residual_bits, y.m_residual_bits);
+}
+
+void LearnedUintVec::risk_set_data(const void* base, size_t bytes) {
+	if (bytes < sizeof(Header)) {
+		THROW_STD(invalid_argument, "bytes = %zd is too small", bytes);
+	}
+	auto header = (const Header*)base;
+	size_t ssize = sizeof(Segment) * header->num_segs;
+	size_t rsize = header->size ? residual_mem_size(header->residual_bits, header->size) : 0;
+	if (sizeof(Header) + ssize + rsize != bytes || header->residual_bits > 64 ||
+			0 != header->format_version || (0 == header->num_segs) != (0 == header->size)) {
+		THROW_STD(invalid_argument,
+			"bad LearnedUintVec: bytes = %zd, size = %llu, segs = %llu, bits = %d",
+			bytes, (ullong)header->size, (ullong)header->num_segs, header->residual_bits);
+	}
+	if (m_data.data() != base) {
+		m_data.risk_set_data((byte_t*)base, bytes);
+	}
+	m_segs = (const Segment*)(header + 1);
+	m_bits = (const byte_t*)(m_segs + header->num_segs);
+	m_size = header->size;
+	m_num_segs = header->num_segs;
+	m_residual_base = header->residual_base;
+	m_epsilon = header->epsilon;
+	m_residual_bits = header->residual_bits;
+}
+
+void LearnedUintVec::risk_release_ownership() {
+	m_data.risk_release_ownership();
+	clear();
+}
+
+} // namespace terark
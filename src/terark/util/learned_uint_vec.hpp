@@ -0,0 +1,101 @@
+#pragma once
+#include <terark/stdtypes.hpp>
+#include <terark/valvec.hpp>
+#include <terark/util/throw.hpp>
+
+namespace terark {
+
+// Learned index over a strictly ascending uint64 sequence:
+// keys are approximated by piecewise linear segments (PGM style, the rank
+// error of each segment is bounded by epsilon), and the exact keys are
+// recovered from bit packed residuals against the segment prediction.
+//
+// lower_bound is: binary search on segments, predict the rank, then binary
+// search in a window of 2*epsilon+2 keys.
+//
+// The object is a single contiguous memory block, it can be saved by
+// writing data()/mem_size() and loaded by risk_set_data on mmap.
+class TERARK_DLL_EXPORT LearnedUintVec {
+public:
+	struct Segment {
+		uint64_t key0;   // first key of this segment
+		uint64_t rank0;  // rank of key0
+		double   slope;  // rank per key
+		double   islope; // key per rank, 1/slope or 0
+	};
+private:
+	struct Header;
+	valvec<byte_t>  m_data;
+	const Segment*  m_segs;
+	const byte_t*   m_bits; // residuals
+	size_t          m_size;
+	size_t          m_num_segs;
+	uint64_t        m_residual_base;
+	uint32_t        m_epsilon;
+	uint32_t        m_residual_bits;
+
+	size_t seg_of_rank(size_t idx) const;
+	uint64_t get_in_seg(const Segment& seg, size_t idx) const {
+		assert(idx >= seg.rank0);
+		assert(idx < m_size);
+		return predict(seg, idx) + get_residual(idx) + m_residual_base; // mod 2^64
+	}
+	static uint64_t predict(const Segment& seg, size_t idx) {
+		double off = double(idx - seg.rank0) * seg.islope;
+		return seg.key0 + (off < 18446744073709551615.0 ? uint64_t(off) : UINT64_MAX);
+	}
+	uint64_t get_residual(size_t idx) const {
+		size_t bits = m_residual_bits;
+		if (0 == bits)
+			return 0;
+		const uint64_t* base = (const uint64_t*)m_bits;
+		size_t bitpos = bits * idx;
+		const uint64_t* p = base + bitpos / 64;
+		size_t offset = bitpos % 64;
+		uint64_t mask = bits < 64 ? ~(uint64_t(-1) << bits) : uint64_t(-1);
+		uint64_t low = p[0] >> offset;
+		if (offset + bits <= 64)
+			return mask & low;
+		else
+			return mask & (low | (p[1] << (64 - offset)));
+	}
+public:
+	LearnedUintVec();
+	~LearnedUintVec();
+	LearnedUintVec(LearnedUintVec&&) noexcept;
+	LearnedUintVec& operator=(LearnedUintVec&&) noexcept;
+
+	// keys must be strictly ascending, else throw invalid_argument
+	void build_from(const uint64_t* keys, size_t num, size_t epsilon);
+	template<class UintVec>
+	void build_from(const UintVec& keys, size_t epsilon) {
+		build_from(keys.data(), keys.size(), epsilon);
+	}
+
+	size_t size() const { return m_size; }
+	size_t epsilon() const { return m_epsilon; }
+	size_t num_segments() const { return m_num_segs; }
+	size_t residual_bits() const { return m_residual_bits; }
+	const Segment* segments() const { return m_segs; }
+
+	const byte_t* data() const { return m_data.data(); }
+	size_t mem_size() const { return m_data.size(); }
+
+	uint64_t get(size_t idx) const;
+	uint64_t operator[](size_t idx) const { return get(idx); }
+
+	// return the first rank whose key >= key, size() if none
+	size_t lower_bound(uint64_t key) const;
+	size_t upper_bound(uint64_t key) const;
+
+	// rough size in bytes of the built object, for choosing an index type
+	// without building it, avg_gap is (max_key - min_key) / num
+	static size_t estimate_mem_size(size_t num, double avg_gap, size_t epsilon);
+
+	void clear();
+	void swap(LearnedUintVec&);
+	void risk_set_data(const void* base, size_t bytes);
+	void risk_release_ownership();
+};
+
+} // namespace terark
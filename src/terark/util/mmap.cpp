@@ -282,6 +282,20 @@ static byte_t* adjust_bondary(byte_t* ptr, byte_t* end) {
     return ptr;
 }
 
+TERARK_DLL_EXPORT
+void mmap_advise_willneed(const void* addr, size_t len) {
+#if defined(_MSC_VER) || !defined(MADV_WILLNEED)
+	(void)addr; (void)len;
+#else
+	if (0 == len)
+		return;
+	static const size_t page = size_t(sysconf(_SC_PAGESIZE));
+	size_t beg = size_t(addr) & ~(page - 1);
+	size_t end = size_t(addr) + len;
+	::madvise((void*)beg, end - beg, MADV_WILLNEED); // error is ignored
+#endif
+}
+
 TERARK_DLL_EXPORT
 void parallel_for_lines(byte_t* base, size_t size, size_t num_threads,
     const function<void(size_t tid, byte_t* beg, byte_t* end)>& func)
@@ -37,6 +37,10 @@ void* mmap_write(const String& fname, size_t* size, intptr_t* pfd) {
 TERARK_DLL_EXPORT
 void  mmap_close(void* base, size_t size, intptr_t fd);
 
+/// hint the kernel to read in the pages of [addr, addr+len) asynchronously,
+/// addr need not be page aligned, no-op where not supported
+TERARK_DLL_EXPORT void mmap_advise_willneed(const void* addr, size_t len);
+
 TERARK_DLL_EXPORT
 void parallel_for_lines(byte_t* base, size_t size, size_t num_threads,
     const function<void(size_t tid, byte_t* beg, byte_t* end)>& func);
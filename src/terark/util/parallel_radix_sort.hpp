@@ -0,0 +1,273 @@
+#pragma once
+
+#include <terark/bitmanip.hpp>
+#include <terark/fstring.hpp>
+#include <terark/valvec.hpp>
+#include <terark/util/byte_swap_impl.hpp>
+#include <boost/predef/other/endian.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace terark {
+
+/// Parallel MSD radix sort of elements which have byte string keys, the
+/// order is the order of fstring: byte-wise, shorter first on equal bytes.
+///
+/// Each element is paired with a 64 bit key prefix which is loaded once,
+/// most compares are integer compares of the prefixes and do not touch the
+/// key data. The prefix is the 7 key bytes from depth in big endian, zero
+/// padded, and a low byte of min(remaining key bytes, 8): equal prefixes
+/// with low byte < 8 are equal keys, with low byte 8 they are decided by
+/// the key bytes from depth + 7.
+///
+/// A range of at least ParallelMinRange elements is split by a counting
+/// pass on the highest byte in which its prefixes differ, the histograms
+/// and the scatter are done by all threads, then the buckets are sorted by
+/// the threads concurrently, a bucket too large for one thread is split by
+/// all threads again. If all prefixes of a range are equal, the prefixes
+/// are reloaded after the common prefix of the keys. One thread sorts a
+/// bucket by std::sort on the prefixes, the runs of equal prefixes are
+/// sorted by reloading or by key compares from the current depth.
+namespace parallel_radix_sort_impl {
+
+static const size_t ParallelMinRange = 64 * 1024;
+static const size_t ReloadMinRun = 64; // shorter runs use key compares
+static const size_t MaxReloadLevel = 16; // bounds the recursion
+
+inline uint64_t load_prefix(fstring key, size_t depth) {
+	size_t len = key.size();
+	uint64_t x;
+	if (len >= depth + 8) {
+		x = unaligned_load<uint64_t>(key.data() + depth);
+	  #if BOOST_ENDIAN_LITTLE_BYTE
+		x = byte_swap(x);
+	  #endif
+		return (x & ~uint64_t(255)) | 8;
+	}
+	size_t rem = len > depth ? len - depth : 0;
+	byte_t buf[8] = {0};
+	memcpy(buf, key.data() + depth, rem);
+	x = unaligned_load<uint64_t>(buf);
+  #if BOOST_ENDIAN_LITTLE_BYTE
+	x = byte_swap(x);
+  #endif
+	return (x & ~uint64_t(255)) | rem;
+}
+
+/// call func(tid) for tid in [0, num_threads), the last one is called on
+/// the calling thread
+template<class Func>
+void run(size_t num_threads, const Func& func) {
+	valvec<std::thread> thrVec(num_threads - 1, valvec_reserve());
+	for (size_t i = 0; i + 1 < num_threads; ++i) {
+		thrVec.unchecked_emplace_back([&,i](){func(i);});
+	}
+	func(num_threads - 1);
+	for (auto& t : thrVec) {
+		t.join();
+	}
+}
+
+template<class Elem, class GetKey>
+class Sorter {
+#pragma pack(push, 4)
+	struct Item {
+		uint64_t prefix;
+		Elem     elem;
+	};
+#pragma pack(pop)
+	GetKey m_key;
+	size_t m_threads;
+
+	static bool less_prefix(const Item& x, const Item& y) {
+		return x.prefix < y.prefix;
+	}
+
+	// common prefix length of the keys of a[beg, end) and key0, the keys
+	// have equal bytes [0, depth), the result is at most maxlen
+	size_t common_prefix(const Item* a, size_t beg, size_t end, fstring key0,
+						 size_t depth, size_t maxlen) const {
+		for (size_t i = beg; i < end && maxlen > depth; ++i) {
+			fstring k = m_key(a[i].elem);
+			maxlen = unmatchPos(key0.udata(), k.udata(), depth,
+								std::min(maxlen, k.size()));
+		}
+		return maxlen;
+	}
+
+	void seq_sort(Item* a, size_t n, size_t depth, size_t level = 0) const {
+		std::sort(a, a + n, &less_prefix);
+		for (size_t i = 0; i < n; ) {
+			size_t j = i + 1;
+			while (j < n && a[j].prefix == a[i].prefix) j++;
+			if (j - i > 1 && 8 == (a[i].prefix & 255))
+				sort_equal_run(a + i, j - i, depth + 7, level + 1);
+			i = j;
+		}
+	}
+
+	// keys of a[0, n) have equal bytes [0, depth)
+	void sort_equal_run(Item* a, size_t n, size_t depth, size_t level) const {
+		if (n >= ReloadMinRun && level < MaxReloadLevel) {
+			fstring key0 = m_key(a[0].elem);
+			depth = common_prefix(a, 1, n, key0, depth, key0.size());
+			for (size_t i = 0; i < n; ++i)
+				a[i].prefix = load_prefix(m_key(a[i].elem), depth);
+			seq_sort(a, n, depth, level);
+		}
+		else {
+			std::sort(a, a + n, [this,depth](const Item& x, const Item& y) {
+				fstring kx = m_key(x.elem), ky = m_key(y.elem);
+				return fstring(kx.p + depth, kx.n - depth) <
+					   fstring(ky.p + depth, ky.n - depth);
+			});
+		}
+	}
+
+	void par_copy(Item* dst, const Item* src, size_t n) const {
+		size_t part = (n + m_threads - 1) / m_threads;
+		run(m_threads, [&](size_t tid) {
+			size_t beg = std::min(n, part * tid);
+			size_t end = std::min(n, beg + part);
+			std::copy(src + beg, src + end, dst + beg);
+		});
+	}
+
+	// sort a[0, n), b is the buffer, the result is in a
+	void par_sort(Item* a, Item* b, size_t n, size_t depth) const {
+		const size_t T = m_threads;
+		const size_t part = (n + T - 1) / T;
+		valvec<uint64_t> diffs(T, 0);
+		uint64_t diff;
+		for (;;) {
+			const uint64_t first = a[0].prefix;
+			run(T, [&](size_t tid) {
+				size_t beg = std::min(n, part * tid);
+				size_t end = std::min(n, beg + part);
+				uint64_t d = 0;
+				for (size_t i = beg; i < end; ++i)
+					d |= a[i].prefix ^ first;
+				diffs[tid] = d;
+			});
+			diff = 0;
+			for (size_t t = 0; t < T; ++t) diff |= diffs[t];
+			if (diff)
+				break;
+			if (8 != (first & 255))
+				return; // all keys are equal
+			fstring key0 = m_key(a[0].elem);
+			valvec<size_t> lcps(T, valvec_no_init());
+			run(T, [&](size_t tid) {
+				size_t beg = std::min(n, part * tid);
+				size_t end = std::min(n, beg + part);
+				lcps[tid] = common_prefix(a, beg, end, key0, depth + 7, key0.size());
+			});
+			depth = *std::min_element(lcps.begin(), lcps.end());
+			run(T, [&](size_t tid) {
+				size_t beg = std::min(n, part * tid);
+				size_t end = std::min(n, beg + part);
+				for (size_t i = beg; i < end; ++i)
+					a[i].prefix = load_prefix(m_key(a[i].elem), depth);
+			});
+		}
+		const int shift = (63 - fast_clz64(diff)) & ~7;
+		valvec<size_t> cnt(T * 256, 0); // cnt[tid*256 + byte]
+		run(T, [&](size_t tid) {
+			size_t beg = std::min(n, part * tid);
+			size_t end = std::min(n, beg + part);
+			size_t* c = cnt.data() + tid * 256;
+			for (size_t i = beg; i < end; ++i)
+				c[(a[i].prefix >> shift) & 255]++;
+		});
+		size_t bucket_beg[257];
+		for (size_t ch = 0, sum = 0; ch < 256; ++ch) {
+			bucket_beg[ch] = sum;
+			for (size_t t = 0; t < T; ++t) {
+				size_t c = cnt[t * 256 + ch];
+				cnt[t * 256 + ch] = sum; // becomes the scatter cursor
+				sum += c;
+			}
+		}
+		bucket_beg[256] = n;
+		run(T, [&](size_t tid) {
+			size_t beg = std::min(n, part * tid);
+			size_t end = std::min(n, beg + part);
+			size_t* c = cnt.data() + tid * 256;
+			for (size_t i = beg; i < end; ++i)
+				b[c[(a[i].prefix >> shift) & 255]++] = a[i];
+		});
+		// a bucket larger than this is split by all threads
+		const size_t large = std::max(ParallelMinRange, n / (2 * T));
+		for (size_t ch = 0; ch < 256; ++ch) {
+			size_t beg = bucket_beg[ch], len = bucket_beg[ch + 1] - beg;
+			if (len > large) {
+				par_sort(b + beg, a + beg, len, depth);
+				par_copy(a + beg, b + beg, len);
+			}
+		}
+		std::atomic<size_t> next_bucket(0);
+		run(T, [&](size_t) {
+			for (;;) {
+				size_t ch = next_bucket++;
+				if (ch >= 256)
+					break;
+				size_t beg = bucket_beg[ch], len = bucket_beg[ch + 1] - beg;
+				if (len <= large) {
+					seq_sort(b + beg, len, depth);
+					std::copy(b + beg, b + beg + len, a + beg);
+				}
+			}
+		});
+	}
+
+public:
+	Sorter(const GetKey& key, size_t num_threads)
+	  : m_key(key), m_threads(num_threads) {}
+
+	void sort(Elem* elems, size_t n) const {
+		valvec<Item> items(n, valvec_no_init());
+		const size_t part = (n + m_threads - 1) / m_threads;
+		run(m_threads, [&](size_t tid) {
+			size_t beg = std::min(n, part * tid);
+			size_t end = std::min(n, beg + part);
+			for (size_t i = beg; i < end; ++i) {
+				items[i].prefix = load_prefix(m_key(elems[i]), 0);
+				items[i].elem = elems[i];
+			}
+		});
+		if (m_threads > 1 && n >= ParallelMinRange) {
+			valvec<Item> buf(n, valvec_no_init());
+			par_sort(items.data(), buf.data(), n, 0);
+		} else {
+			seq_sort(items.data(), n, 0);
+		}
+		run(m_threads, [&](size_t tid) {
+			size_t beg = std::min(n, part * tid);
+			size_t end = std::min(n, beg + part);
+			for (size_t i = beg; i < end; ++i)
+				elems[i] = items[i].elem;
+		});
+	}
+};
+
+} // namespace parallel_radix_sort_impl
+
+/// key(elem) returns the fstring key of elem, Elem must be trivially
+/// copyable. num_threads = 0 means hardware_concurrency, limited by one
+/// thread per ParallelMinRange elements. The temporary memory is about
+/// 2*(8 + sizeof(Elem)) bytes per elem.
+template<class Elem, class GetKey>
+void parallel_radix_sort(Elem* elems, size_t n, GetKey key, size_t num_threads = 0) {
+	using namespace parallel_radix_sort_impl;
+	if (n < 2)
+		return;
+	if (0 == num_threads) {
+		num_threads = std::thread::hardware_concurrency();
+		num_threads = std::min(num_threads, n / ParallelMinRange);
+	}
+	num_threads = std::max<size_t>(num_threads, 1);
+	Sorter<Elem, GetKey>(key, num_threads).sort(elems, n);
+}
+
+} // namespace terark
@@ -0,0 +1,275 @@
+#include "perfect_hash.hpp"
+#include <terark/bitmap.hpp>
+#include <terark/util/throw.hpp>
+#include <zstd/common/xxhash.h>
+#include <algorithm>
+#include <math.h>
+
+namespace terark {
+
+struct MinimalPerfectHash::Header {
+	uint64_t num;
+	uint64_t table_size;
+	uint64_t num_buckets;
+	uint64_t dense_buckets;
+	uint64_t seed;
+	uint64_t codes_bytes;
+	uint64_t remap_bytes;
+	uint32_t dict_size;
+	uint8_t  code_bits;
+	uint8_t  format_version;
+	uint16_t padding2;
+};
+BOOST_STATIC_ASSERT(sizeof(MinimalPerfectHash::Header) == 64);
+
+static const size_t MaxPilot = size_t(1) << 24;
+
+uint64_t MinimalPerfectHash::hash(fstring key, uint64_t seed) {
+	return XXH64(key.data(), key.size(), seed);
+}
+
+MinimalPerfectHash::MinimalPerfectHash() {
+	m_dict = NULL;
+	m_codes = NULL;
+	m_code_bits = 0;
+	m_code_mask = 0;
+	m_num = 0;
+	m_table_size = 0;
+	m_num_buckets = 0;
+	m_dense_buckets = 0;
+	m_seed = 0;
+}
+
+MinimalPerfectHash::~MinimalPerfectHash() {
+	m_remap.risk_release_ownership(); // memory is owned by m_data
+}
+
+MinimalPerfectHash::MinimalPerfectHash(MinimalPerfectHash&& y) noexcept
+  : MinimalPerfectHash() {
+	swap(y);
+}
+
+MinimalPerfectHash& MinimalPerfectHash::operator=(MinimalPerfectHash&& y) noexcept {
+	MinimalPerfectHash(std::move(y)).swap(*this);
+	return *this;
+}
+
+void MinimalPerfectHash::build(size_t num, const function<fstring(size_t)>& key_of,
+							   double load_factor, double avg_bucket_size) {
+	if (!(load_factor >= 0.5 && load_factor <= 1.0)) {
+		THROW_STD(invalid_argument, "load_factor = %f, must be in [0.5, 1.0]", load_factor);
+	}
+	if (!(avg_bucket_size >= 1.0 && avg_bucket_size <= 20.0)) {
+		THROW_STD(invalid_argument, "avg_bucket_size = %f, must be in [1, 20]", avg_bucket_size);
+	}
+	valvec<uint64_t> hashes(num, valvec_no_init());
+	for (uint64_t seed = 0; seed < 16; ++seed) {
+		for (size_t i = 0; i < num; ++i)
+			hashes[i] = hash(key_of(i), seed);
+		if (build_with_seed(hashes, seed, load_factor, avg_bucket_size))
+			return;
+	}
+	THROW_STD(invalid_argument, "num = %zd, failed with 16 seeds, keys are not unique", num);
+}
+
+// return false if 2 keys have same hash, or the pilot search failed
+bool MinimalPerfectHash::build_with_seed(const valvec<uint64_t>& hashes,
+		uint64_t seed, double load_factor, double avg_bucket_size) {
+	const size_t num = hashes.size();
+	const size_t table_size = std::max(num, size_t(ceil(num / load_factor)));
+	const size_t buckets = std::max<size_t>(2, size_t(ceil(num / avg_bucket_size)));
+	const size_t dense = std::max<size_t>(1, size_t(buckets * 0.3));
+
+	// group the keys by bucket, the second hash is used for positions
+	valvec<size_t> bucket_beg(buckets + 1, 0);
+	for (size_t i = 0; i < num; ++i)
+		bucket_beg[bucket_of(hashes[i], dense, buckets) + 1]++;
+	size_t max_bucket_size = 0;
+	for (size_t b = 0; b < buckets; ++b) {
+		maximize(max_bucket_size, bucket_beg[b + 1]);
+		bucket_beg[b + 1] += bucket_beg[b];
+	}
+	valvec<uint64_t> h2(num, valvec_no_init());
+	{
+		valvec<size_t> cursor(bucket_beg.data(), buckets);
+		for (size_t i = 0; i < num; ++i) {
+			size_t b = bucket_of(hashes[i], dense, buckets);
+			h2[cursor[b]++] = mix(hashes[i]);
+		}
+	}
+	for (size_t b = 0; b < buckets; ++b) {
+		uint64_t* beg = h2.data() + bucket_beg[b];
+		uint64_t* end = h2.data() + bucket_beg[b + 1];
+		std::sort(beg, end);
+		if (std::adjacent_find(beg, end) != end)
+			return false;
+	}
+
+	// larger buckets first, counting sort by size
+	valvec<size_t> size_beg(max_bucket_size + 2, 0);
+	for (size_t b = 0; b < buckets; ++b)
+		size_beg[max_bucket_size - (bucket_beg[b + 1] - bucket_beg[b]) + 1]++;
+	for (size_t s = 0; s <= max_bucket_size; ++s)
+		size_beg[s + 1] += size_beg[s];
+	valvec<size_t> order(buckets, valvec_no_init());
+	for (size_t b = 0; b < buckets; ++b)
+		order[size_beg[max_bucket_size - (bucket_beg[b + 1] - bucket_beg[b])]++] = b;
+
+	febitvec taken(table_size, false);
+	valvec<uint32_t> pilots(buckets, 0);
+	valvec<size_t> pos(max_bucket_size + 1, valvec_no_init());
+	for (size_t b : order) {
+		const uint64_t* hb = h2.data() + bucket_beg[b];
+		const size_t bsize = bucket_beg[b + 1] - bucket_beg[b];
+		if (0 == bsize)
+			break; // the rest are all empty
+		for (size_t p = 0; ; ++p) {
+			if (p == MaxPilot)
+				return false;
+			size_t k = 0;
+			for (; k < bsize; ++k) {
+				size_t x = position(hb[k], p, table_size);
+				if (taken.is1(x))
+					break;
+				taken.set1(x); // also detect collisions in the bucket
+				pos[k] = x;
+			}
+			if (k == bsize) {
+				pilots[b] = uint32_t(p);
+				break;
+			}
+			for (size_t j = 0; j < k; ++j)
+				taken.set0(pos[j]);
+		}
+	}
+
+	// dictionary encode the pilots
+	valvec<uint32_t> dict(pilots);
+	std::sort(dict.begin(), dict.end());
+	dict.trim(std::unique(dict.begin(), dict.end()));
+	const size_t code_bits = std::max<size_t>(1, UintVecMin0::compute_uintbits(dict.size() - 1));
+	UintVecMin0 codes;
+	codes.resize_with_uintbits(buckets, code_bits);
+	for (size_t b = 0; b < buckets; ++b) {
+		size_t code = std::lower_bound(dict.begin(), dict.end(), pilots[b]) - dict.begin();
+		codes.set_wire(b, code);
+	}
+
+	// positions >= num to the free positions < num, non-descending
+	EliasFanoUintVec remap;
+	if (table_size > num) {
+		valvec<uint64_t> vals(table_size - num, valvec_no_init());
+		size_t free_pos = 0;
+		uint64_t last = 0;
+		for (size_t p = num; p < table_size; ++p) {
+			if (taken.is1(p)) {
+				while (taken.is1(free_pos))
+					free_pos++;
+				assert(free_pos < num);
+				last = free_pos++;
+			}
+			vals[p - num] = last;
+		}
+		remap.build_from(vals);
+	}
+
+	const size_t hsize = sizeof(Header);
+	const size_t dsize = align_up(sizeof(uint32_t) * dict.size(), 16);
+	const size_t csize = UintVecMin0::compute_mem_size(code_bits, buckets);
+	const size_t rsize = remap.mem_size();
+	assert(csize <= codes.mem_size());
+	valvec<byte_t> data(hsize + dsize + csize + rsize, valvec_reserve());
+	data.resize(hsize + dsize + csize + rsize, 0);
+	auto header = (Header*)data.data();
+	header->num = num;
+	header->table_size = table_size;
+	header->num_buckets = buckets;
+	header->dense_buckets = dense;
+	header->seed = seed;
+	header->codes_bytes = csize;
+	header->remap_bytes = rsize;
+	header->dict_size = uint32_t(dict.size());
+	header->code_bits = uint8_t(code_bits);
+	header->format_version = 0;
+	memcpy(data.data() + hsize, dict.data(), sizeof(uint32_t) * dict.size());
+	memcpy(data.data() + hsize + dsize, codes.data(), csize);
+	memcpy(data.data() + hsize + dsize + csize, remap.data(), rsize);
+	clear();
+	m_data.swap(data);
+	risk_set_data(m_data.data(), m_data.size()); // set pointer fields
+	return true;
+}
+
+void MinimalPerfectHash::clear() {
+	MinimalPerfectHash().swap(*this);
+}
+
+void MinimalPerfectHash::swap(MinimalPerfectHash& y) {
+	m_data.swap(y.m_data);
+	m_remap.swap(y.m_remap);
+	std::swap(m_dict         , y.m_dict);
+	std::swap(m_codes        , y.m_codes);
+	std::swap(m_code_bits    , y.m_code_bits);
+	std::swap(m_code_mask    , y.m_code_mask);
+	std::swap(m_num          , y.m_num);
+	std::swap(m_table_size   , y.m_table_size);
+	std::swap(m_num_buckets  , y.m_num_buckets);
+	std::swap(m_dense_buckets, y.m_dense_buckets);
+	std::swap(m_seed         , y.m_seed);
+}
+
+void MinimalPerfectHash::risk_set_data(const void* base, size_t bytes) {
+	if (bytes < sizeof(Header)) {
+		THROW_STD(invalid_argument, "bytes = %zd is too small", bytes);
+	}
+	auto header = (const Header*)base;
+	size_t dsize = align_up(sizeof(uint32_t) * header->dict_size, 16);
+	size_t csize = UintVecMin0::compute_mem_size(header->code_bits, header->num_buckets);
+	size_t rsize = size_t(header->remap_bytes);
+	if (0 != header->format_version || header->code_bits > 32 ||
+			header->codes_bytes != csize || 0 == header->dict_size ||
+			header->num_buckets < 2 ||
+			header->dense_buckets >= header->num_buckets ||
+			header->table_size < header->num ||
+			(header->table_size > header->num) != (rsize != 0) ||
+			sizeof(Header) + dsize + csize + rsize != bytes) {
+		THROW_STD(invalid_argument,
+			"bad MinimalPerfectHash: bytes = %zd, num = %llu, buckets = %llu",
+			bytes, (ullong)header->num, (ullong)header->num_buckets);
+	}
+	// validate remap before changing this object, on throw it is unchanged
+	EliasFanoUintVec remap;
+	if (rsize) {
+		remap.risk_set_data((const byte_t*)base + sizeof(Header) + dsize + csize, rsize);
+		if (remap.size() != header->table_size - header->num) {
+			size_t remap_size = remap.size();
+			remap.risk_release_ownership();
+			THROW_STD(invalid_argument,
+				"bad MinimalPerfectHash: num = %llu, table_size = %llu, remap size = %zd",
+				(ullong)header->num, (ullong)header->table_size, remap_size);
+		}
+	}
+	if (m_data.data() == base) { // called by build_with_seed
+		m_remap.risk_release_ownership();
+	} else {
+		clear(); // free the data owned by build
+		m_data.risk_set_data((byte_t*)base, bytes);
+	}
+	m_remap.swap(remap); // remap gets the released empty one
+	m_dict = (const uint32_t*)(header + 1);
+	m_codes = (const byte_t*)m_dict + dsize;
+	m_code_bits = header->code_bits;
+	m_code_mask = ~(size_t(-1) << header->code_bits);
+	m_num = size_t(header->num);
+	m_table_size = size_t(header->table_size);
+	m_num_buckets = size_t(header->num_buckets);
+	m_dense_buckets = size_t(header->dense_buckets);
+	m_seed = header->seed;
+}
+
+void MinimalPerfectHash::risk_release_ownership() {
+	m_data.risk_release_ownership();
+	clear();
+}
+
+} // namespace terark
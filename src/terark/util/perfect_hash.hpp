@@ -0,0 +1,117 @@
+#pragma once
+#include <terark/stdtypes.hpp>
+#include <terark/fstring.hpp>
+#include <terark/valvec.hpp>
+#include <terark/int_vector.hpp>
+#include <terark/util/elias_fano_uint_vec.hpp>
+#include <terark/util/function.hpp>
+#if defined(_MSC_VER)
+	#include <intrin.h> // __umulh
+#endif
+
+namespace terark {
+
+// Minimal perfect hash of a static key set, in the manner of PTHash:
+// a key hashes to a bucket, 60% of the keys go to the first 30% of the
+// buckets, each bucket has a pilot, position of a key is
+//   mul_hi(hash2(key) ^ mix(pilot), table_size),
+// the builder searches the pilots bucket by bucket, larger buckets first,
+// until all positions of a bucket are free. table_size = num / load_factor,
+// the positions >= num are remapped to the free positions < num by an
+// EliasFanoUintVec.
+//
+// The pilots are dictionary encoded: a table of the distinct pilot values
+// and a bit packed code per bucket, with the default avg_bucket_size 5 and
+// load_factor 0.98, it is about 2.6 ~ 3 bits per key.
+//
+// lookup is one XXH64 of the key, one code read(a cache miss) and a table
+// read(usually in cache), plus one EliasFanoUintVec::get for 2% of keys.
+// A key which is not in the set maps to an arbitrary position in
+// [0, size()), the caller must verify the key.
+//
+// The object is a single contiguous memory block, it can be saved by
+// writing data()/mem_size() and loaded by risk_set_data on mmap, mem_size()
+// is a multiple of 16.
+class TERARK_DLL_EXPORT MinimalPerfectHash {
+public:
+	struct Header;
+	static uint64_t hash(fstring key, uint64_t seed);
+private:
+	valvec<byte_t>    m_data;
+	EliasFanoUintVec  m_remap; // point into m_data
+	const uint32_t*   m_dict;
+	const byte_t*     m_codes;
+	size_t            m_code_bits;
+	size_t            m_code_mask;
+	size_t            m_num;
+	size_t            m_table_size;
+	size_t            m_num_buckets;
+	size_t            m_dense_buckets;
+	uint64_t          m_seed;
+
+	static uint64_t mul_hi(uint64_t x, uint64_t y) {
+	#if defined(_MSC_VER) && defined(_WIN64)
+		return __umulh(x, y);
+	#elif defined(__SIZEOF_INT128__)
+		return uint64_t((unsigned __int128)(x) * y >> 64);
+	#else
+		uint64_t xl = uint32_t(x), xh = x >> 32;
+		uint64_t yl = uint32_t(y), yh = y >> 32;
+		uint64_t ll = xl * yl, lh = xl * yh, hl = xh * yl, hh = xh * yh;
+		uint64_t mid = (ll >> 32) + uint32_t(lh) + uint32_t(hl);
+		return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	#endif
+	}
+	static uint64_t mix(uint64_t x) { // splitmix64 finalizer
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		return x ^ (x >> 31);
+	}
+	static const uint64_t DenseThreshold = 0x9999999999999999ULL; // 0.6
+	static size_t bucket_of(uint64_t h, size_t dense, size_t buckets) {
+		uint64_t hb = h * 0x9E3779B97F4A7C15ULL;
+		if (h < DenseThreshold)
+			return size_t(mul_hi(hb, dense));
+		else
+			return dense + size_t(mul_hi(hb, buckets - dense));
+	}
+	static size_t position(uint64_t h2, uint64_t pilot, size_t table_size) {
+		return size_t(mul_hi(h2 ^ mix(pilot + 1), table_size));
+	}
+	bool build_with_seed(const valvec<uint64_t>& hashes, uint64_t seed,
+						 double load_factor, double avg_bucket_size);
+
+public:
+	MinimalPerfectHash();
+	~MinimalPerfectHash();
+	MinimalPerfectHash(MinimalPerfectHash&&) noexcept;
+	MinimalPerfectHash& operator=(MinimalPerfectHash&&) noexcept;
+
+	// keys must be unique, else throw invalid_argument
+	void build(size_t num, const function<fstring(size_t)>& key_of,
+			   double load_factor = 0.98, double avg_bucket_size = 5.0);
+
+	size_t size() const { return m_num; }
+	const byte_t* data() const { return m_data.data(); }
+	size_t mem_size() const { return m_data.size(); }
+
+	// return a position in [0, size()), size() must not be 0
+	size_t lookup(fstring key) const { return lookup_hash(hash(key, m_seed)); }
+	size_t lookup_hash(uint64_t h) const {
+		assert(m_num > 0);
+		size_t b = bucket_of(h, m_dense_buckets, m_num_buckets);
+		size_t code = UintVecMin0::fast_get(m_codes, m_code_bits, m_code_mask, b);
+		size_t pos = position(mix(h), m_dict[code], m_table_size);
+		if (terark_likely(pos < m_num))
+			return pos;
+		return m_remap.get(pos - m_num);
+	}
+	uint64_t seed() const { return m_seed; }
+
+	void clear();
+	void swap(MinimalPerfectHash&);
+	void risk_set_data(const void* base, size_t bytes);
+	void risk_release_ownership();
+};
+
+} // namespace terark
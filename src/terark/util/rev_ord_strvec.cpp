@@ -428,18 +428,24 @@ void RevOrdStrVec::back_grow_no_init(size_t nGrow) {
 void RevOrdStrVec::reverse_keys() {
     byte_t* beg = m_strpool.begin();
     size_t  offset = 0;
-    for(size_t i = 0, n = m_offsets.size()-1; i < n; ++i) {
-        size_t endpos = m_offsets[i+1];
-    //  std::reverse(beg, beg + fixlen);
-        byte_t* lo = beg + offset;
-        byte_t* hi = beg + endpos;
-        while (lo < --hi) {
-            byte_t tmp = *lo;
-            *lo = *hi;
-            *hi = tmp;
-            ++lo;
+    size_t  endpos_buf[256];
+    for(size_t i = 0, n = m_offsets.size()-1; i < n; ) {
+        size_t cnt = std::min(n - i, sizeof(endpos_buf)/sizeof(endpos_buf[0]));
+        m_offsets.get_range(i+1, i+1+cnt, endpos_buf);
+        for (size_t j = 0; j < cnt; ++j) {
+            size_t endpos = endpos_buf[j];
+        //  std::reverse(beg, beg + fixlen);
+            byte_t* lo = beg + offset;
+            byte_t* hi = beg + endpos;
+            while (lo < --hi) {
+                byte_t tmp = *lo;
+                *lo = *hi;
+                *hi = tmp;
+                ++lo;
+            }
+            offset = endpos;
         }
-        offset = endpos;
+        i += cnt;
     }
 }
 
@@ -3,6 +3,7 @@
 #include <terark/gold_hash_map.hpp>
 #include <terark/io/DataIO_Basic.hpp>
 #include <terark/util/small_memcpy.hpp>
+#include <terark/util/parallel_radix_sort.hpp>
 
 #if defined(__GNUC__) && !defined(__CYGWIN__) && !defined(__clang__)
 #include <parallel/algorithm>
@@ -133,6 +134,17 @@ void SortableStrVec::sort() {
 			std::stable_sort(m_index.begin(), m_index.end(), cmp);
 			return;
 		}
+		// the prefix radix sort needs 2 temporary {prefix, SEntry} arrays,
+		// small inputs are sorted in place by std::sort
+		if (m_index.size() >= (size_t)getEnvLong("SortableStrVec_minPrefixRadixSortNum", 1<<20) &&
+			getEnvBool("SortableStrVec_usePrefixRadixSort", true)) {
+			auto key = [pool](const SEntry& x) {
+				return fstring(pool + x.offset, x.length);
+			};
+			size_t threads = getEnvLong("SortableStrVec_sortThreads", 0);
+			parallel_radix_sort(m_index.data(), m_index.size(), key, threads);
+			return;
+		}
 #if defined(__GNUC__) && !defined(__CYGWIN__) && !defined(__clang__)
 		const size_t paralell_threshold = (16<<20);
 		if (m_index.size() > paralell_threshold &&
@@ -832,6 +844,15 @@ void SortThinStrVec::sort() {
 			std::stable_sort(m_index.begin(), m_index.end(), cmp);
 			return;
 		}
+		if (m_index.size() >= (size_t)getEnvLong("SortThinStrVec_minPrefixRadixSortNum", 1<<20) &&
+			getEnvBool("SortThinStrVec_usePrefixRadixSort", true)) {
+			auto key = [pool](const SEntry& x) {
+				return fstring(pool + x.offset, x.length);
+			};
+			size_t threads = getEnvLong("SortThinStrVec_sortThreads", 0);
+			parallel_radix_sort(m_index.data(), m_index.size(), key, threads);
+			return;
+		}
 #if defined(__GNUC__) && !defined(__CYGWIN__) && !defined(__clang__)
 		const size_t paralell_threshold = (16<<20);
 		if (m_index.size() > paralell_threshold &&
@@ -868,6 +889,16 @@ void SortThinStrVec::sort(size_t valuelen) {
 			std::stable_sort(m_index.begin(), m_index.end(), cmp);
 			return;
 		}
+		if (m_index.size() >= (size_t)getEnvLong("SortThinStrVec_minPrefixRadixSortNum", 1<<20) &&
+			getEnvBool("SortThinStrVec_usePrefixRadixSort", true)) {
+			auto key = [pool,valuelen](const SEntry& x) {
+				TERARK_ASSERT_GE(x.length, valuelen);
+				return fstring(pool + x.offset, x.length - valuelen);
+			};
+			size_t threads = getEnvLong("SortThinStrVec_sortThreads", 0);
+			parallel_radix_sort(m_index.data(), m_index.size(), key, threads);
+			return;
+		}
 #if defined(__GNUC__) && !defined(__CYGWIN__) && !defined(__clang__)
 		const size_t paralell_threshold = (16<<20);
 		if (m_index.size() > paralell_threshold &&
@@ -1330,7 +1361,24 @@ void FixedLenStrVec::sort_raw(void* base, size_t num, size_t fixlen, size_t valu
 #endif
 	default: break;
 	}
-	QSortCtx(base, num, fixlen, CmpFixLenStr, (void*)(keylen));
+	if (num < (size_t)getEnvLong("FixedLenStrVec_minPrefixRadixSortNum", 1<<20) ||
+		!getEnvBool("FixedLenStrVec_usePrefixRadixSort", true)) {
+		QSortCtx(base, num, fixlen, CmpFixLenStr, (void*)(keylen));
+		return;
+	}
+	// sort the record ids by cached key prefixes, then permute the records
+	const byte_t* pool = (const byte_t*)base;
+	valvec<size_t> ids(num, valvec_no_init());
+	for (size_t i = 0; i < num; ++i) ids[i] = i;
+	auto key = [pool,fixlen,keylen](size_t id) {
+		return fstring(pool + fixlen * id, keylen);
+	};
+	size_t threads = getEnvLong("FixedLenStrVec_sortThreads", 0);
+	parallel_radix_sort(ids.data(), num, key, threads);
+	valvec<byte_t> sorted(fixlen * num, valvec_no_init());
+	for (size_t i = 0; i < num; ++i)
+		memcpy(sorted.data() + fixlen * i, pool + fixlen * ids[i], fixlen);
+	memcpy(base, sorted.data(), fixlen * num);
 }
 
 void FixedLenStrVec::clear() {
@@ -1796,18 +1844,24 @@ void SortedStrVec::back_grow_no_init(size_t nGrow) {
 void SortedStrVec::reverse_keys() {
     byte_t* beg = m_strpool.begin();
     size_t  offset = 0;
-    for(size_t i = 0, n = m_offsets.size()-1; i < n; ++i) {
-        size_t endpos = m_offsets[i+1];
-    //  std::reverse(beg, beg + fixlen);
-        byte_t* lo = beg + offset;
-        byte_t* hi = beg + endpos;
-        while (lo < --hi) {
-            byte_t tmp = *lo;
-            *lo = *hi;
-            *hi = tmp;
-            ++lo;
+    size_t  endpos_buf[256];
+    for(size_t i = 0, n = m_offsets.size()-1; i < n; ) {
+        size_t cnt = std::min(n - i, sizeof(endpos_buf)/sizeof(endpos_buf[0]));
+        m_offsets.get_range(i+1, i+1+cnt, endpos_buf);
+        for (size_t j = 0; j < cnt; ++j) {
+            size_t endpos = endpos_buf[j];
+        //  std::reverse(beg, beg + fixlen);
+            byte_t* lo = beg + offset;
+            byte_t* hi = beg + endpos;
+            while (lo < --hi) {
+                byte_t tmp = *lo;
+                *lo = *hi;
+                *hi = tmp;
+                ++lo;
+            }
+            offset = endpos;
         }
-        offset = endpos;
+        i += cnt;
     }
 }
 
@@ -2021,9 +2075,41 @@ void SortedStrVecUintTpl<UintXX>::reverse_order() {
 	std::reverse(offsets, offsets + num);
 }
 
+// sort the strings and rewrite m_strpool and m_offsets in place, thus it
+// also works on MemType::User and MemType::Mmap(writable) memory
 template<class UintXX>
 void SortedStrVecUintTpl<UintXX>::sort() {
-    THROW_STD(invalid_argument, "This method is not supported");
+    const size_t num = size();
+    const size_t delim_len = m_delim_len;
+    const byte_t* pool = m_strpool.data();
+    UintXX* offsets = m_offsets.data();
+    struct OffsetLength { UintXX offset, length; }; // length has delim
+    valvec<OffsetLength> index(num, valvec_no_init());
+    for (size_t i = 0; i < num; ++i) {
+        index[i].offset = offsets[i];
+        index[i].length = offsets[i+1] - offsets[i];
+    }
+    auto key = [pool,delim_len](const OffsetLength& x) {
+        return fstring(pool + x.offset, x.length - delim_len);
+    };
+    if (num >= (size_t)getEnvLong("SortedStrVec_minPrefixRadixSortNum", 1<<20)) {
+        size_t threads = getEnvLong("SortedStrVec_sortThreads", 0);
+        parallel_radix_sort(index.data(), num, key, threads);
+    } else {
+        std::sort(index.begin(), index.end(),
+            [&key](const OffsetLength& x, const OffsetLength& y) {
+                return key(x) < key(y);
+            });
+    }
+    valvec<byte_t> sorted(m_strpool.size(), valvec_no_init());
+    size_t pos = 0;
+    for (size_t i = 0; i < num; ++i) {
+        memcpy(sorted.data() + pos, pool + index[i].offset, index[i].length);
+        offsets[i] = UintXX(pos);
+        pos += index[i].length;
+    }
+    TERARK_VERIFY_EQ(pos, offsets[num]);
+    memcpy(m_strpool.data(), sorted.data(), pos);
 }
 
 template<class UintXX>
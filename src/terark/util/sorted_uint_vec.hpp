@@ -84,6 +84,11 @@ public:
 
     const void* get_index_base() const { return m_index; }
     size_t get_index_width() const { return m_offsetWidth + m_sampleWidth; }
+    // index entry of the block of idx, such as for prefetch before get(idx)
+    const byte_t* get_index_addr(size_t idx) const {
+        size_t bitpos = get_index_width() * (idx >> m_log2_blockUnits);
+        return m_index + bitpos / 8;
+    }
     size_t get_sample_width() const { return m_sampleWidth; }
     size_t get_block_min_val(size_t blockIdx) const {
         return s_get_block_min_val(m_index, m_sampleWidth, m_offsetWidth + m_sampleWidth, blockIdx);
@@ -0,0 +1,242 @@
+#include "vm_arena.hpp"
+#include "vm_util.hpp"
+#include "hugepage.hpp"
+#include <terark/util/atomic.hpp>
+#include <terark/util/profiling.hpp> // for qtime
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#if defined(_MSC_VER)
+	#define NOMINMAX
+	#define WIN32_LEAN_AND_MEAN
+	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/resource.h>
+#endif
+
+namespace terark {
+
+static void get_page_faults(size_t* minflt, size_t* majflt) {
+  #if defined(_MSC_VER)
+    *minflt = *majflt = 0;
+  #else
+    rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        *minflt = size_t(ru.ru_minflt);
+        *majflt = size_t(ru.ru_majflt);
+    } else {
+        *minflt = *majflt = 0;
+    }
+  #endif
+}
+
+// sum of AnonHugePages of the mappings in [lo, hi), THP may split the
+// mapping of the arena into multiple VMAs
+static size_t get_anon_huge_pages(size_t lo, size_t hi) {
+    size_t bytes = 0;
+  #if defined(__linux__)
+    FILE* fp = fopen("/proc/self/smaps", "r");
+    if (!fp) {
+        return 0;
+    }
+    char line[512];
+    bool in_range = false;
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long beg, end;
+        size_t kb;
+        if (sscanf(line, "%lx-%lx ", &beg, &end) == 2) {
+            in_range = beg >= lo && end <= hi;
+        }
+        else if (in_range && sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) {
+            bytes += kb * 1024;
+        }
+    }
+    fclose(fp);
+  #else
+    TERARK_UNUSED_VAR(lo);
+    TERARK_UNUSED_VAR(hi);
+  #endif
+    return bytes;
+}
+
+VmArena::VmArena() {
+    m_base = NULL;
+    m_size = 0;
+    m_prefaulted = 0;
+    m_minflt0 = 0;
+    m_majflt0 = 0;
+    m_stop = false;
+    m_notified = false;
+}
+
+VmArena::~VmArena() {
+    destroy();
+}
+
+bool VmArena::create(const Options& opt) {
+    TERARK_VERIFY_F(NULL == m_base, "VmArena is already created");
+    TERARK_VERIFY_GT(opt.reserve_size, 0);
+    m_opt = opt;
+    m_opt.prefault_step = pow2_align_up(std::max<size_t>(opt.prefault_step, 1), hugepage_size);
+    size_t size = pow2_align_up(opt.reserve_size, hugepage_size);
+  #if defined(_MSC_VER)
+    void* base = VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_READWRITE);
+    if (!base) {
+        return false;
+    }
+    m_base = (byte_t*)base;
+  #else
+    // over reserve to align the base to 2M, then huge pages are possible
+    // on the whole range
+    size_t map_size = size + hugepage_size;
+    void* mm = mmap(NULL, map_size, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (MAP_FAILED == mm) {
+        return false;
+    }
+    size_t lo = size_t(mm);
+    size_t beg = pow2_align_up(lo, hugepage_size);
+    if (beg > lo) {
+        munmap(mm, beg - lo);
+    }
+    if (lo + map_size > beg + size) {
+        munmap((void*)(beg + size), lo + map_size - (beg + size));
+    }
+    m_base = (byte_t*)beg;
+   #if defined(MADV_HUGEPAGE)
+    if (m_opt.huge_page) {
+        madvise(m_base, size, MADV_HUGEPAGE); // just a hint, ignore error
+    }
+   #endif
+  #endif
+    m_size = size;
+    m_prefaulted = 0;
+    m_stat = Stat();
+    m_stat.reserved = size;
+    get_page_faults(&m_minflt0, &m_majflt0);
+    return true;
+}
+
+void VmArena::destroy() {
+    stop_prefault();
+    if (m_base) {
+      #if defined(_MSC_VER)
+        VirtualFree(m_base, 0, MEM_RELEASE);
+      #else
+        munmap(m_base, m_size);
+      #endif
+        m_base = NULL;
+        m_size = 0;
+    }
+    m_used_size = nullptr;
+}
+
+void VmArena::start_prefault(function<size_t()> used_size) {
+    TERARK_VERIFY(NULL != m_base);
+    TERARK_VERIFY(!m_thread.joinable());
+    m_used_size = std::move(used_size);
+  #if defined(_MSC_VER)
+    // Windows requires explicit commit, which is done by the mempool
+  #else
+    if (m_opt.prefault_ahead && g_has_madv_populate) {
+        m_stop = false;
+        m_notified = false;
+        m_thread = std::thread(&VmArena::prefault_loop, this);
+    }
+  #endif
+}
+
+void VmArena::stop_prefault() {
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_stop = true;
+        }
+        m_cond.notify_one();
+        m_thread.join();
+    }
+}
+
+void VmArena::notify(size_t used) {
+    size_t prefaulted = as_atomic(m_prefaulted).load(std::memory_order_relaxed);
+    if (used + m_opt.prefault_ahead / 2 > prefaulted && prefaulted < m_size) {
+        // a pending notify is not lost when the thread is in madvise, it
+        // is checked before the thread waits again
+        if (!as_atomic(m_notified).load(std::memory_order_relaxed)) {
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_notified = true;
+            }
+            m_cond.notify_one();
+        }
+    }
+}
+
+void VmArena::prefault_loop() {
+  #if !defined(_MSC_VER)
+    const int POPULATE_WRITE = 23; // older kernel has no MADV_POPULATE_WRITE
+    std::unique_lock<std::mutex> lock(m_mtx);
+    while (!m_stop) {
+        size_t used = m_used_size();
+        m_stat.used = used;
+        if (used > m_prefaulted) {
+            m_stat.outrun_cnt++;
+        }
+        size_t target = pow2_align_up(used + m_opt.prefault_ahead, m_opt.prefault_step);
+        target = std::min(target, m_size);
+        while (m_prefaulted < target && !m_stop) {
+            size_t beg = m_prefaulted;
+            size_t len = std::min(m_opt.prefault_step, target - beg);
+            lock.unlock(); // madvise is slow, do not block notify and get_stat
+            auto t0 = qtime::now();
+            int err = 0;
+            while (madvise(m_base + beg, len, POPULATE_WRITE) != 0) {
+                err = errno;
+                if (EAGAIN != err)
+                    break;
+                err = 0; // try again
+            }
+            auto t1 = qtime::now();
+            lock.lock();
+            m_stat.prefault_us += t0.us(t1);
+            if (EINVAL == err) {
+                return; // not supported, the pages are faulted on demand
+            }
+            if (err) {
+                m_stat.prefault_fail++; // such as ENOMEM, skip the range
+            }
+            m_stat.prefault_cnt++;
+            as_atomic(m_prefaulted).store(beg + len, std::memory_order_relaxed);
+        }
+        if (m_prefaulted >= m_size) {
+            break; // all are populated
+        }
+        // no polling, sleep until notify() or stop_prefault()
+        m_cond.wait(lock, [this]{ return m_stop || m_notified; });
+        m_notified = false;
+    }
+  #endif
+}
+
+VmArena::Stat VmArena::get_stat(bool with_huge_pages) const {
+    Stat st;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        st = m_stat;
+        st.prefaulted = m_prefaulted;
+    }
+    if (m_used_size) {
+        st.used = m_used_size();
+    }
+    size_t minflt, majflt;
+    get_page_faults(&minflt, &majflt);
+    st.minor_faults = minflt - m_minflt0;
+    st.major_faults = majflt - m_majflt0;
+    if (with_huge_pages && m_base) {
+        st.huge_page_bytes = get_anon_huge_pages(size_t(m_base), size_t(m_base) + m_size);
+    }
+    return st;
+}
+
+} // namespace terark
@@ -0,0 +1,104 @@
+#pragma once
+#include <terark/config.hpp>
+#include <terark/stdtypes.hpp>
+#include <terark/util/function.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace terark {
+
+/// VmArena reserves a large virtual range up front for a valvec<byte_t>
+/// backed mempool, thus the mempool grows in place without realloc. The
+/// range is aligned to 2M and advised as transparent huge pages, and a
+/// background thread prefaults it by MADV_POPULATE_WRITE ahead of the used
+/// size of the mempool, thus page faults are not on the alloc path. The
+/// thread sleeps on a condvar between the catch-ups, it is woken up just
+/// by notify() and stop_prefault(), thus an idle arena costs no cpu.
+///
+/// Usage with a valvec<byte_t> vec:
+///   arena.create(opt);
+///   vec.risk_set_data(arena.base(), 0);
+///   vec.risk_set_capacity(arena.capacity());
+///   arena.start_prefault([&]{ return as_atomic(used).load(relaxed); });
+///   ...
+///   arena.stop_prefault();
+///   vec.risk_release_ownership();
+///   arena.destroy();
+class TERARK_DLL_EXPORT VmArena {
+    DECLARE_NONE_COPYABLE_CLASS(VmArena)
+public:
+    struct Options {
+        size_t reserve_size = size_t(1) << 30;
+        bool   huge_page = true; // MADV_HUGEPAGE
+        /// the background thread keeps [used, used + prefault_ahead)
+        /// populated, 0 disables the background thread
+        size_t prefault_ahead = size_t(64) << 20;
+        /// bytes populated by each madvise, aligned to 2M
+        size_t prefault_step = size_t(2) << 20;
+    };
+    struct Stat {
+        size_t reserved = 0;
+        size_t used = 0;
+        /// [0, prefaulted) has been populated, pages released later, such as
+        /// by trim, are not populated again, they are faulted on demand
+        size_t prefaulted = 0;
+        size_t prefault_cnt = 0; // number of madvise(POPULATE_WRITE)
+        size_t prefault_fail = 0;
+        size_t prefault_us = 0; // time of the background thread in madvise
+        /// number of checks in which the used size is beyond prefaulted,
+        /// then page faults are on the alloc path
+        size_t outrun_cnt = 0;
+        /// page faults of the whole process since create(), by getrusage
+        size_t minor_faults = 0;
+        size_t major_faults = 0;
+        /// AnonHugePages of the range, just set by get_stat(true), since it
+        /// reads /proc/self/smaps. they are the memory on 2M TLB entries
+        size_t huge_page_bytes = 0;
+    };
+
+    VmArena();
+    ~VmArena(); // calls destroy()
+
+    /// reserve the virtual range, return false on failure
+    bool create(const Options&);
+
+    /// stop the background thread and unmap the range
+    void destroy();
+
+    /// start the background thread which populates the range ahead of
+    /// used_size(), used_size is called by the background thread, once on
+    /// start and then on each wake up by notify()
+    void start_prefault(function<size_t()> used_size);
+    void stop_prefault();
+
+    /// wake up the background thread if used is near the prefaulted end,
+    /// it is cheap, such as to be called on the chunk alloc of a mempool.
+    /// the background thread does not poll, without notify the range beyond
+    /// the initial prefault_ahead is faulted on demand
+    void notify(size_t used);
+
+    byte_t* base() const { return m_base; }
+    size_t capacity() const { return m_size; }
+    const Options& options() const { return m_opt; }
+    Stat get_stat(bool with_huge_pages = false) const;
+
+private:
+    void prefault_loop();
+
+    byte_t*     m_base;
+    size_t      m_size;
+    size_t      m_prefaulted;
+    Options     m_opt;
+    Stat        m_stat;
+    size_t      m_minflt0; // getrusage on create()
+    size_t      m_majflt0;
+    bool        m_stop;
+    bool        m_notified; // a pending notify, guarded by m_mtx
+    function<size_t()>  m_used_size;
+    std::thread m_thread;
+    mutable std::mutex m_mtx;
+    std::condition_variable m_cond;
+};
+
+} // namespace terark
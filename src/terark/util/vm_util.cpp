@@ -65,4 +65,32 @@ void vm_prefetch(const void* addr, size_t len, size_t min_pages) {
   #endif
 }
 
+TERARK_DLL_EXPORT
+size_t vm_release(void* addr, size_t len, bool lazy) {
+    size_t lo = pow2_align_up(size_t(addr), VM_PAGE_SIZE);
+    size_t hi = pow2_align_down(size_t(addr) + len, VM_PAGE_SIZE);
+    if (lo >= hi) {
+      return 0;
+    }
+  #if defined(_MSC_VER)
+    TERARK_UNUSED_VAR(lazy);
+    // MEM_RESET is like MADV_FREE, the pages are still committed
+    if (!VirtualAlloc((void*)lo, hi - lo, MEM_RESET, PAGE_READWRITE)) {
+      return 0;
+    }
+  #else
+   #if defined(MADV_FREE)
+    if (lazy && madvise((void*)lo, hi - lo, MADV_FREE) == 0) {
+      return hi - lo;
+    }
+   #else
+    TERARK_UNUSED_VAR(lazy);
+   #endif
+    if (madvise((void*)lo, hi - lo, MADV_DONTNEED) != 0) {
+      return 0;
+    }
+  #endif
+    return hi - lo;
+}
+
 } // namespace terark
@@ -22,4 +22,10 @@ TERARK_DLL_EXPORT extern const size_t g_min_prefault_pages;
 
 TERARK_DLL_EXPORT void vm_prefetch(const void* addr, size_t len, size_t min_pages);
 
+/// release the whole pages in [addr, addr+len) to the OS, their content is
+/// lost. lazy uses MADV_FREE, the kernel reclaims the pages just on memory
+/// pressure, it falls back to MADV_DONTNEED if MADV_FREE is not supported.
+/// return the released bytes, 0 if there is no whole page or on failure
+TERARK_DLL_EXPORT size_t vm_release(void* addr, size_t len, bool lazy = false);
+
 } // namespace terark
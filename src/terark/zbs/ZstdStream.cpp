@@ -48,7 +48,7 @@ public:
 ZstdInputStream::ZstdInputStream(IInputStream* istream)
     : m_impl(new ZstdInputStream::Impl)
 {
-    assert(m_impl->istream != nullptr);
+    assert(istream != nullptr);
     m_impl->istream = istream;
     m_impl->dctx = ZSTD_createDCtx();
     CHECK(m_impl->dctx != NULL, "ZSTD_createDCtx() failed!");
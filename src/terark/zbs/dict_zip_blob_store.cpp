@@ -26,6 +26,7 @@
 #include <terark/thread/fiber_aio.hpp>
 #include <terark/util/autofree.hpp>
 #include <terark/util/crc.hpp>
+#include <terark/util/cpu_prefetch.hpp>
 #include <terark/util/profiling.hpp>
 #include <terark/util/sortable_strvec.hpp>
 #include <terark/util/sorted_uint_vec.hpp>
@@ -1983,10 +1984,16 @@ void DictZipBlobStoreBuilder::entropyStore(std::unique_ptr<terark::DictZipBlobSt
         if (!isOffsetsZipped) {
             std::unique_ptr<UintVecMin0::Builder> builder(
                 UintVecMin0::create_builder_by_max_value(m_zipDataSize, &m_fpWriter));
-            for (size_t i = 0; i < m_lengthCount; ++i) {
-                builder->push_back(offsetBase);
-                input >> delta;
-                offsetBase += delta;
+            size_t offsetBuf[256];
+            for (size_t i = 0; i < m_lengthCount; ) {
+                size_t cnt = std::min<size_t>(m_lengthCount - i, 256);
+                for (size_t j = 0; j < cnt; ++j) {
+                    offsetBuf[j] = offsetBase;
+                    input >> delta;
+                    offsetBase += delta;
+                }
+                builder->push_back_n(offsetBuf, cnt);
+                i += cnt;
             }
             builder->push_back(maxOffsetEnt = offsetBase);
             auto result = builder->finish();
@@ -2193,10 +2200,16 @@ void DictZipBlobStoreBuilder::finish(int flag) {
         else {
             std::unique_ptr<UintVecMin0::Builder> builder(
                 UintVecMin0::create_builder_by_max_value(m_zipDataSize, &m_fpWriter));
-            for (size_t i = 0; i < m_lengthCount; ++i) {
-                builder->push_back(offsetBase);
-                input >> delta;
-                offsetBase += delta;
+            size_t offsetBuf[256];
+            for (size_t i = 0; i < m_lengthCount; ) {
+                size_t cnt = std::min<size_t>(m_lengthCount - i, 256);
+                for (size_t j = 0; j < cnt; ++j) {
+                    offsetBuf[j] = offsetBase;
+                    input >> delta;
+                    offsetBase += delta;
+                }
+                builder->push_back_n(offsetBuf, cnt);
+                i += cnt;
             }
             builder->push_back(offsetBase);
             auto result = builder->finish();
@@ -2456,10 +2469,14 @@ void DictZipBlobStore::setDataMemory(const void* base, size_t size) {
 		TERARK_VERIFY_EQ(align_up(maxOffsets, 16), m_ptrList.size());
 	}
 	else {
-		for(size_t i = 0; i < m_numRecords; ++i) {
-            size_t offsetBeg = m_offsets[i + 0];
-            size_t offsetEnd = m_offsets[i + 1];
-			TERARK_VERIFY_LE(offsetBeg, offsetEnd);
+		size_t offsets[256 + 1];
+		for(size_t i = 0; i < m_numRecords; ) {
+			size_t cnt = std::min<size_t>(m_numRecords - i, 256);
+			m_offsets.get_range(i, i + cnt + 1, offsets);
+			for (size_t j = 0; j < cnt; ++j) {
+				TERARK_VERIFY_LE(offsets[j], offsets[j + 1]);
+			}
+			i += cnt;
 		}
         size_t maxOffsets = m_offsets[m_numRecords];
 		TERARK_VERIFY_EQ(align_up(maxOffsets, 16), m_ptrList.size());
@@ -2814,6 +2831,32 @@ struct DzCountingUnzipOutBuf {
 #undef CopyForward
 #undef UnzipOutBuf
 
+void DictZipBlobStore::prefetch_offsets(size_t recId) const {
+    assert(recId + 1 < m_offsets.size());
+    if (offsetsIsSortedUintVec()) {
+        TERARK_CPU_PREFETCH(m_zOffsets.get_index_addr(recId));
+    } else {
+        TERARK_CPU_PREFETCH(m_offsets.data() + m_offsets.uintbits() * recId / 8);
+    }
+}
+
+void DictZipBlobStore::prefetch_record(size_t recId) const {
+    assert(recId + 1 < m_offsets.size());
+    auto BegEnd = offsetGet2(recId, offsetsIsSortedUintVec());
+    TERARK_CPU_PREFETCH(m_ptrList.data() + BegEnd[0]);
+}
+
+void DictZipBlobStore::advise_willneed(size_t beg, size_t end) const {
+    assert(beg <= end);
+    if (beg == end)
+        return;
+    assert(end < m_offsets.size());
+    bool sorted = offsetsIsSortedUintVec();
+    size_t lo = offsetGet2(beg, sorted)[0];
+    size_t hi = offsetGet2(end - 1, sorted)[1];
+    mmap_advise_willneed(m_ptrList.data() + lo, hi - lo);
+}
+
 size_t DictZipBlobStore::get_record_size(size_t recId) const {
     assert(recId + 1 < m_offsets.size());
     if (terark_unlikely(Options::kNoEntropy != m_entropyAlgo)) {
@@ -186,6 +186,13 @@ public:
 	size_t mem_size() const override;
 	size_t get_record_size(size_t recID) const;
 
+    // for batch get: call prefetch_offsets on all ids, then prefetch_record
+    // on all ids, then get_record_append, thus cache misses are overlapped
+    void prefetch_offsets(size_t recID) const;
+    void prefetch_record(size_t recID) const;
+    // madvise(WILLNEED) the content bytes of records [beg, end)
+    void advise_willneed(size_t beg, size_t end) const;
+
 private:
     template<bool ZipOffset, int CheckSumLevel, EntropyAlgo Entropy, int EntropyInterLeave>
 	void get_record_append_tpl(size_t recId, valvec<byte_t>* recData) const;
@@ -13,6 +13,7 @@
 #include <terark/io/MemStream.hpp>
 #include <terark/io/IStreamWrapper.hpp>
 #include <terark/util/crc.hpp>
+#include <terark/util/cpu_prefetch.hpp>
 #include <terark/util/checksum_exception.hpp>
 #include <terark/util/mmap.hpp>
 #include <terark/zbs/xxhash_helper.hpp>
@@ -356,6 +357,27 @@ void EntropyZipBlobStore::swap(EntropyZipBlobStore& other) {
   std::swap(m_decoder_o1, other.m_decoder_o1);
 }
 
+void EntropyZipBlobStore::prefetch_offsets(size_t recID) const {
+    assert(recID + 1 < m_offsets.size());
+    TERARK_CPU_PREFETCH(m_offsets.get_index_addr(recID));
+}
+
+void EntropyZipBlobStore::prefetch_record(size_t recID) const {
+    assert(recID + 1 < m_offsets.size());
+    auto BegEnd = m_offsets.get2(recID); // offsets are in bits
+    TERARK_CPU_PREFETCH(m_content.data() + BegEnd[0] / 8);
+}
+
+void EntropyZipBlobStore::advise_willneed(size_t beg, size_t end) const {
+    assert(beg <= end);
+    if (beg == end)
+        return;
+    assert(end < m_offsets.size());
+    size_t lo = m_offsets[beg] / 8; // offsets are in bits
+    size_t hi = (m_offsets[end] + 7) / 8;
+    mmap_advise_willneed(m_content.data() + lo, hi - lo);
+}
+
 size_t EntropyZipBlobStore::mem_size() const {
     return m_content.size() + m_offsets.mem_size() + m_table.size();
 }
@@ -49,6 +49,13 @@ public:
     void save_mmap(function<void(const void*, size_t)> write) const override;
     using AbstractBlobStore::save_mmap;
 
+    // for batch get: call prefetch_offsets on all ids, then prefetch_record
+    // on all ids, then get_record_append, thus cache misses are overlapped
+    void prefetch_offsets(size_t recID) const;
+    void prefetch_record(size_t recID) const;
+    // madvise(WILLNEED) the content bytes of records [beg, end)
+    void advise_willneed(size_t beg, size_t end) const;
+
     size_t mem_size() const override;
     void reorder_zip_data(ZReorderMap& newToOld,
         function<void(const void* data, size_t size)> writeAppend,
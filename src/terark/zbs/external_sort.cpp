@@ -0,0 +1,721 @@
+#include "external_sort.hpp"
+#include "ZstdStream.hpp"
+#include <terark/set_op.hpp>
+#include <terark/valvec.hpp>
+#include <terark/io/var_int.hpp>
+#include <terark/thread/fiber_aio.hpp>
+#include <terark/util/parallel_radix_sort.hpp>
+#include <terark/util/throw.hpp>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#define ZSTD_STATIC_LINKING_ONLY // for ZSTD_estimateDStreamSize
+#include <zstd/zstd.h>
+
+namespace terark {
+
+// a record in a run file: var_uint klen, var_uint vlen, key, value
+static const size_t MaxRecordHeader = 2 * 10;
+
+namespace {
+
+struct Rec {
+	uint64_t offset; // in Batch::pool
+	uint32_t klen;
+	uint32_t vlen;
+};
+
+// sizeof(Rec) plus the temporary memory of parallel_radix_sort
+static const size_t RecMemCost = sizeof(Rec) + 2 * (8 + sizeof(Rec));
+
+struct Batch {
+	valvec<byte_t> pool; // key, value, key, value ...
+	valvec<Rec>    recs;
+
+	// valvec grows by doubling, so the memory is the capacity, and the
+	// temporary memory of sorting recs is per record
+	static size_t mem_size(size_t pool_cap, size_t recs_cap, size_t num) {
+		return pool_cap + sizeof(Rec) * recs_cap + (RecMemCost - sizeof(Rec)) * num;
+	}
+	bool has_room(size_t len) const {
+		return pool.size() + len <= pool.capacity() && recs.size() < recs.capacity();
+	}
+	// capacities to add one more record of len bytes: pool grows by doubling
+	// but not beyond what is left of limit, recs grows by doubling, the
+	// result may exceed limit, then the caller should spill first
+	void grown_cap(size_t len, size_t limit, size_t* pool_cap, size_t* recs_cap) const {
+		size_t num = recs.size() + 1;
+		*recs_cap = recs.capacity();
+		if (num > *recs_cap)
+			*recs_cap = std::max<size_t>(2 * *recs_cap, 256);
+		*pool_cap = pool.capacity();
+		if (pool.size() + len > *pool_cap) {
+			size_t other = mem_size(0, *recs_cap, num);
+			size_t room = limit > other ? limit - other : 0;
+			*pool_cap = std::min(std::max<size_t>(2 * *pool_cap, 4096), room);
+			*pool_cap = std::max(*pool_cap, pool.size() + len);
+		}
+	}
+	fstring key(const Rec& r) const {
+		return fstring(pool.data() + r.offset, r.klen);
+	}
+	fstring value(const Rec& r) const {
+		return fstring(pool.data() + r.offset + r.klen, r.vlen);
+	}
+	void sort(size_t threads) {
+		const byte_t* base = pool.data();
+		parallel_radix_sort(recs.data(), recs.size(), [base](const Rec& r) {
+			return fstring(base + r.offset, r.klen);
+		}, threads);
+	}
+};
+
+struct RunFile {
+	std::string path;
+	uint64_t file_size; // compressed size if compressed
+	uint64_t raw_size;
+	uint64_t num;
+};
+
+// writes records to a new temporary file, the file is removed if the
+// writer is destroyed before finish()
+class RunWriter : public IOutputStream {
+	std::string    m_path;
+	int            m_fd;
+	int            m_err;
+	uint64_t       m_file_size;
+	uint64_t       m_raw_size;
+	uint64_t       m_num;
+	size_t         m_block_size;
+	valvec<byte_t> m_buf;
+	std::unique_ptr<ZstdOutputStream> m_zstd;
+
+	void flush_buf() {
+		if (m_zstd)
+			m_zstd->write(m_buf.data(), m_buf.size());
+		else
+			write(m_buf.data(), m_buf.size());
+		m_buf.risk_set_size(0);
+	}
+
+public:
+	explicit RunWriter(const ExternalSorter::Options& opt) {
+		m_path = opt.tmp_dir + "/terark-extsort-XXXXXX";
+		m_fd = mkstemp(&m_path[0]);
+		if (m_fd < 0) {
+			THROW_STD(runtime_error, "mkstemp(%s) = %s", m_path.c_str(),
+					  strerror(errno));
+		}
+		m_err = 0;
+		m_file_size = 0;
+		m_raw_size = 0;
+		m_num = 0;
+		m_block_size = opt.read_block_size;
+		m_buf.reserve(m_block_size);
+		if (opt.zstd_level > 0) {
+			m_zstd.reset(new ZstdOutputStream(this));
+			m_zstd->setCLevel(opt.zstd_level);
+		}
+	}
+	~RunWriter() override {
+		m_zstd.reset(); // it writes to this in its destructor
+		if (m_fd >= 0) {
+			::close(m_fd);
+			::remove(m_path.c_str());
+		}
+	}
+
+	// the error is checked by finish(), ZstdOutputStream can not throw
+	size_t write(const void* vbuf, size_t len) override {
+		auto buf = (const byte_t*)vbuf;
+		size_t n = 0;
+		while (n < len && 0 == m_err) {
+			ssize_t ret = ::write(m_fd, buf + n, len - n);
+			if (ret < 0) {
+				if (EINTR != errno)
+					m_err = errno;
+			}
+			else n += ret;
+		}
+		m_file_size += n;
+		return n;
+	}
+	void flush() override {}
+
+	void append(fstring key, fstring value) {
+		byte_t  hdr[MaxRecordHeader];
+		byte_t* end = save_var_uint64(hdr, key.size());
+		end = save_var_uint64(end, value.size());
+		size_t  len = (end - hdr) + key.size() + value.size();
+		if (m_buf.size() + len > m_block_size && !m_buf.empty())
+			flush_buf();
+		m_buf.append(hdr, end);
+		m_buf.append(key.udata(), key.size());
+		m_buf.append(value.udata(), value.size());
+		m_raw_size += len;
+		m_num++;
+	}
+
+	RunFile finish() {
+		flush_buf();
+		if (m_zstd)
+			m_zstd->close();
+		m_zstd.reset();
+		if (m_err) {
+			THROW_STD(runtime_error, "write(%s) = %s", m_path.c_str(),
+					  strerror(m_err));
+		}
+		::close(m_fd);
+		m_fd = -1;
+		return RunFile{m_path, m_file_size, m_raw_size, m_num};
+	}
+};
+
+class RunReader;
+
+// threads which load the blocks of RunReader by fiber_aio_read
+class IoQueue {
+public:
+	std::mutex              m_mtx;
+	std::condition_variable m_load_cond; // for io threads
+	std::condition_variable m_done_cond; // for the merge thread
+private:
+	std::deque<std::pair<RunReader*, size_t> > m_queue;
+	std::vector<std::thread> m_threads;
+	bool m_stop;
+
+	void io_proc();
+
+public:
+	explicit IoQueue(size_t num_threads) {
+		m_stop = false;
+		for (size_t i = 0; i < std::max<size_t>(num_threads, 1); ++i)
+			m_threads.emplace_back(&IoQueue::io_proc, this);
+	}
+	// pending loads are dropped
+	~IoQueue() {
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_stop = true;
+		}
+		m_load_cond.notify_all();
+		for (auto& t : m_threads)
+			t.join();
+	}
+	// must hold m_mtx
+	void push(RunReader* r, size_t blk) {
+		m_queue.emplace_back(r, blk);
+		m_load_cond.notify_one();
+	}
+};
+
+// reads a run file by 2 blocks, one block is consumed by read() while the
+// other one is loaded by IoQueue
+class RunReader : public IInputStream {
+	enum BlockState { Empty, Loading, Ready };
+	struct Block {
+		valvec<byte_t> buf;
+		uint64_t   offset = 0; // in the file
+		size_t     len = 0;
+		size_t     pos = 0;
+		BlockState state = Empty; // guarded by IoQueue::m_mtx
+		int        err = 0;
+	};
+	IoQueue* m_io;
+	int      m_fd;
+	uint64_t m_file_size;
+	uint64_t m_next_offset; // of the next block to load
+	size_t   m_cur;
+	bool     m_cur_ready; // m_blocks[m_cur] is known to be Ready or Empty
+	bool     m_eof;
+	Block    m_blocks[2];
+	std::string m_path;
+
+	// must hold m_io->m_mtx
+	void submit(size_t blk) {
+		Block& b = m_blocks[blk];
+		if (m_next_offset < m_file_size) {
+			b.len = size_t(std::min<uint64_t>(b.buf.capacity(),
+											  m_file_size - m_next_offset));
+			b.offset = m_next_offset;
+			b.pos = 0;
+			b.state = Loading;
+			m_io->push(this, blk);
+			m_next_offset += b.len;
+		} else {
+			b.state = Empty;
+		}
+	}
+
+	// return false if there is no more data
+	bool wait_cur() {
+		Block& b = m_blocks[m_cur];
+		std::unique_lock<std::mutex> lock(m_io->m_mtx);
+		m_io->m_done_cond.wait(lock, [&]{ return Loading != b.state; });
+		if (b.err) {
+			THROW_STD(runtime_error, "fiber_aio_read(%s) = %s", m_path.c_str(),
+					  strerror(b.err));
+		}
+		return Ready == b.state;
+	}
+
+public:
+	RunReader(IoQueue* io, const RunFile& run, size_t block_size) {
+		m_io = io;
+		m_file_size = run.file_size;
+		m_next_offset = 0;
+		m_cur = 0;
+		m_cur_ready = false;
+		m_eof = false;
+		m_path = run.path;
+		m_fd = ::open(run.path.c_str(), O_RDONLY);
+		if (m_fd < 0) {
+			THROW_STD(runtime_error, "open(%s, O_RDONLY) = %s",
+					  run.path.c_str(), strerror(errno));
+		}
+	#if defined(POSIX_FADV_SEQUENTIAL)
+		posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	#endif
+		for (Block& b : m_blocks)
+			b.buf.reserve(block_size);
+	}
+	~RunReader() override {
+		::close(m_fd);
+	}
+
+	void start() {
+		std::lock_guard<std::mutex> lock(m_io->m_mtx);
+		submit(0);
+		submit(1);
+	}
+
+	// called by io threads without lock
+	void load(size_t blk) {
+		Block& b = m_blocks[blk];
+		size_t n = 0;
+		int err = 0;
+		while (n < b.len) {
+			intptr_t ret = fiber_aio_read(m_fd, b.buf.data() + n, b.len - n,
+										  off_t(b.offset + n));
+			if (ret < 0) {
+				if (EINTR == errno)
+					continue;
+				err = errno;
+				break;
+			}
+			if (0 == ret) {
+				err = EIO; // file is truncated
+				break;
+			}
+			n += ret;
+		}
+		std::lock_guard<std::mutex> lock(m_io->m_mtx);
+		b.pos = 0;
+		b.err = err;
+		b.state = Ready;
+		m_io->m_done_cond.notify_all();
+	}
+
+	size_t read(void* vbuf, size_t len) override {
+		auto buf = (byte_t*)vbuf;
+		size_t n = 0;
+		while (n < len) {
+			if (!m_cur_ready) {
+				if (!wait_cur()) {
+					m_eof = true;
+					break;
+				}
+				m_cur_ready = true;
+			}
+			Block& b = m_blocks[m_cur];
+			if (b.pos == b.len) { // refill it and switch to the other one
+				std::lock_guard<std::mutex> lock(m_io->m_mtx);
+				submit(m_cur);
+				m_cur ^= 1;
+				m_cur_ready = false;
+				continue;
+			}
+			size_t k = std::min(len - n, b.len - b.pos);
+			memcpy(buf + n, b.buf.data() + b.pos, k);
+			b.pos += k;
+			n += k;
+		}
+		return n;
+	}
+	bool eof() const override { return m_eof; }
+};
+
+void IoQueue::io_proc() {
+	std::unique_lock<std::mutex> lock(m_mtx);
+	for (;;) {
+		m_load_cond.wait(lock, [&]{ return m_stop || !m_queue.empty(); });
+		if (m_stop)
+			break;
+		auto req = m_queue.front();
+		m_queue.pop_front();
+		lock.unlock();
+		req.first->load(req.second);
+		lock.lock();
+	}
+}
+
+struct MergeKey {
+	fstring key;
+	bool    is_max = false; // the end of a run
+};
+
+struct MergeKeyLess {
+	bool operator()(const MergeKey& x, const MergeKey& y) const {
+		if (terark_unlikely(y.is_max)) return !x.is_max;
+		if (terark_unlikely(x.is_max)) return false;
+		return x.key < y.key;
+	}
+};
+
+// a run in the merge, decodes records into a window
+class MergeWay {
+public:
+	MergeKey m_key;
+	fstring  m_value;
+private:
+	RunReader      m_reader;
+	std::unique_ptr<ZstdInputStream> m_zstd;
+	IInputStream*  m_src;
+	uint64_t       m_remain_raw; // not yet read from m_src
+	uint64_t       m_remain_num;
+	valvec<byte_t> m_win;
+	size_t         m_pos;
+	std::string    m_path;
+
+	// make m_win[m_pos, m_pos + n) available, m_win may be moved
+	void ensure(size_t n) {
+		size_t avail = m_win.size() - m_pos;
+		if (avail >= n)
+			return;
+		memmove(m_win.data(), m_win.data() + m_pos, avail);
+		m_win.risk_set_size(avail);
+		m_pos = 0;
+		if (n > m_win.capacity())
+			m_win.reserve(std::max(n, 2 * m_win.capacity()));
+		size_t want = size_t(std::min<uint64_t>(m_win.capacity() - avail, m_remain_raw));
+		if (avail + want < n) {
+			THROW_STD(runtime_error, "run file %s is corrupted", m_path.c_str());
+		}
+		size_t got = m_src->read(m_win.data() + avail, want);
+		if (got != want) {
+			THROW_STD(runtime_error, "run file %s is truncated", m_path.c_str());
+		}
+		m_remain_raw -= got;
+		m_win.risk_set_size(avail + got);
+	}
+
+public:
+	MergeWay(IoQueue* io, const RunFile& run, size_t block_size)
+	  : m_reader(io, run, block_size) {
+		m_src = &m_reader;
+		m_remain_raw = run.raw_size;
+		m_remain_num = run.num;
+		m_win.reserve(block_size);
+		m_pos = 0;
+		m_path = run.path;
+	}
+	void use_zstd() {
+		m_zstd.reset(new ZstdInputStream(&m_reader));
+		m_src = m_zstd.get();
+	}
+	void start() { m_reader.start(); }
+
+	void advance() {
+		if (0 == m_remain_num) {
+			m_key.is_max = true;
+			m_key.key = fstring();
+			m_value = fstring();
+			return;
+		}
+		ensure(size_t(std::min<uint64_t>(MaxRecordHeader,
+								m_win.size() - m_pos + m_remain_raw)));
+		const byte_t* hdr = m_win.data() + m_pos;
+		const byte_t* end = hdr;
+		uint64_t klen = load_var_uint64(end, &end);
+		uint64_t vlen = load_var_uint64(end, &end);
+		size_t hlen = end - hdr;
+		ensure(hlen + klen + vlen);
+		const char* p = (const char*)m_win.data() + m_pos + hlen;
+		m_key.key = fstring(p, klen);
+		m_value = fstring(p + klen, vlen);
+		m_pos += hlen + klen + vlen;
+		m_remain_num--;
+	}
+};
+
+class MergeWayIter {
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef MergeWay  value_type;
+	typedef ptrdiff_t difference_type;
+	typedef MergeWay* pointer;
+	typedef MergeWay& reference;
+
+	MergeWay* p;
+	explicit MergeWayIter(MergeWay* q) : p(q) {}
+	MergeWay& operator*() const { return *p; }
+	MergeWayIter& operator++() { p->advance(); return *this; }
+};
+
+struct MergeKeyOf {
+	const MergeKey& operator()(const MergeWay& w) const { return w.m_key; }
+};
+
+// merges runs[beg, end)
+class Merger {
+	std::vector<std::unique_ptr<MergeWay> > m_ways;
+	IoQueue m_io; // destroyed before m_ways
+	multi_way::LoserTree<MergeWayIter, MergeKey, false, MergeKeyLess, MergeKeyOf,
+						 multi_way::tag_cache_key> m_tree;
+	bool m_started;
+
+public:
+	Merger(const RunFile* runs, size_t num, const ExternalSorter::Options& opt)
+	  : m_io(opt.io_threads), m_tree(MergeKey{fstring(), true}) {
+		m_started = false;
+		for (size_t i = 0; i < num; ++i) {
+			m_ways.emplace_back(new MergeWay(&m_io, runs[i], opt.read_block_size));
+			if (opt.zstd_level > 0)
+				m_ways.back()->use_zstd();
+		}
+		for (auto& w : m_ways)
+			w->start(); // all runs are loading
+		for (auto& w : m_ways) {
+			w->advance(); // load the first record
+			m_tree.m_ways.push_back(MergeWayIter(w.get()));
+		}
+		m_tree.start();
+	}
+
+	bool next(fstring* key, fstring* value) {
+		if (m_tree.empty())
+			return false;
+		if (m_started) {
+			m_tree.increment();
+			if (m_tree.empty())
+				return false;
+		}
+		m_started = true;
+		const MergeWay& w = m_tree.current_value();
+		*key = w.m_key.key;
+		*value = w.m_value;
+		return true;
+	}
+};
+
+} // namespace
+
+class ExternalSorter::Impl {
+public:
+	Options  m_opt;
+	size_t   m_batch_limit;
+	size_t   m_max_ways;
+	Batch    m_batch; // filled by add()
+	Batch    m_spill; // written by m_spill_thread
+	std::thread m_spill_thread;
+	std::exception_ptr m_spill_err;
+	std::vector<RunFile> m_runs;
+	std::unique_ptr<Merger> m_merger;
+	size_t   m_num_records;
+	size_t   m_num_runs;
+	size_t   m_num_merges;
+	size_t   m_mem_pos; // when sorted in memory
+	bool     m_finished;
+
+	explicit Impl(const Options& opt) : m_opt(opt) {
+		if (m_opt.read_block_size < 4096)
+			m_opt.read_block_size = 4096;
+		if (m_opt.tmp_dir.empty())
+			m_opt.tmp_dir = ".";
+		// 2 batches, the write buffer of a run is one block
+		m_batch_limit = m_opt.memory_budget / 2;
+		if (m_batch_limit > m_opt.read_block_size)
+			m_batch_limit -= m_opt.read_block_size;
+		size_t way_mem = 3 * m_opt.read_block_size;
+		if (m_opt.zstd_level > 0) {
+			auto cp = ZSTD_getCParams(m_opt.zstd_level, 0, 0);
+			way_mem += ZSTD_estimateDStreamSize(size_t(1) << cp.windowLog);
+		}
+		m_max_ways = std::max<size_t>(m_opt.memory_budget / way_mem, 2);
+		m_num_records = 0;
+		m_num_runs = 0;
+		m_num_merges = 0;
+		m_mem_pos = 0;
+		m_finished = false;
+	}
+	~Impl() {
+		m_merger.reset();
+		if (m_spill_thread.joinable())
+			m_spill_thread.join();
+		for (auto& run : m_runs)
+			::remove(run.path.c_str());
+	}
+
+	void write_run(Batch& b) {
+		b.sort(m_opt.sort_threads);
+		RunWriter w(m_opt);
+		for (const Rec& r : b.recs)
+			w.append(b.key(r), b.value(r));
+		RunFile run = w.finish();
+		m_runs.push_back(run); // not concurrent with the other thread
+		b.pool.risk_set_size(0); // keep the memory for the next batch
+		b.recs.risk_set_size(0);
+	}
+
+	void join_spill() {
+		if (m_spill_thread.joinable())
+			m_spill_thread.join();
+		if (m_spill_err) {
+			std::exception_ptr err = m_spill_err;
+			m_spill_err = nullptr;
+			std::rethrow_exception(err);
+		}
+	}
+
+	void spill() {
+		join_spill();
+		std::swap(m_batch, m_spill);
+		m_num_runs++;
+		m_spill_thread = std::thread([this]() {
+			try {
+				write_run(m_spill);
+			} catch (...) {
+				m_spill_err = std::current_exception();
+			}
+		});
+	}
+
+	void add(fstring key, fstring value) {
+		if (m_finished) {
+			THROW_STD(logic_error, "add() after finish()");
+		}
+		if (key.size() > UINT32_MAX || value.size() > UINT32_MAX) {
+			THROW_STD(length_error, "key.size() = %zd, value.size() = %zd",
+					  key.size(), value.size());
+		}
+		size_t len = key.size() + value.size();
+		if (!m_batch.has_room(len)) {
+			// grow the batch explicitly, so its real memory is in the limit
+			size_t pool_cap, recs_cap;
+			m_batch.grown_cap(len, m_batch_limit, &pool_cap, &recs_cap);
+			if (!m_batch.recs.empty() &&
+					m_batch.mem_size(pool_cap, recs_cap, m_batch.recs.size() + 1) > m_batch_limit) {
+				spill(); // m_batch is now the empty batch of the previous spill
+				m_batch.grown_cap(len, m_batch_limit, &pool_cap, &recs_cap);
+			}
+			m_batch.pool.reserve(pool_cap);
+			m_batch.recs.reserve(recs_cap);
+		}
+		Batch& b = m_batch;
+		b.recs.unchecked_push_back(Rec{b.pool.size(), uint32_t(key.size()), uint32_t(value.size())});
+		b.pool.append(key.udata(), key.size());
+		b.pool.append(value.udata(), value.size());
+		m_num_records++;
+	}
+
+	void finish() {
+		if (m_finished) {
+			THROW_STD(logic_error, "finish() is called twice");
+		}
+		m_finished = true;
+		join_spill();
+		if (m_runs.empty()) {
+			m_batch.sort(m_opt.sort_threads);
+			m_spill.pool.clear();
+			m_spill.recs.clear();
+			return;
+		}
+		if (!m_batch.recs.empty()) {
+			m_num_runs++;
+			write_run(m_batch);
+		}
+		m_batch.pool.clear(); // free the memory for the merge
+		m_batch.recs.clear();
+		m_spill.pool.clear();
+		m_spill.recs.clear();
+		while (m_runs.size() > m_max_ways) {
+			// merge just enough runs to let the final merge fit
+			size_t k = std::min(m_max_ways, m_runs.size() - m_max_ways + 1);
+			RunFile run;
+			{
+				Merger merger(m_runs.data(), k, m_opt);
+				RunWriter w(m_opt);
+				fstring key, value;
+				while (merger.next(&key, &value))
+					w.append(key, value);
+				run = w.finish();
+			}
+			for (size_t i = 0; i < k; ++i)
+				::remove(m_runs[i].path.c_str());
+			m_runs.erase(m_runs.begin(), m_runs.begin() + k);
+			m_runs.push_back(run);
+			m_num_merges++;
+		}
+		m_merger.reset(new Merger(m_runs.data(), m_runs.size(), m_opt));
+	}
+};
+
+ExternalSorter::ExternalSorter() : ExternalSorter(Options()) {}
+
+ExternalSorter::ExternalSorter(const Options& opt) {
+	m_impl = new Impl(opt);
+	m_next = &ExternalSorter::next_not_finished;
+}
+
+ExternalSorter::~ExternalSorter() {
+	delete m_impl;
+}
+
+void ExternalSorter::add(fstring key, fstring value) {
+	m_impl->add(key, value);
+}
+
+void ExternalSorter::finish() {
+	m_impl->finish();
+	if (m_impl->m_merger)
+		m_next = &ExternalSorter::next_merge;
+	else
+		m_next = &ExternalSorter::next_in_memory;
+}
+
+bool ExternalSorter::next_not_finished() {
+	THROW_STD(logic_error, "next() before finish()");
+}
+
+bool ExternalSorter::next_in_memory() {
+	const Batch& b = m_impl->m_batch;
+	size_t pos = m_impl->m_mem_pos;
+	if (pos == b.recs.size())
+		return false;
+	m_key = b.key(b.recs[pos]);
+	m_value = b.value(b.recs[pos]);
+	m_impl->m_mem_pos = pos + 1;
+	return true;
+}
+
+bool ExternalSorter::next_merge() {
+	return m_impl->m_merger->next(&m_key, &m_value);
+}
+
+const ExternalSorter::Options& ExternalSorter::options() const {
+	return m_impl->m_opt;
+}
+size_t ExternalSorter::num_records() const { return m_impl->m_num_records; }
+size_t ExternalSorter::num_runs() const { return m_impl->m_num_runs; }
+size_t ExternalSorter::num_intermediate_merges() const { return m_impl->m_num_merges; }
+size_t ExternalSorter::max_merge_ways() const { return m_impl->m_max_ways; }
+
+} // namespace terark
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <terark/fstring.hpp>
+#include <string>
+
+namespace terark {
+
+/// External memory sort of key/value records, for inputs much larger than
+/// the memory, keys are in the order of fstring, the order of records with
+/// equal keys is unspecified.
+///
+/// Records are appended to an in memory batch, a full batch is sorted by
+/// parallel_radix_sort and written as a sorted run on a background thread
+/// while add() fills the next batch, runs are optionally Zstd compressed.
+/// finish() merges the runs by a LoserTree, each run is read by two blocks:
+/// one is decoded by the merge while the other is read by fiber_aio_read on
+/// the io threads. If there are more runs than the memory budget can merge
+/// at once, some of them are merged into larger runs first. If all records
+/// fit in one batch, nothing is written and the batch is iterated in memory.
+///
+/// Usage:
+///   ExternalSorter sorter(opt);
+///   for (...) sorter.add(key, value);
+///   sorter.finish();
+///   while (sorter.next()) use(sorter.key(), sorter.value());
+///
+/// The temporary files are created in tmp_dir and removed when they are
+/// merged or when the sorter is destroyed.
+class TERARK_DLL_EXPORT ExternalSorter {
+	DECLARE_NONE_COPYABLE_CLASS(ExternalSorter)
+public:
+	struct Options {
+		/// the batches of run generation and the read buffers of the
+		/// merge are limited by this, it does not include the heap overhead
+		size_t      memory_budget = size_t(1) << 30;
+		std::string tmp_dir = "/tmp";
+		/// threads of parallel_radix_sort, 0 means hardware_concurrency
+		size_t      sort_threads = 0;
+		/// threads which call fiber_aio_read in the merge
+		size_t      io_threads = 2;
+		/// 0 means the runs are not compressed
+		int         zstd_level = 0;
+		/// size of a read block of a run, a run uses 3 blocks in the merge:
+		/// 2 blocks for double buffered reads and a decode window
+		size_t      read_block_size = size_t(1) << 20;
+	};
+	ExternalSorter();
+	explicit ExternalSorter(const Options&);
+	~ExternalSorter();
+
+	void add(fstring key, fstring value);
+
+	/// no more add(), after finish() the records are read by next()
+	void finish();
+
+	/// move to the next record, return false at end, the first call moves
+	/// to the smallest record. key() and value() are valid until the next
+	/// call of next()
+	bool next() { return (this->*m_next)(); }
+	fstring key() const { return m_key; }
+	fstring value() const { return m_value; }
+
+	const Options& options() const;
+	size_t num_records() const;
+	/// number of runs written by run generation, 0 if sorted in memory
+	size_t num_runs() const;
+	/// number of merges which write a larger run before the final merge
+	size_t num_intermediate_merges() const;
+	/// max number of runs merged at once, limited by memory_budget
+	size_t max_merge_ways() const;
+
+	class Impl;
+private:
+	bool next_not_finished();
+	bool next_in_memory();
+	bool next_merge();
+
+	Impl*   m_impl;
+	bool  (ExternalSorter::*m_next)();
+	fstring m_key;
+	fstring m_value;
+};
+
+} // namespace terark
@@ -13,6 +13,7 @@
 #include <terark/io/IStreamWrapper.hpp>
 #include <terark/thread/fiber_aio.hpp>
 #include <terark/util/crc.hpp>
+#include <terark/util/cpu_prefetch.hpp>
 #include <terark/util/checksum_exception.hpp>
 #include <terark/util/mmap.hpp>
 #include <terark/zbs/xxhash_helper.hpp>
@@ -47,7 +48,8 @@ struct ZipOffsetBlobStore::FileHeader : public FileHeaderBase {
     uint08_t  offsets_log2_blockUnits; // 6 or 7
     uint08_t  checksumLevel;
     uint08_t  compressLevel;
-    uint08_t  padding21[5];
+    uint08_t  offsetsFormat; // 0: SortedUintVec, 1: EliasFanoUintVec, formatVersion >= 1
+    uint08_t  padding21[4];
     uint64_t  padding22[3];
 
     void init() {
@@ -56,6 +58,7 @@ struct ZipOffsetBlobStore::FileHeader : public FileHeaderBase {
         magic_len = MagicStrLen;
         strcpy(magic, MagicString);
         strcpy(className, "ZipOffsetBlobStore");
+        formatVersion = 1; // offsetsFormat is valid since version 1
     }
     FileHeader(fstring mem, size_t content_size, size_t offsets_size, Options _options) {
         init();
@@ -65,30 +68,40 @@ struct ZipOffsetBlobStore::FileHeader : public FileHeaderBase {
             + align_up(content_size, 16)
             + offsets_size
             + sizeof(BlobStoreFileFooter));
-        SortedUintVec offsets;
-        offsets.risk_set_data(mem.data() + sizeof(FileHeader) + align_up(content_size, 16), offsets_size);
+        auto offsets_mem = mem.data() + sizeof(FileHeader) + align_up(content_size, 16);
+        if (kEliasFanoOffsets == _options.offsets_format) {
+            EliasFanoUintVec offsets;
+            offsets.risk_set_data(offsets_mem, offsets_size);
+            records = offsets.size() - 1;
+            offsets.risk_release_ownership();
+        } else {
+            SortedUintVec offsets;
+            offsets.risk_set_data(offsets_mem, offsets_size);
+            records = offsets.size() - 1;
+            offsets_log2_blockUnits = offsets.log2_block_units();
+            offsets.risk_release_ownership();
+        }
         unzipSize = content_size;
-        records = offsets.size() - 1;
         contentBytes = content_size;
         offsetsBytes = offsets_size;
-        offsets_log2_blockUnits = offsets.log2_block_units();
-        offsets.risk_release_ownership();
+        offsetsFormat = static_cast<uint08_t>(_options.offsets_format);
         checksumLevel = static_cast<uint08_t>(_options.checksum_level);
         checksumType = static_cast<uint08_t>(_options.checksum_type);
         compressLevel = static_cast<uint08_t>(_options.compress_level);
     }
-    FileHeader(const ZipOffsetBlobStore* store, const SortedUintVec& offsets) {
+    FileHeader(const ZipOffsetBlobStore* store, size_t offsets_size, size_t offsets_log2) {
         init();
         fileSize = 0
             + sizeof(FileHeader)
             + align_up(store->m_content.size(), 16)
-            + offsets.mem_size()
+            + offsets_size
             + sizeof(BlobStoreFileFooter);
         unzipSize = store->m_content.size();
         records = store->m_numRecords;
         contentBytes = store->m_content.size();
-        offsetsBytes = offsets.mem_size();
-        offsets_log2_blockUnits = offsets.log2_block_units();
+        offsetsBytes = offsets_size;
+        offsets_log2_blockUnits = static_cast<uint08_t>(offsets_log2);
+        offsetsFormat = static_cast<uint08_t>(store->m_offsetsFormat);
         checksumLevel = static_cast<uint08_t>(store->m_checksumLevel);
         checksumType = static_cast<uint08_t>(store->m_checksumType);
         compressLevel = static_cast<uint08_t>(store->m_compressLevel);
@@ -103,7 +116,22 @@ void ZipOffsetBlobStore::init_from_memory(fstring dataMem, Dictionary/*dict*/) {
     m_checksumLevel = mmapBase->checksumLevel;
     m_checksumType = mmapBase->checksumType;
     m_compressLevel = mmapBase->compressLevel;
+    if (mmapBase->formatVersion > 1) {
+        TERARK_THROW(std::invalid_argument
+            , "ZipOffsetBlobStore(\"%s\"): unknown formatVersion = %d"
+            , get_fpath().c_str(), int(mmapBase->formatVersion)
+        );
+    }
+    // offsetsFormat was padding in version 0, which is always SortedUintVec
+    m_offsetsFormat = mmapBase->formatVersion >= 1 ? int(mmapBase->offsetsFormat)
+                                                   : int(kSortedUintVecOffsets);
     m_supportZeroCopy = (0 == m_compressLevel);
+    if (m_offsetsFormat > kEliasFanoOffsets) {
+        TERARK_THROW(std::invalid_argument
+            , "ZipOffsetBlobStore(\"%s\"): unknown offsetsFormat = %d"
+            , get_fpath().c_str(), m_offsetsFormat
+        );
+    }
     if (m_checksumLevel == 3 && isChecksumVerifyEnabled()) {
         XXHash64 hash(g_dpbsnark_seed);
         hash.update(mmapBase, mmapBase->fileSize - sizeof(BlobStoreFileFooter));
@@ -115,19 +143,23 @@ void ZipOffsetBlobStore::init_from_memory(fstring dataMem, Dictionary/*dict*/) {
         }
     }
     m_content.risk_set_data((byte_t*)(mmapBase + 1), mmapBase->contentBytes);
-    m_offsets.risk_set_data(m_content.data() + align_up(m_content.size(), 16), mmapBase->offsetsBytes);
-    assert(m_offsets.size() == mmapBase->records+1);
-    assert(m_offsets.mem_size() == mmapBase->offsetsBytes);
-    if (m_offsets.size() != mmapBase->records+1) {
+    auto offsets_base = m_content.data() + align_up(m_content.size(), 16);
+    if (kEliasFanoOffsets == m_offsetsFormat)
+        m_ef_offsets.risk_set_data(offsets_base, mmapBase->offsetsBytes);
+    else
+        m_offsets.risk_set_data(offsets_base, mmapBase->offsetsBytes);
+    assert(offsets_size() == mmapBase->records+1);
+    assert(offsets_mem().size() == mmapBase->offsetsBytes);
+    if (offsets_size() != mmapBase->records+1) {
         TERARK_THROW(std::length_error
             , "m_offsets.size() = %zd, mmapBase->records+1 = %lld, must be equal"
-            ,  m_offsets.size(), llong(mmapBase->records+1)
+            ,  offsets_size(), llong(mmapBase->records+1)
         );
     }
-    if (m_offsets.mem_size() != mmapBase->offsetsBytes) {
+    if (offsets_mem().size() != mmapBase->offsetsBytes) {
         TERARK_THROW(std::length_error
             , "m_offsets.mem_size() = %zd, footer.indexBytes = %lld, must be equal"
-            ,  m_offsets.mem_size(), llong(mmapBase->offsetsBytes)
+            ,  offsets_mem().size(), llong(mmapBase->offsetsBytes)
         );
     }
     set_func();
@@ -135,7 +167,7 @@ void ZipOffsetBlobStore::init_from_memory(fstring dataMem, Dictionary/*dict*/) {
 
 void ZipOffsetBlobStore::get_meta_blocks(valvec<Block>* blocks) const {
     blocks->erase_all();
-    blocks->push_back({"offsets", {m_offsets.data(), (ptrdiff_t)m_offsets.mem_size()}});
+    blocks->push_back({"offsets", offsets_mem()});
 }
 
 void ZipOffsetBlobStore::get_data_blocks(valvec<Block>* blocks) const {
@@ -147,13 +179,22 @@ void ZipOffsetBlobStore::detach_meta_blocks(const valvec<Block>& blocks) {
     assert(!m_isDetachMeta);
     assert(blocks.size() == 1);
     auto offset_mem = blocks.front().data;
-    assert(offset_mem.size() == m_offsets.mem_size());
-    if (m_isUserMem) {
-        m_offsets.risk_release_ownership();
+    assert(offset_mem.size() == offsets_mem().size());
+    if (kEliasFanoOffsets == m_offsetsFormat) {
+        if (m_isUserMem) {
+            m_ef_offsets.risk_release_ownership();
+        } else {
+            m_ef_offsets.clear();
+        }
+        m_ef_offsets.risk_set_data(offset_mem.data(), offset_mem.size());
     } else {
-        m_offsets.clear();
+        if (m_isUserMem) {
+            m_offsets.risk_release_ownership();
+        } else {
+            m_offsets.clear();
+        }
+        m_offsets.risk_set_data((byte_t*)offset_mem.data(), offset_mem.size());
     }
-    m_offsets.risk_set_data((byte_t*)offset_mem.data(), offset_mem.size());
     m_isDetachMeta = true;
 }
 
@@ -161,9 +202,11 @@ void ZipOffsetBlobStore::save_mmap(function<void(const void*, size_t)> write) co
     FunctionAdaptBuffer adaptBuffer(write);
     OutputBuffer buffer(&adaptBuffer);
 
-    assert(m_offsets.mem_size() % 16 == 0);
+    fstring offsets = offsets_mem();
+    assert(offsets.size() % 16 == 0);
     XXHash64 xxhash64(g_dpbsnark_seed);
-    FileHeader header(this, m_offsets);
+    size_t log2 = kEliasFanoOffsets == m_offsetsFormat ? 0 : m_offsets.log2_block_units();
+    FileHeader header(this, offsets.size(), log2);
 
     xxhash64.update(&header, sizeof header);
     buffer.ensureWrite(&header, sizeof(header));
@@ -173,17 +216,30 @@ void ZipOffsetBlobStore::save_mmap(function<void(const void*, size_t)> write) co
 
     PadzeroForAlign<16>(buffer, xxhash64, m_content.size());
 
-    xxhash64.update(m_offsets.data(), m_offsets.mem_size());
-    buffer.ensureWrite(m_offsets.data(), m_offsets.mem_size());
+    xxhash64.update(offsets.data(), offsets.size());
+    buffer.ensureWrite(offsets.data(), offsets.size());
 
     BlobStoreFileFooter footer;
     footer.fileXXHash = xxhash64.digest();
     buffer.ensureWrite(&footer, sizeof footer);
 }
 
+size_t ZipOffsetBlobStore::offsets_size() const {
+    if (kEliasFanoOffsets == m_offsetsFormat)
+        return m_ef_offsets.size();
+    return m_offsets.size();
+}
+
+fstring ZipOffsetBlobStore::offsets_mem() const {
+    if (kEliasFanoOffsets == m_offsetsFormat)
+        return fstring(m_ef_offsets.data(), m_ef_offsets.mem_size());
+    return fstring(m_offsets.data(), m_offsets.mem_size());
+}
+
 ZipOffsetBlobStore::ZipOffsetBlobStore() {
     m_checksumLevel = 3; // check all data
     m_checksumType = 0;  // crc32c
+    m_offsetsFormat = kSortedUintVecOffsets;
     m_get_record_append = nullptr;
     m_fspread_record_append = nullptr;
     m_get_record_append_CacheOffsets = nullptr;
@@ -194,6 +250,7 @@ ZipOffsetBlobStore::ZipOffsetBlobStore() {
 ZipOffsetBlobStore::~ZipOffsetBlobStore() {
     if (m_isDetachMeta) {
         m_offsets.risk_release_ownership();
+        m_ef_offsets.risk_release_ownership();
     }
     if (m_isUserMem) {
         if (m_isMmapData) {
@@ -204,10 +261,12 @@ ZipOffsetBlobStore::~ZipOffsetBlobStore() {
         m_isUserMem = false;
         m_content.risk_release_ownership();
         m_offsets.risk_release_ownership();
+        m_ef_offsets.risk_release_ownership();
     }
     else {
         m_content.clear();
         m_offsets.clear();
+        m_ef_offsets.clear();
     }
 }
 
@@ -260,12 +319,39 @@ void ZipOffsetBlobStore::set_func() {
 void ZipOffsetBlobStore::swap(ZipOffsetBlobStore& other) {
   AbstractBlobStore::risk_swap(other);
   std::swap(m_compressLevel, other.m_compressLevel);
+  std::swap(m_offsetsFormat, other.m_offsetsFormat);
   m_content.swap(other.m_content);
   m_offsets.swap(other.m_offsets);
+  m_ef_offsets.swap(other.m_ef_offsets);
+}
+
+void ZipOffsetBlobStore::prefetch_offsets(size_t recID) const {
+    assert(recID + 1 < offsets_size());
+    // EliasFanoUintVec::get2 selects on the high bits, the address of
+    // which is not known without reading the rank select cache
+    if (kSortedUintVecOffsets == m_offsetsFormat) {
+        TERARK_CPU_PREFETCH(m_offsets.get_index_addr(recID));
+    }
+}
+
+void ZipOffsetBlobStore::prefetch_record(size_t recID) const {
+    assert(recID + 1 < offsets_size());
+    auto BegEnd = offsets_get2(recID);
+    TERARK_CPU_PREFETCH(m_content.data() + BegEnd[0]);
+}
+
+void ZipOffsetBlobStore::advise_willneed(size_t beg, size_t end) const {
+    assert(beg <= end);
+    if (beg == end)
+        return;
+    assert(end < offsets_size());
+    size_t lo = offsets_get2(beg)[0];
+    size_t hi = offsets_get2(end - 1)[1];
+    mmap_advise_willneed(m_content.data() + lo, hi - lo);
 }
 
 size_t ZipOffsetBlobStore::mem_size() const {
-    return m_content.size() + m_offsets.mem_size();
+    return m_content.size() + offsets_mem().size();
 }
 
 static void ZipOffsetBlobStore_AppendDecompress(size_t id, const byte_t* data, size_t size, valvec<byte_t>* output) {
@@ -285,8 +371,8 @@ template<bool Compress, int CheckSumLen, bool FiberVmPrefetch>
 void
 ZipOffsetBlobStore::get_record_append_imp(size_t recID, valvec<byte_t>* recData)
 const {
-    assert(recID + 1 < m_offsets.size());
-    auto BegEnd = m_offsets.get2(recID);
+    assert(recID + 1 < offsets_size());
+    auto BegEnd = offsets_get2(recID);
     assert(BegEnd[0] <= BegEnd[1]);
     assert(BegEnd[1] <= m_content.size());
     size_t len = BegEnd[1] - BegEnd[0];
@@ -325,14 +411,21 @@ template<bool Compress, int CheckSumLen>
 void
 ZipOffsetBlobStore::get_record_append_CacheOffsets_imp(size_t recID, CacheOffsets* co)
 const {
-    assert(recID + 1 < m_offsets.size());
-    size_t log2 = m_offsets.log2_block_units(); // must be 6 or 7
+    assert(recID + 1 < offsets_size());
+    const bool isEliasFano = kEliasFanoOffsets == m_offsetsFormat;
+    size_t log2 = isEliasFano ? 7 : m_offsets.log2_block_units(); // must be 6 or 7
     size_t mask = (size_t(1) << log2) - 1;
     if (terark_unlikely(recID >> log2 != co->blockId)) {
         // cache miss, load the block
         size_t blockIdx = recID >> log2;
-        m_offsets.get_block(blockIdx, co->offsets);
-        co->offsets[mask+1] = m_offsets.get_block_min_val(blockIdx+1);
+        if (isEliasFano) {
+            size_t beg = blockIdx << log2;
+            size_t end = std::min(m_ef_offsets.size(), beg + mask + 2);
+            m_ef_offsets.get_range(beg, end, co->offsets);
+        } else {
+            m_offsets.get_block(blockIdx, co->offsets);
+            co->offsets[mask+1] = m_offsets.get_block_min_val(blockIdx+1);
+        }
         co->blockId = blockIdx;
     }
     size_t inBlockID = recID & mask;
@@ -374,8 +467,8 @@ ZipOffsetBlobStore::fspread_record_append_imp(
                     valvec<byte_t>* recData,
                     valvec<byte_t>* rdbuf)
 const {
-    assert(recID + 1 < m_offsets.size());
-    auto BegEnd = m_offsets.get2(recID);
+    assert(recID + 1 < offsets_size());
+    auto BegEnd = offsets_get2(recID);
     assert(BegEnd[0] <= BegEnd[1]);
     assert(BegEnd[1] <= m_content.size());
     size_t len = BegEnd[1] - BegEnd[0];
@@ -408,8 +501,8 @@ const {
 
 size_t
 ZipOffsetBlobStore::get_zipped_size_imp(size_t recID, CacheOffsets* co) const {
-    TERARK_ASSERT_LT(recID + 1, m_offsets.size());
-    auto BegEnd = m_offsets.get2(recID);
+    TERARK_ASSERT_LT(recID + 1, offsets_size());
+    auto BegEnd = offsets_get2(recID);
     TERARK_ASSERT_LE(BegEnd[0], BegEnd[1]);
     TERARK_ASSERT_LE(BegEnd[1], m_content.size());
     size_t len = BegEnd[1] - BegEnd[0];
@@ -425,36 +518,52 @@ const {
     size_t recNum = m_numRecords;
     TERARK_UNUSED_VAR(recNum);
     size_t offset = 0;
-    auto zipOffsetBuilder = std::unique_ptr<SortedUintVec::Builder>(
+    const bool isEliasFano = kEliasFanoOffsets == m_offsetsFormat;
+    auto zipOffsetBuilder = std::unique_ptr<SortedUintVec::Builder>(isEliasFano ? nullptr :
         SortedUintVec::createBuilder(m_offsets.block_units(), tmpFile.c_str()));
+    valvec<uint64_t> efOffsets(isEliasFano ? recNum + 1 : 0, valvec_reserve());
 #if !defined(NDEBUG)
-    size_t maxOffsetEnt = m_offsets[recNum];
+    size_t maxOffsetEnt = isEliasFano ? m_ef_offsets[recNum] : m_offsets[recNum];
 #endif
     for (assert(newToOld.size() == recNum); !newToOld.eof(); ++newToOld) {
         //size_t newId = newToOld.index();
         size_t oldId = *newToOld;
         assert(oldId < recNum);
-        auto BegEnd = m_offsets.get2(oldId);
-        zipOffsetBuilder->push_back(offset);
+        auto BegEnd = offsets_get2(oldId);
+        if (isEliasFano)
+            efOffsets.push_back(offset);
+        else
+            zipOffsetBuilder->push_back(offset);
         assert(BegEnd[0] <= BegEnd[1]);
         offset += BegEnd[1] - BegEnd[0];
     }
     assert(offset == maxOffsetEnt);
-    zipOffsetBuilder->push_back(offset);
-    zipOffsetBuilder->finish(nullptr);
-    zipOffsetBuilder.reset();
     XXHash64 xxhash64(g_dpbsnark_seed);
-    MmapWholeFile mmapOffset(tmpFile);
+    MmapWholeFile mmapOffset;
     SortedUintVec newZipOffsets;
-    newZipOffsets.risk_set_data(mmapOffset.base, mmapOffset.size);
+    EliasFanoUintVec newEfOffsets;
+    fstring newOffsetsMem;
+    if (isEliasFano) {
+        efOffsets.push_back(offset);
+        newEfOffsets.build_from(efOffsets);
+        efOffsets.clear();
+        newOffsetsMem = fstring(newEfOffsets.data(), newEfOffsets.mem_size());
+    } else {
+        zipOffsetBuilder->push_back(offset);
+        zipOffsetBuilder->finish(nullptr);
+        zipOffsetBuilder.reset();
+        MmapWholeFile(tmpFile).swap(mmapOffset);
+        newZipOffsets.risk_set_data(mmapOffset.base, mmapOffset.size);
+        newOffsetsMem = fstring(newZipOffsets.data(), newZipOffsets.mem_size());
+    }
     TERARK_SCOPE_EXIT(newZipOffsets.risk_release_ownership());
-    FileHeader header(this, newZipOffsets);
+    FileHeader header(this, newOffsetsMem.size(), isEliasFano ? 0 : newZipOffsets.log2_block_units());
     xxhash64.update(&header, sizeof header);
     buffer.ensureWrite(&header, sizeof header);
     for (newToOld.rewind(); !newToOld.eof(); ++newToOld) {
         //size_t newId = newToOld.index();
         size_t oldId = *newToOld;
-        auto BegEnd = m_offsets.get2(oldId);
+        auto BegEnd = offsets_get2(oldId);
         size_t len = BegEnd[1] - BegEnd[0];
         const byte* beg = m_content.data() + BegEnd[0];
         xxhash64.update(beg, len);
@@ -462,11 +571,13 @@ const {
     }
     PadzeroForAlign<16>(buffer, xxhash64, offset);
 
-    xxhash64.update(newZipOffsets.data(), newZipOffsets.mem_size());
-    buffer.ensureWrite(newZipOffsets.data(), newZipOffsets.mem_size());
+    xxhash64.update(newOffsetsMem.data(), newOffsetsMem.size());
+    buffer.ensureWrite(newOffsetsMem.data(), newOffsetsMem.size());
 
-    MmapWholeFile().swap(mmapOffset);
-    ::remove(tmpFile.c_str());
+    if (!isEliasFano) {
+        MmapWholeFile().swap(mmapOffset);
+        ::remove(tmpFile.c_str());
+    }
 
     BlobStoreFileFooter footer;
     footer.fileXXHash = xxhash64.digest();
@@ -477,7 +588,8 @@ const {
 class ZipOffsetBlobStore::MyBuilder::Impl : boost::noncopyable {
     std::string m_fpath;
     std::string m_fpath_offset;
-    std::unique_ptr<SortedUintVec::Builder> m_builder;
+    std::unique_ptr<SortedUintVec::Builder> m_builder; // null for EliasFano
+    valvec<uint64_t> m_ef_offsets;
     FileStream m_file;
     SeekableOutputStreamWrapper<FileMemIO*> m_memStream;
     NativeDataOutput<OutputBuffer> m_writer;
@@ -489,7 +601,8 @@ public:
     Impl(fstring fpath, size_t offset, Options options)
         : m_fpath(fpath.begin(), fpath.end())
         , m_fpath_offset(fpath + ".offset")
-        , m_builder(SortedUintVec::createBuilder(options.block_units, m_fpath_offset.c_str()))
+        , m_builder(kEliasFanoOffsets == options.offsets_format ? nullptr :
+                    SortedUintVec::createBuilder(options.block_units, m_fpath_offset.c_str()))
         , m_file()
         , m_memStream(nullptr)
         , m_writer(&m_file)
@@ -512,7 +625,8 @@ public:
     Impl(FileMemIO& mem, Options options)
         : m_fpath()
         , m_fpath_offset()
-        , m_builder(SortedUintVec::createBuilder(options.block_units))
+        , m_builder(kEliasFanoOffsets == options.offsets_format ? nullptr :
+                    SortedUintVec::createBuilder(options.block_units))
         , m_file()
         , m_memStream(&mem)
         , m_writer(&m_memStream)
@@ -523,6 +637,12 @@ public:
         memset(&header, 0, sizeof header);
         m_writer.ensureWrite(&header, sizeof header);
     }
+    void push_offset(size_t offset) {
+        if (m_builder)
+            m_builder->push_back(offset);
+        else
+            m_ef_offsets.push_back(offset);
+    }
     void add_record(fstring rec) {
         if (m_options.compress_level > 0) {
             m_compressBuffer.resize_no_init(ZSTD_compressBound(rec.size()));
@@ -535,7 +655,7 @@ public:
             }
             rec = fstring(m_compressBuffer.data(), zstd_size);
         }
-        m_builder->push_back(m_content_size);
+        push_offset(m_content_size);
         m_writer.ensureWrite(rec.data(), rec.size());
         m_content_size += rec.size();
         if (2 == m_options.checksum_level) {
@@ -552,14 +672,35 @@ public:
     }
     void finish() {
         PadzeroForAlign<16>(m_writer, m_content_size);
-        m_builder->push_back(m_content_size);
+        push_offset(m_content_size);
+        if (!m_builder && !EliasFanoUintVec::can_build(m_ef_offsets.size(), m_content_size)) {
+            // too many records for EliasFanoUintVec, fall back to SortedUintVec
+            m_builder.reset(m_fpath.empty()
+                ? SortedUintVec::createBuilder(m_options.block_units)
+                : SortedUintVec::createBuilder(m_options.block_units, m_fpath_offset.c_str()));
+            for (uint64_t offset : m_ef_offsets) {
+                m_builder->push_back(offset);
+            }
+            m_ef_offsets.clear();
+            m_options.offsets_format = kSortedUintVecOffsets;
+        }
+        EliasFanoUintVec ef;
+        if (!m_builder) {
+            ef.build_from(m_ef_offsets);
+            m_ef_offsets.clear();
+        }
         if (m_file.fp() == nullptr) {
             SortedUintVec vec;
-            m_builder->finish(&vec);
-            m_builder.reset();
-
-            size_t offsets_size = vec.mem_size();
-            m_writer.ensureWrite(vec.data(), offsets_size);
+            fstring offsets;
+            if (m_builder) {
+                m_builder->finish(&vec);
+                m_builder.reset();
+                offsets = fstring(vec.data(), vec.mem_size());
+            } else {
+                offsets = fstring(ef.data(), ef.mem_size());
+            }
+            size_t offsets_size = offsets.size();
+            m_writer.ensureWrite(offsets.data(), offsets_size);
             m_writer.flush_buffer();
 
             size_t file_size = m_offset
@@ -582,15 +723,22 @@ public:
             m_memStream.stream()->reserve(file_size);
             ((BlobStoreFileFooter*)(m_memStream.stream()->end()))[-1] = footer;
         } else {
-            m_builder->finish(nullptr);
-            m_builder.reset();
-
-            FileStream offset(m_fpath_offset, "rb");
-            size_t offsets_size = offset.fsize();
-            m_writer.flush_buffer();
-            m_file.cat(offset);
-            offset.close();
-            ::remove(m_fpath_offset.c_str());
+            size_t offsets_size;
+            if (m_builder) {
+                m_builder->finish(nullptr);
+                m_builder.reset();
+
+                FileStream offset(m_fpath_offset, "rb");
+                offsets_size = offset.fsize();
+                m_writer.flush_buffer();
+                m_file.cat(offset);
+                offset.close();
+                ::remove(m_fpath_offset.c_str());
+            } else {
+                offsets_size = ef.mem_size();
+                m_writer.ensureWrite(ef.data(), offsets_size);
+                m_writer.flush_buffer();
+            }
             m_file.close();
 
             size_t file_size = m_offset
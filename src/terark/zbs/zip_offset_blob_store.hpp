@@ -10,15 +10,34 @@
 #include "abstract_blob_store.hpp"
 #include <terark/io/FileMemStream.hpp>
 #include <terark/util/sorted_uint_vec.hpp>
+#include <terark/util/elias_fano_uint_vec.hpp>
 
 namespace terark {
 
-// Object layout is same to PlainBlobStore, but use SortedUintVec as offset
+// Object layout is same to PlainBlobStore, but use SortedUintVec as offset,
+// or EliasFanoUintVec when Options::offsets_format is kEliasFanoOffsets and
+// EliasFanoUintVec::can_build, else it falls back to SortedUintVec
 class TERARK_DLL_EXPORT ZipOffsetBlobStore : public AbstractBlobStore {
+public:
+    enum OffsetsFormat {
+        kSortedUintVecOffsets = 0,
+        kEliasFanoOffsets = 1,
+    };
+private:
     struct FileHeader; friend struct FileHeader;
     int m_compressLevel;
+    int m_offsetsFormat;
     valvec<byte_t> m_content;
     SortedUintVec  m_offsets;
+    EliasFanoUintVec m_ef_offsets; // used when m_offsetsFormat is kEliasFanoOffsets
+
+    std::array<size_t, 2> offsets_get2(size_t recID) const {
+        if (kEliasFanoOffsets == m_offsetsFormat)
+            return m_ef_offsets.get2(recID);
+        return m_offsets.get2(recID);
+    }
+    size_t offsets_size() const;
+    fstring offsets_mem() const;
 
     void set_func();
     template<bool Compress, int CheckSumLen, bool FiberVmPrefetch = false>
@@ -36,11 +55,13 @@ public:
     ~ZipOffsetBlobStore();
 
     struct Options {
-      Options() : block_units(128), compress_level(0), checksum_level(3), checksum_type(0) {}
-      int block_units;
+      Options() : block_units(128), compress_level(0), checksum_level(3), checksum_type(0)
+                , offsets_format(kSortedUintVecOffsets) {}
+      int block_units; // ignored by kEliasFanoOffsets
       int compress_level;
       int checksum_level;
       int checksum_type;
+      int offsets_format; // OffsetsFormat
     };
 
     void swap(ZipOffsetBlobStore& other);
@@ -52,6 +73,13 @@ public:
     void save_mmap(function<void(const void*, size_t)> write) const override;
     using AbstractBlobStore::save_mmap;
 
+    // for batch get: call prefetch_offsets on all ids, then prefetch_record
+    // on all ids, then get_record_append, thus cache misses are overlapped
+    void prefetch_offsets(size_t recID) const;
+    void prefetch_record(size_t recID) const;
+    // madvise(WILLNEED) the content bytes of records [beg, end)
+    void advise_willneed(size_t beg, size_t end) const;
+
     size_t mem_size() const override;
     void reorder_zip_data(ZReorderMap& newToOld,
         function<void(const void* data, size_t size)> writeAppend,
@@ -0,0 +1,78 @@
+#include <terark/util/block_bloom_filter.hpp>
+#include <terark/util/crc.hpp>
+#include <stdio.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+static void check(size_t num, size_t bits_per_key, double max_fp_rate) {
+    std::mt19937_64 rnd(num * 131 + bits_per_key);
+    std::vector<std::string> keys(num);
+    for (auto& k : keys) {
+        k.resize(1 + rnd() % 24);
+        for (auto& c : k) c = char(rnd());
+    }
+    BlockBloomFilter bf;
+    bf.init(num, bits_per_key);
+    for (auto& k : keys) bf.add(k);
+    for (auto& k : keys) TERARK_VERIFY(bf.may_contain(k));
+
+    // image at a misaligned file offset, blocks must be 64 aligned in file
+    for (size_t offset : {0, 8, 40, 1000}) {
+        valvec<byte_t> file(offset, valvec_reserve());
+        file.resize(offset, 0);
+        bf.save_image(offset, [&](const void* data, size_t size) {
+            file.append((const byte_t*)data, size);
+        });
+        TERARK_VERIFY_EQ(file.size() - offset, bf.image_size(offset));
+        valvec<byte_t> aligned(file.size() + BlockBloomFilter::BlockAlign, valvec_no_init());
+        byte_t* base = (byte_t*)align_up(size_t(aligned.data()), BlockBloomFilter::BlockAlign);
+        memcpy(base, file.data(), file.size());
+        BlockBloomFilter bf2;
+        bf2.risk_set_image(base + offset, file.size() - offset, true);
+        TERARK_VERIFY_EQ(bf2.num_blocks(), bf.num_blocks());
+        for (auto& k : keys) TERARK_VERIFY(bf2.may_contain(k));
+        // corrupted blocks are detected
+        base[file.size() - 1] ^= 1;
+        bool thrown = false;
+        try {
+            bf2.risk_set_image(base + offset, file.size() - offset, true);
+        } catch (const BadCrc32cException&) {
+            thrown = true;
+        }
+        TERARK_VERIFY(thrown);
+    }
+
+    size_t fp = 0, probes = 200000;
+    for (size_t i = 0; i < probes; ++i) {
+        std::string k = "absent-" + std::to_string(i);
+        fp += bf.may_contain(k);
+    }
+    double rate = double(fp) / probes;
+    printf("num = %7zd, bits/key = %2zd, blocks = %6zd, fp rate = %.5f\n",
+           num, bits_per_key, bf.num_blocks(), rate);
+    TERARK_VERIFY_F(rate <= max_fp_rate, "%f > %f", rate, max_fp_rate);
+}
+
+int main() {
+    BlockBloomFilter empty;
+    TERARK_VERIFY(empty.may_contain("any"));
+    check(0, 10, 1.0);
+    check(1, 10, 0.05);
+    check(1000, 10, 0.03);
+    check(100000, 10, 0.03);
+    check(100000, 16, 0.005);
+    check(100000, 4, 0.40);
+    bool thrown = false;
+    try {
+        BlockBloomFilter bf;
+        bf.init(10, 0);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    TERARK_VERIFY(thrown);
+    printf("test_block_bloom_filter passed\n");
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <terark/concurrent_hash_strmap.hpp>
+#include <terark/hash_strmap.hpp>
+
+using namespace terark;
+
+void test_single(size_t num, size_t shard_bits, std::mt19937_64& rng) {
+    concurrent_hash_strmap<size_t> m(shard_bits);
+    std::unordered_map<std::string, size_t> stdm;
+    auto rand_str = [&](size_t keyspace) {
+        size_t x = rng() % keyspace;
+        return std::string(x % 13, 'a' + x % 26) + std::to_string(x);
+    };
+    for (size_t k = 0; k < num * 8; ++k) {
+        // erase heavy in the second half, to shrink and compact
+        std::string key = rand_str(num);
+        size_t val = 0;
+        switch (rng() % (k < num * 4 ? 4 : 3)) {
+        case 0:
+            TERARK_VERIFY_EQ(m.insert_i(key, k), stdm.emplace(key, k).second);
+            break;
+        case 1: {
+            bool inserted = stdm.count(key) == 0;
+            stdm[key] = k;
+            TERARK_VERIFY_EQ(m.insert_or_assign(key, k), inserted);
+            break; }
+        case 2: {
+            auto iter = stdm.find(key);
+            if (stdm.end() != iter) {
+                TERARK_VERIFY_EQ(m.erase(key, &val), 1);
+                TERARK_VERIFY_EQ(val, iter->second);
+                stdm.erase(iter);
+            } else {
+                TERARK_VERIFY_EQ(m.erase(key), 0);
+            }
+            break; }
+        case 3:
+            TERARK_VERIFY_EQ(m.find(key, &val), (stdm.count(key) != 0));
+            if (stdm.count(key))
+                TERARK_VERIFY_EQ(val, stdm[key]);
+            break;
+        }
+        TERARK_VERIFY_EQ(m.size(), stdm.size());
+    }
+    for (auto& kv : stdm) {
+        size_t val = size_t(-1);
+        TERARK_VERIFY(m.find(kv.first, &val));
+        TERARK_VERIFY_EQ(val, kv.second);
+    }
+    size_t n = 0;
+    m.for_each([&](fstring key, size_t val) {
+        TERARK_VERIFY_EQ(stdm[key.str()], val);
+        n++;
+    });
+    TERARK_VERIFY_EQ(n, stdm.size());
+    m.clear();
+    TERARK_VERIFY_EQ(m.size(), 0);
+    TERARK_VERIFY(!m.exists("a1"));
+    TERARK_VERIFY(m.insert_i("a1", 1));
+    TERARK_VERIFY(m.exists("a1"));
+}
+
+// readers check that the stable keys are always found with a consistent
+// value while the writers insert, assign and erase their own keys
+struct Val {
+    size_t id;
+    size_t ver;
+    size_t check;
+};
+
+void test_concurrent(size_t num, size_t writers, size_t readers) {
+    concurrent_hash_strmap<Val> m(4);
+    auto make_key = [](size_t id) { return "key." + std::to_string(id); };
+    size_t stable = num / 4;
+    for (size_t id = 0; id < stable; ++id)
+        m.insert_i(make_key(id), Val{id, 0, id * 3});
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> threads;
+    std::vector<std::unordered_map<size_t, size_t> > expected(writers);
+    for (size_t w = 0; w < writers; ++w) {
+        threads.emplace_back([&,w]() {
+            std::mt19937_64 rng(w);
+            auto& exp = expected[w];
+            for (size_t k = 0; k < num * 4; ++k) {
+                size_t id = stable + (rng() % num) / writers * writers + w;
+                std::string key = make_key(id);
+                if (rng() % 3) {
+                    m.insert_or_assign(key, Val{id, k, id * 3 + k});
+                    exp[id] = k;
+                } else {
+                    TERARK_VERIFY_EQ(m.erase(key), exp.erase(id));
+                }
+                if (k % 64 == 0) { // stable keys: assign a new version
+                    size_t sid = rng() % stable;
+                    m.insert_or_assign(make_key(sid), Val{sid, k, sid * 3 + k});
+                }
+            }
+        });
+    }
+    std::atomic<size_t> lookups(0);
+    for (size_t r = 0; r < readers; ++r) {
+        threads.emplace_back([&,r]() {
+            std::mt19937_64 rng(1000 + r);
+            size_t n = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                size_t id = rng() % (stable + num);
+                Val val;
+                bool found = m.find(make_key(id), &val);
+                if (id < stable)
+                    TERARK_VERIFY(found);
+                if (found) {
+                    TERARK_VERIFY_EQ(val.id, id);
+                    TERARK_VERIFY_EQ(val.check, val.id * 3 + val.ver);
+                }
+                n++;
+            }
+            lookups += n;
+        });
+    }
+    for (size_t w = 0; w < writers; ++w)
+        threads[w].join();
+    stop = true;
+    for (size_t r = 0; r < readers; ++r)
+        threads[writers + r].join();
+    size_t total = stable;
+    for (size_t w = 0; w < writers; ++w) {
+        for (auto& kv : expected[w]) {
+            Val val;
+            TERARK_VERIFY(m.find(make_key(kv.first), &val));
+            TERARK_VERIFY_EQ(val.ver, kv.second);
+        }
+        total += expected[w].size();
+    }
+    TERARK_VERIFY_EQ(m.size(), total);
+    fprintf(stderr, "test_concurrent: writers = %zd, readers = %zd, lookups = %zd\n",
+            writers, readers, lookups.load());
+}
+
+int main() {
+    const size_t num = 30000;
+    std::mt19937_64 rng(num);
+    test_single(num, 0, rng);
+    test_single(num, 6, rng);
+    test_single(10, 2, rng);
+    test_concurrent(num, 1, 1);
+    test_concurrent(num, 4, 4);
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <string>
+#include <vector>
+#include <terark/zbs/external_sort.hpp>
+#include <terark/fstring.hpp>
+
+using namespace terark;
+
+typedef std::pair<std::string, std::string> KV;
+
+std::vector<KV> make_records(size_t num, std::mt19937_64& rng) {
+    std::vector<KV> recs(num);
+    for (size_t i = 0; i < num; ++i) {
+        KV& kv = recs[i];
+        switch (rng() % 4) {
+        case 0: // random, with zero bytes
+            kv.first.resize(rng() % 16);
+            for (auto& c : kv.first) c = char(rng() % 256);
+            break;
+        case 1: // long common prefix
+            kv.first = "user/profile/" + std::to_string(rng() % (num / 2 + 1));
+            break;
+        case 2: // duplicates and the empty key
+            kv.first.assign(rng() % 3, 'k');
+            break;
+        case 3: // a large record, larger than the read block sometimes
+            kv.first.assign(rng() % 64, char('a' + rng() % 26));
+            kv.second.assign(rng() % (rng() % 8 ? 100 : 6000), 'v');
+            break;
+        }
+        kv.second += std::to_string(i);
+    }
+    return recs;
+}
+
+void check(const std::vector<KV>& recs, ExternalSorter::Options opt) {
+    ExternalSorter sorter(opt);
+    for (auto& kv : recs)
+        sorter.add(kv.first, kv.second);
+    sorter.finish();
+    TERARK_VERIFY_EQ(sorter.num_records(), recs.size());
+    std::vector<KV> expected(recs);
+    std::sort(expected.begin(), expected.end());
+    std::vector<KV> got;
+    while (sorter.next()) {
+        fstring key = sorter.key();
+        if (!got.empty())
+            TERARK_VERIFY(fstring(got.back().first) <= key);
+        got.emplace_back(key.str(), sorter.value().str());
+    }
+    TERARK_VERIFY(!sorter.next()); // still at end
+    // values of equal keys are in unspecified order
+    std::sort(got.begin(), got.end());
+    TERARK_VERIFY_EQ(got.size(), expected.size());
+    TERARK_VERIFY(got == expected);
+    fprintf(stderr, "num = %zd, budget = %zd, zstd = %d: runs = %zd, max ways = %zd, intermediate merges = %zd\n",
+            recs.size(), opt.memory_budget, opt.zstd_level, sorter.num_runs(),
+            sorter.max_merge_ways(), sorter.num_intermediate_merges());
+}
+
+int main() {
+    const size_t num = 200000;
+    std::mt19937_64 rng(num);
+    std::vector<KV> recs = make_records(num, rng);
+    ExternalSorter::Options opt;
+    opt.tmp_dir = "/tmp";
+    opt.sort_threads = 2;
+    check(recs, opt); // in memory
+    opt.read_block_size = 4096;
+    opt.memory_budget = 1 << 20; // many runs
+    check(recs, opt);
+    opt.memory_budget = 128 << 10; // intermediate merges
+    check(recs, opt);
+    opt.memory_budget = 1 << 20;
+    opt.zstd_level = 1;
+    opt.io_threads = 1;
+    check(recs, opt);
+    check(std::vector<KV>(), opt);
+    check(std::vector<KV>(1, KV("a", "b")), opt);
+    return 0;
+}
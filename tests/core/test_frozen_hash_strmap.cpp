@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <random>
+#include <string>
+#include <terark/frozen_hash_strmap.hpp>
+#include <terark/hash_strmap.hpp>
+
+using namespace terark;
+
+void test_perfect_hash(size_t num) {
+    valvec<std::string> keys(num);
+    for (size_t i = 0; i < num; ++i) keys[i] = "k" + std::to_string(i * 31);
+    MinimalPerfectHash mph;
+    mph.build(num, [&](size_t i) { return fstring(keys[i]); });
+    TERARK_VERIFY_EQ(mph.size(), num);
+    febitvec seen(num, false);
+    for (size_t i = 0; i < num; ++i) {
+        size_t pos = mph.lookup(keys[i]);
+        TERARK_VERIFY_LT(pos, num);
+        TERARK_VERIFY(!seen.is1(pos));
+        seen.set1(pos);
+    }
+    // load from a copy of the memory block
+    valvec<byte_t> copy(mph.data(), mph.mem_size());
+    MinimalPerfectHash mph2;
+    mph2.risk_set_data(copy.data(), copy.size());
+    for (size_t i = 0; i < num; ++i) {
+        TERARK_VERIFY_EQ(mph2.lookup(keys[i]), mph.lookup(keys[i]));
+    }
+    mph2.risk_release_ownership();
+    // the built data is freed, a bad block throws and changes nothing
+    MinimalPerfectHash mph3;
+    mph3.build(num, [&](size_t i) { return fstring(keys[i]); });
+    if (num) {
+        valvec<byte_t> bad(copy);
+        ((uint64_t*)bad.data())[0]--; // Header::num
+        try {
+            mph3.risk_set_data(bad.data(), bad.size());
+            TERARK_DIE("bad num must throw");
+        } catch (const std::invalid_argument&) {}
+        TERARK_VERIFY_EQ(mph3.size(), num);
+        TERARK_VERIFY_EQ(mph3.lookup(keys[0]), mph.lookup(keys[0]));
+    }
+    mph3.risk_set_data(copy.data(), copy.size());
+    TERARK_VERIFY(mph3.data() == copy.data());
+    for (size_t i = 0; i < num; ++i) {
+        TERARK_VERIFY_EQ(mph3.lookup(keys[i]), mph.lookup(keys[i]));
+    }
+    mph3.risk_release_ownership();
+    if (num >= 1000)
+        fprintf(stderr, "MinimalPerfectHash: num = %zd, %.3f bits per key\n",
+                num, mph.mem_size() * 8.0 / num);
+}
+
+void test_frozen(size_t num, std::mt19937_64& rng) {
+    hash_strmap<size_t> hsm;
+    while (hsm.size() < num) {
+        size_t x = rng();
+        hsm[std::string(x % 17, 'a' + x % 26) + std::to_string(x % (num * 4))] = x;
+    }
+    for (size_t i = 0; i < num / 4; ++i) { // erased keys must not be frozen
+        size_t j = rng() % hsm.end_i();
+        if (!hsm.is_deleted(j))
+            hsm.erase_i(j);
+    }
+    frozen_hash_strmap<size_t> fm;
+    fm.freeze(hsm);
+    auto check = [&](const frozen_hash_strmap<size_t>& m) {
+        TERARK_VERIFY_EQ(m.size(), hsm.size());
+        for (size_t i = hsm.beg_i(); i < hsm.end_i(); i = hsm.next_i(i)) {
+            size_t j = m.find_i(hsm.key(i));
+            TERARK_VERIFY_NE(j, m.end_i());
+            TERARK_VERIFY(m.key(j) == hsm.key(i));
+            TERARK_VERIFY_EQ(m.val(j), hsm.val(i));
+        }
+        for (size_t i = 0; i < num; ++i) {
+            std::string key = "missing" + std::to_string(rng());
+            TERARK_VERIFY(!m.exists(key));
+        }
+        for (size_t j = m.beg_i(); j < m.end_i(); j = m.next_i(j)) {
+            TERARK_VERIFY_EQ(hsm.val(hsm.find_i(m.key(j))), m.val(j));
+        }
+    };
+    check(fm);
+    const char* fpath = "test_frozen_hash_strmap.tmp";
+    fm.save_mmap(fpath);
+    frozen_hash_strmap<size_t> fm2;
+    fm2.load_mmap(fpath);
+    TERARK_VERIFY_EQ(fm2.mem_size(), fm.mem_size());
+    check(fm2);
+    // a bad perfect hash throws and changes nothing
+    valvec<byte_t> bad_data(fm.data(), fm.mem_size());
+    size_t hsize = sizeof(frozen_hash_strmap<size_t>::Header);
+    ((uint64_t*)(bad_data.data() + hsize))[0]--; // num of the perfect hash
+    try {
+        fm2.risk_set_data(bad_data.data(), bad_data.size());
+        TERARK_DIE("bad perfect hash must throw");
+    } catch (const std::invalid_argument&) {}
+    check(fm2);
+    fm2.clear();
+    TERARK_VERIFY_EQ(fm2.size(), 0);
+    TERARK_VERIFY(!fm2.exists("a"));
+    // load_mmap over a frozen map frees the frozen data
+    frozen_hash_strmap<size_t> fm3;
+    fm3.freeze(hsm);
+    fm3.load_mmap(fpath);
+    check(fm3);
+    frozen_hash_strmap<uint32_t> bad;
+    try {
+        bad.risk_set_data(fm.data(), fm.mem_size());
+        TERARK_DIE("value_size mismatch must throw");
+    } catch (const std::invalid_argument&) {}
+    ::remove(fpath);
+}
+
+int main() {
+    const size_t num = 30000;
+    std::mt19937_64 rng(num);
+    for (size_t n : {size_t(0), size_t(1), size_t(2), size_t(10), num, num * 10})
+        test_perfect_hash(n);
+    test_frozen(num, rng);
+    test_frozen(3, rng);
+    return 0;
+}
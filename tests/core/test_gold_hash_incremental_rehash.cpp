@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <random>
+#include <unordered_map>
+#include <terark/fstring.hpp>
+#include <terark/gold_hash_map.hpp>
+
+using namespace terark;
+
+template<class Map>
+void test_random(Map& m, size_t num, std::mt19937_64& rng) {
+    std::unordered_map<size_t, size_t> stdm;
+    for (size_t k = 0; k < num * 4; ++k) {
+        size_t key = rng() % num;
+        switch (rng() % 4) {
+        case 0:
+        case 1: {
+            auto ib = m.insert_i(key, k);
+            TERARK_VERIFY_EQ(ib.second, stdm.emplace(key, k).second);
+            TERARK_VERIFY_EQ(m.val(ib.first), stdm[key]);
+            break; }
+        case 2:
+            TERARK_VERIFY_EQ(m.erase(key), stdm.erase(key));
+            break;
+        case 3: {
+            size_t idx = m.find_i(key);
+            auto iter = stdm.find(key);
+            if (stdm.end() == iter) {
+                TERARK_VERIFY_EQ(idx, m.end_i());
+            } else {
+                TERARK_VERIFY_LT(idx, m.end_i());
+                TERARK_VERIFY_EQ(m.val(idx), iter->second);
+            }
+            break; }
+        }
+        TERARK_VERIFY_EQ(m.size(), stdm.size());
+        if (k % 1024 == 0) { // copy and move in the middle of a migration
+            Map copy(m);
+            TERARK_VERIFY_EQ(copy.size(), m.size());
+            TERARK_VERIFY_EQ(copy.is_rehashing(), m.is_rehashing());
+            for (auto& kv : stdm)
+                TERARK_VERIFY_EQ(copy[kv.first], kv.second);
+            Map moved(std::move(copy));
+            TERARK_VERIFY_EQ(moved.size(), stdm.size());
+        }
+    }
+    for (auto& kv : stdm) {
+        size_t idx = m.find_i(kv.first);
+        TERARK_VERIFY_LT(idx, m.end_i());
+        TERARK_VERIFY_EQ(m.val(idx), kv.second);
+    }
+    m.finish_rehash();
+    TERARK_VERIFY(!m.is_rehashing());
+    for (auto& kv : stdm)
+        TERARK_VERIFY_EQ(m[kv.first], kv.second);
+    m.revoke_deleted();
+    for (auto& kv : stdm)
+        TERARK_VERIFY_EQ(m[kv.first], kv.second);
+}
+
+void test_rehashing(size_t num) {
+    gold_hash_map<size_t, size_t> m;
+    m.enable_incremental_rehash();
+    bool seen_rehashing = false;
+    for (size_t i = 0; i < num; ++i) {
+        m[i] = i * 3;
+        seen_rehashing |= m.is_rehashing();
+        if (m.is_rehashing()) { // lookups during the migration
+            TERARK_VERIFY_EQ(m.find_i(i / 2), i / 2);
+            TERARK_VERIFY_EQ(m.find_i(i + 1), m.end_i());
+        }
+    }
+    TERARK_VERIFY(seen_rehashing);
+    for (size_t i = 0; i < num; ++i)
+        TERARK_VERIFY_EQ(m.val(m.find_i(i)), i * 3);
+    // erase all during a migration
+    while (!m.is_rehashing())
+        m[m.size()] = 0;
+    m.erase_all();
+    TERARK_VERIFY(!m.is_rehashing());
+    TERARK_VERIFY_EQ(m.size(), 0);
+    m[1] = 1;
+    TERARK_VERIFY_EQ(m.find_i(1), 0);
+}
+
+// the worst latency of a single insert, with and without incremental rehash
+int main() {
+    const size_t num = 100000;
+    std::mt19937_64 rng(num);
+    {
+        gold_hash_map<size_t, size_t> m;
+        m.enable_incremental_rehash();
+        test_random(m, num, rng);
+    }
+    {
+        gold_hash_map<size_t, size_t> m; // hash cache enabled
+        m.enable_incremental_rehash();
+        m.enable_hash_cache();
+        test_random(m, num, rng);
+    }
+    {
+        gold_hash_map<size_t, size_t> m; // default mode is not changed
+        test_random(m, num, rng);
+        TERARK_VERIFY(!m.is_rehashing());
+    }
+    test_rehashing(num);
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <thread>
+#include <terark/fstring.hpp>
+#include <terark/mempool_thread_cache.hpp>
+#include <terark/util/hugepage.hpp>
+#include <terark/util/vm_util.hpp>
+
+using namespace terark;
+
+static void print(const char* sig, const VmArena::Stat& st) {
+    fprintf(stderr, "%s: reserved = %zd, used = %zd, prefaulted = %zd, "
+            "prefault = {cnt %zd, fail %zd, %zd us}, outrun = %zd, "
+            "faults = {minor %zd, major %zd}, huge pages = %zd\n",
+            sig, st.reserved, st.used, st.prefaulted, st.prefault_cnt,
+            st.prefault_fail, st.prefault_us, st.outrun_cnt,
+            st.minor_faults, st.major_faults, st.huge_page_bytes);
+}
+
+int main() {
+    const size_t num_threads = 4;
+    const size_t num = 200000;
+    size_t cap = num_threads * num * 64 + (64 << 20);
+    {
+        ThreadCacheMemPool<8> mp(256);
+        VmArena::Options opt;
+        opt.prefault_ahead = 16 << 20;
+        mp.enable_arena(opt);
+        TERARK_VERIFY(mp.is_arena_enabled());
+        mp.reserve(cap);
+        TERARK_VERIFY_AL(size_t(mp.data()), hugepage_size);
+        TERARK_VERIFY_GE(mp.capacity(), cap);
+        TERARK_VERIFY_EQ(mp.size(), 0);
+        const byte_t* base = mp.data();
+        valvec<std::thread> thr(num_threads, valvec_reserve());
+        for (size_t t = 0; t < num_threads; ++t) {
+            thr.unchecked_emplace_back([&mp,num,t]() {
+                valvec<size_t> pos(num, valvec_no_init());
+                for (size_t i = 0; i < num; ++i) {
+                    size_t len = 8 * (1 + (i + t) % 8);
+                    pos[i] = mp.alloc(len);
+                    TERARK_VERIFY_NE(pos[i], size_t(-1));
+                    mp.at<size_t>(pos[i]) = t * num + i;
+                }
+                for (size_t i = 0; i < num; ++i)
+                    TERARK_VERIFY_EQ(mp.at<size_t>(pos[i]), t * num + i);
+                for (size_t i = 0; i < num; i += 2)
+                    mp.sfree(pos[i], 8 * (1 + (i + t) % 8));
+            });
+        }
+        for (auto& th : thr) th.join();
+        TERARK_VERIFY(mp.data() == base); // grown in place
+        auto st = mp.get_arena_stat(true);
+        if (st.prefault_cnt) {
+            // the background thread catches up with the used size
+            for (int i = 0; i < 5000 && st.prefaulted < mp.size(); ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                st = mp.get_arena_stat(true);
+            }
+            TERARK_VERIFY_GE(st.prefaulted, mp.size());
+        } else {
+            fprintf(stderr, "MADV_POPULATE_WRITE is not supported\n");
+        }
+        print("ThreadCacheMemPool", st);
+        TERARK_VERIFY_EQ(st.reserved, mp.capacity());
+        TERARK_VERIFY_EQ(st.used, mp.size());
+        mp.destroy_and_clean();
+        TERARK_VERIFY(!mp.is_arena_enabled());
+        TERARK_VERIFY(mp.data() == NULL);
+    }
+    {
+        // the arena is unmapped by the destructor
+        ThreadCacheMemPool<8> mp(256);
+        mp.enable_arena();
+        mp.reserve(64 << 20);
+        size_t pos = mp.alloc(64);
+        TERARK_VERIFY_NE(pos, size_t(-1));
+        mp.at<size_t>(pos) = 12345;
+        TERARK_VERIFY_EQ(mp.at<size_t>(pos), 12345);
+    }
+    {
+        VmArena arena;
+        VmArena::Options opt;
+        opt.reserve_size = 3 << 20; // aligned up to 4M
+        opt.prefault_ahead = 0; // no background thread
+        TERARK_VERIFY(arena.create(opt));
+        TERARK_VERIFY_EQ(arena.capacity(), 4 << 20);
+        TERARK_VERIFY_AL(size_t(arena.base()), hugepage_size);
+        memset(arena.base(), 1, arena.capacity());
+        arena.start_prefault([]{ return size_t(0); });
+        print("VmArena", arena.get_stat(true));
+        TERARK_VERIFY_EQ(arena.get_stat().prefault_cnt, 0);
+        arena.destroy();
+        TERARK_VERIFY(arena.base() == NULL);
+    }
+    if (g_has_madv_populate) {
+        // the background thread does not poll, it is woken up by notify
+        VmArena arena;
+        VmArena::Options opt;
+        opt.reserve_size = 64 << 20;
+        opt.prefault_ahead = 4 << 20;
+        opt.huge_page = false;
+        TERARK_VERIFY(arena.create(opt));
+        size_t used = 0;
+        arena.start_prefault([&]{ return as_atomic(used).load(std::memory_order_relaxed); });
+        auto wait_prefaulted = [&](size_t min_prefaulted) {
+            auto st = arena.get_stat();
+            for (int i = 0; i < 5000 && st.prefaulted < min_prefaulted; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                st = arena.get_stat();
+            }
+            return st;
+        };
+        auto st = wait_prefaulted(opt.prefault_ahead);
+        if (st.prefault_fail == 0 && st.prefaulted >= opt.prefault_ahead) {
+            as_atomic(used).store(size_t(16) << 20, std::memory_order_relaxed);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            st = arena.get_stat();
+            TERARK_VERIFY_EQ(st.prefaulted, opt.prefault_ahead); // still idle
+            arena.notify(used);
+            st = wait_prefaulted(used + opt.prefault_ahead);
+            TERARK_VERIFY_GE(st.prefaulted, used + opt.prefault_ahead);
+            TERARK_VERIFY_EQ(st.outrun_cnt, 1);
+        }
+        print("VmArena notify", st);
+        arena.destroy();
+    }
+    return 0;
+}
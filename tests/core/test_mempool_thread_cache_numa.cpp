@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <thread>
+#include <terark/fstring.hpp>
+#include <terark/mempool_thread_cache.hpp>
+
+using namespace terark;
+
+int main() {
+    const size_t num_threads = 4;
+    const size_t num = 200000;
+    ThreadCacheMemPool<8> mp(256);
+    TERARK_VERIFY(!mp.is_numa_enabled());
+    mp.reserve(size_t(num_threads) * num * 64 + (64 << 20));
+    if (!mp.enable_numa()) {
+        fprintf(stderr, "numa is not supported, skipped\n");
+        return 0;
+    }
+    TERARK_VERIFY(mp.is_numa_enabled());
+    TERARK_VERIFY_GE(mp.get_numa_stat().size(), 1);
+    mp.set_chunk_size(256 << 10); // to have many chunks
+    valvec<std::thread> thr(num_threads, valvec_reserve());
+    for (size_t t = 0; t < num_threads; ++t) {
+        thr.unchecked_emplace_back([&mp,num,t]() {
+            valvec<size_t> pos(num, valvec_no_init());
+            for (size_t i = 0; i < num; ++i) {
+                size_t len = 8 * (1 + (i + t) % 8);
+                pos[i] = mp.alloc(len);
+                TERARK_VERIFY_NE(pos[i], size_t(-1));
+                mp.at<size_t>(pos[i]) = t * num + i;
+            }
+            for (size_t i = 0; i < num; ++i)
+                TERARK_VERIFY_EQ(mp.at<size_t>(pos[i]), t * num + i);
+            for (size_t i = 0; i < num; i += 2)
+                mp.sfree(pos[i], 8 * (1 + (i + t) % 8));
+        });
+    }
+    for (auto& th : thr) th.join();
+    size_t chunk_len = 0, chunk_cnt = 0;
+    for (auto& ns : mp.get_numa_stat()) {
+        chunk_len += ns.chunk_len;
+        chunk_cnt += ns.chunk_cnt;
+    }
+    // all chunks are accounted to a node
+    TERARK_VERIFY_EQ(chunk_len, mp.size());
+    TERARK_VERIFY_GE(chunk_cnt, num_threads);
+    mp.print_stat(stderr);
+    mp.destroy_and_clean();
+    return 0;
+}
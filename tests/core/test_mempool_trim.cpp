@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <thread>
+#include <terark/fstring.hpp>
+#include <terark/mempool.hpp>
+
+using namespace terark;
+
+// alloc num blocks of len, free all but each keep_every'th block, then
+// trim should release the pages of the freed blocks, the kept blocks are
+// intact, and the freed blocks are still reusable
+template<class MemPool>
+void check(const char* name, MemPool& mp, size_t num, size_t len, size_t keep_every) {
+    valvec<size_t> pos(num, valvec_no_init());
+    for (size_t i = 0; i < num; ++i) {
+        pos[i] = mp.alloc(len);
+        TERARK_VERIFY_NE(pos[i], size_t(-1));
+        memset(&mp.template at<byte_t>(pos[i]), int(i), len);
+        mp.template at<size_t>(pos[i]) = i;
+    }
+    size_t watermark = num * len / 4;
+    MemPoolTrimPolicy tp;
+    tp.high_watermark = watermark;
+    mp.set_trim_policy(tp);
+    TERARK_VERIFY_EQ(mp.maybe_trim(), 0); // nothing is freed
+    size_t freed = 0;
+    for (size_t i = 0; i < num; ++i) {
+        if (i % keep_every != 0) {
+            mp.sfree(pos[i], len);
+            freed += len;
+        }
+    }
+    size_t released = mp.maybe_trim();
+    auto st = mp.get_trim_stat();
+    fprintf(stderr, "%s: freed = %zd, released = %zd, ranges = %zd\n",
+            name, freed, released, st.last_ranges);
+    TERARK_VERIFY_GT(released, freed / 2);
+    TERARK_VERIFY_EQ(st.trim_cnt, 1);
+    TERARK_VERIFY_EQ(st.released_bytes, released);
+    TERARK_VERIFY_EQ(mp.maybe_trim(), 0); // below watermark again
+    mp.trim(); // just advise the released pages again
+    for (size_t i = 0; i < num; i += keep_every) {
+        TERARK_VERIFY_EQ(mp.template at<size_t>(pos[i]), i);
+        TERARK_VERIFY_EQ(mp.template at<byte_t>(pos[i] + len - 1), byte_t(i));
+    }
+    // coalesced blocks are reused
+    for (size_t i = 0; i < num; ++i) {
+        if (i % keep_every != 0) {
+            pos[i] = mp.alloc(len);
+            TERARK_VERIFY_NE(pos[i], size_t(-1));
+            mp.template at<size_t>(pos[i]) = i;
+        }
+    }
+    for (size_t i = 0; i < num; ++i)
+        TERARK_VERIFY_EQ(mp.template at<size_t>(pos[i]), i);
+}
+
+void check_thread_cache(size_t num, size_t len) {
+    size_t num_threads = 4;
+    ThreadCacheMemPool<8> mp(256);
+    mp.reserve(num_threads * num * len * 2 + (64 << 20));
+    MemPoolTrimPolicy tp;
+    tp.high_watermark = num * len / 4;
+    tp.auto_trim = true;
+    mp.set_trim_policy(tp);
+    valvec<std::thread> thr(num_threads, valvec_reserve());
+    for (size_t t = 0; t < num_threads; ++t) {
+        thr.unchecked_emplace_back([&mp,num,len,t]() {
+            valvec<size_t> pos(num, valvec_no_init());
+            for (size_t i = 0; i < num; ++i) {
+                pos[i] = mp.alloc(len);
+                TERARK_VERIFY_NE(pos[i], size_t(-1));
+                mp.at<size_t>(pos[i]) = t * num + i;
+            }
+            for (size_t i = 0; i < num; ++i) {
+                if (i % 1000 != 0)
+                    mp.sfree(pos[i], len); // auto trim by this thread
+            }
+            for (size_t i = 0; i < num; i += 1000)
+                TERARK_VERIFY_EQ(mp.at<size_t>(pos[i]), t * num + i);
+        });
+    }
+    for (auto& th : thr) th.join();
+    auto st = mp.get_trim_stat();
+    fprintf(stderr, "ThreadCacheMemPool: auto trim = %zd, released = %zd\n",
+            st.trim_cnt, st.released_bytes);
+    TERARK_VERIFY_GE(st.trim_cnt, num_threads);
+    TERARK_VERIFY_GT(st.released_bytes, 0);
+    mp.trim();
+    mp.destroy_and_clean();
+}
+
+int main() {
+    const size_t num = 500000;
+    size_t len = 48;
+    {
+        MemPool_LockNone<8> mp(256);
+        check("MemPool_LockNone", mp, num, len, 1000);
+    }
+    {
+        // little spare capacity, freed blocks must be reused after
+        // coalesced, the tail of a split block may be in another fastbin
+        MemPool_LockFree<4> mp(256);
+        mp.reserve(num * len * 9 / 8);
+        check("MemPool_LockFree", mp, num, len, 1000);
+    }
+    {
+        MemPool_FixedCap<8> mp(256);
+        mp.reserve(num * len * 9 / 8);
+        check("MemPool_FixedCap", mp, num, len, 1000);
+    }
+    {
+        ThreadCacheMemPool<8> mp(256);
+        mp.reserve(num * len * 2 + (4 << 20));
+        check("ThreadCacheMemPool", mp, num, len, 1000);
+        mp.destroy_and_clean();
+    }
+    check_thread_cache(num, len);
+    return 0;
+}
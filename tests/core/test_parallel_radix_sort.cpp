@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <string>
+#include <terark/util/parallel_radix_sort.hpp>
+#include <terark/util/sortable_strvec.hpp>
+
+using namespace terark;
+
+// keys with long common prefixes, duplicates, empty keys and zero bytes
+valvec<std::string> make_keys(size_t num, int kind, std::mt19937_64& rng) {
+    valvec<std::string> keys(num);
+    for (size_t i = 0; i < num; ++i) {
+        std::string& k = keys[i];
+        switch (kind) {
+        case 0: // random short
+            k.resize(rng() % 12);
+            for (auto& c : k) c = char(rng() % 256);
+            break;
+        case 1: // url like, long common prefix
+            k = "http://www.example.com/path/" + std::to_string(rng() % (num * 2));
+            break;
+        case 2: // many duplicates and zero bytes
+            k = std::string(rng() % 20, '\0') + char(rng() % 3);
+            break;
+        case 3: // long keys equal up to a random depth
+            k.assign(rng() % 200, 'x');
+            if (!k.empty()) k[rng() % k.size()] = char('a' + rng() % 4);
+            break;
+        }
+    }
+    return keys;
+}
+
+// min_num is the min number of strings which use parallel_radix_sort
+void check_sortable(const valvec<std::string>& keys, const char* threads,
+                    const char* min_num) {
+    setenv("SortableStrVec_minPrefixRadixSortNum", min_num, 1);
+    setenv("SortThinStrVec_minPrefixRadixSortNum", min_num, 1);
+    setenv("SortedStrVec_minPrefixRadixSortNum", min_num, 1);
+    setenv("SortableStrVec_sortThreads", threads, 1);
+    setenv("SortThinStrVec_sortThreads", threads, 1);
+    setenv("SortedStrVec_sortThreads", threads, 1);
+    valvec<std::string> sorted(keys);
+    std::sort(sorted.begin(), sorted.end());
+
+    SortableStrVec sv;
+    SortThinStrVec tv;
+    DoSortedStrVec dv;
+    for (auto& k : keys) {
+        sv.push_back(k);
+        tv.push_back(k);
+        dv.push_back(k);
+    }
+    sv.sort();
+    tv.sort();
+    dv.sort();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        TERARK_VERIFY(sv[i] == sorted[i]);
+        TERARK_VERIFY(tv[i] == sorted[i]);
+        TERARK_VERIFY(dv[i] == sorted[i]);
+    }
+    // sort with the value suffix excluded
+    SortThinStrVec tv2;
+    valvec<std::pair<std::string, std::string> > kv(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        kv[i].first = keys[i];
+        kv[i].second = std::string((char*)&i, 4);
+        tv2.push_back(keys[i] + kv[i].second);
+    }
+    tv2.sort(4);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        fstring s = tv2[i];
+        TERARK_VERIFY(s.substr(0, s.size() - 4) == sorted[i]);
+    }
+}
+
+void check_fixed(size_t num, size_t keylen, size_t valuelen, std::mt19937_64& rng) {
+    size_t fixlen = keylen + valuelen;
+    valvec<byte_t> recs(num * fixlen, valvec_no_init());
+    for (size_t i = 0; i < recs.size(); ++i)
+        recs[i] = byte_t(rng() % 4); // many duplicate keys
+    valvec<std::string> expected(num);
+    for (size_t i = 0; i < num; ++i)
+        expected[i].assign((char*)recs.data() + fixlen * i, fixlen);
+    FixedLenStrVec::sort_raw(recs.data(), num, fixlen, valuelen);
+    // keys must be sorted, records must be a permutation
+    valvec<std::string> got(num);
+    for (size_t i = 0; i < num; ++i) {
+        got[i].assign((char*)recs.data() + fixlen * i, fixlen);
+        if (i)
+            TERARK_VERIFY_LE(memcmp(got[i-1].data(), got[i].data(), keylen), 0);
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(got.begin(), got.end());
+    TERARK_VERIFY(expected == got);
+}
+
+int main() {
+    const size_t num = 300000;
+    std::mt19937_64 rng(num);
+    for (int kind = 0; kind < 4; ++kind) {
+        valvec<std::string> keys = make_keys(num, kind, rng);
+        check_sortable(keys, "1", "0");
+        check_sortable(keys, "4", "0");
+        keys.resize(100);
+        check_sortable(keys, "4", "0");
+        check_sortable(keys, "4", "101"); // std::sort
+    }
+    setenv("FixedLenStrVec_minPrefixRadixSortNum", "0", 1);
+    for (size_t keylen : {3, 5, 7, 8, 11, 20}) {
+        check_fixed(num, keylen, 0, rng);
+        check_fixed(num / 4, keylen, 6, rng);
+    }
+    setenv("FixedLenStrVec_minPrefixRadixSortNum", "1000", 1);
+    check_fixed(999, 5, 0, rng); // qsort
+    return 0;
+}
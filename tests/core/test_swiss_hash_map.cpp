@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <terark/swiss_hash_map.hpp>
+#include <terark/hash_strmap.hpp>
+
+using namespace terark;
+
+template<class Map, class StdMap>
+void check_same(const Map& m, const StdMap& sm) {
+    TERARK_VERIFY_EQ(m.size(), sm.size());
+    size_t n = 0;
+    for (size_t i = m.beg_i(); i < m.end_i(); i = m.next_i(i)) {
+        auto iter = sm.find(m.key(i));
+        TERARK_VERIFY(sm.end() != iter);
+        TERARK_VERIFY(iter->second == m.val(i));
+        n++;
+    }
+    TERARK_VERIFY_EQ(n, sm.size());
+    for (auto& kv : sm) {
+        size_t i = m.find_i(kv.first);
+        TERARK_VERIFY_NE(i, m.end_i());
+        TERARK_VERIFY(m.val(i) == kv.second);
+    }
+}
+
+void test_int_map(size_t num, std::mt19937_64& rng) {
+    swiss_hash_map<size_t, size_t> m;
+    std::unordered_map<size_t, size_t> sm;
+    size_t keyspace = num * 2;
+    for (size_t k = 0; k < num * 4; ++k) {
+        size_t key = rng() % keyspace;
+        switch (rng() % 4) {
+        case 0:
+        case 1: {
+            auto ib = m.insert_i(key, k);
+            auto sb = sm.emplace(key, k);
+            TERARK_VERIFY_EQ(ib.second, sb.second);
+            TERARK_VERIFY_EQ(m.val(ib.first), sb.first->second);
+            break; }
+        case 2:
+            TERARK_VERIFY_EQ(m.erase(key), sm.erase(key));
+            break;
+        case 3: {
+            size_t i = m.find_i(key);
+            TERARK_VERIFY_EQ((i != m.end_i()), (sm.count(key) != 0));
+            if (i != m.end_i()) {
+                m.val(i) = k;
+                sm[key] = k;
+            }
+            break; }
+        }
+    }
+    check_same(m, sm);
+    for (size_t k = 0; k < keyspace; ++k) {
+        TERARK_VERIFY_EQ(m.exists(k), (sm.count(k) != 0));
+    }
+    // erase_i by id
+    for (size_t i = m.beg_i(); i < m.end_i() && m.size() > num / 2; i = m.next_i(i)) {
+        sm.erase(m.key(i));
+        m.erase_i(i);
+    }
+    check_same(m, sm);
+    m.revoke_deleted();
+    TERARK_VERIFY_EQ(m.delcnt(), 0);
+    TERARK_VERIFY_EQ(m.end_i(), sm.size());
+    check_same(m, sm);
+    for (auto& kv : sm) m[kv.first] += 1, kv.second += 1;
+    check_same(m, sm);
+
+    swiss_hash_map<size_t, size_t> m2(m);
+    check_same(m2, sm);
+    swiss_hash_map<size_t, size_t> m3(std::move(m2));
+    check_same(m3, sm);
+    TERARK_VERIFY_EQ(m2.size(), 0);
+    TERARK_VERIFY_EQ(m2.find_i(1), m2.end_i());
+    m3.erase_all();
+    TERARK_VERIFY_EQ(m3.size(), 0);
+    TERARK_VERIFY_EQ(m3.find_i(*&sm.begin()->first), m3.end_i());
+    m3.insert_i(1, 2);
+    TERARK_VERIFY_EQ(m3.at(1), 2);
+}
+
+void test_str_map(size_t num, std::mt19937_64& rng) {
+    // std::string is not memmove-able, the node_layout must be SafeCopy
+    swiss_hash_map<std::string, size_t, std::hash<std::string>, std::equal_to<std::string>,
+                   node_layout<std::pair<std::string, size_t>, unsigned, SafeCopy> > m;
+    swiss_hash_strmap<size_t> sm;
+    std::unordered_map<std::string, size_t> stdm;
+    auto rand_str = [&](size_t keyspace) {
+        size_t x = rng() % keyspace;
+        return std::string(x % 13, 'a' + x % 26) + std::to_string(x);
+    };
+    for (size_t k = 0; k < num * 4; ++k) {
+        std::string key = rand_str(num * 2);
+        switch (rng() % 4) {
+        case 0:
+        case 1: {
+            size_t val = k;
+            auto ib1 = m.insert_i(key, val);
+            auto ib2 = sm.insert_i(key, val);
+            auto sb = stdm.emplace(key, val);
+            TERARK_VERIFY_EQ(ib1.second, sb.second);
+            TERARK_VERIFY_EQ(ib2.second, sb.second);
+            TERARK_VERIFY(sm.key(ib2.first) == key);
+            TERARK_VERIFY(sm.val(ib2.first) == sb.first->second);
+            break; }
+        case 2: {
+            size_t n = stdm.erase(key);
+            TERARK_VERIFY_EQ(m.erase(key), n);
+            TERARK_VERIFY_EQ(sm.erase(key), n);
+            break; }
+        case 3:
+            TERARK_VERIFY_EQ(sm.exists(key), (stdm.count(key) != 0));
+            TERARK_VERIFY_EQ(m.exists(key), (stdm.count(key) != 0));
+            break;
+        }
+    }
+    check_same(m, stdm);
+    TERARK_VERIFY_EQ(sm.size(), stdm.size());
+    sm.for_each([&](fstring key, size_t val) {
+        TERARK_VERIFY(stdm[key.str()] == val);
+    });
+    for (auto& kv : stdm) {
+        TERARK_VERIFY(sm.val(sm.find_i(kv.first)) == kv.second);
+    }
+    size_t delcnt = sm.delcnt();
+    TERARK_VERIFY_EQ(sm.revoke_deleted(), delcnt);
+    TERARK_VERIFY_EQ(sm.end_i(), stdm.size());
+    for (auto& kv : stdm) {
+        TERARK_VERIFY(sm.val(sm.find_i(kv.first)) == kv.second);
+    }
+    for (size_t i = sm.beg_i(); i < sm.end_i(); i = sm.next_i(i)) {
+        if (rng() % 2) {
+            stdm.erase(sm.key(i).str());
+            sm.erase_i(i);
+        }
+    }
+    swiss_hash_strmap<size_t> sm2(sm);
+    TERARK_VERIFY_EQ(sm2.size(), stdm.size());
+    for (auto& kv : stdm) {
+        TERARK_VERIFY(sm2[kv.first] == kv.second);
+    }
+    TERARK_VERIFY_EQ(sm2.size(), stdm.size());
+    sm.clear();
+    TERARK_VERIFY_EQ(sm.size(), 0);
+    TERARK_VERIFY(!sm.exists("a"));
+}
+
+int main() {
+    const size_t num = 30000;
+    std::mt19937_64 rng(num);
+    test_int_map(num, rng);
+    test_int_map(10, rng);
+    test_str_map(num, rng);
+    test_str_map(10, rng);
+    return 0;
+}
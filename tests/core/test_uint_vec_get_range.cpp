@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <random>
+#include <terark/int_vector.hpp>
+#include <terark/util/mmap.hpp>
+
+using namespace terark;
+
+template<class UintVec>
+void test_get_range(const UintVec& uv, std::mt19937_64& rng) {
+    size_t size = uv.size();
+    valvec<size_t> out(size + 1, valvec_no_init());
+    uv.get_range(0, size, out.data());
+    for (size_t i = 0; i < size; ++i) {
+        TERARK_VERIFY_F(out[i] == uv.get(i), "bits = %zd, i = %zd: %zd %zd",
+                        uv.uintbits(), i, out[i], uv.get(i));
+    }
+    for (size_t k = 0; k < 100; ++k) {
+        size_t beg = rng() % (size + 1);
+        size_t end = beg + rng() % (size - beg + 1);
+        out[end - beg] = size_t(-1);
+        uv.get_range(beg, end, out.data());
+        TERARK_VERIFY_EQ(out[end - beg], size_t(-1)); // no overrun
+        for (size_t i = beg; i < end; ++i) {
+            TERARK_VERIFY_EQ(out[i - beg], uv.get(i));
+        }
+    }
+}
+
+void test_bits(size_t bits, size_t size, std::mt19937_64& rng) {
+    size_t mask = 64 == bits ? size_t(-1) : ~(size_t(-1) << bits);
+    valvec<size_t> data(size, valvec_no_init());
+    for (size_t i = 0; i < size; ++i) data[i] = rng() & mask;
+
+    // set_range in random pieces
+    BigUintVecMin0 big;
+    big.resize_with_uintbits(size, bits);
+    for (size_t i = 0; i < size; ) {
+        size_t n = std::min(size - i, size_t(rng() % 100));
+        big.set_range(i, i + n, data.data() + i);
+        i += n;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        TERARK_VERIFY_EQ(big.get(i), data[i]);
+    }
+    // set_range must keep the neighbours
+    if (size >= 3) {
+        size_t mid = size / 2;
+        big.set_range(mid, mid + 1, data.data());
+        TERARK_VERIFY_EQ(big.get(mid - 1), data[mid - 1]);
+        TERARK_VERIFY_EQ(big.get(mid + 0), data[0]);
+        TERARK_VERIFY_EQ(big.get(mid + 1), data[mid + 1]);
+        big.set_range(mid, mid + 1, data.data() + mid);
+    }
+    test_get_range(big, rng);
+
+    if (bits <= 58) {
+        UintVecMin0 uv;
+        uv.resize_with_uintbits(size, bits);
+        uv.set_range(0, size, data.data());
+        test_get_range(uv, rng);
+    }
+
+    // Builder::push_back_n must produce the same file as push_back
+    const char* fpath1 = "test_uint_vec_get_range.1.tmp";
+    const char* fpath2 = "test_uint_vec_get_range.2.tmp";
+    std::unique_ptr<UintVecMin0::Builder>
+        b1(UintVecMin0::create_builder_by_uintbits(bits, fpath1)),
+        b2(UintVecMin0::create_builder_by_uintbits(bits, fpath2));
+    for (size_t i = 0; i < size; ++i) b1->push_back(data[i]);
+    for (size_t i = 0; i < size; ) {
+        size_t n = std::min(size - i, size_t(rng() % 300));
+        b2->push_back_n(data.data() + i, n);
+        i += n;
+    }
+    auto r1 = b1->finish();
+    auto r2 = b2->finish();
+    TERARK_VERIFY_EQ(r1.size, r2.size);
+    TERARK_VERIFY_EQ(r1.mem_size, r2.mem_size);
+    b1.reset();
+    b2.reset();
+    MmapWholeFile f1(fpath1), f2(fpath2);
+    TERARK_VERIFY_EQ(f1.size, f2.size);
+    TERARK_VERIFY_EQ(memcmp(f1.base, f2.base, f1.size), 0);
+}
+
+void test_zip_int_vector(size_t size, std::mt19937_64& rng) {
+    valvec<intptr_t> data(size, valvec_no_init());
+    for (size_t i = 0; i < size; ++i) data[i] = intptr_t(rng() % 100000) - 50000;
+    SintVector sv;
+    sv.build_from(data);
+    valvec<intptr_t> out(size, valvec_no_init());
+    sv.get_range(0, size, out.data());
+    for (size_t i = 0; i < size; ++i) {
+        TERARK_VERIFY_EQ(sv.get(i), data[i]);
+        TERARK_VERIFY_EQ(out[i], data[i]);
+    }
+    ZipIntVector<uint32_t> zv;
+    zv.build_from(data.data(), size);
+    valvec<uint32_t> out32(size, valvec_no_init());
+    zv.get_range(0, size, out32.data());
+    for (size_t i = 0; i < size; ++i) {
+        TERARK_VERIFY_EQ(out32[i], uint32_t(data[i]));
+    }
+}
+
+int main() {
+    const size_t size = 30000;
+    std::mt19937_64 rng(size);
+    for (size_t bits = 0; bits <= 64; ++bits) {
+        test_bits(bits, size, rng);
+        test_bits(bits, rng() % 40, rng);
+    }
+    test_zip_int_vector(size, rng);
+    test_zip_int_vector(7, rng);
+    ::remove("test_uint_vec_get_range.1.tmp");
+    ::remove("test_uint_vec_get_range.2.tmp");
+    return 0;
+}
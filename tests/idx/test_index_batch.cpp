@@ -0,0 +1,128 @@
+#include <terark/idx/terark_zip_index.hpp>
+#include <terark/entropy/entropy_base.hpp>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+class VecKeyReader : public TerarkKeyReader {
+    const std::vector<std::string>& m_keys;
+    size_t m_pos = 0;
+public:
+    explicit VecKeyReader(const std::vector<std::string>& keys) : m_keys(keys) {}
+    fstring next() override { return m_keys[m_pos++]; }
+    void rewind() override { m_pos = 0; }
+    TerarkKeyReader* clone() const override { return new VecKeyReader(m_keys); }
+};
+
+static std::unique_ptr<TerarkIndex>
+build(const std::vector<std::string>& keys) {
+    VecKeyReader reader(keys);
+    TerarkIndexOptions tiopt;
+    return std::unique_ptr<TerarkIndex>(
+        TerarkIndex::Factory::Build(&reader, keys.size(), tiopt));
+}
+
+static std::vector<std::string>
+make_probes(const std::vector<std::string>& keys, std::mt19937_64& rnd) {
+    std::vector<std::string> probes;
+    for (auto& key : keys) {
+        probes.push_back(key);
+        switch (rnd() % 4) {
+        case 0: probes.push_back(key.substr(0, rnd() % (key.size() + 1))); break;
+        case 1: probes.push_back(key + char(rnd())); break;
+        case 2: probes.push_back(key); probes.back().back() ^= 1; break;
+        case 3: probes.push_back(keys[rnd() % keys.size()].substr(0, 3) + key); break;
+        }
+    }
+    std::shuffle(probes.begin(), probes.end(), rnd);
+    return probes;
+}
+
+static void check(const std::vector<std::string>& keys, const char* suffix_name) {
+    std::mt19937_64 rnd(keys.size());
+    auto index = build(keys);
+    auto ctx = GetTlsTerarkContext();
+    std::string name = index->Name().str();
+    fprintf(stderr, "%s: keys = %zd\n", name.c_str(), keys.size());
+    TERARK_VERIFY_F(name.find(suffix_name) != std::string::npos,
+                    "%s: expect suffix %s", name.c_str(), suffix_name);
+    TERARK_VERIFY_EQ(index->NumKeys(), keys.size());
+    auto probes = make_probes(keys, rnd);
+    std::vector<fstring> batch;
+    std::vector<size_t> ids, ranks;
+    for (size_t beg = 0; beg < probes.size(); ) {
+        size_t n = std::min<size_t>(1 + rnd() % 100, probes.size() - beg);
+        batch.assign(probes.begin() + beg, probes.begin() + beg + n);
+        ids.assign(n, 0);
+        ranks.assign(n, 0);
+        index->FindBatch(batch.data(), n, ids.data(), ctx);
+        index->DictRankBatch(batch.data(), n, ranks.data(), ctx);
+        for (size_t i = 0; i < n; ++i) {
+            TERARK_VERIFY_EQ(ids[i], index->Find(batch[i], ctx));
+            TERARK_VERIFY_EQ(ranks[i], index->DictRank(batch[i], ctx));
+        }
+        beg += n;
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        TERARK_VERIFY_NE(index->Find(keys[i], ctx), size_t(-1));
+    }
+}
+
+static std::string rand_str(std::mt19937_64& rnd, const char* alpha, size_t len) {
+    size_t alen = strlen(alpha);
+    std::string s(len, '\0');
+    for (auto& c : s) c = alpha[rnd() % alen];
+    return s;
+}
+
+static void sort_unique(std::vector<std::string>& keys, bool reverse) {
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    if (reverse)
+        std::reverse(keys.begin(), keys.end());
+}
+
+int main() {
+    // just the nest louds trie prefix has FindBatch of its own
+    setenv("TerarkZipTable_enableUintIndex", "0", 1);
+    setenv("TerarkZipTable_enableEntropySuffix", "0", 1);
+    std::mt19937_64 rnd(12345);
+    std::vector<std::string> keys;
+    // fixed length suffix: the prefix words are exactly the first 2 bytes
+    for (int b0 = 0; b0 < 64; ++b0) {
+        for (int b1 = 0; b1 < 256; ++b1) {
+            std::string key = {char(b0), char(b1)};
+            keys.push_back(key + rand_str(rnd, "0123456789abcdef", 14));
+        }
+    }
+    check(keys, "FixLen");
+    // var length suffix, many keys are prefixes of other keys
+    keys.clear();
+    for (int i = 0; i < 20000; ++i) {
+        keys.push_back(rand_str(rnd, "abcd", 1 + rnd() % 24));
+    }
+    sort_unique(keys, false);
+    check(keys, "VarLen");
+    sort_unique(keys, true);
+    check(keys, "VarLen");
+    // long compressible suffix
+    static const char* words[] = {
+        "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf",
+        "hotel", "india", "juliet", "kilo", "lima", "mike", "november",
+    };
+    keys.clear();
+    for (int i = 0; i < 20000; ++i) {
+        std::string key = rand_str(rnd, "abcd", 1 + rnd() % 10);
+        for (int j = 0; j < 8; ++j) {
+            key += ' ';
+            key += words[rnd() % (sizeof(words)/sizeof(words[0]))];
+        }
+        keys.push_back(key);
+    }
+    sort_unique(keys, false);
+    check(keys, "DictZip");
+    return 0;
+}
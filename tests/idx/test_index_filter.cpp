@@ -0,0 +1,70 @@
+#include <terark/idx/terark_zip_index.hpp>
+#include <terark/entropy/entropy_base.hpp>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+class VecKeyReader : public TerarkKeyReader {
+    const std::vector<std::string>& m_keys;
+    size_t m_pos = 0;
+public:
+    explicit VecKeyReader(const std::vector<std::string>& keys) : m_keys(keys) {}
+    fstring next() override { return m_keys[m_pos++]; }
+    void rewind() override { m_pos = 0; }
+    TerarkKeyReader* clone() const override { return new VecKeyReader(m_keys); }
+};
+
+// every key must be found, no matter whether the filter is enabled, and
+// keys not in the index must not be found
+static void check(const TerarkIndex* index, const std::vector<std::string>& keys,
+                  const std::vector<std::string>& absent) {
+    auto ctx = GetTlsTerarkContext();
+    TERARK_VERIFY_EQ(index->NumKeys(), keys.size());
+    std::vector<fstring> batch(keys.begin(), keys.end());
+    std::vector<size_t> ids(keys.size());
+    index->FindBatch(batch.data(), batch.size(), ids.data(), ctx);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        size_t id = index->Find(keys[i], ctx);
+        TERARK_VERIFY_F(id != size_t(-1), "false negative: %s", keys[i].c_str());
+        TERARK_VERIFY_EQ(ids[i], id);
+    }
+    for (auto& key : absent) {
+        TERARK_VERIFY_EQ(index->Find(key, ctx), size_t(-1));
+    }
+}
+
+int main() {
+    std::mt19937_64 rnd(12345);
+    std::vector<std::string> keys, absent;
+    for (int i = 0; i < 50000; ++i) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "key/%016llx", (unsigned long long)rnd());
+        (i % 4 ? keys : absent).push_back(buf);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    for (auto& key : absent) {
+        TERARK_VERIFY(!std::binary_search(keys.begin(), keys.end(), key));
+    }
+    for (uint32_t bitsPerKey : {0, 4, 10}) {
+        VecKeyReader reader(keys);
+        TerarkIndexOptions tiopt;
+        tiopt.filterBitsPerKey = bitsPerKey;
+        std::unique_ptr<TerarkIndex> index(
+            TerarkIndex::Factory::Build(&reader, keys.size(), tiopt));
+        fprintf(stderr, "%s: filterBitsPerKey = %u\n",
+                index->Name().c_str(), bitsPerKey);
+        check(index.get(), keys, absent);
+        // the filter is also checked after save and load
+        valvec<byte_t> mem;
+        index->SaveMmap([&](const void* data, size_t size) {
+            mem.append((const byte_t*)data, size);
+        });
+        auto loaded = TerarkIndex::LoadMemory(mem);
+        check(loaded.get(), keys, absent);
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <terark/idx/terark_zip_index.hpp>
+#include <terark/entropy/entropy_base.hpp>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+class VecKeyReader : public TerarkKeyReader {
+    const std::vector<std::string>& m_keys;
+    size_t m_pos = 0;
+public:
+    explicit VecKeyReader(const std::vector<std::string>& keys) : m_keys(keys) {}
+    fstring next() override { return m_keys[m_pos++]; }
+    void rewind() override { m_pos = 0; }
+    TerarkKeyReader* clone() const override { return new VecKeyReader(m_keys); }
+};
+
+static std::string uint_key(uint64_t val, fstring suffix) {
+    std::string key(8, '\0');
+    for (size_t i = 0; i < 8; ++i)
+        key[i] = char(val >> (56 - 8 * i)); // big endian
+    key.append(suffix.data(), suffix.size());
+    return key;
+}
+
+static void check(const TerarkIndex* index, const std::vector<std::string>& keys,
+                  const std::vector<std::string>& absent) {
+    auto ctx = GetTlsTerarkContext();
+    TERARK_VERIFY_EQ(index->NumKeys(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        TERARK_VERIFY_EQ(index->DictRank(keys[i], ctx), i);
+        TERARK_VERIFY_NE(index->Find(keys[i], ctx), size_t(-1));
+    }
+    for (auto& key : absent) {
+        TERARK_VERIFY_EQ(index->Find(key, ctx), size_t(-1));
+        size_t rank = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+        TERARK_VERIFY_EQ(index->DictRank(key, ctx), rank);
+    }
+    std::unique_ptr<TerarkIndex::Iterator> iter(index->NewIterator(nullptr, ctx));
+    size_t i = 0;
+    for (bool ok = iter->SeekToFirst(); ok; ok = iter->Next(), ++i) {
+        TERARK_VERIFY(iter->key() == keys[i]);
+        TERARK_VERIFY_EQ(iter->id(), index->Find(keys[i], ctx));
+    }
+    TERARK_VERIFY_EQ(i, keys.size());
+    for (auto& key : absent) {
+        size_t rank = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+        if (rank < keys.size()) {
+            TERARK_VERIFY(iter->Seek(key));
+            TERARK_VERIFY(iter->key() == keys[rank]);
+        } else {
+            TERARK_VERIFY(!iter->Seek(key));
+        }
+    }
+}
+
+// sparse near linear uint keys, with and without a suffix, are indexed by
+// the learned uint prefix
+static void check_learned(fstring suffix) {
+    std::mt19937_64 rnd(suffix.size());
+    std::vector<std::string> keys, absent;
+    for (uint64_t i = 0; i < 100000; ++i) {
+        uint64_t val = (uint64_t(1) << 40) + i * 1000000 + rnd() % 1000000;
+        (i % 8 ? keys : absent).push_back(uint_key(val, suffix));
+    }
+    absent.push_back(uint_key(0, suffix));
+    absent.push_back(uint_key(uint64_t(-1), suffix));
+    std::sort(keys.begin(), keys.end());
+    VecKeyReader reader(keys);
+    std::unique_ptr<TerarkIndex> index(
+        TerarkIndex::Factory::Build(&reader, keys.size(), TerarkIndexOptions()));
+    std::string name = index->Name().str();
+    fprintf(stderr, "%s: keys = %zd\n", name.c_str(), keys.size());
+    TERARK_VERIFY_F(name.find("Learned") != std::string::npos, "%s", name.c_str());
+    check(index.get(), keys, absent);
+    valvec<byte_t> mem;
+    index->SaveMmap([&](const void* data, size_t size) {
+        mem.append((const byte_t*)data, size);
+    });
+    auto loaded = TerarkIndex::LoadMemory(mem);
+    check(loaded.get(), keys, absent);
+}
+
+int main() {
+    check_learned("");
+    check_learned("/suffix");
+    return 0;
+}
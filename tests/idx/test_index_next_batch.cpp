@@ -0,0 +1,124 @@
+#include <terark/idx/terark_zip_index.hpp>
+#include <terark/entropy/entropy_base.hpp>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+class VecKeyReader : public TerarkKeyReader {
+    const std::vector<std::string>& m_keys;
+    size_t m_pos = 0;
+public:
+    explicit VecKeyReader(const std::vector<std::string>& keys) : m_keys(keys) {}
+    fstring next() override { return m_keys[m_pos++]; }
+    void rewind() override { m_pos = 0; }
+    TerarkKeyReader* clone() const override { return new VecKeyReader(m_keys); }
+};
+
+// NextBatch, mixed with Next, must see the same keys and ids as Next only
+static void check(const std::vector<std::string>& keys, const char* suffix_name) {
+    std::mt19937_64 rnd(keys.size());
+    VecKeyReader reader(keys);
+    std::unique_ptr<TerarkIndex> index(
+        TerarkIndex::Factory::Build(&reader, keys.size(), TerarkIndexOptions()));
+    std::string name = index->Name().str();
+    fprintf(stderr, "%s: keys = %zd\n", name.c_str(), keys.size());
+    TERARK_VERIFY_F(name.find(suffix_name) != std::string::npos,
+                    "%s: expect suffix %s", name.c_str(), suffix_name);
+    auto ctx = GetTlsTerarkContext();
+    std::vector<std::string> expect_keys;
+    std::vector<size_t> expect_ids;
+    std::unique_ptr<TerarkIndex::Iterator> iter(index->NewIterator(nullptr, ctx));
+    for (bool ok = iter->SeekToFirst(); ok; ok = iter->Next()) {
+        expect_keys.push_back(iter->key().str());
+        expect_ids.push_back(iter->id());
+    }
+    TERARK_VERIFY_EQ(expect_keys.size(), keys.size());
+    for (bool prefetch_ahead : {false, true}) {
+        iter.reset(index->NewIterator(nullptr, ctx));
+        iter->SetPrefetchAhead(prefetch_ahead);
+        TERARK_VERIFY(iter->SeekToFirst());
+        size_t pos = 0;
+        valvec<fstring> batch;
+        std::vector<size_t> ids(300);
+        while (pos + 1 < expect_keys.size()) {
+            if (rnd() % 4 == 0) {
+                TERARK_VERIFY(iter->Next());
+                pos++;
+                TERARK_VERIFY(iter->key() == expect_keys[pos]);
+                TERARK_VERIFY_EQ(iter->id(), expect_ids[pos]);
+                continue;
+            }
+            size_t n = 1 + rnd() % ids.size();
+            size_t m = iter->NextBatch(n, &batch, ids.data());
+            TERARK_VERIFY_EQ(m, std::min(n, expect_keys.size() - pos - 1));
+            TERARK_VERIFY_EQ(batch.size(), m);
+            for (size_t i = 0; i < m; ++i) {
+                TERARK_VERIFY(batch[i] == expect_keys[pos + 1 + i]);
+                TERARK_VERIFY_EQ(ids[i], expect_ids[pos + 1 + i]);
+            }
+            pos += m;
+            if (pos + 1 < expect_keys.size()) {
+                TERARK_VERIFY(iter->Valid());
+                TERARK_VERIFY(iter->key() == expect_keys[pos]);
+                TERARK_VERIFY_EQ(iter->id(), expect_ids[pos]);
+            }
+        }
+        TERARK_VERIFY_EQ(iter->NextBatch(10, &batch, ids.data()), 0);
+        TERARK_VERIFY(!iter->Valid());
+    }
+}
+
+static std::string rand_str(std::mt19937_64& rnd, const char* alpha, size_t len) {
+    size_t alen = strlen(alpha);
+    std::string s(len, '\0');
+    for (auto& c : s) c = alpha[rnd() % alen];
+    return s;
+}
+
+static void sort_unique(std::vector<std::string>& keys, bool reverse) {
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    if (reverse)
+        std::reverse(keys.begin(), keys.end());
+}
+
+int main() {
+    setenv("TerarkZipTable_enableUintIndex", "0", 1);
+    setenv("TerarkZipTable_enableEntropySuffix", "0", 1);
+    std::mt19937_64 rnd(12345);
+    std::vector<std::string> keys;
+    for (int b0 = 0; b0 < 64; ++b0) {
+        for (int b1 = 0; b1 < 256; ++b1) {
+            std::string key = {char(b0), char(b1)};
+            keys.push_back(key + rand_str(rnd, "0123456789abcdef", 14));
+        }
+    }
+    check(keys, "FixLen");
+    keys.clear();
+    for (int i = 0; i < 20000; ++i) {
+        keys.push_back(rand_str(rnd, "abcd", 1 + rnd() % 24));
+    }
+    sort_unique(keys, false);
+    check(keys, "VarLen");
+    sort_unique(keys, true);
+    check(keys, "VarLen");
+    static const char* words[] = {
+        "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf",
+        "hotel", "india", "juliet", "kilo", "lima", "mike", "november",
+    };
+    keys.clear();
+    for (int i = 0; i < 20000; ++i) {
+        std::string key = rand_str(rnd, "abcd", 1 + rnd() % 10);
+        for (int j = 0; j < 8; ++j) {
+            key += ' ';
+            key += words[rnd() % (sizeof(words)/sizeof(words[0]))];
+        }
+        keys.push_back(key);
+    }
+    sort_unique(keys, false);
+    check(keys, "DictZip");
+    return 0;
+}
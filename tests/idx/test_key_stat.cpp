@@ -0,0 +1,145 @@
+#include <terark/idx/terark_zip_index.hpp>
+#include <terark/entropy/entropy_base.hpp>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+class VecKeyReader : public TerarkKeyReader {
+    const std::vector<std::string>& m_keys;
+    size_t m_pos = 0;
+public:
+    explicit VecKeyReader(const std::vector<std::string>& keys) : m_keys(keys) {}
+    fstring next() override { return m_keys[m_pos++]; }
+    void rewind() override { m_pos = 0; }
+    TerarkKeyReader* clone() const override { return new VecKeyReader(m_keys); }
+};
+
+// clone() returns nullptr, so Factory::Build is sequential
+class SeqKeyReader : public VecKeyReader {
+public:
+    using VecKeyReader::VecKeyReader;
+    TerarkKeyReader* clone() const override { return nullptr; }
+};
+
+// the entropy suffix is not byte identical between two builds, so the
+// parallel and the sequential build are compared by their behaviour
+static void verify_same_index(const TerarkIndex* x, const TerarkIndex* y,
+                              const std::vector<std::string>& keys) {
+    auto ctx = GetTlsTerarkContext();
+    TERARK_VERIFY(x->Name() == y->Name());
+    TERARK_VERIFY_EQ(x->NumKeys(), y->NumKeys());
+    for (auto& key : keys) {
+        TERARK_VERIFY_EQ(x->Find(key, ctx), y->Find(key, ctx));
+    }
+    std::unique_ptr<TerarkIndex::Iterator> xi(x->NewIterator(nullptr, ctx));
+    std::unique_ptr<TerarkIndex::Iterator> yi(y->NewIterator(nullptr, ctx));
+    bool xok = xi->SeekToFirst(), yok = yi->SeekToFirst();
+    for (; xok && yok; xok = xi->Next(), yok = yi->Next()) {
+        TERARK_VERIFY(xi->key() == yi->key());
+        TERARK_VERIFY_EQ(xi->id(), yi->id());
+    }
+    TERARK_VERIFY(!xok && !yok);
+}
+
+// one pass over all keys, same as TerarkIndexDebugBuilder
+static void reference_key_stat(const std::vector<std::string>& keys,
+                               TerarkIndex::KeyStat* ks) {
+    freq_hist_o1 freq;
+    *ks = TerarkIndex::KeyStat();
+    ks->keyCount = keys.size();
+    ks->minKey.assign(fstring(keys.front()));
+    ks->maxKey.assign(fstring(keys.back()));
+    size_t prevSamePrefix = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        fstring key = keys[i];
+        freq.add_record(key);
+        size_t samePrefix = i + 1 < keys.size() ? key.commonPrefixLen(keys[i + 1]) : 0;
+        size_t prefixSize = std::min(key.size(), std::max(samePrefix, prevSamePrefix) + 1);
+        size_t suffixSize = key.size() - prefixSize;
+        ks->minKeyLen = std::min(ks->minKeyLen, key.size());
+        ks->maxKeyLen = std::max(ks->maxKeyLen, key.size());
+        ks->sumKeyLen += key.size();
+        ks->sumPrefixLen += prefixSize;
+        ks->minPrefixLen = std::min(ks->minPrefixLen, prefixSize);
+        ks->maxPrefixLen = std::max(ks->maxPrefixLen, prefixSize);
+        ks->minSuffixLen = std::min(ks->minSuffixLen, suffixSize);
+        ks->maxSuffixLen = std::max(ks->maxSuffixLen, suffixSize);
+        auto& diff = ks->diff;
+        if (diff.size() < samePrefix) {
+            diff.resize(samePrefix);
+        }
+        for (size_t j = 0; j < samePrefix; ++j) {
+            diff[j].cur++;
+            diff[j].cnt++;
+        }
+        for (size_t j = samePrefix; j < diff.size(); ++j) {
+            diff[j].max = std::max(diff[j].cur, diff[j].max);
+            diff[j].cur = 0;
+        }
+        prevSamePrefix = samePrefix;
+    }
+    freq.finish();
+    ks->entropyLen = freq_hist_o1::estimate_size(freq.histogram());
+}
+
+static void verify_equal(const TerarkIndex::KeyStat& x, const TerarkIndex::KeyStat& y) {
+    TERARK_VERIFY_EQ(x.keyCount, y.keyCount);
+    TERARK_VERIFY_EQ(x.sumKeyLen, y.sumKeyLen);
+    TERARK_VERIFY_EQ(x.minKeyLen, y.minKeyLen);
+    TERARK_VERIFY_EQ(x.maxKeyLen, y.maxKeyLen);
+    TERARK_VERIFY_EQ(x.sumPrefixLen, y.sumPrefixLen);
+    TERARK_VERIFY_EQ(x.minPrefixLen, y.minPrefixLen);
+    TERARK_VERIFY_EQ(x.maxPrefixLen, y.maxPrefixLen);
+    TERARK_VERIFY_EQ(x.minSuffixLen, y.minSuffixLen);
+    TERARK_VERIFY_EQ(x.maxSuffixLen, y.maxSuffixLen);
+    TERARK_VERIFY_EQ(x.entropyLen, y.entropyLen);
+    TERARK_VERIFY(x.minKey == y.minKey);
+    TERARK_VERIFY(x.maxKey == y.maxKey);
+    TERARK_VERIFY_EQ(x.diff.size(), y.diff.size());
+    for (size_t i = 0; i < x.diff.size(); ++i) {
+        TERARK_VERIFY_EQ(x.diff[i].cnt, y.diff[i].cnt);
+        TERARK_VERIFY_EQ(x.diff[i].max, y.diff[i].max);
+    }
+}
+
+int main() {
+    // the prefix and the suffix are built concurrently by the cloned reader
+    setenv("TerarkZipTable_buildThreads", "4", 1);
+    std::mt19937_64 rnd(1);
+    std::vector<std::string> keys;
+    // some long runs of a shared prefix cross the chunks of 64K keys
+    for (size_t i = 0; i < 300000; ++i) {
+        std::string key(1 + rnd() % 16, '\0');
+        for (auto& c : key) c = "abc"[rnd() % 3];
+        if (i % 100000 < 80000)
+            key = "shared/prefix/" + key;
+        keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    TerarkIndex::KeyStat ref;
+    reference_key_stat(keys, &ref);
+    VecKeyReader reader(keys);
+    for (size_t threads : {1, 2, 3, 8}) {
+        TerarkIndex::KeyStat ks;
+        TerarkIndex::CollectKeyStat(&reader, keys.size(), &ks, threads);
+        verify_equal(ks, ref);
+    }
+    // Factory::Build without a KeyStat uses CollectKeyStat, the parallel
+    // build must be the same as the sequential one
+    std::unique_ptr<TerarkIndex> index(
+        TerarkIndex::Factory::Build(&reader, keys.size(), TerarkIndexOptions()));
+    TERARK_VERIFY_EQ(index->NumKeys(), keys.size());
+    auto ctx = GetTlsTerarkContext();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        TERARK_VERIFY_EQ(index->DictRank(keys[i], ctx), i);
+    }
+    SeqKeyReader seq_reader(keys);
+    std::unique_ptr<TerarkIndex> seq_index(
+        TerarkIndex::Factory::Build(&seq_reader, keys.size(), TerarkIndexOptions()));
+    verify_same_index(index.get(), seq_index.get(), keys);
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <random>
+#include <algorithm>
+#include <terark/util/elias_fano_uint_vec.hpp>
+#include <terark/util/sorted_uint_vec.hpp>
+#include <terark/util/profiling.hpp>
+
+using namespace terark;
+
+static void check(const valvec<uint64_t>& vals) {
+    EliasFanoUintVec ef;
+    ef.build_from(vals);
+    TERARK_VERIFY_EQ(ef.size(), vals.size());
+    for (size_t i = 0; i < vals.size(); ++i) {
+        TERARK_VERIFY_EQ(ef[i], vals[i]);
+    }
+    for (size_t i = 0; i + 1 < vals.size(); ++i) {
+        auto BegEnd = ef.get2(i);
+        TERARK_VERIFY_EQ(BegEnd[0], vals[i]);
+        TERARK_VERIFY_EQ(BegEnd[1], vals[i+1]);
+    }
+    std::mt19937_64 rnd(vals.size());
+    valvec<size_t> buf(200, valvec_no_init());
+    for (size_t beg = 0; beg < vals.size(); beg += 1 + rnd() % 500) {
+        size_t end = std::min(vals.size(), beg + rnd() % 200);
+        ef.get_range(beg, end, buf.data());
+        for (size_t i = beg; i < end; ++i)
+            TERARK_VERIFY_EQ(buf[i - beg], vals[i]);
+    }
+    auto check_bound = [&](const EliasFanoUintVec& v, uint64_t key) {
+        size_t lb = std::lower_bound(vals.begin(), vals.end(), key) - vals.begin();
+        size_t ub = std::upper_bound(vals.begin(), vals.end(), key) - vals.begin();
+        TERARK_VERIFY_EQ(v.lower_bound(key), lb);
+        TERARK_VERIFY_EQ(v.upper_bound(key), ub);
+        if (vals.size()) {
+            size_t lo = rnd() % vals.size();
+            size_t hi = lo + rnd() % (vals.size() - lo + 1);
+            auto b = vals.begin();
+            TERARK_VERIFY_EQ(v.lower_bound(lo, hi, key), size_t(std::lower_bound(b + lo, b + hi, key) - b));
+            TERARK_VERIFY_EQ(v.upper_bound(lo, hi, key), size_t(std::upper_bound(b + lo, b + hi, key) - b));
+        }
+    };
+    for (size_t i = 0; i < vals.size(); ++i) {
+        check_bound(ef, vals[i]);
+        check_bound(ef, vals[i] - 1);
+        check_bound(ef, vals[i] + 1);
+    }
+    for (size_t i = 0; i < 1000; ++i) {
+        check_bound(ef, vals.size() ? rnd() % (vals.back() + 2) : rnd());
+    }
+    check_bound(ef, 0);
+    check_bound(ef, UINT64_MAX);
+
+    // load from a copy of the memory image
+    valvec<byte_t> image(ef.data(), ef.mem_size());
+    EliasFanoUintVec ef2;
+    ef2.risk_set_data(image.data(), image.size());
+    TERARK_VERIFY_EQ(ef2.size(), ef.size());
+    for (size_t i = 0; i < vals.size(); ++i) {
+        TERARK_VERIFY_EQ(ef2[i], vals[i]);
+        check_bound(ef2, vals[i]);
+    }
+    ef2.risk_release_ownership();
+    size_t est = EliasFanoUintVec::estimate_mem_size(vals.size(), vals.size() ? vals.back() : 0);
+    printf("size = %8zd, low_bits = %2zd, bits/val = %6.3f, estimate = %zd, real = %zd\n",
+        vals.size(), ef.low_bits(),
+        vals.size() ? 8.0 * ef.mem_size() / vals.size() : 0.0, est, ef.mem_size());
+    TERARK_VERIFY_LE(ef.mem_size(), est);
+}
+
+static void unit_test_invalid() {
+    uint64_t vals[] = { 1, 3, 2 };
+    EliasFanoUintVec ef;
+    try {
+        ef.build_from(vals, 3);
+        TERARK_DIE("should throw");
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+static void unit_test_can_build() {
+    TERARK_VERIFY(EliasFanoUintVec::can_build(0, 0));
+    TERARK_VERIFY(EliasFanoUintVec::can_build(1000, uint64_t(1) << 40));
+    TERARK_VERIFY(EliasFanoUintVec::can_build(size_t(1) << 30, size_t(1) << 30));
+    // the high bitmap needs 2^32 bits or more
+    TERARK_VERIFY(!EliasFanoUintVec::can_build(size_t(1) << 31, size_t(1) << 31));
+    TERARK_VERIFY(!EliasFanoUintVec::can_build(size_t(1) << 32, 0));
+}
+
+static void bench(const valvec<uint64_t>& vals) {
+    EliasFanoUintVec ef;
+    ef.build_from(vals);
+    SortedUintVec sv;
+    sv.build_from(vals, 128);
+    std::mt19937_64 rnd(1);
+    valvec<size_t> q(1 << 20, valvec_no_init());
+    for (auto& x : q) x = rnd() % (vals.size() - 1);
+    profiling pf;
+    size_t sum1 = 0, sum2 = 0;
+    long long t0 = pf.now();
+    for (auto i : q) { auto x = sv.get2(i); sum1 += x[1] - x[0]; }
+    long long t1 = pf.now();
+    for (auto i : q) { auto x = ef.get2(i); sum2 += x[1] - x[0]; }
+    long long t2 = pf.now();
+    TERARK_VERIFY_EQ(sum1, sum2);
+    valvec<size_t> buf(128, valvec_no_init());
+    sum1 = sum2 = 0;
+    long long t3 = pf.now();
+    for (size_t i = 0; i + 128 <= vals.size(); i += 128) {
+        sv.get_block(i / 128, buf.data()); sum1 += buf[127];
+    }
+    long long t4 = pf.now();
+    for (size_t i = 0; i + 128 <= vals.size(); i += 128) {
+        ef.get_range(i, i + 128, buf.data()); sum2 += buf[127];
+    }
+    long long t5 = pf.now();
+    TERARK_VERIFY_EQ(sum1, sum2);
+    printf("get2: sorted = %6.2f ns, elias-fano = %6.2f ns\n",
+        pf.nf(t0, t1) / q.size(), pf.nf(t1, t2) / q.size());
+    printf("bulk: sorted = %6.2f ns, elias-fano = %6.2f ns per value\n",
+        pf.nf(t3, t4) / vals.size(), pf.nf(t4, t5) / vals.size());
+    printf("mem : sorted = %zd, elias-fano = %zd\n", sv.mem_size(), ef.mem_size());
+}
+
+int main(int argc, char* argv[]) {
+    unit_test_invalid();
+    unit_test_can_build();
+    std::mt19937_64 rnd(12345);
+    valvec<uint64_t> vals;
+    check(vals);
+    vals.push_back(0);
+    check(vals);
+    vals.push_back(77);
+    check(vals);
+    // all zero, all equal
+    vals.erase_all();
+    vals.resize(1000, 0);
+    check(vals);
+    vals.fill(uint64_t(1) << 40);
+    check(vals);
+    // record offsets: small variable lengths with empty records
+    vals.erase_all();
+    uint64_t x = 0;
+    for (size_t i = 0; i < 200000; ++i) {
+        vals.push_back(x);
+        x += i % 7 == 0 ? 0 : rnd() % 300;
+    }
+    check(vals);
+    // huge gaps, low bits > 56 takes the scalar path
+    vals.erase_all();
+    for (size_t i = 0; i < 16; ++i)
+        vals.push_back(rnd() >> 1);
+    std::sort(vals.begin(), vals.end());
+    check(vals);
+    // uniform random, dense
+    vals.erase_all();
+    for (size_t i = 0; i < 100000; ++i)
+        vals.push_back(rnd() % 1000000);
+    std::sort(vals.begin(), vals.end());
+    check(vals);
+    if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+        vals.erase_all();
+        x = 0;
+        for (size_t i = 0; i < 4000000; ++i) {
+            vals.push_back(x);
+            x += rnd() % 1000;
+        }
+        bench(vals);
+    }
+    printf("elias_fano_uint_vec_test passed\n");
+    return 0;
+}
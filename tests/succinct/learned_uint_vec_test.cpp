@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <random>
+#include <algorithm>
+#include <terark/util/learned_uint_vec.hpp>
+#include <terark/util/profiling.hpp>
+
+using namespace terark;
+
+static void check(const valvec<uint64_t>& keys, size_t epsilon) {
+    LearnedUintVec lv;
+    lv.build_from(keys, epsilon);
+    TERARK_VERIFY_EQ(lv.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        TERARK_VERIFY_EQ(lv[i], keys[i]);
+    }
+    std::mt19937_64 rnd(keys.size());
+    auto check_bound = [&](const LearnedUintVec& v, uint64_t key) {
+        size_t lb = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+        size_t ub = std::upper_bound(keys.begin(), keys.end(), key) - keys.begin();
+        TERARK_VERIFY_EQ(v.lower_bound(key), lb);
+        TERARK_VERIFY_EQ(v.upper_bound(key), ub);
+    };
+    for (size_t i = 0; i < keys.size(); ++i) {
+        check_bound(lv, keys[i]);
+        check_bound(lv, keys[i] - 1);
+        check_bound(lv, keys[i] + 1);
+    }
+    for (size_t i = 0; i < 1000; ++i) {
+        check_bound(lv, rnd());
+    }
+    check_bound(lv, 0);
+    check_bound(lv, UINT64_MAX);
+
+    // load from a copy of the memory image
+    valvec<byte_t> image(lv.data(), lv.mem_size());
+    LearnedUintVec lv2;
+    lv2.risk_set_data(image.data(), image.size());
+    TERARK_VERIFY_EQ(lv2.num_segments(), lv.num_segments());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        TERARK_VERIFY_EQ(lv2[i], keys[i]);
+        check_bound(lv2, keys[i]);
+    }
+    lv2.risk_release_ownership();
+    printf("size = %8zd, eps = %3zd, segs = %6zd, bits = %2zd, bytes/key = %6.3f\n",
+        keys.size(), epsilon, lv.num_segments(), lv.residual_bits(),
+        keys.size() ? double(lv.mem_size()) / keys.size() : 0.0);
+}
+
+static void unit_test_invalid() {
+    uint64_t keys[] = { 1, 3, 3 };
+    LearnedUintVec lv;
+    try {
+        lv.build_from(keys, 3, 16);
+        TERARK_DIE("should throw");
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+static void bench(const valvec<uint64_t>& keys) {
+    LearnedUintVec lv;
+    lv.build_from(keys, 32);
+    std::mt19937_64 rnd(1);
+    valvec<uint64_t> q(1 << 20, valvec_no_init());
+    for (auto& x : q) x = keys[rnd() % keys.size()];
+    profiling pf;
+    size_t sum1 = 0, sum2 = 0;
+    long long t0 = pf.now();
+    for (auto x : q) sum1 += std::lower_bound(keys.begin(), keys.end(), x) - keys.begin();
+    long long t1 = pf.now();
+    for (auto x : q) sum2 += lv.lower_bound(x);
+    long long t2 = pf.now();
+    TERARK_VERIFY_EQ(sum1, sum2);
+    printf("lower_bound: std = %6.2f ns, learned = %6.2f ns, mem = %zd vs %zd\n",
+        pf.nf(t0, t1) / q.size(), pf.nf(t1, t2) / q.size(),
+        keys.size() * 8, lv.mem_size());
+}
+
+int main(int argc, char* argv[]) {
+    unit_test_invalid();
+    std::mt19937_64 rnd(12345);
+    valvec<uint64_t> keys;
+    check(keys, 8);
+    keys.push_back(77);
+    check(keys, 8);
+    keys.push_back(UINT64_MAX);
+    keys[0] = 0;
+    check(keys, 1);
+    for (size_t eps : {1, 8, 32, 128}) {
+        // linear with noise
+        keys.erase_all();
+        for (size_t i = 0; i < 100000; ++i)
+            keys.push_back(i * 1000 + rnd() % 900);
+        check(keys, eps);
+        // uniform random, full 64 bit range
+        keys.erase_all();
+        for (size_t i = 0; i < 100000; ++i)
+            keys.push_back(rnd());
+        std::sort(keys.begin(), keys.end());
+        keys.trim(std::unique(keys.begin(), keys.end()));
+        check(keys, eps);
+        // piecewise with jumps and dense runs
+        keys.erase_all();
+        uint64_t x = 0;
+        for (size_t i = 0; i < 100000; ++i) {
+            x += i % 5000 < 2500 ? 1 : 1 + rnd() % 100000;
+            keys.push_back(x);
+        }
+        check(keys, eps);
+    }
+    if (argc > 1 && strcmp(argv[1], "-b") == 0)
+        bench(keys);
+    printf("learned_uint_vec_test passed\n");
+    return 0;
+}
@@ -12,6 +12,8 @@
 #include <random>
 #include <terark/bitmap.hpp>
 #include <terark/rank_select.hpp>
+#include <terark/succinct/rank_select_batch.hpp>
+#include <terark/util/profiling.hpp>
 
 using namespace terark;
 
@@ -97,6 +99,67 @@ inline bm_uint_t rand_word() {
     return mt();
 }
 
+static const char* const batch_kernels[] = { "scalar", "avx2", "avx512" };
+
+template<class RsBitVec>
+void test_batch(const RsBitVec& rs) {
+    valvec<size_t> pos(rs.size() + 1, valvec_no_init());
+    valvec<size_t> ranks(rs.max_rank1(), valvec_no_init());
+    valvec<size_t> out(pos.size() + 1, valvec_no_init());
+    for (size_t i = 0; i < pos.size(); ++i) pos[i] = i;
+    for (size_t i = 0; i < ranks.size(); ++i) ranks[i] = i;
+    std::mt19937_64 rnd(rs.size());
+    std::shuffle(pos.begin(), pos.end(), rnd);
+    std::shuffle(ranks.begin(), ranks.end(), rnd);
+    for (const char* kernel : batch_kernels) {
+        if (!rank_select_batch_set_kernel(kernel))
+            continue;
+        rank1_batch(rs, pos.data(), pos.size(), out.data());
+        for (size_t i = 0; i < pos.size(); ++i)
+            TERARK_VERIFY_EQ(out[i], rs.rank1(pos[i]));
+        select1_batch(rs, ranks.data(), ranks.size(), out.data());
+        for (size_t i = 0; i < ranks.size(); ++i)
+            TERARK_VERIFY_EQ(out[i], rs.select1(ranks[i]));
+    }
+}
+
+template<class RsBitVec>
+void bench_batch(const RsBitVec& rs, const char* name) {
+    valvec<size_t> pos(1 << 20, valvec_no_init());
+    valvec<size_t> ranks(1 << 20, valvec_no_init());
+    valvec<size_t> out(1 << 20, valvec_no_init());
+    for (auto& x : pos) x = mt() % rs.size();
+    for (auto& x : ranks) x = mt() % rs.max_rank1();
+    profiling pf;
+    size_t sum1 = 0;
+    long long t0 = pf.now();
+    for (size_t i = 0; i < pos.size(); ++i) sum1 += rs.rank1(pos[i]);
+    long long t1 = pf.now();
+    for (size_t i = 0; i < ranks.size(); ++i) sum1 += rs.select1(ranks[i]);
+    long long t2 = pf.now();
+    printf("%-24s single: rank1 %6.2f ns, select1 %6.2f ns\n", name,
+        pf.nf(t0, t1) / pos.size(), pf.nf(t1, t2) / ranks.size());
+    for (const char* kernel : batch_kernels) {
+        if (!rank_select_batch_set_kernel(kernel))
+            continue;
+        size_t sum2 = 0;
+        t0 = pf.now();
+        for (size_t i = 0; i < pos.size(); i += 32) {
+            rank1_batch(rs, pos.data() + i, 32, out.data() + i);
+        }
+        for (size_t x : out) sum2 += x;
+        t1 = pf.now();
+        for (size_t i = 0; i < ranks.size(); i += 32) {
+            select1_batch(rs, ranks.data() + i, 32, out.data() + i);
+        }
+        for (size_t x : out) sum2 += x;
+        t2 = pf.now();
+        TERARK_VERIFY_EQ(sum1, sum2);
+        printf("%-24s %6s: rank1 %6.2f ns, select1 %6.2f ns\n", name, kernel,
+            pf.nf(t0, t1) / pos.size(), pf.nf(t1, t2) / ranks.size());
+    }
+}
+
 template<class RsBitVec>
 void test_rs(RsBitVec& rs) {
     auto bldata = rs.bldata();
@@ -191,6 +254,7 @@ void test_rs(RsBitVec& rs) {
         assert(ffff_s1 == slow_s1);
         assert(fast_s1 == slow_s1);
     }
+    test_batch(rs);
 }
 
 template<>
@@ -413,10 +477,132 @@ void test_mixed(size_t max_bits) {
     rs2.risk_release_ownership();
 }
 
+template<class RsBitVec>
+void check_same_cache(const RsBitVec& x, const RsBitVec& y, size_t LineBits) {
+    size_t num_lines = (x.size() + LineBits - 1) / LineBits;
+    TERARK_VERIFY_EQ(x.max_rank0(), y.max_rank0());
+    TERARK_VERIFY_EQ(x.max_rank1(), y.max_rank1());
+    // the sentinel line is checked by max_rank1
+    size_t rank_cache_bytes = sizeof(*x.get_rank_cache()) * num_lines;
+    TERARK_VERIFY_EQ(memcmp(x.get_rank_cache(), y.get_rank_cache(), rank_cache_bytes), 0);
+    size_t slots0 = (x.max_rank0() + LineBits - 1) / LineBits + 1;
+    size_t slots1 = (x.max_rank1() + LineBits - 1) / LineBits + 1;
+    TERARK_VERIFY_EQ(memcmp(x.get_sel0_cache(), y.get_sel0_cache(), sizeof(*x.get_sel0_cache()) * slots0), 0);
+    TERARK_VERIFY_EQ(memcmp(x.get_sel1_cache(), y.get_sel1_cache(), sizeof(*x.get_sel1_cache()) * slots1), 0);
+}
+
+// build_cache_parallel must have the same result as build_cache
+template<class RsBitVec>
+void test_parallel(size_t max_bits) {
+    for (size_t threads : {2, 3, 7, 64}) {
+        RsBitVec rs1(max_bits, valvec_no_init());
+        RsBitVec rs2(max_bits, valvec_no_init());
+        for (size_t i = 0; i < rs1.num_words(); ++i) {
+            bm_uint_t w = rand_word();
+            w = w % 4 == 0 ? size_t(-1) : rand() % 5 == 1 ? 0 : w;
+            rs1.set_word(i, w);
+            rs2.set_word(i, w);
+        }
+        rs1.build_cache(true, true);
+        rs2.build_cache_parallel(true, true, threads);
+        check_same_cache(rs1, rs2, RsBitVec::LineBits);
+    }
+}
+
+template<class RsBitVec, size_t Arity, size_t I>
+struct test_parallel_mixed_dimensions {
+    static void test(RsBitVec& rs1, RsBitVec& rs2, size_t threads) {
+        auto& x = rs1.template get<I>();
+        auto& y = rs2.template get<I>();
+        for (size_t i = 0; i < x.num_words(); ++i) {
+            bm_uint_t w = rand_word();
+            w = w % 4 == 0 ? size_t(-1) : rand() % 5 == 1 ? 0 : w;
+            x.set_word(i, w);
+            y.set_word(i, w);
+        }
+        x.build_cache(true, true);
+        y.build_cache_parallel(true, true, threads);
+        check_same_cache(x, y, RsBitVec::LineBits);
+        test_parallel_mixed_dimensions<RsBitVec, Arity, I + 1>::test(rs1, rs2, threads);
+    }
+};
+template<class RsBitVec, size_t Arity>
+struct test_parallel_mixed_dimensions<RsBitVec, Arity, Arity> {
+    static void test(RsBitVec&, RsBitVec&, size_t) {
+    }
+};
+
+template<class RsBitVec, size_t Arity>
+void test_parallel_mixed(size_t max_bits) {
+    for (size_t threads : {2, 3, 7, 64}) {
+        // the rank cache of a dimension is interleaved with the others,
+        // zero init, so the dimensions not built yet are same
+        RsBitVec rs1(max_bits, valvec_no_init());
+        RsBitVec rs2(max_bits, valvec_no_init());
+        memset((void*)rs1.data(), 0, rs1.mem_size());
+        memset((void*)rs2.data(), 0, rs2.mem_size());
+        test_parallel_mixed_dimensions<RsBitVec, Arity, 0>::test(rs1, rs2, threads);
+    }
+}
+
+// rank_select_rrr at a given density, compared with rank_select_il
+void test_rrr(size_t max_bits, double density, bool speed_select) {
+    rank_select_il ref(max_bits, false);
+    rank_select_rrr rs(max_bits, false);
+    std::bernoulli_distribution bern(density);
+    for (size_t i = 0; i < max_bits; ++i) {
+        if (bern(mt)) {
+            ref.set1(i);
+            rs.set1(i);
+        }
+    }
+    ref.build_cache(true, true);
+    rs.build_cache(speed_select, speed_select);
+    TERARK_VERIFY_EQ(rs.size(), ref.size());
+    TERARK_VERIFY_EQ(rs.max_rank1(), ref.max_rank1());
+    for (size_t i = 0; i < max_bits; ++i) {
+        TERARK_VERIFY_EQ(rs.is1(i), ref.is1(i));
+        TERARK_VERIFY_EQ(rs.rank1(i), ref.rank1(i));
+        TERARK_VERIFY_EQ(rs.zero_seq_len(i), std::min(ref.zero_seq_len(i), max_bits - i));
+    }
+    TERARK_VERIFY_EQ(rs.rank1(max_bits), ref.max_rank1());
+    for (size_t i = 0; i < rs.max_rank1(); ++i)
+        TERARK_VERIFY_EQ(rs.select1(i), ref.select1(i));
+    for (size_t i = 0; i < rs.max_rank0(); ++i)
+        TERARK_VERIFY_EQ(rs.select0(i), ref.select0(i));
+    rank_select_rrr copy(rs);
+    TERARK_VERIFY_EQ(copy.rank1(max_bits / 2), rs.rank1(max_bits / 2));
+    if (density < 0.1 || density > 0.9) {
+        TERARK_VERIFY_LT(rs.mem_size(), ref.mem_size() / 2);
+    }
+}
+
+template<class RsBitVec>
+void bench(const char* name) {
+    RsBitVec rs(size_t(1) << 28, valvec_no_init());
+    for (size_t i = 0; i < rs.num_words(); ++i) {
+        rs.set_word(i, rand_word());
+    }
+    rs.build_cache(true, true);
+    bench_batch(rs, name);
+}
+
+template<class RsBitVec>
+void bench_mixed(const char* name) {
+    RsBitVec rs_base(size_t(1) << 28, valvec_no_init());
+    auto& rs = rs_base.template get<1>();
+    rs.resize(size_t(1) << 28);
+    for (size_t i = 0; i < rs.num_words(); ++i) {
+        rs.set_word(i, rand_word());
+    }
+    rs.build_cache(true, true);
+    bench_batch(rs, name);
+}
+
 int main(int argc, char* argv[]) {
     size_t max_bits = 10000;
     if (argc < 2) {
-        fprintf(stderr, "usage: %s num_max_bits(default=10000)\n", argv[0]);
+        fprintf(stderr, "usage: %s num_max_bits(default=10000) [-b]\n", argv[0]);
     }
     else {
         max_bits = strtoul(argv[1], NULL, 10);
@@ -437,6 +623,11 @@ int main(int argc, char* argv[]) {
     test<rank_select_se       >(max_bits);
     test<rank_select_se_512   >(max_bits);
     test<rank_select_se_512_64>(max_bits);
+    test<rank_select_rrr      >(max_bits);
+    for (double density : {0.0, 0.001, 0.02, 0.3, 0.5, 0.98, 1.0}) {
+        test_rrr(max_bits, density, true);
+        test_rrr(max_bits, density, false);
+    }
 
     test_mixed<rank_select_mixed_il_256   , 2>(max_bits);
     test_mixed<rank_select_mixed_se_512   , 2>(max_bits);
@@ -444,6 +635,20 @@ int main(int argc, char* argv[]) {
     test_mixed<rank_select_mixed_xl_256<3>, 3>(max_bits);
     test_mixed<rank_select_mixed_xl_256<4>, 4>(max_bits);
 
+    test_parallel<rank_select_il        >(max_bits);
+    test_parallel<rank_select_se_512    >(max_bits);
+    test_parallel<rank_select_se_512_64 >(max_bits);
+    test_parallel_mixed<rank_select_mixed_xl_256<2>, 2>(max_bits);
+    test_parallel_mixed<rank_select_mixed_xl_256<3>, 3>(max_bits);
+
+    if (argc > 2 && strcmp(argv[2], "-b") == 0) {
+        fprintf(stderr, "batch kernel: %s\n", rank_select_batch_kernel_name());
+        bench<rank_select_il        >("rank_select_il");
+        bench<rank_select_se_512    >("rank_select_se_512");
+        bench_mixed<rank_select_mixed_il_256   >("rank_select_mixed_il_256");
+        bench_mixed<rank_select_mixed_xl_256<2> >("rank_select_mixed_xl_256");
+    }
+
     fprintf(stderr, "All Passed!\n");
     return 0;
 }
@@ -299,7 +299,7 @@ void unit_nlt() {
         };
         unit_test_run<NLT>(insert);
     }
-    rewind(stdin);
+    rewind(fp);
     printf("\n");
 }
 
@@ -327,6 +327,7 @@ void unit_test() {
     }
     if (test_nlt) {
         unit_nlt<NestLoudsTrieDAWG_IL_256_32_FL>();
+        unit_nlt<NestLoudsTrieDAWG_IL_256_32_RRR_FL>();
         unit_nlt<NestLoudsTrieDAWG_IL_256      >();
     }
     {
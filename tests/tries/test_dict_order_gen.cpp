@@ -46,6 +46,7 @@ int main(int argc, char* argv[]) {
 	NestLoudsTrieDAWG_SE_512 trie;
 	trie.build_from(strVec, conf);
 	valvec<byte_t> trieKey;
+	valvec<size_t> states;
 	NonRecursiveDictionaryOrderToStateMapGenerator gen;
 	gen(trie, [&](size_t byteLexNth, size_t state) {
 		size_t trieIdx = trie.state_to_word_id(state);
@@ -54,7 +55,17 @@ int main(int argc, char* argv[]) {
 		TERARK_RT_assert(hashKey == trieKey, std::logic_error);
 	//	printf("%zd %zd\n", byteLexNth, trieIdx);
 	//	printf("%s\n", hashKey.c_str());
+		states.push_back(state);
 	});
+	valvec<size_t> ranks(states.size(), valvec_no_init());
+	valvec<size_t> ids(states.size(), valvec_no_init());
+	trie.state_to_dict_rank_batch(states.data(), states.size(), ranks.data());
+	trie.state_to_word_id_batch(states.data(), states.size(), ids.data());
+	for (size_t i = 0; i < states.size(); ++i) {
+		TERARK_VERIFY_EQ(ranks[i], i);
+		TERARK_VERIFY_EQ(ranks[i], trie.state_to_dict_rank(states[i]));
+		TERARK_VERIFY_EQ(ids[i], trie.state_to_word_id(states[i]));
+	}
 	return 0;
 }
 
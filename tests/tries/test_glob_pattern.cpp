@@ -0,0 +1,90 @@
+#include <terark/fsa/cspptrie.hpp>
+#include <terark/fsa/glob_pattern.hpp>
+#include <terark/fsa/nest_trie_dawg.hpp>
+#include <terark/util/sortable_strvec.hpp>
+#include <random>
+#include <set>
+
+using namespace terark;
+
+static void check(const BaseDFA& dfa, const std::set<std::string>& keys,
+                  const GlobPatternDFA& pat) {
+  std::vector<std::string> expected, got;
+  for (auto& key : keys)
+    if (pat.match(key)) expected.push_back(key);
+  GlobPatternIterator iter(&dfa, &pat);
+  for (bool ok = iter.seek_begin(); ok; ok = iter.incr()) {
+    TERARK_VERIFY(dfa.v_is_term(iter.word_state()));
+    got.push_back(iter.word().str());
+  }
+  TERARK_VERIFY_EQ(expected.size(), got.size());
+  TERARK_VERIFY(expected == got); // both in lexicographic order
+}
+
+int main() {
+  GlobPatternDFA g;
+  g.compile_glob("user:*:session:[0-9]+");
+  TERARK_VERIFY(g.match("user:abc:session:123"));
+  TERARK_VERIFY(g.match("user::session:0"));
+  TERARK_VERIFY(!g.match("user:abc:session:"));
+  TERARK_VERIFY(!g.match("user:abc:session:12a"));
+  TERARK_VERIFY(g.literal_prefix() == "user:");
+  g.compile_regex("^user:.*:session:\\d+$");
+  TERARK_VERIFY(g.match("user:x:y:session:9"));
+  TERARK_VERIFY(!g.match("usr:x:session:9"));
+  g.compile_glob("[!a]?\\*");
+  TERARK_VERIFY(g.match("bc*"));
+  TERARK_VERIFY(!g.match("ac*"));
+  TERARK_VERIFY(!g.match("bcd"));
+
+  std::mt19937 rnd(54321);
+  std::set<std::string> keys;
+  const char* users[] = {"alice", "bob", "carol", "dave"};
+  for (size_t i = 0; i < 5000; ++i) {
+    std::string key = "user:";
+    key += users[rnd() % 4];
+    key += rnd() % 2 ? ":session:" : ":profile:";
+    size_t len = rnd() % 4;
+    for (size_t j = 0; j < len; ++j)
+      key.push_back(rnd() % 8 ? char('0' + rnd() % 10) : 'x');
+    keys.insert(key);
+  }
+  keys.insert("");
+  keys.insert("user");
+  SortableStrVec strVec;
+  for (auto& key : keys) strVec.push_back(key);
+  NestLoudsTrieDAWG_SE_512 dawg;
+  NestLoudsTrieConfig conf;
+  conf.initFromEnv();
+  dawg.build_from(strVec, conf);
+
+  std::unique_ptr<Patricia> pt(Patricia::create(4, 1<<20, Patricia::MultiWriteMultiRead));
+  auto wtok = pt->tls_writer_token_nn();
+  wtok->acquire(pt.get());
+  for (auto& key : keys) {
+    uint32_t val = 0;
+    TERARK_VERIFY(pt->insert(key, &val, wtok));
+  }
+
+  const char* globs[] = {"user:*:session:[0-9]+", "*", "user:bob:*", "*x*",
+                         "user:?o*", "user:[a-c]*:profile:", "nomatch*", ""};
+  const char* regexs[] = {"user:.*:session:[0-9]+", ".*", "user:(bob)", "user:\\w+:profile:x?\\d*"};
+  for (const char* p : globs) {
+    g.compile_glob(p);
+    check(dawg, keys, g);
+    check(*pt, keys, g);
+  }
+  for (const char* p : regexs) {
+    try {
+      g.compile_regex(p);
+    } catch (const std::invalid_argument&) {
+      TERARK_VERIFY(strchr(p, '(') != NULL);
+      continue;
+    }
+    check(dawg, keys, g);
+    check(*pt, keys, g);
+  }
+  wtok->release();
+  printf("test_glob_pattern passed\n");
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include <terark/fsa/cspptrie.hpp>
+#include <terark/fsa/levenshtein_automaton.hpp>
+#include <terark/fsa/nest_trie_dawg.hpp>
+#include <terark/util/sortable_strvec.hpp>
+#include <map>
+#include <random>
+
+using namespace terark;
+
+static size_t edit_distance(fstring x, fstring y) {
+  valvec<size_t> prev(y.size() + 1), curr(y.size() + 1);
+  for (size_t j = 0; j <= y.size(); ++j) prev[j] = j;
+  for (size_t i = 1; i <= x.size(); ++i) {
+    curr[0] = i;
+    for (size_t j = 1; j <= y.size(); ++j) {
+      size_t sub = prev[j-1] + (x[i-1] != y[j-1]);
+      curr[j] = std::min(sub, std::min(prev[j], curr[j-1]) + 1);
+    }
+    prev.swap(curr);
+  }
+  return prev[y.size()];
+}
+
+int main() {
+  std::mt19937 rnd(12345);
+  SortableStrVec strVec;
+  std::map<std::string, size_t> stdmap;
+  for (size_t i = 0; i < 3000; ++i) {
+    std::string key;
+    size_t len = rnd() % 9;
+    for (size_t j = 0; j < len; ++j)
+      key.push_back(char('a' + rnd() % 4));
+    if (stdmap.emplace(key, 0).second)
+      strVec.push_back(key);
+  }
+  std::unique_ptr<Patricia> pt(Patricia::create(4, 1<<20, Patricia::MultiWriteMultiRead));
+  {
+    auto wtok = pt->tls_writer_token_nn();
+    wtok->acquire(pt.get());
+    uint32_t val = 0;
+    for (auto& kv : stdmap)
+      TERARK_VERIFY(pt->insert(kv.first, &val, wtok));
+    wtok->release();
+  }
+  NestLoudsTrieDAWG_SE_512 dawg;
+  NestLoudsTrieConfig conf;
+  conf.initFromEnv();
+  dawg.build_from(strVec, conf);
+  TERARK_VERIFY_EQ(dawg.num_words(), stdmap.size());
+
+  const char* queries[] = {"", "a", "abcd", "dcba", "aaaaaaaa", "abcabcabc", "bad"};
+  for (const char* q : queries) {
+    for (size_t k = 0; k <= 3; ++k) {
+      std::map<std::string, size_t> expected;
+      for (auto& kv : stdmap) {
+        size_t d = edit_distance(q, kv.first);
+        if (d <= k) expected.emplace(kv.first, d);
+      }
+      std::map<std::string, size_t> got_pt, got_dawg, got_base;
+      std::string prev_word;
+      pt->match_levenshtein(q, k, [&](fstring w, size_t, size_t d) {
+        TERARK_VERIFY(got_pt.empty() || prev_word < w.str()); // lex order
+        prev_word = w.str();
+        got_pt.emplace(w.str(), d);
+      });
+      dawg.match_levenshtein_dawg(q, k, [&](fstring w, size_t id, size_t d) {
+        TERARK_VERIFY_EQ(dawg.index(w), id);
+        got_dawg.emplace(w.str(), d);
+      });
+      const BaseDFA& base = dawg; // generic virtual implementation
+      MatchContext ctx;
+      base.BaseDFA::match_levenshtein(ctx, initial_state, q, k,
+        [&](fstring w, size_t, size_t d) { got_base.emplace(w.str(), d); });
+      TERARK_VERIFY(expected == got_pt);
+      TERARK_VERIFY(expected == got_dawg);
+      TERARK_VERIFY(expected == got_base);
+    }
+  }
+  printf("test_levenshtein passed\n");
+  return 0;
+}
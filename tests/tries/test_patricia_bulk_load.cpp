@@ -0,0 +1,118 @@
+#include <terark/fsa/cspptrie.inl>
+#include <random>
+#include <set>
+
+using namespace terark;
+
+static void check(Patricia::ConcurrentLevel conLevel, const std::set<std::string>& keys) {
+  MainPatricia inserted(4, 64<<20, Patricia::MultiWriteMultiRead);
+  MainPatricia loaded(4, 64<<20, conLevel);
+  {
+    auto wtok = inserted.tls_writer_token_nn();
+    wtok->acquire(&inserted);
+    uint32_t nth = 0;
+    for (auto& key : keys) {
+      TERARK_VERIFY(inserted.insert(key, &nth, wtok));
+      TERARK_VERIFY(wtok->has_value());
+      nth++;
+    }
+    wtok->release();
+    inserted.sync_stat(); // MultiWriteMultiRead counts words in tls
+  }
+  std::vector<std::string> vec(keys.begin(), keys.end());
+  std::vector<uint32_t> vals(vec.size());
+  for (size_t i = 0; i < vals.size(); ++i) vals[i] = uint32_t(i);
+  size_t n = loaded.bulk_load_sorted(vec.cbegin(), vec.cend(),
+      [&](std::vector<std::string>::const_iterator it) { return &vals[it - vec.cbegin()]; },
+      conLevel);
+  TERARK_VERIFY_EQ(n, keys.size());
+  TERARK_VERIFY_EQ(loaded.num_words(), inserted.num_words());
+  TERARK_VERIFY_EQ(loaded.adfa_total_words_len(), inserted.adfa_total_words_len());
+  TERARK_VERIFY_LE(loaded.mem_size(), inserted.mem_size());
+
+  // same words in same order with same values
+  ADFA_LexIteratorUP it1(inserted.adfa_make_iter());
+  ADFA_LexIteratorUP it2(loaded.adfa_make_iter());
+  bool ok1 = it1->seek_begin(), ok2 = it2->seek_begin();
+  for (; ok1 && ok2; ok1 = it1->incr(), ok2 = it2->incr()) {
+    TERARK_VERIFY_S_EQ(it1->word(), it2->word());
+    uint32_t v1 = *(const uint32_t*)inserted.get_valptr(it1->word_state());
+    uint32_t v2 = *(const uint32_t*)loaded.get_valptr(it2->word_state());
+    TERARK_VERIFY_EQ(v1, v2);
+  }
+  TERARK_VERIFY(!ok1 && !ok2);
+  it1.reset(); it2.reset();
+
+  // still writable by the requested level
+  uint32_t nth = uint32_t(keys.size());
+  auto wtok = loaded.tls_writer_token_nn();
+  wtok->acquire(&loaded);
+  for (auto& key : keys) {
+    TERARK_VERIFY(wtok->lookup(key));
+    TERARK_VERIFY(!loaded.insert(key, &nth, wtok));
+  }
+  std::string newkey = keys.empty() ? "" : *keys.rbegin() + "~new";
+  TERARK_VERIFY(loaded.insert(newkey, &nth, wtok));
+  TERARK_VERIFY(wtok->lookup(newkey));
+  wtok->release();
+}
+
+int main() {
+  std::mt19937 rnd(8642);
+  std::set<std::string> keys;
+  keys.insert("");
+  for (size_t i = 0; i < 20000; ++i) {
+    std::string key;
+    size_t len = rnd() % 12;
+    for (size_t j = 0; j < len; ++j)
+      key.push_back(char(rnd() % 3 ? 'a' + rnd() % 6 : rnd() % 256));
+    keys.insert(key);
+  }
+  for (size_t i = 0; i < 100; ++i) { // long zpath chain
+    std::string key(rnd() % 900, 'x');
+    key += char('a' + rnd() % 26);
+    keys.insert(key);
+  }
+  for (size_t i = 0; i < 300; ++i) { // wide non-root nodes
+    std::string key = "wide";
+    key.push_back(char(i));
+    if (i % 2) key.push_back(char(rnd()));
+    keys.insert(key);
+  }
+  check(Patricia::SingleThreadShared, keys);
+  check(Patricia::OneWriteMultiRead, keys);
+  check(Patricia::MultiWriteMultiRead, keys);
+
+  // bad order: loaded prefix is still valid
+  MainPatricia pt(4, 1<<20, Patricia::MultiWriteMultiRead);
+  const char* bad[] = {"a", "b", "c", "bb"};
+  uint32_t val = 0;
+  size_t nth = 0;
+  try {
+    pt.bulk_load_sorted([&](fstring* key, const void** value) {
+      if (nth == 4)
+        return false;
+      *key = bad[nth++];
+      *value = &val;
+      return true;
+    }, Patricia::MultiWriteMultiRead);
+    TERARK_DIE("should throw");
+  } catch (const std::invalid_argument&) {
+  }
+  TERARK_VERIFY_EQ(pt.num_words(), 3);
+  auto rtok = pt.tls_reader_token();
+  rtok->acquire(&pt);
+  TERARK_VERIFY(rtok->lookup("c"));
+  TERARK_VERIFY(!rtok->lookup("bb"));
+  rtok->release();
+
+  // readonly as final level
+  MainPatricia ro(4, 1<<20, Patricia::OneWriteMultiRead);
+  const char* good[] = {"a", "ab", "b"};
+  ro.bulk_load_sorted(good, good + 3, [&](const char**) { return &val; },
+                      Patricia::NoWriteReadOnly);
+  TERARK_VERIFY(ro.is_readonly());
+  TERARK_VERIFY_EQ(ro.num_words(), 3);
+  printf("test_patricia_bulk_load passed\n");
+  return 0;
+}
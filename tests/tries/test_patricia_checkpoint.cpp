@@ -0,0 +1,141 @@
+#include <terark/fsa/cspptrie.inl>
+#include <terark/util/mmap.hpp>
+#include <random>
+#include <map>
+#include <set>
+
+using namespace terark;
+
+static const char* live_path = "test_patricia_checkpoint.live";
+static const char* ckpt_path = "test_patricia_checkpoint.ckpt";
+static const char* copy_path = "test_patricia_checkpoint.copy";
+
+static std::string reopen_conf(const char* fpath) {
+  return std::string("?reopen=1&file_path=") + fpath;
+}
+
+static void insert(MainPatricia& pt, const std::vector<std::string>& keys,
+                   size_t beg, size_t end) {
+  auto wtok = pt.tls_writer_token_nn();
+  wtok->acquire(&pt);
+  for (size_t i = beg; i < end; ++i) {
+    uint32_t val = uint32_t(i);
+    TERARK_VERIFY(pt.insert(keys[i], &val, wtok));
+  }
+  wtok->release();
+  pt.sync_stat();
+}
+
+static void verify(MainPatricia& pt, const std::vector<std::string>& keys,
+                   size_t num) {
+  TERARK_VERIFY_EQ(pt.num_words(), num);
+  auto rtok = pt.tls_reader_token();
+  rtok->acquire(&pt);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (i < num) {
+      TERARK_VERIFY_S(rtok->lookup(keys[i]), "%s", keys[i]);
+      TERARK_VERIFY_EQ(rtok->value_of<uint32_t>(), i);
+    } else {
+      TERARK_VERIFY(!rtok->lookup(keys[i]));
+    }
+  }
+  rtok->release();
+}
+
+static void copy_file(const char* src, const char* dst) {
+  MmapWholeFile mmap(src);
+  FILE* fp = fopen(dst, "wb");
+  TERARK_VERIFY(NULL != fp);
+  TERARK_VERIFY_EQ(fwrite(mmap.base, 1, mmap.size, fp), mmap.size);
+  fclose(fp);
+}
+
+static void check(Patricia::ConcurrentLevel conLevel,
+                  const std::vector<std::string>& keys) {
+  const size_t n1 = keys.size() / 4, n2 = keys.size() / 2;
+  remove(live_path);
+  remove(ckpt_path);
+  {
+    // reopen=1 on a missing file creates a new trie
+    MainPatricia pt(4, 64<<20, conLevel, reopen_conf(live_path));
+    insert(pt, keys, 0, n1);
+    pt.checkpoint(ckpt_path, 111);
+    TERARK_VERIFY_EQ(pt.checkpoint_seq(), 111);
+    insert(pt, keys, n1, n2);
+    {
+      // live file is dirty while opened for write
+      bool thrown = false;
+      try {
+        MainPatricia pt2(4, 64<<20, conLevel, reopen_conf(live_path));
+      } catch (const std::logic_error&) {
+        thrown = true;
+      }
+      TERARK_VERIFY(thrown);
+    }
+    pt.set_checkpoint_seq(222);
+  } // clean close
+
+  // clean shutdown: reopen the live file inplace
+  {
+    MainPatricia pt(4, 64<<20, conLevel, reopen_conf(live_path));
+    TERARK_VERIFY_EQ(pt.checkpoint_seq(), 222);
+    verify(pt, keys, n2);
+    insert(pt, keys, n2, keys.size());
+    verify(pt, keys, keys.size());
+  }
+  {
+    MainPatricia ro(4, 0, Patricia::NoWriteReadOnly, live_path);
+    TERARK_VERIFY_EQ(ro.num_words(), keys.size());
+    std::map<std::string, uint32_t> kv;
+    for (size_t i = 0; i < keys.size(); ++i) kv[keys[i]] = uint32_t(i);
+    ADFA_LexIteratorUP iter(ro.adfa_make_iter());
+    auto kvi = kv.begin();
+    for (bool ok = iter->seek_begin(); ok; ok = iter->incr(), ++kvi) {
+      TERARK_VERIFY_S_EQ(iter->word(), kvi->first);
+      TERARK_VERIFY_EQ(*(const uint32_t*)ro.get_valptr(iter->word_state()), kvi->second);
+    }
+    TERARK_VERIFY(kv.end() == kvi);
+  }
+
+  // crash: recover from a copy of the checkpoint, then replay the tail
+  copy_file(ckpt_path, copy_path);
+  {
+    MainPatricia pt(4, 64<<20, conLevel, reopen_conf(copy_path));
+    TERARK_VERIFY_EQ(pt.checkpoint_seq(), 111);
+    verify(pt, keys, n1);
+    insert(pt, keys, n1, keys.size());
+    verify(pt, keys, keys.size());
+  }
+  {
+    // valsize mismatch is rejected without touching the image
+    bool thrown = false;
+    try {
+      MainPatricia pt(8, 64<<20, conLevel, reopen_conf(copy_path));
+    } catch (const std::logic_error&) {
+      thrown = true;
+    }
+    TERARK_VERIFY(thrown);
+    MainPatricia pt(4, 64<<20, conLevel, reopen_conf(copy_path));
+    verify(pt, keys, keys.size());
+  }
+  remove(live_path);
+  remove(ckpt_path);
+  remove(copy_path);
+}
+
+int main() {
+  std::mt19937 rnd(2024);
+  std::set<std::string> uniq;
+  while (uniq.size() < 20000) {
+    std::string key;
+    size_t len = 1 + rnd() % 16;
+    for (size_t j = 0; j < len; ++j)
+      key.push_back(char('a' + rnd() % 26));
+    uniq.insert(key);
+  }
+  std::vector<std::string> keys(uniq.begin(), uniq.end());
+  std::shuffle(keys.begin(), keys.end(), rnd);
+  check(Patricia::MultiWriteMultiRead, keys);
+  printf("test_patricia_checkpoint passed\n");
+  return 0;
+}
@@ -0,0 +1,230 @@
+#include <terark/fsa/cspptrie.inl>
+#include <random>
+#include <map>
+#include <set>
+#include <atomic>
+#include <thread>
+
+using namespace terark;
+
+// tls tokens are just for MultiWriteMultiRead
+static Patricia::ReaderToken*
+reader_token(MainPatricia& pt, Patricia::ReaderTokenPtr& local) {
+  if (pt.concurrent_level() == Patricia::MultiWriteMultiRead)
+    return pt.tls_reader_token();
+  local.reset(new Patricia::ReaderToken());
+  return local.get();
+}
+
+static void insert(MainPatricia& pt, const std::vector<std::string>& keys,
+                   size_t beg, size_t end) {
+  Patricia::WriterTokenPtr local;
+  Patricia::WriterToken* wtok;
+  if (pt.concurrent_level() == Patricia::MultiWriteMultiRead) {
+    wtok = pt.tls_writer_token_nn();
+  } else {
+    local.reset(new Patricia::WriterToken());
+    wtok = local.get();
+  }
+  wtok->acquire(&pt);
+  for (size_t i = beg; i < end; ++i) {
+    uint32_t val = uint32_t(i);
+    TERARK_VERIFY(pt.insert(keys[i], &val, wtok));
+  }
+  wtok->release();
+  pt.sync_stat();
+}
+
+static void verify(MainPatricia& pt, const std::vector<std::string>& keys,
+                   size_t num) {
+  TERARK_VERIFY_EQ(pt.num_words(), num);
+  Patricia::ReaderTokenPtr local;
+  auto rtok = reader_token(pt, local);
+  rtok->acquire(&pt);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (i < num) {
+      TERARK_VERIFY_S(rtok->lookup(keys[i]), "%s", keys[i]);
+      TERARK_VERIFY_EQ(rtok->value_of<uint32_t>(), i);
+    } else {
+      TERARK_VERIFY(!rtok->lookup(keys[i]));
+    }
+  }
+  std::map<std::string, uint32_t> kv;
+  for (size_t i = 0; i < num; ++i) kv[keys[i]] = uint32_t(i);
+  auto iter = pt.new_iter();
+  auto kvi = kv.begin();
+  for (bool ok = iter->seek_begin(); ok; ok = iter->incr(), ++kvi) {
+    TERARK_VERIFY_S_EQ(iter->word(), kvi->first);
+    TERARK_VERIFY_EQ(iter->value_of<uint32_t>(), kvi->second);
+  }
+  TERARK_VERIFY(kv.end() == kvi);
+  iter->dispose();
+  rtok->release();
+}
+
+static void print(const char* sig, const MainPatricia& pt,
+                  const MainPatricia::CompactStat& st) {
+  printf("%-24s: mem_size = %8zd, frag = %8zd, moved = {%6zd, %8zd}, "
+         "tail = %8zd, released = %d, total released = %zd\n",
+         sig, pt.mem_size(), pt.mem_frag_size(), st.moved_nodes,
+         st.moved_bytes, st.tail_size, st.tail_released,
+         pt.compact_released_bytes());
+}
+
+static void check(Patricia::ConcurrentLevel conLevel,
+                  const std::vector<std::string>& keys) {
+  printf("%s:\n", enum_cstr(conLevel));
+  const size_t n1 = keys.size() / 2;
+  MainPatricia pt(4, 64<<20, conLevel);
+  if (Patricia::MultiWriteMultiRead == conLevel) {
+    const size_t nthr = 4;
+    std::vector<std::thread> thr;
+    for (size_t t = 0; t < nthr; ++t) {
+      thr.emplace_back([&,t]() {
+        insert(pt, keys, n1 * t / nthr, n1 * (t + 1) / nthr);
+      });
+    }
+    for (auto& th : thr) th.join();
+    pt.sync_stat();
+  } else {
+    insert(pt, keys, 0, n1);
+  }
+  size_t size0 = pt.mem_size();
+  auto st = pt.compact();
+  print("compact", pt, st);
+  TERARK_VERIFY_EQ(st.tail_released, (st.tail_size > 0));
+  TERARK_VERIFY_LE(pt.mem_size(), size0);
+  if (Patricia::MultiWriteMultiRead != conLevel) {
+    // tail of the single mempool is the top
+    TERARK_VERIFY_EQ(pt.mem_size(), size0 - st.tail_size);
+  }
+  verify(pt, keys, n1);
+
+  // compact refuses to run while a writer token is acquired
+  {
+    Patricia::WriterTokenPtr local;
+    Patricia::WriterToken* wtok;
+    if (Patricia::MultiWriteMultiRead == conLevel) {
+      wtok = pt.tls_writer_token_nn();
+    } else {
+      local.reset(new Patricia::WriterToken());
+      wtok = local.get();
+    }
+    wtok->acquire(&pt);
+    bool thrown = false;
+    try {
+      pt.compact();
+    } catch (const std::logic_error&) {
+      thrown = true;
+    }
+    TERARK_VERIFY(thrown);
+    wtok->release();
+  }
+
+  // a reader acquired before compact pins the tail
+  insert(pt, keys, n1, keys.size());
+  {
+    Patricia::ReaderTokenPtr local;
+    auto rtok = reader_token(pt, local);
+    rtok->acquire(&pt);
+    TERARK_VERIFY(rtok->lookup(keys[0]));
+    st = pt.compact();
+    print("compact with reader", pt, st);
+    if (st.tail_size) {
+      TERARK_VERIFY(!st.tail_released);
+      // nodes of the tail are still readable by the old reader
+      TERARK_VERIFY(rtok->lookup(keys[1]));
+      TERARK_VERIFY_EQ(rtok->value_of<uint32_t>(), 1);
+      st = pt.compact(); // just retry to release the tail
+      TERARK_VERIFY(!st.tail_released);
+      TERARK_VERIFY_EQ(st.moved_nodes, 0);
+    }
+    rtok->release();
+    st = pt.compact();
+    print("compact after reader", pt, st);
+    TERARK_VERIFY_EQ(st.tail_released, (st.tail_size > 0));
+  }
+  verify(pt, keys, keys.size());
+  st = pt.compact();
+  print("compact again", pt, st);
+  verify(pt, keys, keys.size());
+
+  if (Patricia::SingleThreadShared == conLevel)
+    return;
+  // readers run concurrently with compact
+  MainPatricia pt2(4, 64<<20, conLevel);
+  insert(pt2, keys, 0, keys.size());
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (size_t t = 0; t < 2; ++t) {
+    readers.emplace_back([&,t]() {
+      Patricia::ReaderTokenPtr local;
+      auto rtok = reader_token(pt2, local);
+      for (size_t i = t; !done.load(std::memory_order_relaxed); ++i) {
+        size_t k = i % keys.size();
+        rtok->acquire(&pt2);
+        TERARK_VERIFY_S(rtok->lookup(keys[k]), "%s", keys[k]);
+        TERARK_VERIFY_EQ(rtok->value_of<uint32_t>(), k);
+        rtok->release();
+      }
+    });
+  }
+  // a writer token acquired during compact waits until compact is done,
+  // compact throws if it starts while the writer token is acquired
+  std::atomic<size_t> writer_acquired(0);
+  readers.emplace_back([&]() {
+    Patricia::WriterTokenPtr local;
+    Patricia::WriterToken* wtok;
+    if (Patricia::MultiWriteMultiRead == conLevel) {
+      wtok = pt2.tls_writer_token_nn();
+    } else {
+      local.reset(new Patricia::WriterToken());
+      wtok = local.get();
+    }
+    while (!done.load(std::memory_order_relaxed)) {
+      wtok->acquire(&pt2);
+      writer_acquired++;
+      wtok->release();
+    }
+  });
+  size_t released = 0, refused = 0;
+  for (size_t round = 0; round < 20; ) {
+    try {
+      st = pt2.compact();
+    } catch (const std::logic_error&) {
+      refused++;
+      continue;
+    }
+    released += st.tail_released;
+    round++;
+    std::this_thread::yield();
+  }
+  while (0 == writer_acquired)
+    std::this_thread::yield();
+  done = true;
+  for (auto& th : readers) th.join();
+  fprintf(stderr, "writer acquired = %zd, compact refused = %zd\n",
+          size_t(writer_acquired), refused);
+  print("compact with readers", pt2, st);
+  TERARK_VERIFY_GT(released, 0);
+  verify(pt2, keys, keys.size());
+}
+
+int main() {
+  std::mt19937 rnd(2024);
+  std::set<std::string> uniq;
+  while (uniq.size() < 100000) {
+    std::string key;
+    size_t len = 1 + rnd() % 16;
+    for (size_t j = 0; j < len; ++j)
+      key.push_back(char('a' + rnd() % 26));
+    uniq.insert(key);
+  }
+  std::vector<std::string> keys(uniq.begin(), uniq.end());
+  std::shuffle(keys.begin(), keys.end(), rnd);
+  check(Patricia::SingleThreadShared, keys);
+  check(Patricia::OneWriteMultiRead, keys);
+  check(Patricia::MultiWriteMultiRead, keys);
+  printf("test_patricia_compact passed\n");
+  return 0;
+}
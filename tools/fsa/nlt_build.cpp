@@ -75,6 +75,7 @@ Options:
          m-xl-256, this is the default
          m-il-256-41
          m-xl-256-41
+         il-256-rrr, is_link and is_term are compressed, needs -F 1
     -w File
        Write words to File in NLT order
        Because NLT order is not dictionary/bytewise/strcmp/sort order.
@@ -202,6 +203,8 @@ GetoptDone:
 			return build<NestLoudsTrieDAWG_Mixed_IL_256_32_FL>(argc, argv);
 		if (strcasecmp(rank_select_impl, "m-xl-256") == 0)
 			return build<NestLoudsTrieDAWG_Mixed_XL_256_32_FL>(argc, argv);
+		if (strcasecmp(rank_select_impl, "il-256-rrr") == 0)
+			return build<NestLoudsTrieDAWG_IL_256_32_RRR_FL>(argc, argv);
 		/*
 		if (strcasecmp(rank_select_impl, "m-il-256-41") == 0)
 			return build<NestLoudsTrieDAWG_Mixed_IL_256_32_41_FL>(argc, argv);
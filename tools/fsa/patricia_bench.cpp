@@ -1,8 +1,54 @@
 #include <terark/fsa/fsa.hpp>
+#include <terark/fsa/fast_search_byte.hpp>
 #include <terark/util/fstrvec.hpp>
+#include <terark/util/profiling.hpp>
+#include <random>
+
+using namespace terark;
+
+// child label search kernels on random sorted label arrays of each fan-out
+static void bench_search_byte() {
+    std::mt19937 rnd(1234);
+    const size_t loop = 1 << 20;
+    profiling pf;
+    alignas(64) byte_t labels[16] = {0};
+    valvec<byte_t> keys(loop, valvec_no_init());
+    for (size_t n : {7, 12, 16}) {
+        valvec<byte_t> all(256, valvec_no_init());
+        for (size_t i = 0; i < 256; ++i) all[i] = byte_t(i);
+        std::shuffle(all.begin(), all.end(), rnd);
+        std::sort(all.begin(), all.begin() + n);
+        memcpy(labels, all.data(), n);
+        for (size_t i = 0; i < loop; ++i) keys[i] = all[rnd() % (2 * n)]; // ~50% hit
+        size_t sum = 0;
+        long long t0 = pf.now();
+        for (size_t i = 0; i < loop; ++i) {
+            byte_t ch = keys[i];
+            if (ch <= labels[n-1]) {
+                size_t idx = size_t(-1);
+                do idx++; while (labels[idx] < ch);
+                sum += labels[idx] == ch ? idx : n;
+            } else sum += n;
+        }
+        long long t1 = pf.now();
+        fprintf(stderr, "fanout = %2zd, linear : %6.2f ns/op\n", n, pf.nf(t0, t1)/loop);
+      #if defined(__SSE2__)
+        size_t sum2 = 0;
+        t0 = pf.now();
+        for (size_t i = 0; i < loop; ++i)
+            sum2 += sse2_search_byte_max_16(labels, n, keys[i]);
+        t1 = pf.now();
+        TERARK_VERIFY_EQ(sum, sum2);
+        fprintf(stderr, "fanout = %2zd, sse2   : %6.2f ns/op\n", n, pf.nf(t0, t1)/loop);
+      #endif
+    }
+}
 
 int main(int argc, char* argv[]) {
-    using namespace terark;
+    if (argc > 1 && strcmp(argv[1], "-s") == 0) {
+        bench_search_byte();
+        return 0;
+    }
     std::unique_ptr<MatchingDFA> dfa(MatchingDFA::load_mmap(0));
     fstrvecl fsv;
     ADFA_LexIteratorUP iter(dfa->adfa_make_iter());
@@ -12,10 +58,27 @@ int main(int argc, char* argv[]) {
             fsv.push_back(word);
         } while (iter->incr());
     }
+    profiling pf;
+    long long t0 = pf.now();
     for (size_t i = 0; i < fsv.size(); ++i) {
         fstring word = fsv[i];
         TERARK_VERIFY_S(iter->seek_lower_bound(word), "word = %s", word);
     }
+    long long t1 = pf.now();
+    size_t found = 0;
+    for (size_t i = 0; i < fsv.size(); ++i) {
+        fstring word = fsv[i];
+        size_t curr = initial_state;
+        for (size_t j = 0; j < word.size() && dfa->v_nil_state() != curr; ++j) {
+            if (dfa->v_is_pzip(curr))
+                break; // state_move is the subject, zpath is not
+            curr = dfa->v_state_move(curr, byte_t(word[j]));
+        }
+        found += dfa->v_nil_state() != curr;
+    }
+    long long t2 = pf.now();
     fprintf(stderr, "key num = %zd, key len sum = %zd\n", fsv.size(), fsv.strpool.size());
+    fprintf(stderr, "seek_lower_bound: %8.3f ns/key\n", pf.nf(t0, t1)/fsv.size());
+    fprintf(stderr, "state_move walk : %8.3f ns/key, found = %zd\n", pf.nf(t1, t2)/fsv.size(), found);
     return 0;
 }
@@ -42,6 +42,7 @@ Options:
     -w Writer ConcurrentLevel
     -s print stat
     -b BenchmarkLoop : Run benchmark
+    -L Also build a trie by bulk_load_sorted from sorted keys
     -B Input is binary(bson) data
     -6 Input is base64 encoded data
 If Input-TXT-File is omitted, use stdin
@@ -96,10 +97,11 @@ int main(int argc, char* argv[]) {
     bool mark_readonly = false;
     bool print_stat = false;
     bool concWriteInterleave = false;
+    bool bulk_load = false;
     auto conLevel = Patricia::SingleThreadStrict;
     std::string ptconfstr;
     for (;;) {
-        int opt = getopt(argc, argv, "Bb:ghm:o:6:t:w:r:ijsH:");
+        int opt = getopt(argc, argv, "Bb:ghLm:o:6:t:w:r:ijsH:");
         switch (opt) {
         case -1:
             goto GetoptDone;
@@ -124,6 +126,9 @@ int main(int argc, char* argv[]) {
         case 'i':
             concWriteInterleave = true;
             break;
+        case 'L':
+            bulk_load = true;
+            break;
         case 'm':
             maxMem = ParseSizeXiB(optarg);
             break;
@@ -525,6 +530,33 @@ GetoptDone:
     long long ta = pf.now(); exec_read(strVec_find);
     long long tb = pf.now(); exec_read(strVec_lb);
     long long tc = pf.now();
+    if (bulk_load) {
+        MainPatricia trie3(sizeof(size_t), maxMem, conLevel, ptconfstr);
+        size_t i = 0, nth = 0;
+        fstring prev;
+        long long td = pf.now();
+        trie3.bulk_load_sorted([&](fstring* key, const void** value) {
+            while (i < strVec.size() && i && strVec[i] == prev)
+                i++; // skip dup
+            if (i == strVec.size())
+                return false;
+            prev = *key = strVec[i++];
+            *value = &nth;
+            nth++;
+            return true;
+        }, mark_readonly ? Patricia::NoWriteReadOnly : conLevel);
+        long long te = pf.now();
+        fprintf(stderr
+            , "patricia b_load: time = %8.3f sec, %8.3f MB/sec, QPS = %8.3f M, memory = %8.3f M, words = %zd, nodes = %zd, speed ratio = %.2f(over patricia insert)\n"
+            , pf.sf(td, te), sumkeylen / pf.uf(td, te), strVec.size() / pf.uf(td, te)
+            , trie3.mem_size() / 1e6, trie3.num_words(), trie3.v_gnode_states()
+            , pf.uf(t0, t1) / pf.uf(td, te)
+        );
+        if (trie3.num_words() != stdmap.size()) {
+            fprintf(stderr, "ERROR: bulk load words = %zd, unique keys = %zd\n"
+                , trie3.num_words(), stdmap.size());
+        }
+    }
     fprintf(stderr
         , "patricia insert: time = %8.3f sec, %8.3f MB/sec, QPS = %8.3f M, memory(sum = %8.3f M, key = %8.3f M, val = %8.3f M, fragments = %7zd (%.2f%%)), words = %zd, nodes = %zd, fanout = %.3f\n"
         , pf.sf(t0, t1), sumkeylen / pf.uf(t0, t1), strVec.size() / pf.uf(t0, t1)
@@ -70,9 +70,10 @@ Options:
   -R integer: test reorder times
   -j [BlockUnits of Zipped Offset Array]
      This option is only for DictZipBlobStore and ZipOffsetBlobStore.
-     This option takes an optional argument, must be one of {0,64,128}.
+     This option takes an optional argument, must be one of {0,64,128,e}.
      Default argument is 128.
      0 to disable offset array compression.
+     e to use Elias-Fano offset array, only for ZipOffsetBlobStore.
   -V verify zbs
   -p print progress
 
@@ -187,6 +188,7 @@ TERARK_IF_DEBUG(,try) {
 	char entropy_algo = '?'; // NO entropy
     char select_store = 'a';
     int reorder_test = 0;
+    int offsetsFormat = ZipOffsetBlobStore::kSortedUintVecOffsets;
 	bool randomUnzipBench = false;
 	const char* nlt_fname = NULL;
 	const char* sampleFile = NULL;
@@ -325,7 +327,10 @@ TERARK_IF_DEBUG(,try) {
             verify = true;
             break;
 		case 'j':
-			if (optarg) {
+			if (optarg && strcmp(optarg, "e") == 0) {
+				offsetsFormat = ZipOffsetBlobStore::kEliasFanoOffsets;
+			}
+			else if (optarg) {
 				dzopt.offsetArrayBlockUnits = atoi(optarg);
 				if (true
 					&&   0 != dzopt.offsetArrayBlockUnits // disable compression
@@ -531,6 +536,7 @@ GetoptDone:
         options.compress_level = compressLevel;
         options.checksum_level = checksumLevel;
         options.checksum_type = checksumType;
+        options.offsets_format = offsetsFormat;
         ZipOffsetBlobStore::MyBuilder zobuilder(nlt_fname, 0, options);
         for (size_t i = 0, ei = strVec.size(); i < ei; ++i) {
             zobuilder.addRecord(strVec[i]);